@@ -0,0 +1,90 @@
+#include "../LumenPCH.h"
+#include "BindlessHeap.h"
+#include "VkUtils.h"
+
+void BindlessHeap::init(VulkanContext* ctx) {
+	this->ctx = ctx;
+	VkPhysicalDeviceVulkan12Properties props12 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+	VkPhysicalDeviceProperties2 props2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+	props2.pNext = &props12;
+	vkGetPhysicalDeviceProperties2(ctx->physical_device, &props2);
+	max_descriptors = std::min({props12.maxDescriptorSetUpdateAfterBindSampledImages,
+								props12.maxPerStageDescriptorUpdateAfterBindSampledImages, 1u << 16});
+
+	VkDescriptorSetLayoutBinding binding = {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = max_descriptors;
+	binding.stageFlags = VK_SHADER_STAGE_ALL;
+	const VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+												   VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+												   VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {
+		VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+	binding_flags_info.bindingCount = 1;
+	binding_flags_info.pBindingFlags = &binding_flags;
+	VkDescriptorSetLayoutCreateInfo set_create_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+	set_create_info.pNext = &binding_flags_info;
+	set_create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	set_create_info.bindingCount = 1;
+	set_create_info.pBindings = &binding;
+	vk::check(vkCreateDescriptorSetLayout(ctx->device, &set_create_info, nullptr, &set_layout),
+			  "Failed to create the bindless set layout");
+	VkDescriptorSetLayoutCreateInfo empty_create_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+	vk::check(vkCreateDescriptorSetLayout(ctx->device, &empty_create_info, nullptr, &empty_layout),
+			  "Failed to create the empty set layout");
+
+	auto pool_size = vk::descriptor_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max_descriptors);
+	auto pool_ci = vk::descriptor_pool_CI(1, &pool_size, 1);
+	pool_ci.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	vk::check(vkCreateDescriptorPool(ctx->device, &pool_ci, nullptr, &pool), "Failed to create descriptor pool");
+	VkDescriptorSetAllocateInfo set_allocate_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+	set_allocate_info.descriptorPool = pool;
+	set_allocate_info.descriptorSetCount = 1;
+	set_allocate_info.pSetLayouts = &set_layout;
+	vk::check(vkAllocateDescriptorSets(ctx->device, &set_allocate_info, &set), "Failed to allocate the bindless set");
+	DebugMarker::set_resource_name(ctx->device, (uint64_t)set, "Bindless Heap", VK_OBJECT_TYPE_DESCRIPTOR_SET);
+	LUMEN_INFO("Bindless heap with {} texture slots", max_descriptors);
+}
+
+void BindlessHeap::destroy() {
+	if (!ctx) {
+		return;
+	}
+	vkDestroyDescriptorPool(ctx->device, pool, nullptr);
+	vkDestroyDescriptorSetLayout(ctx->device, set_layout, nullptr);
+	vkDestroyDescriptorSetLayout(ctx->device, empty_layout, nullptr);
+	pool = VK_NULL_HANDLE;
+	set_layout = empty_layout = VK_NULL_HANDLE;
+	set = VK_NULL_HANDLE;
+	num_slots = 0;
+	free_slots.clear();
+	ctx = nullptr;
+}
+
+uint32_t BindlessHeap::add(VkImageView view, VkSampler sampler, VkImageLayout layout) {
+	// Writes into the set have to be synchronized as well
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t slot;
+	if (!free_slots.empty()) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+	} else {
+		if (num_slots == max_descriptors) {
+			LUMEN_ERROR("Bindless heap is full");
+		}
+		slot = num_slots++;
+	}
+	VkDescriptorImageInfo image_info = {sampler, view, layout};
+	VkWriteDescriptorSet write =
+		vk::write_descriptor_set(set, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &image_info);
+	write.dstArrayElement = slot;
+	vkUpdateDescriptorSets(ctx->device, 1, &write, 0, nullptr);
+	return slot;
+}
+
+void BindlessHeap::remove(uint32_t slot) {
+	// The descriptor is left in place, it's partially bound and nothing indexes the slot until it's reused
+	std::lock_guard<std::mutex> lock(mutex);
+	free_slots.push_back(slot);
+}
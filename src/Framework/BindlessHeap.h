@@ -0,0 +1,35 @@
+#pragma once
+#include "../LumenPCH.h"
+
+// Descriptor set index of the heap in the shaders, set 0 holds the push descriptors and set 1 the TLAS
+#define BINDLESS_SET 2
+
+/*
+	Global descriptor set of combined image samplers that lives for the whole device. Read-only textures get a
+	persistent slot when they are loaded and shaders index the array with it (e.g. Material::texture_id), so
+	the passes don't push the scene textures anymore. Slots are written with update-after-bind, so textures
+	can be added while previously recorded command buffers that bind the set are still pending.
+*/
+class BindlessHeap {
+   public:
+	void init(VulkanContext* ctx);
+	void destroy();
+	// Returns the slot, the texture has to stay in the given layout while it is registered
+	uint32_t add(VkImageView view, VkSampler sampler, VkImageLayout layout);
+	void remove(uint32_t slot);
+	uint32_t capacity() const { return max_descriptors; }
+	uint32_t size() const { return num_slots - (uint32_t)free_slots.size(); }
+
+	VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+	// Stands in for the TLAS set in pipelines without one, the heap has to be at the same set index everywhere
+	VkDescriptorSetLayout empty_layout = VK_NULL_HANDLE;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+
+   private:
+	VulkanContext* ctx = nullptr;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	uint32_t max_descriptors = 0;
+	uint32_t num_slots = 0;
+	std::vector<uint32_t> free_slots;
+	std::mutex mutex;
+};
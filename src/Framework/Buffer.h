@@ -1,8 +1,13 @@
 #pragma once
 #include "../LumenPCH.h"
+#include "ResourceRegistry.h"
+#include "DeviceMemoryAllocator.h"
 struct Buffer {
 	VkBuffer handle{};
+	// allocation.memory, shared with other resources unless the allocation is dedicated
 	VkDeviceMemory buffer_memory = VK_NULL_HANDLE;
+	// Empty for transient buffers, their memory belongs to the render graph
+	MemoryAllocation allocation;
 	VulkanContext* ctx = nullptr;
 	void* data = nullptr;
 	VkDescriptorBufferInfo descriptor = {};
@@ -11,21 +16,28 @@ struct Buffer {
 	VkBufferUsageFlags usage_flags = 0;
 	VkMemoryPropertyFlags mem_property_flags = 0;
 	std::string name;
+	// Id in the render graph
+	ResourceHandle rg_handle;
 
 	inline void destroy() {
 		if (handle) vkDestroyBuffer(ctx->device, handle, nullptr);
-		if (buffer_memory) vkFreeMemory(ctx->device, buffer_memory, nullptr);
+		if (allocation) ctx->allocator->free(allocation);
+		buffer_memory = VK_NULL_HANDLE;
+		data = nullptr;
 	}
 
 	inline void bind(VkDeviceSize offset = 0) {
-		vk::check(vkBindBufferMemory(ctx->device, handle, buffer_memory, offset), "Failed to bind buffer");
+		vk::check(vkBindBufferMemory(ctx->device, handle, buffer_memory, allocation.offset + offset),
+				  "Failed to bind buffer");
 	}
 
+	// Host visible memory stays mapped by the allocator, this only hands out the pointer
 	inline void map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
-		vk::check(vkMapMemory(ctx->device, buffer_memory, offset, size, 0, &data), "Unable to map memory");
+		LUMEN_ASSERT(allocation.mapped, "Unable to map memory");
+		data = allocation.mapped + offset;
 	}
 
-	inline void unmap() { vkUnmapMemory(ctx->device, buffer_memory); }
+	inline void unmap() { data = nullptr; }
 
 	inline VkDeviceAddress get_device_address() {
 		VkBufferDeviceAddressInfo info = {VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
@@ -40,6 +52,12 @@ struct Buffer {
 					   VkSharingMode sharing_mode, VkDeviceSize size, void* data = nullptr, bool use_staging = false) {
 		return create("", ctx, flags, mem_property_flags, sharing_mode, size, data, use_staging);
 	}
+	// Creates the handle without any backing memory, see bind_memory()
+	void create_unbound(const char* name, VulkanContext*, VkBufferUsageFlags, VkDeviceSize);
+	inline void bind_memory(VkDeviceMemory memory, VkDeviceSize offset) {
+		vk::check(vkBindBufferMemory(ctx->device, handle, memory, offset), "Failed to bind buffer");
+		prepare_descriptor();
+	}
 	void flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 	void invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 	void prepare_descriptor(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
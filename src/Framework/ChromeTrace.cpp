@@ -0,0 +1,50 @@
+#include "ChromeTrace.h"
+#include <cstdio>
+#include <fstream>
+
+static std::string escape_json(const std::string& str) {
+	std::string res;
+	res.reserve(str.size());
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			res += '\\';
+			res += c;
+		} else if ((unsigned char)c < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			res += buf;
+		} else {
+			res += c;
+		}
+	}
+	return res;
+}
+
+bool write_chrome_trace(const std::string& path, std::span<const TraceEvent> events,
+						std::span<const std::string> extra_tracks) {
+	std::ofstream out(path);
+	if (!out) {
+		return false;
+	}
+	const char* track_names[] = {"CPU", "GPU Graphics", "GPU Compute"};
+	out << "{\"traceEvents\":[\n";
+	for (uint32_t tid = 0; tid < 3; tid++) {
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"name\":\""
+			<< track_names[tid] << "\"}},\n";
+	}
+	for (uint32_t i = 0; i < extra_tracks.size(); i++) {
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << 3 + i << ",\"args\":{\"name\":\""
+			<< escape_json(extra_tracks[i]) << "\"}},\n";
+	}
+	out.precision(3);
+	out << std::fixed;
+	for (size_t i = 0; i < events.size(); i++) {
+		const TraceEvent& e = events[i];
+		out << "{\"name\":\"" << escape_json(e.name) << "\",\"cat\":\"" << e.category
+			<< "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.tid << ",\"ts\":" << e.start_us
+			<< ",\"dur\":" << e.duration_us << "}";
+		out << (i + 1 < events.size() ? ",\n" : "\n");
+	}
+	out << "],\"displayTimeUnit\":\"ms\"}\n";
+	return out.good();
+}
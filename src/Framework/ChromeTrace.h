@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Complete ("X") event in the chrome://tracing JSON format, times in microseconds
+struct TraceEvent {
+	std::string name;
+	const char* category = "cpu";
+	double start_us = 0.0;
+	double duration_us = 0.0;
+	// Track the event shows up in, CPU phases and GPU queues are kept apart
+	uint32_t tid = 0;
+};
+
+// Tracks 0-2 are the CPU and the two GPU queues, extra_tracks names the ones from tid 3 on
+bool write_chrome_trace(const std::string& path, std::span<const TraceEvent> events,
+						std::span<const std::string> extra_tracks = {});
@@ -1,5 +1,6 @@
 #include "../LumenPCH.h"
 #include "CommandBuffer.h"
+#include "UploadContext.h"
 CommandBuffer::CommandBuffer(VulkanContext* ctx, bool begin, VkCommandBufferUsageFlags begin_flags, QueueType type,
 							 VkCommandBufferLevel level) {
 	this->ctx = ctx;
@@ -27,24 +28,43 @@ void CommandBuffer::begin(VkCommandBufferUsageFlags begin_flags) {
 	state = CommandBufferState::RECORDING;
 }
 
-void CommandBuffer::submit(bool wait_fences, bool queue_wait_idle) {
+void CommandBuffer::submit(bool wait_fences, bool queue_wait_idle, const VkSemaphoreSubmitInfo* wait_info) {
+	VkSemaphoreSubmitInfo wait_infos[2];
+	uint32_t wait_count = 0;
+	if (wait_info && wait_info->semaphore) {
+		wait_infos[wait_count++] = *wait_info;
+	}
+	// The work may read anything uploaded so far, on the graphics queue the submission order is enough
+	if (ctx->uploader) {
+		ctx->uploader->flush();
+		if (type != QueueType::GFX) {
+			const VkSemaphoreSubmitInfo upload_wait = ctx->uploader->wait_info();
+			if (upload_wait.semaphore) {
+				wait_infos[wait_count++] = upload_wait;
+			}
+		}
+	}
 	vk::check(vkEndCommandBuffer(handle), "Failed to end command buffer");
 	++VulkanSyncronization::available_command_pools;
 	VulkanSyncronization::cv.notify_one();
 	state = CommandBufferState::STOPPED;
-	VkSubmitInfo submit_info = vk::submit_info();
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &handle;
+	VkCommandBufferSubmitInfo cmd_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+	cmd_info.commandBuffer = handle;
+	VkSubmitInfo2 submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+	submit_info.commandBufferInfoCount = 1;
+	submit_info.pCommandBufferInfos = &cmd_info;
+	submit_info.waitSemaphoreInfoCount = wait_count;
+	submit_info.pWaitSemaphoreInfos = wait_infos;
 	VulkanSyncronization::queue_mutex.lock();
 	if (wait_fences) {
 		VkFenceCreateInfo fence_info = vk::fence_create_info(0);
 		VkFence fence;
 		vk::check(vkCreateFence(ctx->device, &fence_info, nullptr, &fence), "Fence creation error");
-		vk::check(vkQueueSubmit(ctx->queues[(int)type], 1, &submit_info, fence), "Queue submission error");
+		vk::check(vkQueueSubmit2(ctx->queues[(int)type], 1, &submit_info, fence), "Queue submission error");
 		vk::check(vkWaitForFences(ctx->device, 1, &fence, VK_TRUE, 100000000000), "Fence wait error");
 		vkDestroyFence(ctx->device, fence, nullptr);
 	} else {
-		vk::check(vkQueueSubmit(ctx->queues[(int)type], 1, &submit_info, VK_NULL_HANDLE), "Queue submission error");
+		vk::check(vkQueueSubmit2(ctx->queues[(int)type], 1, &submit_info, VK_NULL_HANDLE), "Queue submission error");
 	}
 	if (queue_wait_idle) {
 		vk::check(vkQueueWaitIdle(ctx->queues[(int)type]), "Queue wait error! Check previous submissions");
@@ -7,7 +7,8 @@ class CommandBuffer {
 				  QueueType type = QueueType::GFX, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	~CommandBuffer();
 	void begin(VkCommandBufferUsageFlags begin_flags = 0);
-	void submit(bool wait_fences = true, bool queue_wait_idle = true);
+	// wait_info: Optional semaphore the submission waits on (e.g. async compute work of the render graph)
+	void submit(bool wait_fences = true, bool queue_wait_idle = true, const VkSemaphoreSubmitInfo* wait_info = nullptr);
 
 	VkCommandBuffer handle = VK_NULL_HANDLE;
 
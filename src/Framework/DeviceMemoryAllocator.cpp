@@ -0,0 +1,246 @@
+#include "../LumenPCH.h"
+#include "DeviceMemoryAllocator.h"
+#include "VkUtils.h"
+
+static constexpr VkDeviceSize MAX_BLOCK_SIZE = 64ull << 20;
+
+void DeviceMemoryAllocator::init(VulkanContext* ctx) {
+	this->ctx = ctx;
+	const VkPhysicalDeviceMemoryProperties& props = ctx->memory_properties;
+	for (uint32_t i = 0; i < props.memoryTypeCount; i++) {
+		// Small heaps (e.g. the 256 MB host visible device local one) still get a few blocks
+		const VkDeviceSize heap_size = props.memoryHeaps[props.memoryTypes[i].heapIndex].size;
+		const VkDeviceSize block_size = std::max<VkDeviceSize>(std::min(MAX_BLOCK_SIZE, heap_size / 8), 1 << 20);
+		for (AllocationKind kind : {AllocationKind::Linear, AllocationKind::Optimal}) {
+			Pool& pool = pools[2 * i + (uint32_t)kind];
+			pool.memory_type = i;
+			pool.kind = kind;
+			pool.block_size = block_size;
+		}
+	}
+}
+
+void DeviceMemoryAllocator::destroy() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Pool& pool : pools) {
+		for (Block& block : pool.blocks) {
+			if (!block.memory) {
+				continue;
+			}
+			if (!block.placement.empty()) {
+				LUMEN_WARN("{} allocations leaked in memory type {}", block.placement.allocation_count(),
+						   pool.memory_type);
+			}
+			release_memory(block.memory);
+		}
+		pool.blocks.clear();
+	}
+	if (num_dedicated) {
+		LUMEN_WARN("{} dedicated allocations leaked", num_dedicated);
+	}
+	ctx = nullptr;
+}
+
+VkDeviceMemory DeviceMemoryAllocator::allocate_memory(VkDeviceSize size, uint32_t memory_type, AllocationKind kind,
+													  uint8_t** mapped) {
+	VkMemoryAllocateInfo alloc_info = vk::memory_allocate_info();
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = memory_type;
+	// Any buffer in the block might need its device address
+	VkMemoryAllocateFlagsInfo flags_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO};
+	if (kind == AllocationKind::Linear) {
+		flags_info.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+		alloc_info.pNext = &flags_info;
+	}
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	vk::check(vkAllocateMemory(ctx->device, &alloc_info, nullptr, &memory), "Failed to allocate device memory");
+	*mapped = nullptr;
+	if (ctx->memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		vk::check(vkMapMemory(ctx->device, memory, 0, VK_WHOLE_SIZE, 0, (void**)mapped), "Unable to map memory");
+	}
+	peak_device_allocations = std::max(peak_device_allocations, ++num_device_allocations);
+	return memory;
+}
+
+void DeviceMemoryAllocator::release_memory(VkDeviceMemory memory) {
+	// Freeing implicitly unmaps
+	vkFreeMemory(ctx->device, memory, nullptr);
+	num_device_allocations--;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate(const VkMemoryRequirements& reqs, VkMemoryPropertyFlags props,
+												 AllocationKind kind) {
+	const uint32_t memory_type = find_memory_type(&ctx->physical_device, reqs.memoryTypeBits, props);
+	LUMEN_ASSERT(memory_type < ctx->memory_properties.memoryTypeCount, "Failed to find suitable memory type!");
+	const uint32_t pool_idx = 2 * memory_type + (uint32_t)kind;
+	Pool& pool = pools[pool_idx];
+	MemoryAllocation allocation;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (reqs.size > pool.block_size / 2) {
+		allocation.memory = allocate_memory(reqs.size, memory_type, kind, &allocation.mapped);
+		allocation.size = reqs.size;
+		num_dedicated++;
+		dedicated_bytes += reqs.size;
+		return allocation;
+	}
+	uint32_t block_idx = UINT32_MAX;
+	uint32_t node = TLSFAllocator::INVALID;
+	for (uint32_t i = 0; i < pool.blocks.size() && node == TLSFAllocator::INVALID; i++) {
+		if (pool.blocks[i].memory) {
+			node = pool.blocks[i].placement.allocate(reqs.size, reqs.alignment);
+			block_idx = i;
+		}
+	}
+	if (node == TLSFAllocator::INVALID) {
+		block_idx = (uint32_t)pool.blocks.size();
+		for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+			if (!pool.blocks[i].memory) {
+				block_idx = i;
+				break;
+			}
+		}
+		if (block_idx == pool.blocks.size()) {
+			pool.blocks.emplace_back();
+		}
+		Block& block = pool.blocks[block_idx];
+		block.memory = allocate_memory(pool.block_size, memory_type, kind, &block.mapped);
+		block.placement = TLSFAllocator(pool.block_size);
+		node = block.placement.allocate(reqs.size, reqs.alignment);
+		LUMEN_ASSERT(node != TLSFAllocator::INVALID, "Allocation doesn't fit into an empty block");
+	}
+	const Block& block = pool.blocks[block_idx];
+	allocation.memory = block.memory;
+	allocation.offset = block.placement.offset(node);
+	allocation.size = reqs.size;
+	allocation.mapped = block.mapped ? block.mapped + allocation.offset : nullptr;
+	allocation.pool = pool_idx;
+	allocation.block = block_idx;
+	allocation.node = node;
+	return allocation;
+}
+
+void DeviceMemoryAllocator::free(MemoryAllocation& allocation) {
+	if (!allocation) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	if (allocation.pool == UINT32_MAX) {
+		release_memory(allocation.memory);
+		num_dedicated--;
+		dedicated_bytes -= allocation.size;
+	} else {
+		Pool& pool = pools[allocation.pool];
+		Block& block = pool.blocks[allocation.block];
+		block.placement.free(allocation.node);
+		if (block.placement.empty()) {
+			// Keep a single empty block per pool as a cache
+			bool has_empty_block = false;
+			for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+				has_empty_block |= i != allocation.block && pool.blocks[i].memory && pool.blocks[i].placement.empty();
+			}
+			if (has_empty_block) {
+				release_memory(block.memory);
+				block = Block();
+			}
+		}
+	}
+	allocation = MemoryAllocation();
+}
+
+VkMappedMemoryRange DeviceMemoryAllocator::mapped_range(const MemoryAllocation& allocation, VkDeviceSize size,
+														VkDeviceSize offset) {
+	const VkDeviceSize atom_size = ctx->device_properties.limits.nonCoherentAtomSize;
+	const VkDeviceSize memory_size = allocation.pool == UINT32_MAX ? allocation.size : pools[allocation.pool].block_size;
+	if (size == VK_WHOLE_SIZE) {
+		size = allocation.size - offset;
+	}
+	const VkDeviceSize begin = (allocation.offset + offset) / atom_size * atom_size;
+	const VkDeviceSize end = (allocation.offset + offset + size + atom_size - 1) / atom_size * atom_size;
+	VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+	range.memory = allocation.memory;
+	range.offset = begin;
+	// The rounded up end may lie past the memory, which is only valid as VK_WHOLE_SIZE
+	range.size = end > memory_size ? VK_WHOLE_SIZE : end - begin;
+	return range;
+}
+
+void DeviceMemoryAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) {
+	const VkMappedMemoryRange range = mapped_range(allocation, size, offset);
+	vk::check(vkFlushMappedMemoryRanges(ctx->device, 1, &range), "Failed to flush mapped memory ranges");
+}
+
+void DeviceMemoryAllocator::invalidate(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) {
+	const VkMappedMemoryRange range = mapped_range(allocation, size, offset);
+	vk::check(vkInvalidateMappedMemoryRanges(ctx->device, 1, &range), "Failed to invalidate mapped memory range");
+}
+
+DeviceMemoryStats DeviceMemoryAllocator::stats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	DeviceMemoryStats res;
+	for (const Pool& pool : pools) {
+		DeviceMemoryStats::Pool pool_stats;
+		pool_stats.memory_type = pool.memory_type;
+		pool_stats.kind = pool.kind;
+		for (const Block& block : pool.blocks) {
+			if (!block.memory) {
+				continue;
+			}
+			pool_stats.blocks++;
+			pool_stats.allocations += block.placement.allocation_count();
+			pool_stats.free_ranges += block.placement.free_range_count();
+			pool_stats.reserved += block.placement.size();
+			pool_stats.used += block.placement.used();
+			pool_stats.largest_free_range =
+				std::max(pool_stats.largest_free_range, block.placement.largest_free_range());
+		}
+		if (!pool_stats.blocks) {
+			continue;
+		}
+		const VkDeviceSize free_bytes = pool_stats.reserved - pool_stats.used;
+		if (free_bytes) {
+			pool_stats.fragmentation = 1.0f - (float)pool_stats.largest_free_range / (float)free_bytes;
+		}
+		res.pools.push_back(pool_stats);
+	}
+	res.dedicated_allocations = num_dedicated;
+	res.dedicated_bytes = dedicated_bytes;
+	res.device_allocations = num_device_allocations;
+	res.peak_device_allocations = peak_device_allocations;
+	return res;
+}
+
+void DeviceMemoryAllocator::gui() {
+	const DeviceMemoryStats mem_stats = stats();
+	ImGui::Text("Device allocations %u (peak %u), dedicated %u (%.1f MB)", mem_stats.device_allocations,
+				mem_stats.peak_device_allocations, mem_stats.dedicated_allocations, mem_stats.dedicated_bytes * 1e-6);
+	if (!ImGui::BeginTable("Memory pools", 7,
+						   ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable)) {
+		return;
+	}
+	ImGui::TableSetupColumn("Type");
+	ImGui::TableSetupColumn("Blocks");
+	ImGui::TableSetupColumn("Allocations");
+	ImGui::TableSetupColumn("Used (MB)");
+	ImGui::TableSetupColumn("Reserved (MB)");
+	ImGui::TableSetupColumn("Free ranges");
+	ImGui::TableSetupColumn("Fragmentation");
+	ImGui::TableHeadersRow();
+	for (const DeviceMemoryStats::Pool& pool : mem_stats.pools) {
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("%u %s", pool.memory_type, pool.kind == AllocationKind::Linear ? "linear" : "optimal");
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", pool.blocks);
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", pool.allocations);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.1f", pool.used * 1e-6);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.1f", pool.reserved * 1e-6);
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", pool.free_ranges);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.1f%%", pool.fragmentation * 100.0f);
+	}
+	ImGui::EndTable();
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "../LumenPCH.h"
+#include "TLSFAllocator.h"
+
+// Buffers and linear images never share a block with optimal images, which satisfies bufferImageGranularity
+enum class AllocationKind { Linear, Optimal };
+
+struct MemoryAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	// Persistent mapping of offset, nullptr if the memory isn't host visible
+	uint8_t* mapped = nullptr;
+	// UINT32_MAX for dedicated allocations
+	uint32_t pool = UINT32_MAX;
+	uint32_t block = 0;
+	uint32_t node = TLSFAllocator::INVALID;
+	explicit operator bool() const { return memory != VK_NULL_HANDLE; }
+};
+
+struct DeviceMemoryStats {
+	struct Pool {
+		uint32_t memory_type = 0;
+		AllocationKind kind = AllocationKind::Linear;
+		uint32_t blocks = 0;
+		uint32_t allocations = 0;
+		uint32_t free_ranges = 0;
+		VkDeviceSize reserved = 0;
+		VkDeviceSize used = 0;
+		VkDeviceSize largest_free_range = 0;
+		// 1 - largest free range / free bytes, 0 when all free memory is a single range
+		float fragmentation = 0.0f;
+	};
+	std::vector<Pool> pools;
+	uint32_t dedicated_allocations = 0;
+	VkDeviceSize dedicated_bytes = 0;
+	// Live vkAllocateMemory allocations, blocks plus dedicated ones
+	uint32_t device_allocations = 0;
+	uint32_t peak_device_allocations = 0;
+};
+
+/*
+	Sub-allocates Buffer and Texture memory from large blocks, one list of blocks per memory type and
+	AllocationKind. Ranges inside a block are placed with a TLSFAllocator. Resources bigger than half a block get a
+	dedicated allocation. Host visible blocks are mapped once for their whole lifetime. An empty block is kept
+	around per pool, so destroying and recreating a set of resources (integrator switches, resizes) doesn't go
+	back to the driver.
+*/
+class DeviceMemoryAllocator {
+   public:
+	void init(VulkanContext* ctx);
+	void destroy();
+	MemoryAllocation allocate(const VkMemoryRequirements& reqs, VkMemoryPropertyFlags props, AllocationKind kind);
+	// Resets the allocation, does nothing for an empty one
+	void free(MemoryAllocation& allocation);
+	// Offsets are relative to the allocation, the range is expanded to nonCoherentAtomSize
+	void flush(const MemoryAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+	void invalidate(const MemoryAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+	DeviceMemoryStats stats();
+	void gui();
+
+   private:
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		uint8_t* mapped = nullptr;
+		TLSFAllocator placement;
+	};
+	struct Pool {
+		uint32_t memory_type = 0;
+		AllocationKind kind = AllocationKind::Linear;
+		VkDeviceSize block_size = 0;
+		// Released blocks leave an empty slot behind, so the indices in MemoryAllocation stay valid
+		std::vector<Block> blocks;
+	};
+
+	VkDeviceMemory allocate_memory(VkDeviceSize size, uint32_t memory_type, AllocationKind kind, uint8_t** mapped);
+	void release_memory(VkDeviceMemory memory);
+	VkMappedMemoryRange mapped_range(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset);
+
+	VulkanContext* ctx = nullptr;
+	std::array<Pool, VK_MAX_MEMORY_TYPES * 2> pools;
+	std::mutex mutex;
+	uint32_t num_dedicated = 0;
+	VkDeviceSize dedicated_bytes = 0;
+	uint32_t num_device_allocations = 0;
+	uint32_t peak_device_allocations = 0;
+};
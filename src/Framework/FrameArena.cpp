@@ -0,0 +1,46 @@
+#include "FrameArena.h"
+
+FrameArena::FrameArena(size_t initial_size) {
+	blocks.reserve(16);
+	add_block(initial_size);
+}
+
+void FrameArena::add_block(size_t size) {
+	blocks.push_back({std::make_unique<std::byte[]>(size), size});
+	offset = 0;
+	num_upstream_allocations++;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+	Block* block = &blocks.back();
+	uintptr_t base = (uintptr_t)block->data.get();
+	uintptr_t ptr = (base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	if (ptr + bytes > base + block->size) {
+		add_block(std::max(2 * block->size, bytes + alignment));
+		block = &blocks.back();
+		base = (uintptr_t)block->data.get();
+		ptr = (base + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	}
+	offset = ptr + bytes - base;
+	used_bytes += bytes;
+	return (void*)ptr;
+}
+
+void FrameArena::reset() {
+	if (blocks.size() > 1) {
+		// The frame overflowed, replace the blocks with one that fits all of it
+		const size_t size = capacity();
+		blocks.clear();
+		add_block(size);
+	}
+	offset = 0;
+	used_bytes = 0;
+}
+
+size_t FrameArena::capacity() const {
+	size_t size = 0;
+	for (const Block& block : blocks) {
+		size += block.size;
+	}
+	return size;
+}
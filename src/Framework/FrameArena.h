@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+/*
+	Linear allocator for the scratch data of a frame, used through std::pmr containers.
+	Deallocation is a no-op, everything is released at once with reset(). When a frame doesn't fit, new blocks
+	are requested from the heap and merged into a single block on the next reset(), so that in steady state
+	a frame doesn't touch the heap at all.
+*/
+class FrameArena : public std::pmr::memory_resource {
+   public:
+	explicit FrameArena(size_t initial_size = 64 * 1024);
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+	void reset();
+	// Bytes handed out since the last reset
+	size_t used() const { return used_bytes; }
+	size_t capacity() const;
+	// Heap allocations made by the arena since its creation
+	uint64_t upstream_allocations() const { return num_upstream_allocations; }
+
+   private:
+	struct Block {
+		std::unique_ptr<std::byte[]> data;
+		size_t size = 0;
+	};
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+	void add_block(size_t size);
+
+	std::vector<Block> blocks;
+	size_t offset = 0;
+	size_t used_bytes = 0;
+	uint64_t num_upstream_allocations = 0;
+};
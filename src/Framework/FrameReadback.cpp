@@ -0,0 +1,112 @@
+#include "../LumenPCH.h"
+#include "FrameReadback.h"
+
+void FrameReadback::init(VulkanContext* ctx, VkSemaphore timeline, VkDeviceSize size, uint32_t num_slots) {
+	this->ctx = ctx;
+	this->timeline = timeline;
+	// The consumers read every byte, cached memory makes that a lot faster where it exists
+	VkMemoryPropertyFlags mem_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	const VkMemoryPropertyFlags cached_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	for (uint32_t i = 0; i < ctx->memory_properties.memoryTypeCount; i++) {
+		if ((ctx->memory_properties.memoryTypes[i].propertyFlags & cached_flags) == cached_flags) {
+			mem_flags = cached_flags;
+			break;
+		}
+	}
+	for (uint32_t i = 0; i < num_slots; i++) {
+		Slot& slot = slots.emplace_back();
+		const std::string name = "Readback " + std::to_string(i);
+		slot.buffer.create(name.c_str(), ctx, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+						   mem_flags, VK_SHARING_MODE_EXCLUSIVE, size);
+	}
+	next_slot = 0;
+}
+
+void FrameReadback::destroy() {
+	for (Slot& slot : slots) {
+		if (slot.state == SlotState::Submitted) {
+			VkSemaphoreWaitInfo wait_info = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+			wait_info.semaphoreCount = 1;
+			wait_info.pSemaphores = &timeline;
+			wait_info.pValues = &slot.value;
+			vk::check(vkWaitSemaphores(ctx->device, &wait_info, UINT64_MAX), "Failed to wait for the readback");
+			consume(slot);
+		}
+	}
+	consumers.wait();
+	for (Slot& slot : slots) {
+		slot.buffer.destroy();
+	}
+	slots.clear();
+}
+
+Buffer& FrameReadback::acquire(Consumer consumer) {
+	Slot& slot = slots[next_slot];
+	next_slot = (next_slot + 1) % (uint32_t)slots.size();
+	if (slot.state != SlotState::Free) {
+		LUMEN_WARN("All readback slots are busy, waiting for the oldest one");
+		if (slot.state == SlotState::Submitted) {
+			VkSemaphoreWaitInfo wait_info = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+			wait_info.semaphoreCount = 1;
+			wait_info.pSemaphores = &timeline;
+			wait_info.pValues = &slot.value;
+			vk::check(vkWaitSemaphores(ctx->device, &wait_info, UINT64_MAX), "Failed to wait for the readback");
+			consume(slot);
+		}
+		LUMEN_ASSERT(slot.state != SlotState::Recorded, "Readback slot acquired twice in a frame");
+		while (slot.state.load(std::memory_order_acquire) != SlotState::Free) {
+			if (!ThreadPool::run_pending_task()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+	slot.consumer = std::move(consumer);
+	slot.state = SlotState::Recorded;
+	return slot.buffer;
+}
+
+void FrameReadback::submitted(uint64_t value) {
+	for (Slot& slot : slots) {
+		if (slot.state == SlotState::Recorded) {
+			slot.value = value;
+			slot.state = SlotState::Submitted;
+		}
+	}
+}
+
+void FrameReadback::poll() {
+	uint64_t completed = 0;
+	vk::check(vkGetSemaphoreCounterValue(ctx->device, timeline, &completed), "Failed to query the timeline");
+	for (Slot& slot : slots) {
+		if (slot.state == SlotState::Submitted && slot.value <= completed) {
+			consume(slot);
+		}
+	}
+}
+
+uint32_t FrameReadback::pending() const {
+	uint32_t res = 0;
+	for (const Slot& slot : slots) {
+		res += slot.state != SlotState::Free;
+	}
+	return res;
+}
+
+void FrameReadback::consume(Slot& slot) {
+	if (!(slot.buffer.mem_property_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+		slot.buffer.invalidate();
+	}
+	slot.state = SlotState::Consuming;
+	consumers.run("readback", [&slot] {
+		// A failing consumer only loses its frame, the slot has to be freed either way or acquire() waits forever
+		try {
+			slot.consumer(slot.buffer.data);
+		} catch (const std::exception& ex) {
+			LUMEN_WARN("Readback consumer failed: {}", ex.what());
+		} catch (...) {
+			LUMEN_WARN("Readback consumer failed");
+		}
+		slot.consumer = nullptr;
+		slot.state.store(SlotState::Free, std::memory_order_release);
+	});
+}
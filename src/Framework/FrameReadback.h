@@ -0,0 +1,45 @@
+#pragma once
+#include "../LumenPCH.h"
+#include "Buffer.h"
+
+/*
+	Ring of host visible buffers that GPU data is copied into for consumption on the CPU, e.g. writing EXRs.
+	A slot is handed to its consumer on the ThreadPool once the frame timeline passed the value of the frame that
+	filled it, and is reused when the consumer returns. With every slot busy acquire() waits for the oldest one, which
+	bounds the queued work and the memory for it.
+*/
+class FrameReadback {
+   public:
+	// Runs on a worker, data stays valid until it returns
+	using Consumer = std::function<void(const void* data)>;
+
+	// timeline is signaled with the value passed to submitted() when the frame is done, see VulkanBase::frame_timeline
+	void init(VulkanContext* ctx, VkSemaphore timeline, VkDeviceSize size, uint32_t num_slots = 3);
+	// Waits for the pending copies and consumers
+	void destroy();
+	// Buffer to copy into during the frame that is submitted next, see submitted()
+	Buffer& acquire(Consumer consumer);
+	// The acquired buffers were recorded into the frame that signals value on the timeline
+	void submitted(uint64_t value);
+	// Hands the slots of completed frames to their consumers
+	void poll();
+	// Slots that wait for the GPU or their consumer
+	uint32_t pending() const;
+
+   private:
+	enum class SlotState { Free, Recorded, Submitted, Consuming };
+	struct Slot {
+		Buffer buffer;
+		std::atomic<SlotState> state = SlotState::Free;
+		uint64_t value = 0;
+		Consumer consumer;
+	};
+	void consume(Slot& slot);
+
+	VulkanContext* ctx = nullptr;
+	VkSemaphore timeline = VK_NULL_HANDLE;
+	std::deque<Slot> slots;
+	// Slots are used round robin, so the next one is always the oldest
+	uint32_t next_slot = 0;
+	TaskGroup consumers;
+};
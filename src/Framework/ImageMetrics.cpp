@@ -0,0 +1,585 @@
+#include "ImageMetrics.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LUMEN_METRICS_SSE2
+#endif
+
+namespace {
+// Output rows per band of SSIM and FLIP, every band filters its halo rows again
+constexpr int BAND_ROWS = 64;
+constexpr float PI = 3.14159265358979f;
+
+enum class PixelError { Squared, RelativeSquared, AbsoluteRelative };
+
+template <PixelError E>
+float channel_error(float test, float ref, float eps) {
+	const float d = test - ref;
+	if constexpr (E == PixelError::Squared) {
+		return d * d;
+	} else if constexpr (E == PixelError::RelativeSquared) {
+		return d * d / (ref * ref + eps);
+	} else {
+		return std::abs(d) / (std::abs(ref) + eps);
+	}
+}
+
+#ifdef LUMEN_METRICS_SSE2
+template <PixelError E>
+__m128 channel_error(__m128 test, __m128 ref, __m128 eps) {
+	const __m128 d = _mm_sub_ps(test, ref);
+	if constexpr (E == PixelError::Squared) {
+		return _mm_mul_ps(d, d);
+	} else if constexpr (E == PixelError::RelativeSquared) {
+		return _mm_div_ps(_mm_mul_ps(d, d), _mm_add_ps(_mm_mul_ps(ref, ref), eps));
+	} else {
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		return _mm_div_ps(_mm_andnot_ps(sign, d), _mm_add_ps(_mm_andnot_ps(sign, ref), eps));
+	}
+}
+#endif
+
+// Sum of the channel errors of a row, map gets the mean of each pixel
+template <PixelError E>
+double row_error(const float* test, const float* ref, int width, float eps, float* map) {
+	constexpr float third = 1.0f / 3.0f;
+	int x = 0;
+	double sum = 0.0;
+#ifdef LUMEN_METRICS_SSE2
+	const __m128 eps4 = _mm_set1_ps(eps);
+	__m128 acc = _mm_setzero_ps();
+	for (; x + 4 <= width; x += 4) {
+		// Four pixels, transposed to one register per channel
+		__m128 t0 = _mm_loadu_ps(test + 4 * x);
+		__m128 t1 = _mm_loadu_ps(test + 4 * x + 4);
+		__m128 t2 = _mm_loadu_ps(test + 4 * x + 8);
+		__m128 t3 = _mm_loadu_ps(test + 4 * x + 12);
+		__m128 r0 = _mm_loadu_ps(ref + 4 * x);
+		__m128 r1 = _mm_loadu_ps(ref + 4 * x + 4);
+		__m128 r2 = _mm_loadu_ps(ref + 4 * x + 8);
+		__m128 r3 = _mm_loadu_ps(ref + 4 * x + 12);
+		_MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		const __m128 e = _mm_add_ps(_mm_add_ps(channel_error<E>(t0, r0, eps4), channel_error<E>(t1, r1, eps4)),
+									channel_error<E>(t2, r2, eps4));
+		acc = _mm_add_ps(acc, e);
+		if (map) {
+			_mm_storeu_ps(map + x, _mm_mul_ps(e, _mm_set1_ps(third)));
+		}
+	}
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, acc);
+	sum = double(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#endif
+	for (; x < width; x++) {
+		const float* t = test + 4 * x;
+		const float* r = ref + 4 * x;
+		const float e = channel_error<E>(t[0], r[0], eps) + channel_error<E>(t[1], r[1], eps) +
+						channel_error<E>(t[2], r[2], eps);
+		sum += e;
+		if (map) {
+			map[x] = e * third;
+		}
+	}
+	return sum;
+}
+
+template <PixelError E>
+double mean_error(const float* test, const float* ref, int width, int height, float eps, std::vector<float>* map) {
+	const double sum = ThreadPool::parallel_reduce(
+		0u, uint32_t(height), 0.0,
+		[&](uint32_t y) {
+			const size_t offset = size_t(y) * width;
+			return row_error<E>(test + 4 * offset, ref + 4 * offset, width, eps, map ? map->data() + offset : nullptr);
+		},
+		std::plus<double>());
+	return sum / (3.0 * width * height);
+}
+
+// 2 * radius + 1 taps, taps[radius + i] = parity * taps[radius - i] with a parity of 1 or -1
+struct Kernel {
+	int radius = 0;
+	float parity = 1.0f;
+	std::vector<float> taps;
+};
+
+Kernel gaussian_kernel(float sigma, int radius) {
+	Kernel kernel{radius, 1.0f, std::vector<float>(2 * radius + 1)};
+	float sum = 0.0f;
+	for (int i = -radius; i <= radius; i++) {
+		sum += kernel.taps[i + radius] = std::exp(-float(i * i) / (2.0f * sigma * sigma));
+	}
+	for (float& tap : kernel.taps) {
+		tap /= sum;
+	}
+	return kernel;
+}
+
+// dst[x] = sum of taps[k] * src[k * tap_stride + x], the mirrored taps are folded so each pair takes one multiply
+void convolve(const float* src, size_t tap_stride, const Kernel& kernel, float* dst, int width) {
+	const int r = kernel.radius;
+	const float* taps = kernel.taps.data() + r;
+	const float* center = src + r * tap_stride;
+	const bool odd = kernel.parity < 0.0f;
+	int x = 0;
+#ifdef LUMEN_METRICS_SSE2
+	// 16 outputs at a time, the independent sums hide the latency of the adds
+	for (; x + 16 <= width; x += 16) {
+		__m128 acc[4];
+		const __m128 w = _mm_set1_ps(taps[0]);
+		for (int i = 0; i < 4; i++) {
+			acc[i] = _mm_mul_ps(w, _mm_loadu_ps(center + x + 4 * i));
+		}
+		for (int k = 1; k <= r; k++) {
+			const __m128 w = _mm_set1_ps(taps[k]);
+			const float* hi = center + k * tap_stride + x;
+			const float* lo = center - k * tap_stride + x;
+			for (int i = 0; i < 4; i++) {
+				const __m128 a = _mm_loadu_ps(hi + 4 * i);
+				const __m128 b = _mm_loadu_ps(lo + 4 * i);
+				acc[i] = _mm_add_ps(acc[i], _mm_mul_ps(w, odd ? _mm_sub_ps(a, b) : _mm_add_ps(a, b)));
+			}
+		}
+		for (int i = 0; i < 4; i++) {
+			_mm_storeu_ps(dst + x + 4 * i, acc[i]);
+		}
+	}
+#endif
+	for (; x < width; x++) {
+		float acc = taps[0] * center[x];
+		for (int k = 1; k <= r; k++) {
+			const float a = center[k * tap_stride + x];
+			const float b = (center - k * tap_stride)[x];
+			acc += taps[k] * (odd ? a - b : a + b);
+		}
+		dst[x] = acc;
+	}
+}
+
+// Clamps at the borders, padded holds width + 2 * radius floats
+void filter_horizontal(const float* src, float* dst, int width, const Kernel& kernel, float* padded) {
+	const int r = kernel.radius;
+	std::fill(padded, padded + r, src[0]);
+	std::copy(src, src + width, padded + r);
+	std::fill(padded + r + width, padded + 2 * r + width, src[width - 1]);
+	convolve(padded, 1, kernel, dst, width);
+}
+
+// Filters a row of a band plane, the rows within the radius have to be in the plane
+void filter_vertical(const float* plane, int row, int width, const Kernel& kernel, float* dst) {
+	convolve(plane + size_t(row - kernel.radius) * width, width, kernel, dst, width);
+}
+
+// Reused by the bands that run on the same thread
+float* band_scratch(size_t size) {
+	thread_local std::vector<float> scratch;
+	if (scratch.size() < size) {
+		scratch.resize(size);
+	}
+	return scratch.data();
+}
+
+// Sums f(y0, y1) over bands of BAND_ROWS rows
+template <typename F>
+double reduce_bands(int height, F&& f) {
+	const uint32_t num_bands = uint32_t(height + BAND_ROWS - 1) / BAND_ROWS;
+	return ThreadPool::parallel_reduce(
+		0u, num_bands, 0.0,
+		[&](uint32_t band) {
+			const int y0 = int(band) * BAND_ROWS;
+			return f(y0, std::min(y0 + BAND_ROWS, height));
+		},
+		std::plus<double>());
+}
+
+// Luminance of the exposed color clamped to [0, 1]
+void display_luminance(const float* rgba, int width, float scale, float* dst) {
+	for (int x = 0; x < width; x++) {
+		const float* p = rgba + 4 * x;
+		dst[x] = 0.2126f * std::clamp(p[0] * scale, 0.0f, 1.0f) + 0.7152f * std::clamp(p[1] * scale, 0.0f, 1.0f) +
+				 0.0722f * std::clamp(p[2] * scale, 0.0f, 1.0f);
+	}
+}
+
+// Gaussian window with a sigma of 1.5 over the display luminance, as in Wang et al. 2004
+double ssim(const float* test, const float* ref, int width, int height, float exposure, std::vector<float>* map) {
+	constexpr float C1 = 0.01f * 0.01f;
+	constexpr float C2 = 0.03f * 0.03f;
+	const Kernel window = gaussian_kernel(1.5f, 5);
+	const int halo = window.radius;
+	const float scale = std::exp2(exposure);
+	const double sum = reduce_bands(height, [&](int y0, int y1) {
+		const int num_rows = y1 - y0 + 2 * halo;
+		const size_t plane_size = size_t(num_rows) * width;
+		// Horizontally filtered x, y, x^2, y^2 and xy
+		float* planes = band_scratch(5 * plane_size + 6 * size_t(width) + 2 * halo);
+		float* lines[5];
+		for (int i = 0; i < 5; i++) {
+			lines[i] = planes + 5 * plane_size + size_t(i) * width;
+		}
+		float* padded = lines[4] + width;
+		for (int i = 0; i < num_rows; i++) {
+			const size_t y = std::clamp(y0 - halo + i, 0, height - 1);
+			display_luminance(test + 4 * y * width, width, scale, lines[0]);
+			display_luminance(ref + 4 * y * width, width, scale, lines[1]);
+			for (int x = 0; x < width; x++) {
+				lines[2][x] = lines[0][x] * lines[0][x];
+				lines[3][x] = lines[1][x] * lines[1][x];
+				lines[4][x] = lines[0][x] * lines[1][x];
+			}
+			for (int p = 0; p < 5; p++) {
+				filter_horizontal(lines[p], planes + p * plane_size + size_t(i) * width, width, window, padded);
+			}
+		}
+		double band_sum = 0.0;
+		for (int y = y0; y < y1; y++) {
+			for (int p = 0; p < 5; p++) {
+				filter_vertical(planes + p * plane_size, y - y0 + halo, width, window, lines[p]);
+			}
+			float* s = lines[0];
+			float row_sum = 0.0f;
+			for (int x = 0; x < width; x++) {
+				const float mx = lines[0][x];
+				const float my = lines[1][x];
+				const float vx = lines[2][x] - mx * mx;
+				const float vy = lines[3][x] - my * my;
+				const float cov = lines[4][x] - mx * my;
+				s[x] = (2.0f * mx * my + C1) * (2.0f * cov + C2) / ((mx * mx + my * my + C1) * (vx + vy + C2));
+				row_sum += s[x];
+			}
+			if (map) {
+				std::copy(s, s + width, map->data() + size_t(y) * width);
+			}
+			band_sum += row_sum;
+		}
+		return band_sum;
+	});
+	return sum / (double(width) * height);
+}
+
+struct Color {
+	float x, y, z;
+};
+
+// Reference white of the XYZ conversions
+constexpr Color D65 = {0.950428545f, 1.0f, 1.088900371f};
+
+Color linear_rgb_to_xyz(Color c) {
+	return {0.4124564f * c.x + 0.3575761f * c.y + 0.1804375f * c.z,
+			0.2126729f * c.x + 0.7151522f * c.y + 0.0721750f * c.z,
+			0.0193339f * c.x + 0.1191920f * c.y + 0.9503041f * c.z};
+}
+
+Color xyz_to_linear_rgb(Color c) {
+	return {3.2404542f * c.x - 1.5371385f * c.y - 0.4985314f * c.z,
+			-0.9692660f * c.x + 1.8760108f * c.y + 0.0415560f * c.z,
+			0.0556434f * c.x - 0.2040259f * c.y + 1.0572252f * c.z};
+}
+
+Color xyz_to_ycxcz(Color c) {
+	const float y = c.y * (1.0f / D65.y);
+	return {116.0f * y - 16.0f, 500.0f * (c.x * (1.0f / D65.x) - y), 200.0f * (y - c.z * (1.0f / D65.z))};
+}
+
+Color ycxcz_to_xyz(Color c) {
+	const float y = (c.x + 16.0f) * (1.0f / 116.0f);
+	return {D65.x * (c.y * (1.0f / 500.0f) + y), D65.y * y, D65.z * (y - c.z * (1.0f / 200.0f))};
+}
+
+// Bit trick for the initial guess and two Halley iterations, within float precision for positive values
+float fast_cbrt(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	bits = bits / 3 + 709921077;
+	float y;
+	std::memcpy(&y, &bits, sizeof(y));
+	for (int i = 0; i < 2; i++) {
+		const float y3 = y * y * y;
+		y *= (y3 + 2.0f * value) / (2.0f * y3 + value);
+	}
+	return y;
+}
+
+// CIELAB with a and b scaled by the lightness (Hunt effect)
+Color xyz_to_hunt_lab(Color c) {
+	constexpr float delta = 6.0f / 29.0f;
+	auto f = [](float t) {
+		return t > delta * delta * delta ? fast_cbrt(t) : t * (1.0f / (3.0f * delta * delta)) + 4.0f / 29.0f;
+	};
+	const float fx = f(c.x * (1.0f / D65.x));
+	const float fy = f(c.y * (1.0f / D65.y));
+	const float fz = f(c.z * (1.0f / D65.z));
+	const float l = 116.0f * fy - 16.0f;
+	return {l, 0.01f * l * 500.0f * (fx - fy), 0.01f * l * 200.0f * (fy - fz)};
+}
+
+float hyab(Color a, Color b) {
+	const float da = a.y - b.y;
+	const float db = a.z - b.z;
+	return std::abs(a.x - b.x) + std::sqrt(da * da + db * db);
+}
+
+// Constants of LDR-FLIP (Andersson et al. 2020)
+constexpr float FLIP_QC = 0.7f;
+constexpr float FLIP_PC = 0.4f;
+constexpr float FLIP_PT = 0.95f;
+// Degrees
+constexpr float FLIP_FEATURE_WIDTH = 0.082f;
+
+struct FlipFilters {
+	// Contrast sensitivity of the Y, Cx and Cz channels, the one of Cz is a weighted sum of two Gaussians
+	Kernel y, cx, cz[2];
+	float cz_weights[2];
+	// Gaussian and its derivatives for the edge and point detection
+	Kernel g, dg, ddg;
+	int halo;
+	float max_color_difference;
+};
+
+FlipFilters flip_filters(float pixels_per_degree) {
+	// a1, b1, a2, b2 of the contrast sensitivity functions
+	constexpr float csf[3][4] = {
+		{1.0f, 0.0047f, 0.0f, 1e-5f}, {1.0f, 0.0053f, 0.0f, 1e-5f}, {34.1f, 0.04f, 13.5f, 0.025f}};
+	FlipFilters filters;
+	const int csf_radius = int(std::ceil(3.0f * std::sqrt(0.04f / (2.0f * PI * PI)) * pixels_per_degree));
+	// The 2D Gaussians are a * sqrt(pi / b) * e(x) * e(y), returns the normalized e and sets weight to the 2D sum
+	auto csf_gaussian = [&](float a, float b, float& weight) {
+		Kernel kernel{csf_radius, 1.0f, std::vector<float>(2 * csf_radius + 1)};
+		float sum = 0.0f;
+		for (int i = -csf_radius; i <= csf_radius; i++) {
+			const float d = i / pixels_per_degree;
+			sum += kernel.taps[i + csf_radius] = std::exp(-PI * PI * d * d / b);
+		}
+		for (float& tap : kernel.taps) {
+			tap /= sum;
+		}
+		weight = a * std::sqrt(PI / b) * sum * sum;
+		return kernel;
+	};
+	float unused;
+	filters.y = csf_gaussian(csf[0][0], csf[0][1], unused);
+	filters.cx = csf_gaussian(csf[1][0], csf[1][1], unused);
+	filters.cz[0] = csf_gaussian(csf[2][0], csf[2][1], filters.cz_weights[0]);
+	filters.cz[1] = csf_gaussian(csf[2][2], csf[2][3], filters.cz_weights[1]);
+	const float cz_sum = filters.cz_weights[0] + filters.cz_weights[1];
+	filters.cz_weights[0] /= cz_sum;
+	filters.cz_weights[1] /= cz_sum;
+
+	const float sigma = 0.5f * FLIP_FEATURE_WIDTH * pixels_per_degree;
+	const int radius = int(std::ceil(3.0f * sigma));
+	filters.g = gaussian_kernel(sigma, radius);
+	filters.dg = {radius, -1.0f, std::vector<float>(2 * radius + 1)};
+	filters.ddg = {radius, 1.0f, std::vector<float>(2 * radius + 1)};
+	float dg_sums[2] = {};
+	float ddg_sums[2] = {};
+	for (int i = -radius; i <= radius; i++) {
+		const float g = std::exp(-float(i * i) / (2.0f * sigma * sigma));
+		const float dg = -i * g;
+		const float ddg = (i * i / (sigma * sigma) - 1.0f) * g;
+		filters.dg.taps[i + radius] = dg;
+		filters.ddg.taps[i + radius] = ddg;
+		dg_sums[dg > 0.0f] += std::abs(dg);
+		ddg_sums[ddg > 0.0f] += std::abs(ddg);
+	}
+	// Positive and negative taps sum to 1 and -1
+	for (float& tap : filters.dg.taps) {
+		tap /= dg_sums[tap > 0.0f];
+	}
+	for (float& tap : filters.ddg.taps) {
+		tap /= ddg_sums[tap > 0.0f];
+	}
+	filters.halo = std::max(csf_radius, radius);
+
+	const Color green = xyz_to_hunt_lab(linear_rgb_to_xyz({0.0f, 1.0f, 0.0f}));
+	const Color blue = xyz_to_hunt_lab(linear_rgb_to_xyz({0.0f, 0.0f, 1.0f}));
+	filters.max_color_difference = std::pow(hyab(green, blue), FLIP_QC);
+	return filters;
+}
+
+// LDR-FLIP of the exposed images clamped to [0, 1]
+double flip(const float* test, const float* ref, int width, int height, const ImageMetricSettings& settings,
+			std::vector<float>* map) {
+	// Y, Cx, Cz with both of its filters, then luminance with g, dg and ddg
+	constexpr int NUM_PLANES = 7;
+	const FlipFilters filters = flip_filters(settings.pixels_per_degree);
+	const int halo = filters.halo;
+	const float scale = std::exp2(settings.exposure);
+	const float cmax = filters.max_color_difference;
+	const float pccmax = FLIP_PC * cmax;
+	const double sum = reduce_bands(height, [&](int y0, int y1) {
+		const int num_rows = y1 - y0 + 2 * halo;
+		const size_t plane_size = size_t(num_rows) * width;
+		float* planes = band_scratch(2 * NUM_PLANES * (plane_size + width) + 2 * halo + width);
+		float* lines = planes + 2 * NUM_PLANES * plane_size;
+		float* padded = lines + 2 * NUM_PLANES * width;
+		auto plane = [&](int image, int idx) { return planes + (image * NUM_PLANES + idx) * plane_size; };
+		auto line = [&](int image, int idx) { return lines + size_t(image * NUM_PLANES + idx) * width; };
+		const float* images[2] = {test, ref};
+		for (int image = 0; image < 2; image++) {
+			float* yccs[3] = {line(image, 0), line(image, 1), line(image, 2)};
+			float* lum = line(image, 3);
+			for (int i = 0; i < num_rows; i++) {
+				const size_t y = std::clamp(y0 - halo + i, 0, height - 1);
+				const float* src = images[image] + 4 * y * width;
+				for (int x = 0; x < width; x++) {
+					const float* p = src + 4 * x;
+					const Color xyz = linear_rgb_to_xyz({std::clamp(p[0] * scale, 0.0f, 1.0f),
+														 std::clamp(p[1] * scale, 0.0f, 1.0f),
+														 std::clamp(p[2] * scale, 0.0f, 1.0f)});
+					const Color ycc = xyz_to_ycxcz(xyz);
+					yccs[0][x] = ycc.x;
+					yccs[1][x] = ycc.y;
+					yccs[2][x] = ycc.z;
+					lum[x] = xyz.y / D65.y;
+				}
+				const size_t offset = size_t(i) * width;
+				filter_horizontal(yccs[0], plane(image, 0) + offset, width, filters.y, padded);
+				filter_horizontal(yccs[1], plane(image, 1) + offset, width, filters.cx, padded);
+				filter_horizontal(yccs[2], plane(image, 2) + offset, width, filters.cz[0], padded);
+				filter_horizontal(yccs[2], plane(image, 3) + offset, width, filters.cz[1], padded);
+				filter_horizontal(lum, plane(image, 4) + offset, width, filters.g, padded);
+				filter_horizontal(lum, plane(image, 5) + offset, width, filters.dg, padded);
+				filter_horizontal(lum, plane(image, 6) + offset, width, filters.ddg, padded);
+			}
+		}
+		double band_sum = 0.0;
+		for (int y = y0; y < y1; y++) {
+			const int row = y - y0 + halo;
+			for (int image = 0; image < 2; image++) {
+				float* cz = line(image, 2);
+				float* cz_wide = line(image, 3);
+				filter_vertical(plane(image, 0), row, width, filters.y, line(image, 0));
+				filter_vertical(plane(image, 1), row, width, filters.cx, line(image, 1));
+				filter_vertical(plane(image, 2), row, width, filters.cz[0], cz);
+				filter_vertical(plane(image, 3), row, width, filters.cz[1], cz_wide);
+				for (int x = 0; x < width; x++) {
+					cz[x] = filters.cz_weights[0] * cz[x] + filters.cz_weights[1] * cz_wide[x];
+				}
+				// Edges and points along x and y
+				filter_vertical(plane(image, 5), row, width, filters.g, line(image, 3));
+				filter_vertical(plane(image, 4), row, width, filters.dg, line(image, 4));
+				filter_vertical(plane(image, 6), row, width, filters.g, line(image, 5));
+				filter_vertical(plane(image, 4), row, width, filters.ddg, line(image, 6));
+			}
+			// Hunt adjusted CIELAB of the filtered colors and the edge and point strengths, in place
+			for (int image = 0; image < 2; image++) {
+				float* ycc[3] = {line(image, 0), line(image, 1), line(image, 2)};
+				float* features[4] = {line(image, 3), line(image, 4), line(image, 5), line(image, 6)};
+				for (int x = 0; x < width; x++) {
+					const Color rgb = xyz_to_linear_rgb(ycxcz_to_xyz({ycc[0][x], ycc[1][x], ycc[2][x]}));
+					const Color lab = xyz_to_hunt_lab(linear_rgb_to_xyz(
+						{std::clamp(rgb.x, 0.0f, 1.0f), std::clamp(rgb.y, 0.0f, 1.0f), std::clamp(rgb.z, 0.0f, 1.0f)}));
+					ycc[0][x] = lab.x;
+					ycc[1][x] = lab.y;
+					ycc[2][x] = lab.z;
+					features[0][x] = std::sqrt(features[0][x] * features[0][x] + features[1][x] * features[1][x]);
+					features[1][x] = std::sqrt(features[2][x] * features[2][x] + features[3][x] * features[3][x]);
+				}
+			}
+			const float* labs[2][3] = {{line(0, 0), line(0, 1), line(0, 2)}, {line(1, 0), line(1, 1), line(1, 2)}};
+			const float* edges[2] = {line(0, 3), line(1, 3)};
+			const float* points[2] = {line(0, 4), line(1, 4)};
+			float* error = line(0, 5);
+			float row_sum = 0.0f;
+			for (int x = 0; x < width; x++) {
+				const float da = labs[0][1][x] - labs[1][1][x];
+				const float db = labs[0][2][x] - labs[1][2][x];
+				// HyAB distance
+				float color = std::pow(std::abs(labs[0][0][x] - labs[1][0][x]) + std::sqrt(da * da + db * db), FLIP_QC);
+				if (color < pccmax) {
+					color *= FLIP_PT / pccmax;
+				} else {
+					color = FLIP_PT + (color - pccmax) / (cmax - pccmax) * (1.0f - FLIP_PT);
+				}
+				// q_f = 0.5
+				const float feature =
+					std::sqrt(std::max(std::abs(edges[0][x] - edges[1][x]), std::abs(points[0][x] - points[1][x])) *
+							  (1.0f / std::sqrt(2.0f)));
+				error[x] = std::pow(color, 1.0f - feature);
+				row_sum += error[x];
+			}
+			if (map) {
+				std::copy(error, error + width, map->data() + size_t(y) * width);
+			}
+			band_sum += row_sum;
+		}
+		return band_sum;
+	});
+	return sum / (double(width) * height);
+}
+}  // namespace
+
+const char* metric_name(ImageMetric metric) {
+	switch (metric) {
+		case ImageMetric::MSE:
+			return "MSE";
+		case ImageMetric::RMSE:
+			return "RMSE";
+		case ImageMetric::RelMSE:
+			return "relMSE";
+		case ImageMetric::MAPE:
+			return "MAPE";
+		case ImageMetric::SSIM:
+			return "SSIM";
+		case ImageMetric::FLIP:
+			return "FLIP";
+		default:
+			return "Unknown";
+	}
+}
+
+double compute_metric(ImageMetric metric, const float* test, const float* reference, int width, int height,
+					  const ImageMetricSettings& settings, std::vector<float>* error_map) {
+	if (width <= 0 || height <= 0) {
+		return 0.0;
+	}
+	if (error_map) {
+		error_map->resize(size_t(width) * height);
+	}
+	switch (metric) {
+		case ImageMetric::MSE:
+			return mean_error<PixelError::Squared>(test, reference, width, height, 0.0f, error_map);
+		case ImageMetric::RMSE:
+			return std::sqrt(mean_error<PixelError::Squared>(test, reference, width, height, 0.0f, error_map));
+		case ImageMetric::RelMSE:
+			return mean_error<PixelError::RelativeSquared>(test, reference, width, height, settings.epsilon,
+														   error_map);
+		case ImageMetric::MAPE:
+			return mean_error<PixelError::AbsoluteRelative>(test, reference, width, height, settings.epsilon,
+															error_map);
+		case ImageMetric::SSIM:
+			return ssim(test, reference, width, height, settings.exposure, error_map);
+		case ImageMetric::FLIP:
+			return flip(test, reference, width, height, settings, error_map);
+		default:
+			return 0.0;
+	}
+}
+
+std::vector<float> error_heatmap(std::span<const float> values, float max_value) {
+	// sRGB samples of magma at i / 8
+	constexpr float magma[9][3] = {{0.001f, 0.000f, 0.014f}, {0.113f, 0.065f, 0.277f}, {0.317f, 0.072f, 0.485f},
+								   {0.513f, 0.129f, 0.506f}, {0.716f, 0.215f, 0.475f}, {0.900f, 0.315f, 0.390f},
+								   {0.987f, 0.536f, 0.382f}, {0.996f, 0.746f, 0.524f}, {0.987f, 0.991f, 0.750f}};
+	std::vector<float> rgba(values.size() * 4);
+	const float scale = max_value > 0.0f ? 8.0f / max_value : 0.0f;
+	ThreadPool::parallel_for(
+		0, uint32_t(values.size()),
+		[&](uint32_t i) {
+			// NaNs end up at the bottom of the map
+			const float v = values[i] * scale;
+			const float t = v > 0.0f ? std::min(v, 8.0f) : 0.0f;
+			const int idx = std::min(int(t), 7);
+			const float f = t - idx;
+			for (int c = 0; c < 3; c++) {
+				const float srgb = magma[idx][c] + f * (magma[idx + 1][c] - magma[idx][c]);
+				rgba[4 * i + c] = std::pow(srgb, 2.2f);
+			}
+			rgba[4 * i + 3] = 1.0f;
+		},
+		4096);
+	return rgba;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*
+	Image metrics on the CPU, over tightly packed RGBA float images as returned by load_exr. Alpha is ignored.
+	Rows are split over the ThreadPool and the inner loops run on SSE2 or are written to auto-vectorize. SSIM and
+	FLIP filter separably, on bands of rows that keep their intermediate planes small.
+*/
+
+enum class ImageMetric : uint32_t { MSE, RMSE, RelMSE, MAPE, SSIM, FLIP, Count };
+
+struct ImageMetricSettings {
+	// Stops applied before SSIM and FLIP clamp the images to [0, 1]
+	float exposure = 0.0f;
+	// Observer of FLIP, the default is a 0.7 m wide 4K display viewed from 0.7 m
+	float pixels_per_degree = 67.0f;
+	// Added to the denominators of relMSE and MAPE
+	float epsilon = 1e-2f;
+};
+
+const char* metric_name(ImageMetric metric);
+// The per pixel values are written to error_map if given, the metric is their mean (except for the square root of
+// RMSE, which shares the map of MSE). The map of SSIM holds the similarity, the others the error.
+double compute_metric(ImageMetric metric, const float* test, const float* reference, int width, int height,
+					  const ImageMetricSettings& settings = {}, std::vector<float>* error_map = nullptr);
+// RGBA visualization of an error map, the values are divided by max_value and mapped to an approximation of magma
+std::vector<float> error_heatmap(std::span<const float> values, float max_value);
@@ -1,8 +1,13 @@
-#include "LumenPCH.h"
-#include "LumenPCH.h"
 #include "ImageUtils.h"
+#include "Logger.h"
+#include "ThreadPool.h"
+#include <fstream>
 #define TINYEXR_IMPLEMENTATION
 #include <tinyexr.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LUMEN_EXR_SSE2
+#endif
 
 float* load_exr(const char* img_name, int& width, int& height) {
 	// Load the ground truth image
@@ -18,71 +23,313 @@ float* load_exr(const char* img_name, int& width, int& height) {
 	return data;
 }
 
-void save_exr(const float* rgb, int width, int height, const char* outfilename) {
-	EXRHeader header;
-	InitEXRHeader(&header);
-	EXRImage image;
-	InitEXRImage(&image);
-	image.num_channels = 3;
-
-	std::vector<float> images[3];
-	images[0].resize(width * height);
-	images[1].resize(width * height);
-	images[2].resize(width * height);
-
-	// Split RGBRGBRGB... into R, G and B layer
-	for (int i = 0; i < width * height; i++) {
-		images[0][i] = rgb[4 * i + 0];
-		images[1][i] = rgb[4 * i + 1];
-		images[2][i] = rgb[4 * i + 2];
-	}
-
-	float* image_ptr[3];
-	image_ptr[0] = &(images[2].at(0));	// B
-	image_ptr[1] = &(images[1].at(0));	// G
-	image_ptr[2] = &(images[0].at(0));	// R
-
-	image.images = (unsigned char**)image_ptr;
-	image.width = width;
-	image.height = height;
-
-	header.num_channels = 3;
-	header.channels = (EXRChannelInfo*)malloc(sizeof(EXRChannelInfo) * header.num_channels);
-	// Must be (A)BGR order, since most of EXR viewers expect this channel
-	// order.
-#ifdef _MSC_VER
-	strncpy_s(header.channels[0].name, "B", 255);
-	header.channels[0].name[strlen("B")] = '\0';
-	strncpy_s(header.channels[1].name, "G", 255);
-	header.channels[1].name[strlen("G")] = '\0';
-	strncpy_s(header.channels[2].name, "R", 255);
-	header.channels[2].name[strlen("R")] = '\0';
-#else
-	strncpy(header.channels[0].name, "B", 255);
-	header.channels[0].name[strlen("B")] = '\0';
-	strncpy(header.channels[1].name, "G", 255);
-	header.channels[1].name[strlen("G")] = '\0';
-	strncpy(header.channels[2].name, "R", 255);
-	header.channels[2].name[strlen("R")] = '\0';
+namespace {
+struct ExrChannel {
+	std::string name;
+	uint32_t layer;
+	// Index into the RGBA pixels of the layer
+	uint32_t component;
+	ExrPixelType type;
+	// Bytes per pixel of the channels stored before it in a line
+	uint32_t line_offset = 0;
+};
+
+uint32_t pixel_size(ExrPixelType type) { return type == ExrPixelType::Half ? 2 : 4; }
+
+// Rounds to nearest even
+uint16_t float_to_half(float value) {
+	uint32_t f;
+	memcpy(&f, &value, 4);
+	const uint32_t sign = f & 0x80000000u;
+	f ^= sign;
+	uint16_t res;
+	if (f >= 0x47800000u) {
+		// Overflows to inf, NaNs stay quiet NaNs
+		res = f > 0x7f800000u ? 0x7e00 : 0x7c00;
+	} else if (f < 0x38800000u) {
+		// Subnormal, the float addition does the rounding
+		const uint32_t magic = 0x3f000000u;
+		float fv;
+		memcpy(&fv, &f, 4);
+		float magic_f;
+		memcpy(&magic_f, &magic, 4);
+		fv += magic_f;
+		memcpy(&f, &fv, 4);
+		res = (uint16_t)(f - magic);
+	} else {
+		const uint32_t mant_odd = (f >> 13) & 1;
+		// Rebias the exponent and round
+		f += 0xc8000fffu + mant_odd;
+		res = (uint16_t)(f >> 13);
+	}
+	return res | (uint16_t)(sign >> 16);
+}
+
+#ifdef LUMEN_EXR_SSE2
+// Same as above for four values. The results are sign extended to 32 bits, so _mm_packs_epi32 keeps them intact
+__m128i float_to_half(__m128 value) {
+	const __m128i f16_max = _mm_set1_epi32(0x47800000);
+	const __m128i min_normal = _mm_set1_epi32(0x38800000);
+	const __m128i subnorm_magic = _mm_set1_epi32(0x3f000000);
+	const __m128i normal_bias = _mm_set1_epi32((int)0xc8000fffu);
+	const __m128 sign = _mm_and_ps(value, _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000u)));
+	const __m128 abs = _mm_xor_ps(value, sign);
+	const __m128i abs_i = _mm_castps_si128(abs);
+
+	const __m128i is_nan = _mm_castps_si128(_mm_cmpunord_ps(abs, abs));
+	const __m128i inf_or_nan = _mm_or_si128(_mm_and_si128(is_nan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+	const __m128i is_regular = _mm_cmpgt_epi32(f16_max, abs_i);
+	const __m128i is_subnormal = _mm_cmpgt_epi32(min_normal, abs_i);
+
+	const __m128i subnormal =
+		_mm_sub_epi32(_mm_castps_si128(_mm_add_ps(abs, _mm_castsi128_ps(subnorm_magic))), subnorm_magic);
+	const __m128i mant_odd = _mm_srai_epi32(_mm_slli_epi32(abs_i, 31 - 13), 31);
+	const __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(abs_i, normal_bias), mant_odd), 13);
+
+	const __m128i finite =
+		_mm_or_si128(_mm_and_si128(is_subnormal, subnormal), _mm_andnot_si128(is_subnormal, normal));
+	const __m128i res = _mm_or_si128(_mm_and_si128(is_regular, finite), _mm_andnot_si128(is_regular, inf_or_nan));
+	return _mm_or_si128(res, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
 #endif
 
-	header.pixel_types = (int*)malloc(sizeof(int) * header.num_channels);
-	header.requested_pixel_types = (int*)malloc(sizeof(int) * header.num_channels);
-	for (int i = 0; i < header.num_channels; i++) {
-		header.pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;		   // pixel type of input image
-		header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_HALF;  // pixel type of output image to be stored
-																   // in .EXR
+// Converts count RGBA pixels of a layer into its channels in one line of a chunk, which stores the pixels of each
+// channel after each other
+void pack_line(const float* rgba, uint32_t count, const std::vector<const ExrChannel*>& channels, uint8_t* line) {
+	uint8_t* channel_dst[4];
+	for (size_t c = 0; c < channels.size(); c++) {
+		channel_dst[c] = line + count * channels[c]->line_offset;
+	}
+	uint32_t x = 0;
+#ifdef LUMEN_EXR_SSE2
+	for (; x + 4 <= count; x += 4) {
+		__m128 components[4] = {_mm_loadu_ps(rgba + 4 * x), _mm_loadu_ps(rgba + 4 * x + 4),
+								_mm_loadu_ps(rgba + 4 * x + 8), _mm_loadu_ps(rgba + 4 * x + 12)};
+		// Four pixels to R, G, B and A of four pixels
+		_MM_TRANSPOSE4_PS(components[0], components[1], components[2], components[3]);
+		for (size_t c = 0; c < channels.size(); c++) {
+			const __m128 v = components[channels[c]->component];
+			if (channels[c]->type == ExrPixelType::Half) {
+				const __m128i half = float_to_half(v);
+				_mm_storel_epi64((__m128i*)(channel_dst[c] + 2 * x), _mm_packs_epi32(half, half));
+			} else {
+				_mm_storeu_ps((float*)(channel_dst[c] + 4 * x), v);
+			}
+		}
 	}
+#endif
+	for (; x < count; x++) {
+		for (size_t c = 0; c < channels.size(); c++) {
+			const float v = rgba[4 * x + channels[c]->component];
+			if (channels[c]->type == ExrPixelType::Half) {
+				const uint16_t half = float_to_half(v);
+				memcpy(channel_dst[c] + 2 * x, &half, 2);
+			} else {
+				memcpy(channel_dst[c] + 4 * x, &v, 4);
+			}
+		}
+	}
+}
 
-	const char* err = NULL;	 // or nullptr in C++11 or later.
-	int ret = SaveEXRImageToFile(&image, &header, outfilename, &err);
-	if (ret != TINYEXR_SUCCESS) {
-		LUMEN_ERROR("Save EXR err: {}", err);
-		FreeEXRErrorMessage(err);  // free's buffer for an error message
+// EXR is little endian like every platform we run on
+template <typename T>
+void put(std::vector<uint8_t>& out, T value) {
+	const uint8_t* bytes = (const uint8_t*)&value;
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void put_attribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value) {
+	out.insert(out.end(), name, name + strlen(name) + 1);
+	out.insert(out.end(), type, type + strlen(type) + 1);
+	put<int32_t>(out, (int32_t)value.size());
+	out.insert(out.end(), value.begin(), value.end());
+}
+}  // namespace
+
+bool save_exr(std::span<const ExrLayer> layers, int width, int height, const char* outfilename,
+			  const ExrWriteSettings& settings) {
+	// Channels are sorted by name in the file
+	std::vector<ExrChannel> channels;
+	for (uint32_t l = 0; l < (uint32_t)layers.size(); l++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			if (layers[l].names[c]) {
+				channels.push_back({layers[l].names[c], l, c, layers[l].pixel_types[c]});
+			}
+		}
+	}
+	std::sort(channels.begin(), channels.end(),
+			  [](const ExrChannel& a, const ExrChannel& b) { return a.name < b.name; });
+	uint32_t bytes_per_pixel = 0;
+	for (ExrChannel& channel : channels) {
+		channel.line_offset = bytes_per_pixel;
+		bytes_per_pixel += pixel_size(channel.type);
+	}
+	std::vector<std::vector<const ExrChannel*>> layer_channels(layers.size());
+	for (const ExrChannel& channel : channels) {
+		layer_channels[channel.layer].push_back(&channel);
+	}
+
+	// Scanline files have a fixed number of lines per chunk for each compression
+	const bool tiled = settings.tile_size > 0;
+	uint32_t chunk_width = width;
+	uint32_t chunk_height = 1;
+	uint8_t compression_id = 0;
+	switch (settings.compression) {
+		case ExrCompression::None:
+			compression_id = TINYEXR_COMPRESSIONTYPE_NONE;
+			break;
+		case ExrCompression::Zip:
+			compression_id = TINYEXR_COMPRESSIONTYPE_ZIP;
+			chunk_height = 16;
+			break;
+		case ExrCompression::Piz:
+			compression_id = TINYEXR_COMPRESSIONTYPE_PIZ;
+			chunk_height = 32;
+			break;
+	}
+	if (tiled) {
+		chunk_width = chunk_height = settings.tile_size;
+	}
+	const uint32_t chunks_x = (width + chunk_width - 1) / chunk_width;
+	const uint32_t chunks_y = (height + chunk_height - 1) / chunk_height;
+	const uint32_t num_chunks = chunks_x * chunks_y;
+
+	std::vector<tinyexr::ChannelInfo> piz_channels;
+	for (const ExrChannel& channel : channels) {
+		tinyexr::ChannelInfo& info = piz_channels.emplace_back();
+		info.name = channel.name;
+		info.pixel_type = info.requested_pixel_type =
+			channel.type == ExrPixelType::Half ? TINYEXR_PIXELTYPE_HALF : TINYEXR_PIXELTYPE_FLOAT;
+		info.x_sampling = info.y_sampling = 1;
+		info.p_linear = 0;
+	}
+
+	// Each chunk is packed and compressed independently, the file is written in order afterwards
+	std::vector<std::vector<uint8_t>> chunks(num_chunks);
+	ThreadPool::parallel_for(0, num_chunks, [&](uint32_t i) {
+		const uint32_t x0 = (i % chunks_x) * chunk_width;
+		const uint32_t y0 = (i / chunks_x) * chunk_height;
+		const uint32_t w = std::min(chunk_width, width - x0);
+		const uint32_t h = std::min(chunk_height, height - y0);
+		// Scanline chunks start with y and the data size, tiles with their coordinates, level and the data size
+		const size_t header_size = tiled ? 20 : 8;
+		const size_t raw_size = size_t(w) * h * bytes_per_pixel;
+		std::vector<uint8_t>& chunk = chunks[i];
+		std::vector<uint8_t> raw;
+		uint8_t* dst;
+		if (settings.compression == ExrCompression::None) {
+			chunk.resize(header_size + raw_size);
+			dst = chunk.data() + header_size;
+		} else {
+			raw.resize(raw_size);
+			dst = raw.data();
+		}
+		for (uint32_t y = 0; y < h; y++) {
+			const size_t src_offset = (size_t(y0 + y) * width + x0) * 4;
+			for (size_t l = 0; l < layers.size(); l++) {
+				pack_line(layers[l].rgba + src_offset, w, layer_channels[l], dst);
+			}
+			dst += size_t(w) * bytes_per_pixel;
+		}
+
+		// Both codecs store the raw data if it doesn't get smaller
+		size_t data_size = raw_size;
+		if (settings.compression == ExrCompression::Zip) {
+			chunk.resize(header_size + mz_compressBound((mz_ulong)raw_size));
+			tinyexr::tinyexr_uint64 compressed_size = 0;
+			tinyexr::CompressZip(chunk.data() + header_size, compressed_size, raw.data(), (unsigned long)raw_size);
+			data_size = compressed_size;
+		} else if (settings.compression == ExrCompression::Piz) {
+			chunk.resize(header_size + 8192 + 2 * raw_size);
+			unsigned int compressed_size = (unsigned int)(chunk.size() - header_size);
+			tinyexr::CompressPiz(chunk.data() + header_size, &compressed_size, raw.data(), raw_size, piz_channels,
+								 (int)w, (int)h);
+			data_size = compressed_size;
+		}
+		chunk.resize(header_size + data_size);
+
+		int32_t fields[5];
+		uint32_t num_fields = 0;
+		if (tiled) {
+			fields[num_fields++] = (int32_t)(x0 / chunk_width);
+			fields[num_fields++] = (int32_t)(y0 / chunk_height);
+			fields[num_fields++] = 0;
+			fields[num_fields++] = 0;
+		} else {
+			fields[num_fields++] = (int32_t)y0;
+		}
+		fields[num_fields++] = (int32_t)data_size;
+		memcpy(chunk.data(), fields, num_fields * sizeof(int32_t));
+	});
+
+	std::vector<uint8_t> header;
+	put<uint32_t>(header, 20000630);
+	// Version 2, single part
+	put<uint32_t>(header, tiled ? 0x202 : 2);
+	std::vector<uint8_t> value;
+	for (const ExrChannel& channel : channels) {
+		value.insert(value.end(), channel.name.c_str(), channel.name.c_str() + channel.name.size() + 1);
+		put<int32_t>(value, channel.type == ExrPixelType::Half ? TINYEXR_PIXELTYPE_HALF : TINYEXR_PIXELTYPE_FLOAT);
+		// pLinear and padding
+		put<uint32_t>(value, 0);
+		// Sampling
+		put<int32_t>(value, 1);
+		put<int32_t>(value, 1);
+	}
+	value.push_back(0);
+	put_attribute(header, "channels", "chlist", value);
+	put_attribute(header, "compression", "compression", {compression_id});
+	value.clear();
+	put<int32_t>(value, 0);
+	put<int32_t>(value, 0);
+	put<int32_t>(value, width - 1);
+	put<int32_t>(value, height - 1);
+	put_attribute(header, "dataWindow", "box2i", value);
+	put_attribute(header, "displayWindow", "box2i", value);
+	// Increasing y
+	put_attribute(header, "lineOrder", "lineOrder", {0});
+	value.clear();
+	put<float>(value, 1.0f);
+	put_attribute(header, "pixelAspectRatio", "float", value);
+	put_attribute(header, "screenWindowWidth", "float", value);
+	value.clear();
+	put<float>(value, 0.0f);
+	put<float>(value, 0.0f);
+	put_attribute(header, "screenWindowCenter", "v2f", value);
+	if (tiled) {
+		value.clear();
+		put<uint32_t>(value, settings.tile_size);
+		put<uint32_t>(value, settings.tile_size);
+		// One level, rounded down
+		value.push_back(0);
+		put_attribute(header, "tiles", "tiledesc", value);
+	}
+	header.push_back(0);
+
+	uint64_t offset = header.size() + num_chunks * sizeof(uint64_t);
+	for (const std::vector<uint8_t>& chunk : chunks) {
+		put<uint64_t>(header, offset);
+		offset += chunk.size();
+	}
+
+	std::ofstream out(outfilename, std::ios::binary);
+	out.write((const char*)header.data(), header.size());
+	for (const std::vector<uint8_t>& chunk : chunks) {
+		out.write((const char*)chunk.data(), chunk.size());
+	}
+	if (!out) {
+		LUMEN_WARN("Failed to write EXR file {}", outfilename);
+		return false;
 	}
 	LUMEN_TRACE("Saved exr file. [ {} ]", outfilename);
+	return true;
+}
 
-	free(header.channels);
-	free(header.pixel_types);
-	free(header.requested_pixel_types);
+bool save_exr(const float* rgba, int width, int height, const char* outfilename, const ExrWriteSettings& settings) {
+	const ExrLayer layer = {rgba, {"R", "G", "B", settings.write_alpha ? "A" : nullptr}, settings.pixel_types};
+	return save_exr(std::span<const ExrLayer>(&layer, 1), width, height, outfilename, settings);
+}
+
+void save_exr(const float* rgb, int width, int height, const char* outfilename) {
+	save_exr(rgb, width, height, outfilename, ExrWriteSettings());
 }
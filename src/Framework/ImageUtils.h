@@ -1,3 +1,33 @@
 #pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+
+enum class ExrCompression { None, Zip, Piz };
+enum class ExrPixelType { Half, Float };
+
+struct ExrWriteSettings {
+	ExrCompression compression = ExrCompression::Zip;
+	// Indexed R, G, B, A, only used when writing a single RGBA image
+	std::array<ExrPixelType, 4> pixel_types = {ExrPixelType::Half, ExrPixelType::Half, ExrPixelType::Half,
+											   ExrPixelType::Half};
+	bool write_alpha = false;
+	// Square tiles of this size, 0 writes scanlines
+	uint32_t tile_size = 0;
+};
+
+// One RGBA image of a multi-channel EXR, components without a name are left out
+struct ExrLayer {
+	const float* rgba = nullptr;
+	std::array<const char*, 4> names = {};
+	std::array<ExrPixelType, 4> pixel_types = {ExrPixelType::Half, ExrPixelType::Half, ExrPixelType::Half,
+											   ExrPixelType::Half};
+};
+
 float* load_exr(const char* img_name, int& width, int& height);
+// rgba is tightly packed, the chunks are converted and compressed in parallel on the ThreadPool
+bool save_exr(const float* rgba, int width, int height, const char* outfilename, const ExrWriteSettings& settings);
+// Layers share the size, their channel names have to be unique
+bool save_exr(std::span<const ExrLayer> layers, int width, int height, const char* outfilename,
+			  const ExrWriteSettings& settings);
 void save_exr(const float* rgb, int width, int height, const char* outfilename);
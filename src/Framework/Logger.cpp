@@ -1,4 +1,3 @@
-#include "../LumenPCH.h"
 #include "Logger.h"
 std::shared_ptr<spdlog::logger> Logger::s_logger;
 void Logger::init() {
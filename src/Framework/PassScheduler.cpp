@@ -0,0 +1,187 @@
+#include "PassScheduler.h"
+#include <algorithm>
+#include <unordered_map>
+
+PassSchedule schedule_passes(std::span<const PassAccesses> passes, const std::unordered_set<uint64_t>& transients,
+							 bool cull, bool reorder) {
+	std::vector<uint64_t> sorted_transients(transients.begin(), transients.end());
+	std::sort(sorted_transients.begin(), sorted_transients.end());
+	PassSchedule schedule;
+	schedule_passes(passes, sorted_transients, cull, reorder, schedule, std::pmr::get_default_resource());
+	return schedule;
+}
+
+void schedule_passes(std::span<const PassAccesses> passes, std::span<const uint64_t> transients, bool cull,
+					 bool reorder, PassSchedule& schedule, std::pmr::memory_resource* scratch) {
+	const uint32_t pass_count = (uint32_t)passes.size();
+	schedule.order.clear();
+	schedule.culled.clear();
+	std::pmr::vector<bool> live(pass_count, true, scratch);
+	if (cull) {
+		// Walk backwards and keep track of the resources a live pass still needs
+		std::pmr::unordered_set<uint64_t> needed(scratch);
+		for (uint32_t i = pass_count; i-- > 0;) {
+			const PassAccesses& pass = passes[i];
+			// Without any tracked write the pass can only have effects we don't see (device addresses, atomics...)
+			bool is_live = pass.side_effects || pass.writes.empty();
+			for (uint64_t resource : pass.writes) {
+				if (is_live) {
+					break;
+				}
+				is_live = !std::binary_search(transients.begin(), transients.end(), resource) ||
+						  needed.contains(resource);
+			}
+			live[i] = is_live;
+			if (!is_live) {
+				schedule.culled.push_back(i);
+				continue;
+			}
+			for (uint64_t resource : pass.reads) {
+				needed.insert(resource);
+			}
+		}
+		std::reverse(schedule.culled.begin(), schedule.culled.end());
+	}
+
+	if (!reorder) {
+		for (uint32_t i = 0; i < pass_count; i++) {
+			if (live[i]) {
+				schedule.order.push_back(i);
+			}
+		}
+		return;
+	}
+
+	// Dependencies between the live passes
+	std::pmr::unordered_map<uint64_t, int64_t> last_writers(scratch);
+	std::pmr::unordered_map<uint64_t, std::pmr::vector<uint32_t>> readers(scratch);
+	std::pmr::vector<std::pmr::vector<uint32_t>> predecessors(pass_count, scratch);
+	std::pmr::vector<std::pmr::vector<uint32_t>> successors(pass_count, scratch);
+	auto add_edge = [&](uint32_t src, uint32_t dst) {
+		if (src == dst ||
+			std::find(predecessors[dst].begin(), predecessors[dst].end(), src) != predecessors[dst].end()) {
+			return;
+		}
+		predecessors[dst].push_back(src);
+		successors[src].push_back(dst);
+	};
+	for (uint32_t i = 0; i < pass_count; i++) {
+		if (!live[i]) {
+			continue;
+		}
+		for (uint64_t resource : passes[i].reads) {
+			auto writer = last_writers.find(resource);
+			if (writer != last_writers.end()) {
+				add_edge((uint32_t)writer->second, i);
+			}
+			// The sync planner makes a read wait on the previous access only. After a read, that is the earlier
+			// reader (or nothing at all for two shader reads), which itself waited on the writer
+			auto resource_readers = readers.find(resource);
+			if (resource_readers != readers.end() && !resource_readers->second.empty()) {
+				add_edge(resource_readers->second.back(), i);
+			}
+		}
+		for (uint64_t resource : passes[i].writes) {
+			auto writer = last_writers.find(resource);
+			if (writer != last_writers.end()) {
+				add_edge((uint32_t)writer->second, i);
+			}
+			auto resource_readers = readers.find(resource);
+			if (resource_readers != readers.end()) {
+				for (uint32_t reader : resource_readers->second) {
+					add_edge(reader, i);
+				}
+			}
+		}
+		// Update the states after all the edges of the pass are in place
+		for (uint64_t resource : passes[i].reads) {
+			readers[resource].push_back(i);
+		}
+		for (uint64_t resource : passes[i].writes) {
+			last_writers[resource] = i;
+			readers[resource].clear();
+		}
+	}
+
+	std::pmr::vector<uint32_t> rem_predecessors(pass_count, scratch);
+	std::pmr::vector<uint32_t> positions(pass_count, 0, scratch);
+	std::pmr::vector<uint32_t> ready(scratch);
+	for (uint32_t i = 0; i < pass_count; i++) {
+		rem_predecessors[i] = (uint32_t)predecessors[i].size();
+		if (live[i] && rem_predecessors[i] == 0) {
+			ready.push_back(i);
+		}
+	}
+	while (!ready.empty()) {
+		const uint32_t curr_pos = (uint32_t)schedule.order.size();
+		size_t best = 0;
+		uint32_t best_distance = 0;
+		for (size_t r = 0; r < ready.size(); r++) {
+			uint32_t distance = UINT32_MAX;
+			for (uint32_t pred : predecessors[ready[r]]) {
+				distance = std::min(distance, curr_pos - positions[pred]);
+			}
+			if (distance > best_distance || (distance == best_distance && ready[r] < ready[best])) {
+				best = r;
+				best_distance = distance;
+			}
+		}
+		const uint32_t pass_idx = ready[best];
+		ready.erase(ready.begin() + best);
+		positions[pass_idx] = curr_pos;
+		schedule.order.push_back(pass_idx);
+		for (uint32_t succ : successors[pass_idx]) {
+			if (--rem_predecessors[succ] == 0) {
+				ready.push_back(succ);
+			}
+		}
+	}
+}
+
+std::vector<RecordSegment> partition_recording(const std::vector<bool>& serial, uint32_t min_chunk_size,
+											   uint32_t max_chunks) {
+	std::vector<RecordSegment> segments;
+	partition_recording(serial, min_chunk_size, max_chunks, segments);
+	return segments;
+}
+
+void partition_recording(const std::vector<bool>& serial, uint32_t min_chunk_size, uint32_t max_chunks,
+						 std::vector<RecordSegment>& segments) {
+	const uint32_t num_passes = (uint32_t)serial.size();
+	const uint32_t num_parallel = (uint32_t)std::count(serial.begin(), serial.end(), false);
+	max_chunks = std::max(max_chunks, 1u);
+	const uint32_t chunk_size = std::max({min_chunk_size, (num_parallel + max_chunks - 1) / max_chunks, 1u});
+	segments.clear();
+	auto add_serial = [&](uint32_t begin, uint32_t end) {
+		if (!segments.empty() && segments.back().serial && segments.back().end == begin) {
+			segments.back().end = end;
+		} else {
+			segments.push_back({begin, end, true});
+		}
+	};
+	uint32_t i = 0;
+	while (i < num_passes) {
+		if (serial[i]) {
+			add_serial(i, i + 1);
+			i++;
+			continue;
+		}
+		uint32_t run_end = i;
+		while (run_end < num_passes && !serial[run_end]) {
+			run_end++;
+		}
+		const uint32_t run_length = run_end - i;
+		// Rounding down keeps every chunk at chunk_size or above, so the total stays within max_chunks
+		const uint32_t num_chunks = run_length / chunk_size;
+		if (num_chunks == 0) {
+			add_serial(i, run_end);
+		} else {
+			for (uint32_t c = 0; c < num_chunks; c++) {
+				const uint32_t begin = i + (uint32_t)((uint64_t)run_length * c / num_chunks);
+				const uint32_t end = i + (uint32_t)((uint64_t)run_length * (c + 1) / num_chunks);
+				segments.push_back({begin, end, false});
+			}
+		}
+		i = run_end;
+	}
+}
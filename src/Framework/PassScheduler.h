@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <unordered_set>
+#include <vector>
+
+// Device independent scheduling of the render graph passes.
+// Resources are identified by opaque ids (the render graph uses the Buffer/Texture2D addresses).
+struct PassAccesses {
+	std::vector<uint64_t> reads;
+	std::vector<uint64_t> writes;
+	// The pass affects something that isn't tracked by the ids above, never culled
+	bool side_effects = false;
+};
+
+struct PassSchedule {
+	// Indices into the input passes in execution order, culled passes are left out
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> culled;
+};
+
+/*
+	Builds the dependency DAG from the accesses in declaration order (RAW, WAR and WAW hazards). Readers of a
+	resource are chained in declaration order as well, since the sync planner only synchronizes a read with the
+	access right before it.
+	- Culling: A pass is dead when everything it writes is transient and isn't read by a later live pass.
+	  Non-transient resources persist across frames, so their writes always count as consumed. Passes without
+	  any tracked write are never culled.
+	- Reordering: Among the passes whose dependencies are satisfied, the one furthest away from its
+	  closest producer is picked next, ties go to declaration order. This puts independent work between
+	  producers and consumers.
+*/
+PassSchedule schedule_passes(std::span<const PassAccesses> passes, const std::unordered_set<uint64_t>& transients,
+							 bool cull, bool reorder);
+// Per-frame form, doesn't touch the heap once schedule has grown to the pass count: the working memory comes from
+// scratch (the FrameArena of the render graph). transients has to be sorted
+void schedule_passes(std::span<const PassAccesses> passes, std::span<const uint64_t> transients, bool cull,
+					 bool reorder, PassSchedule& schedule, std::pmr::memory_resource* scratch);
+
+// Contiguous piece of an execution order, recorded either in place on the calling thread or as one chunk on a worker
+struct RecordSegment {
+	uint32_t begin = 0;
+	uint32_t end = 0;
+	bool serial = false;
+};
+
+/*
+	Splits an execution order into segments for multithreaded recording. Passes flagged in serial have to be
+	recorded on the calling thread, the runs between them are cut into chunks of at least min_chunk_size passes
+	and at most max_chunks chunks overall. Runs too short for a chunk are recorded in place as well.
+*/
+std::vector<RecordSegment> partition_recording(const std::vector<bool>& serial, uint32_t min_chunk_size,
+											   uint32_t max_chunks);
+// Same, into segments to reuse its capacity
+void partition_recording(const std::vector<bool>& serial, uint32_t min_chunk_size, uint32_t max_chunks,
+						 std::vector<RecordSegment>& segments);
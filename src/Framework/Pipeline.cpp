@@ -1,6 +1,7 @@
 #include "../LumenPCH.h"
 #include "Pipeline.h"
 #include "VkUtils.h"
+#include "BindlessHeap.h"
 
 Pipeline::Pipeline(VulkanContext* ctx, const std::string& name)
 	: ctx(ctx),name(name) {}
@@ -13,13 +14,13 @@ void Pipeline::refresh() {
 	}
 }
 
-void Pipeline::create_gfx_pipeline(const GraphicsPassSettings& settings, const std::vector<uint32_t>& descriptor_counts,
-								   std::vector<Texture2D*> color_outputs, Texture2D* depth_output) {
-	LUMEN_ASSERT(color_outputs.size(), "No color outputs for GFX pipeline");
-	type = PipelineType::GFX;
-	binding_mask = get_bindings(settings.shaders, descriptor_types);
-	create_set_layout(settings.shaders, descriptor_counts);
-	for (const auto& shader : settings.shaders) {
+void Pipeline::reflect(const std::vector<Shader>& shaders) {
+	if (reflected) {
+		return;
+	}
+	reflected = true;
+	binding_mask = get_bindings(shaders, descriptor_types);
+	for (const auto& shader : shaders) {
 		if (push_constant_size && shader.push_constant_size) {
 			LUMEN_ASSERT(push_constant_size == shader.push_constant_size,
 						 "Currently all shaders only support 1 push constant!");
@@ -28,6 +29,14 @@ void Pipeline::create_gfx_pipeline(const GraphicsPassSettings& settings, const s
 			push_constant_size = shader.push_constant_size;
 		}
 	}
+}
+
+void Pipeline::create_gfx_pipeline(const GraphicsPassSettings& settings, const std::vector<uint32_t>& descriptor_counts,
+								   std::vector<Texture2D*> color_outputs, Texture2D* depth_output) {
+	LUMEN_ASSERT(color_outputs.size(), "No color outputs for GFX pipeline");
+	type = PipelineType::GFX;
+	reflect(settings.shaders);
+	create_set_layout(settings.shaders, descriptor_counts);
 	create_pipeline_layout(settings.shaders, {push_constant_size});
 	create_update_template(settings.shaders, descriptor_counts);
 
@@ -163,17 +172,8 @@ void Pipeline::create_gfx_pipeline(const GraphicsPassSettings& settings, const s
 
 void Pipeline::create_rt_pipeline(const RTPassSettings& settings, const std::vector<uint32_t>& descriptor_counts) {
 	type = PipelineType::RT;
-	binding_mask = get_bindings(settings.shaders, descriptor_types);
+	reflect(settings.shaders);
 	create_set_layout(settings.shaders, descriptor_counts);
-	for (const auto& shader : settings.shaders) {
-		if (push_constant_size && shader.push_constant_size) {
-			LUMEN_ASSERT(push_constant_size == shader.push_constant_size,
-						 "Currently all shaders only support 1 push constant!");
-		}
-		if (shader.push_constant_size) {
-			push_constant_size = shader.push_constant_size;
-		}
-	}
 	create_pipeline_layout(settings.shaders, {push_constant_size});
 	create_update_template(settings.shaders, descriptor_counts);
 
@@ -269,10 +269,9 @@ void Pipeline::create_rt_pipeline(const RTPassSettings& settings, const std::vec
 void Pipeline::create_compute_pipeline(const ComputePassSettings& settings,
 									   const std::vector<uint32_t>& descriptor_counts) {
 	type = PipelineType::COMPUTE;
-	binding_mask = get_bindings({settings.shader}, descriptor_types);
+	reflect({settings.shader});
 	create_set_layout({settings.shader}, descriptor_counts);
-	if (settings.shader.push_constant_size > 0) {
-		push_constant_size = settings.shader.push_constant_size;
+	if (push_constant_size > 0) {
 		create_pipeline_layout({settings.shader}, {push_constant_size});
 	} else {
 		create_pipeline_layout({settings.shader}, {});
@@ -397,9 +396,20 @@ void Pipeline::create_set_layout(const std::vector<Shader>& shaders, const std::
 void Pipeline::create_pipeline_layout(const std::vector<Shader>& shaders,
 									  const std::vector<uint32_t> push_const_sizes) {
 	VkPipelineLayoutCreateInfo create_info = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-	VkDescriptorSetLayout set_layouts[] = {set_layout, tlas_layout};
+	VkDescriptorSetLayout set_layouts[] = {set_layout, tlas_layout, VK_NULL_HANDLE};
 	create_info.setLayoutCount = type == PipelineType::RT ? 2 : 1;
 	create_info.pSetLayouts = set_layouts;
+	uses_bindless = false;
+	for (const Shader& shader : shaders) {
+		uses_bindless |= shader.uses_bindless;
+	}
+	if (uses_bindless) {
+		if (type != PipelineType::RT) {
+			set_layouts[1] = ctx->bindless->empty_layout;
+		}
+		set_layouts[BINDLESS_SET] = ctx->bindless->set_layout;
+		create_info.setLayoutCount = BINDLESS_SET + 1;
+	}
 
 	for (const Shader& shader : shaders)
 		if (shader.uses_push_constants) pc_stages |= shader.stage;
@@ -6,6 +6,7 @@
 #include "Texture.h"
 #include "SBTWrapper.h"
 #include "RenderGraphTypes.h"
+#include <atomic>
 struct Pipeline;
 
 struct PipelineTrace {
@@ -17,6 +18,9 @@ struct Pipeline {
    public:
 	enum class PipelineType { GFX = 0, RT = 1, COMPUTE = 2 };
 	Pipeline(VulkanContext* ctx, const std::string& name);
+	// The binding layout and the push constant range, the part of the creation the recording depends on.
+	// Called by the create functions as well, ahead of them when the pipeline is created on another thread
+	void reflect(const std::vector<Shader>& shaders);
 	void reload();
 	void cleanup();
 	void create_gfx_pipeline(const GraphicsPassSettings& settings, const std::vector<uint32_t>& descriptor_counts,
@@ -61,12 +65,18 @@ struct Pipeline {
 	std::string name;
 	uint32_t push_constant_size = 0;
 	VkDescriptorType descriptor_types[32] = {};
+	// The BindlessHeap is bound at BINDLESS_SET
+	bool uses_bindless = false;
+	// Set while the pipeline is created on a worker, passes skip their dispatches until it's cleared. Passes can be
+	// recorded on other threads, the release store publishes the pipeline objects created by the worker
+	std::atomic<bool> compiling = false;
 
    private:
 	void create_set_layout(const std::vector<Shader>& shaders, const std::vector<uint32_t>& descriptor_counts);
 	void create_pipeline_layout(const std::vector<Shader>& shaders, const std::vector<uint32_t> push_const_sizes);
 	void create_update_template(const std::vector<Shader>& shaders, const std::vector<uint32_t>& descriptor_counts);
 	bool tracking_stopped = true;
+	bool reflected = false;
 	std::mutex mut;
 	std::condition_variable cv;
 	uint32_t binding_mask;
@@ -0,0 +1,254 @@
+#include "../LumenPCH.h"
+#include "Profiler.h"
+#include <cfloat>
+
+Profiler::CPUScope::CPUScope(Profiler& profiler, const char* name)
+	: profiler(&profiler), name(name), start_us(profiler.enabled ? profiler.now_us() : 0.0) {}
+
+Profiler::CPUScope::~CPUScope() {
+	if (profiler->enabled) {
+		profiler->add_cpu_event(name, start_us, profiler->now_us());
+	}
+}
+
+double Profiler::now_us() const {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::begin_frame(VulkanContext* ctx) {
+	if (!enabled || curr_frame) {
+		return;
+	}
+	if (!this->ctx) {
+		this->ctx = ctx;
+		uint32_t count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(ctx->physical_device, &count, nullptr);
+		std::vector<VkQueueFamilyProperties> families(count);
+		vkGetPhysicalDeviceQueueFamilyProperties(ctx->physical_device, &count, families.data());
+		const uint32_t family_idxs[2] = {ctx->indices.gfx_family.value(), ctx->indices.compute_family.value()};
+		for (int i = 0; i < 2; i++) {
+			const uint32_t valid_bits = families[family_idxs[i]].timestampValidBits;
+			timestamp_masks[i] = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+		}
+		timestamp_period = ctx->device_properties.limits.timestampPeriod;
+		if (!timestamp_masks[0]) {
+			LUMEN_WARN("Timestamp queries aren't supported on the graphics queue, GPU profiling is disabled");
+		}
+		VkQueryPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+		pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		pool_info.queryCount = MAX_QUERIES;
+		for (auto& frame : frames) {
+			vk::check(vkCreateQueryPool(ctx->device, &pool_info, nullptr, &frame.pool), "Failed to create query pool");
+			vkResetQueryPool(ctx->device, frame.pool, 0, MAX_QUERIES);
+		}
+	}
+	if (!timestamp_masks[0]) {
+		return;
+	}
+	FrameQueries& frame = frames[frame_idx];
+	if (frame.pending) {
+		collect(frame);
+		if (frame.pending) {
+			// Still in flight, this frame doesn't get timed
+			return;
+		}
+	}
+	frame_idx = (frame_idx + 1) % (uint32_t)frames.size();
+	frame.passes.clear();
+	frame.cpu_start_us = now_us();
+	frame.traced = trace_frames_left > 0;
+	if (frame.traced) {
+		trace_frames_left--;
+		trace_frames_pending++;
+	}
+	curr_frame = &frame;
+}
+
+void Profiler::end_frame() {
+	if (curr_frame) {
+		curr_frame->pending = true;
+		curr_frame->frame_number = frame_count;
+		curr_frame = nullptr;
+	}
+	frame_count++;
+}
+
+uint32_t Profiler::begin_pass(VkCommandBuffer cmd, const std::string& name, bool compute_queue) {
+	if (!curr_frame || !timestamp_masks[compute_queue]) {
+		return UINT32_MAX;
+	}
+	uint32_t pass_query;
+	{
+		// Passes may be recorded on several threads
+		std::lock_guard<std::mutex> lock(pass_mutex);
+		if (2 * (curr_frame->passes.size() + 1) > MAX_QUERIES) {
+			return UINT32_MAX;
+		}
+		pass_query = (uint32_t)curr_frame->passes.size();
+		curr_frame->passes.push_back({name, compute_queue});
+	}
+	vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, curr_frame->pool, 2 * pass_query);
+	return pass_query;
+}
+
+void Profiler::end_pass(VkCommandBuffer cmd, uint32_t pass_query) {
+	if (pass_query == UINT32_MAX || !curr_frame) {
+		return;
+	}
+	vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, curr_frame->pool, 2 * pass_query + 1);
+}
+
+void Profiler::add_cpu_event(const char* name, double start_us, double end_us) {
+	if (!curr_frame || !curr_frame->traced) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	trace_events.push_back({.name = name, .start_us = start_us, .duration_us = end_us - start_us});
+}
+
+void Profiler::capture_trace(const std::string& path, uint32_t num_frames) {
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	trace_events.clear();
+	trace_path = path;
+	trace_frames_left = num_frames;
+	trace_frames_pending = 0;
+}
+
+void Profiler::collect(FrameQueries& frame) {
+	const uint32_t query_count = 2 * (uint32_t)frame.passes.size();
+	// Value + availability per query
+	std::vector<uint64_t> results(2 * query_count);
+	bool available = true;
+	if (query_count) {
+		VkResult result = vkGetQueryPoolResults(ctx->device, frame.pool, 0, query_count,
+												results.size() * sizeof(uint64_t), results.data(),
+												2 * sizeof(uint64_t),
+												VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		available = result == VK_SUCCESS;
+	}
+	if (!available) {
+		// Passes that were recorded but never submitted (e.g. on a swapchain resize) don't ever become available
+		if (frame_count - frame.frame_number < 16) {
+			return;
+		}
+		frame.passes.clear();
+	}
+
+	std::vector<std::pair<std::string, float>> frame_times;
+	uint64_t frame_begin = UINT64_MAX;
+	uint64_t frame_end = 0;
+	for (size_t i = 0; i < frame.passes.size(); i++) {
+		const uint64_t mask = timestamp_masks[frame.passes[i].compute_queue];
+		const uint64_t begin = results[4 * i] & mask;
+		const uint64_t end = results[4 * i + 2] & mask;
+		frame_begin = std::min(frame_begin, begin);
+		frame_end = std::max(frame_end, end);
+	}
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	for (size_t i = 0; i < frame.passes.size(); i++) {
+		const TimedPass& pass = frame.passes[i];
+		const uint64_t mask = timestamp_masks[pass.compute_queue];
+		const uint64_t begin = results[4 * i] & mask;
+		const uint64_t end = results[4 * i + 2] & mask;
+		const float ms = float(((end - begin) & mask) * timestamp_period * 1e-6);
+		// Passes with the same name (e.g. the reduction steps) are accumulated
+		auto it = std::find_if(frame_times.begin(), frame_times.end(),
+							   [&](const auto& entry) { return entry.first == pass.name; });
+		if (it == frame_times.end()) {
+			frame_times.push_back({pass.name, ms});
+		} else {
+			it->second += ms;
+		}
+		if (frame.traced) {
+			trace_events.push_back({.name = pass.name,
+									.category = "gpu",
+									.start_us = frame.cpu_start_us + (begin - frame_begin) * timestamp_period * 1e-3,
+									.duration_us = ms * 1e3,
+									.tid = pass.compute_queue ? 2u : 1u});
+		}
+	}
+	if (!frame_times.empty()) {
+		gpu_frame_ms = float((frame_end - frame_begin) * timestamp_period * 1e-6);
+		total_gpu_ms += gpu_frame_ms;
+		stats.clear();
+		for (auto& [name, ms] : frame_times) {
+			auto& samples = history[name].samples_ms;
+			samples.push_back(ms);
+			if (samples.size() > STATS_WINDOW) {
+				samples.pop_front();
+			}
+			PassStats pass_stats = {.name = name, .min_ms = FLT_MAX, .max_ms = 0.0f, .last_ms = ms};
+			for (float sample : samples) {
+				pass_stats.min_ms = std::min(pass_stats.min_ms, sample);
+				pass_stats.max_ms = std::max(pass_stats.max_ms, sample);
+				pass_stats.avg_ms += sample;
+			}
+			pass_stats.avg_ms /= (float)samples.size();
+			stats.push_back(pass_stats);
+		}
+	}
+	if (frame.traced) {
+		frame.traced = false;
+		if (--trace_frames_pending == 0 && trace_frames_left == 0) {
+			if (write_chrome_trace(trace_path, trace_events)) {
+				LUMEN_INFO("Wrote the trace to {}", trace_path);
+			} else {
+				LUMEN_WARN("Failed to write the trace to {}", trace_path);
+			}
+			trace_events.clear();
+		}
+	}
+	if (query_count) {
+		vkResetQueryPool(ctx->device, frame.pool, 0, query_count);
+	}
+	frame.pending = false;
+}
+
+void Profiler::gui() {
+	ImGui::Text("GPU frame time %.3f ms", gpu_frame_ms);
+	const bool capturing = trace_frames_left > 0 || trace_frames_pending > 0;
+	if (!capturing && ImGui::Button("Capture trace")) {
+		capture_trace("lumen_trace.json");
+	} else if (capturing) {
+		ImGui::Text("Capturing trace...");
+	}
+	if (stats.empty() ||
+		!ImGui::BeginTable("Pass timings", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable)) {
+		return;
+	}
+	ImGui::TableSetupColumn("Pass");
+	ImGui::TableSetupColumn("Min (ms)");
+	ImGui::TableSetupColumn("Avg (ms)");
+	ImGui::TableSetupColumn("Max (ms)");
+	ImGui::TableHeadersRow();
+	for (const PassStats& pass_stats : stats) {
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(pass_stats.name.c_str());
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", pass_stats.min_ms);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", pass_stats.avg_ms);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", pass_stats.max_ms);
+	}
+	ImGui::EndTable();
+}
+
+void Profiler::destroy() {
+	if (ctx) {
+		for (auto& frame : frames) {
+			if (frame.pool) {
+				vkDestroyQueryPool(ctx->device, frame.pool, nullptr);
+			}
+		}
+	}
+	frames = {};
+	frame_idx = 0;
+	curr_frame = nullptr;
+	ctx = nullptr;
+	history.clear();
+	stats.clear();
+	trace_events.clear();
+	trace_frames_left = trace_frames_pending = 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "../LumenPCH.h"
+#include "ChromeTrace.h"
+#include <array>
+#include <deque>
+
+/*
+	Timestamp queries around the render graph passes. Every frame (reset() to reset()) gets its own query pool
+	from a small ring. The results are only fetched once the ring comes back to the pool, if they still aren't
+	available by then, the frame is skipped instead of waiting on the GPU.
+*/
+class Profiler {
+   public:
+	struct PassStats {
+		std::string name;
+		float min_ms = 0.0f;
+		float avg_ms = 0.0f;
+		float max_ms = 0.0f;
+		float last_ms = 0.0f;
+	};
+
+	// RAII timer for a CPU phase, does nothing if the profiler is disabled
+	struct CPUScope {
+		CPUScope(Profiler& profiler, const char* name);
+		~CPUScope();
+		Profiler* profiler;
+		const char* name;
+		double start_us;
+	};
+
+	// Query pools are created on the first profiled frame
+	void begin_frame(VulkanContext* ctx);
+	void end_frame();
+	void destroy();
+	// Returns the index that has to be passed to end_pass(), UINT32_MAX if the pass isn't timed
+	uint32_t begin_pass(VkCommandBuffer cmd, const std::string& name, bool compute_queue);
+	void end_pass(VkCommandBuffer cmd, uint32_t pass_query);
+	void add_cpu_event(const char* name, double start_us, double end_us);
+	double now_us() const;
+	// Collects the next num_frames frames and writes them to path
+	void capture_trace(const std::string& path, uint32_t num_frames = 8);
+	void gui();
+
+	const std::vector<PassStats>& pass_stats() const { return stats; }
+	// Sum of the GPU frame times collected so far, lags the recorded frames by up to the size of the ring
+	double gpu_time_ms() const { return total_gpu_ms; }
+	bool enabled = false;
+
+   private:
+	static constexpr uint32_t MAX_QUERIES = 1024;
+	static constexpr uint32_t STATS_WINDOW = 128;
+
+	struct TimedPass {
+		std::string name;
+		bool compute_queue = false;
+	};
+
+	struct FrameQueries {
+		VkQueryPool pool = VK_NULL_HANDLE;
+		std::vector<TimedPass> passes;
+		// CPU time at the beginning of the frame, the GPU events of the trace are placed relative to it
+		double cpu_start_us = 0.0;
+		uint64_t frame_number = 0;
+		bool pending = false;
+		bool traced = false;
+	};
+
+	struct PassHistory {
+		std::deque<float> samples_ms;
+	};
+
+	void collect(FrameQueries& frame);
+
+	VulkanContext* ctx = nullptr;
+	std::array<FrameQueries, 4> frames;
+	uint32_t frame_idx = 0;
+	FrameQueries* curr_frame = nullptr;
+	std::mutex pass_mutex;
+	uint64_t frame_count = 0;
+	float timestamp_period = 1.0f;
+	uint64_t timestamp_masks[2] = {};
+	std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+	std::unordered_map<std::string, PassHistory> history;
+	std::vector<PassStats> stats;
+	float gpu_frame_ms = 0.0f;
+	double total_gpu_ms = 0.0;
+
+	std::mutex trace_mutex;
+	std::vector<TraceEvent> trace_events;
+	std::string trace_path;
+	uint32_t trace_frames_left = 0;
+	// Frames whose GPU results still have to arrive before the trace is written
+	uint32_t trace_frames_pending = 0;
+};
@@ -1,6 +1,8 @@
 #include "../LumenPCH.h"
 #include "RenderGraph.h"
 #include "VkUtils.h"
+#include "BindlessHeap.h"
+#include "UploadContext.h"
 #include <unordered_set>
 
 // TODO: "Handle" the stupid bug where the multithreaded pipeline compilation
@@ -12,94 +14,102 @@
 		return *this;  \
 	}
 
-void RenderPass::register_dependencies(Buffer& buffer, VkAccessFlags dst_access_flags) {
-	const bool found = rg->buffer_resource_map.find(buffer.handle) != rg->buffer_resource_map.end();
-	if (!found || (dst_access_flags == VK_ACCESS_SHADER_READ_BIT &&
-				   (rg->buffer_resource_map[buffer.handle].second == dst_access_flags))) {
+static inline void hash_combine(size_t& seed, size_t val) { seed ^= val + 0x9e3779b9 + (seed << 6) + (seed >> 2); }
+
+// Task names only show up in the ThreadPool profile, so they are only built while it's on
+static std::string task_name(const char* prefix, const std::string& name) {
+	return ThreadPool::profiling() ? prefix + name : std::string();
+}
+
+template <typename T>
+static T* find_sync_descriptor(std::vector<T>& descriptors, uint32_t resource) {
+	auto it = std::find_if(descriptors.begin(), descriptors.end(),
+						   [resource](const T& descriptor) { return descriptor.resource == resource; });
+	return it != descriptors.end() ? &*it : nullptr;
+}
+
+void RenderPass::register_dependencies(Buffer& buffer, uint32_t resource, VkAccessFlags dst_access_flags) {
+	const auto& state = rg->buffer_states[resource];
+	const bool found = state.pass_idx != UINT32_MAX;
+	LastAccess last;
+	if (found) {
+		const RenderPass& opposing_pass = rg->passes[state.pass_idx];
+		last = {.pass_idx = opposing_pass.pass_idx,
+				.access_flags = state.access_flags,
+				.submitted = opposing_pass.submitted};
+	}
+	const BufferDependency dependency = plan_buffer_dependency(found ? &last : nullptr, pass_idx, dst_access_flags);
+	if (dependency.action == SyncAction::Barrier) {
+		buffer_barriers.push_back({buffer.handle, dependency.src_access_flags, dependency.dst_access_flags});
 		return;
 	}
-	RenderPass& opposing_pass = rg->passes[rg->buffer_resource_map[buffer.handle].first];
-	if (opposing_pass.submitted) {
+	if (dependency.action != SyncAction::Event) {
 		return;
 	}
-	// Invariant : Pass with lower index should be the setter
 	// Set current pass dependencies
-	auto src_access_flags = rg->buffer_resource_map[buffer.handle].second;
-	if (src_access_flags & VK_ACCESS_TRANSFER_WRITE_BIT) {
-		dst_access_flags |= VK_ACCESS_TRANSFER_WRITE_BIT;
+	if (!find_sync_descriptor(wait_signals_buffer, resource)) {
+		wait_signals_buffer.push_back(BufferSyncDescriptor{
+			.resource = resource,
+			.buffer = buffer.handle,
+			.src_access_flags = dependency.src_access_flags,
+			.dst_access_flags = dependency.dst_access_flags,
+			.opposing_pass_idx = dependency.opposing_pass_idx,
+		});
 	}
-
-	if (opposing_pass.pass_idx < pass_idx) {
-		if (wait_signals_buffer.find(buffer.handle) == wait_signals_buffer.end()) {
-			wait_signals_buffer[buffer.handle] = BufferSyncDescriptor{
-				.src_access_flags = src_access_flags,
-				.dst_access_flags = dst_access_flags,
-				.opposing_pass_idx = opposing_pass.pass_idx,
-			};
-		}
-		// Set source pass dependencies (Signalling pass)
-		if (opposing_pass.set_signals_buffer.find(buffer.handle) == opposing_pass.set_signals_buffer.end()) {
-			opposing_pass.set_signals_buffer[buffer.handle] = BufferSyncDescriptor{.src_access_flags = src_access_flags,
-																				   .dst_access_flags = dst_access_flags,
-																				   .opposing_pass_idx = pass_idx};
-		}
-	} else {
-		buffer_barriers.push_back({buffer.handle, src_access_flags, dst_access_flags});
+	// Set source pass dependencies (Signalling pass)
+	RenderPass& opposing_pass = rg->passes[state.pass_idx];
+	if (!find_sync_descriptor(opposing_pass.set_signals_buffer, resource)) {
+		opposing_pass.set_signals_buffer.push_back(BufferSyncDescriptor{.resource = resource,
+																		.buffer = buffer.handle,
+																		.src_access_flags = dependency.src_access_flags,
+																		.dst_access_flags = dependency.dst_access_flags,
+																		.opposing_pass_idx = pass_idx});
 	}
 }
 
-void RenderPass::register_dependencies(Texture2D& tex, VkImageLayout dst_layout) {
+void RenderPass::register_dependencies(Texture2D& tex, uint32_t resource, VkImageLayout dst_layout) {
 	const bool has_storage_bit = (tex.usage_flags & VK_IMAGE_USAGE_STORAGE_BIT) == VK_IMAGE_USAGE_STORAGE_BIT;
-	const bool eq_layouts = tex.layout == dst_layout;
-	// Note: Currently, the following optimization doesn't work for this:
-	// if (eq_layouts && (!has_storage_bit || dst_layout == VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL)) {
-	// The reason is that when both src and dst layout are VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, it's possible that prior
-	// to this pass, there was another pass that signalled a transition to READ_ONLY_OPTIMAL, and that pass might have a
-	// different pipeline type. So, for example: 
-	// (compute - Image layout : general) -> (compute - Image layout: read_only (for compute only)) - (fragment - Image layout: read only) 
-	// In this case: The correct synchronization is needed to ensure a fragment shader read access. 
-	// So in principle it would be possible to feed that access flag in the 2nd stage, 
-	// but our architecture currently doesn't allow this as we don't explicitly store the pipeline stage for signals
-	if (eq_layouts && !has_storage_bit) {
-		return;
+	const uint32_t last_pass = rg->img_states[resource];
+	LastAccess last;
+	if (last_pass != UINT32_MAX) {
+		const RenderPass& opposing_pass = rg->passes[last_pass];
+		last = {.pass_idx = opposing_pass.pass_idx, .submitted = opposing_pass.submitted};
 	}
-	auto img_resource = rg->img_resource_map.find(tex.img);
-	const bool resource_exists = img_resource != rg->img_resource_map.end();
-	if (has_storage_bit && tex.layout == dst_layout && !resource_exists) {
-		return;
-	}
-	if (tex.layout == VK_IMAGE_LAYOUT_UNDEFINED || !resource_exists) {
+	const ImageDependency dependency =
+		plan_image_dependency(last_pass != UINT32_MAX ? &last : nullptr, tex.layout, dst_layout, has_storage_bit,
+							  pass_idx, rg->beginning_pass_idx);
+	if (dependency.action == SyncAction::Transition) {
 		layout_transitions.push_back({&tex, tex.layout, dst_layout});
-		tex.layout = dst_layout;
-	} else {
-		RenderPass& opposing_pass = rg->passes[img_resource->second];
-		if (opposing_pass.submitted) {
-			return;
+	} else if (dependency.action == SyncAction::Event) {
+		// Set current pass dependencies (Waiting pass)
+		if (!find_sync_descriptor(wait_signals_img, resource)) {
+			wait_signals_img.push_back(ImageSyncDescriptor{.resource = resource,
+														   .img = tex.img,
+														   .old_layout = tex.layout,
+														   .new_layout = dst_layout,
+														   .opposing_pass_idx = dependency.opposing_pass_idx,
+														   .image_aspect = tex.aspect_flags});
 		}
-		if (opposing_pass.pass_idx < pass_idx && opposing_pass.pass_idx >= rg->beginning_pass_idx) {
-			// Set current pass dependencies (Waiting pass)
-			if (wait_signals_img.find(tex.img) == wait_signals_img.end()) {
-				wait_signals_img[tex.img] = ImageSyncDescriptor{.old_layout = tex.layout,
-																.new_layout = dst_layout,
-																.opposing_pass_idx = opposing_pass.pass_idx,
-																.image_aspect = tex.aspect_flags};
-			}
-			// Set source pass dependencies (Signalling pass)
-			if (opposing_pass.set_signals_img.find(tex.img) == opposing_pass.set_signals_img.end()) {
-				opposing_pass.set_signals_img[tex.img] = ImageSyncDescriptor{.old_layout = tex.layout,
-																			 .new_layout = dst_layout,
-																			 .opposing_pass_idx = pass_idx,
-																			 .image_aspect = tex.aspect_flags};
-			}
-			tex.layout = dst_layout;
-		} else {
-			layout_transitions.push_back({&tex, tex.layout, dst_layout});
-			tex.layout = dst_layout;
+		// Set source pass dependencies (Signalling pass)
+		RenderPass& opposing_pass = rg->passes[last_pass];
+		if (!find_sync_descriptor(opposing_pass.set_signals_img, resource)) {
+			opposing_pass.set_signals_img.push_back(ImageSyncDescriptor{.resource = resource,
+																		.img = tex.img,
+																		.old_layout = tex.layout,
+																		.new_layout = dst_layout,
+																		.opposing_pass_idx = pass_idx,
+																		.image_aspect = tex.aspect_flags});
 		}
+	} else {
+		return;
 	}
+	tex.layout = dst_layout;
 }
 
 void RenderPass::transition_resources() {
+	for (Texture2D* tex : discarded_textures) {
+		tex->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
 	if (rg->settings.shader_inference) {
 		for (auto i = 0; i < bound_resources.size(); i++) {
 			auto& bound_resource = bound_resources[i];
@@ -151,6 +161,11 @@ void RenderPass::transition_resources() {
 			descriptor_infos[i] = bound_resources[i].get_descriptor_info();
 		}
 	}
+	// The arguments are read by the command itself, whichever way the rest is inferred
+	if (Buffer* args = indirect_buffer()) {
+		LUMEN_ASSERT(args->usage_flags & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, "Indirect argument buffer lacks the usage");
+		read_impl(*args, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+	}
 	for (const Resource& resource : resource_zeros) {
 		if (resource.buf) {
 			write_impl(*resource.buf, VK_ACCESS_TRANSFER_WRITE_BIT);
@@ -174,101 +189,77 @@ void RenderPass::transition_resources() {
 	}
 }
 
-static void build_shaders(RenderPass* pass, const std::vector<Shader*>& active_shaders) {
-	// todo: make resource processing in order
-	auto process_bindless_resources = [pass](const Shader& shader) {
-		if (!pass->rg->settings.shader_inference) {
-			return;
-		}
-		for (auto& [k, v] : shader.buffer_status_map) {
-			if (v.read) {
-				pass->affected_buffer_pointers[k].read = v.read;
-			}
-			if (v.write) {
-				pass->affected_buffer_pointers[k].write = v.write;
-			}
+static void process_bindless_resources(RenderPass* pass, const Shader& shader) {
+	if (!pass->rg->settings.shader_inference) {
+		return;
+	}
+	for (auto& [k, v] : shader.buffer_status_map) {
+		if (v.read) {
+			pass->affected_buffer_pointers[k].read = v.read;
 		}
-	};
-	auto process_bindings = [pass](const Shader& shader) {
-		for (auto& [k, v] : shader.resource_binding_map) {
-			assert(k < pass->bound_resources.size());
-			pass->bound_resources[k].active = v.active;
-			pass->bound_resources[k].read = v.read;
-			pass->bound_resources[k].write = v.write;
+		if (v.write) {
+			pass->affected_buffer_pointers[k].write = v.write;
 		}
-	};
+	}
+}
+
+static void process_bindings(RenderPass* pass, const Shader& shader) {
+	for (auto& [k, v] : shader.resource_binding_map) {
+		assert(k < pass->bound_resources.size());
+		pass->bound_resources[k].active = v.active;
+		pass->bound_resources[k].read = v.read;
+		pass->bound_resources[k].write = v.write;
+	}
+}
+
+static void build_shaders(RenderPass* pass, const std::vector<Shader*>& active_shaders) {
+	// todo: make resource processing in order
 	switch (pass->type) {
-		case PassType::Graphics: {
-			std::vector<std::future<Shader*>> shader_tasks;
-			shader_tasks.reserve(pass->gfx_settings->shaders.size());
+		case PassType::Graphics:
+		case PassType::RT: {
+			// Waiting on the group runs other compilations, so this doesn't block a worker
+			TaskGroup shader_tasks;
 			for (auto& shader : active_shaders) {
-				if (pass->rg->shader_cache.find(shader->name_with_macros) != pass->rg->shader_cache.end()) {
-					*shader = pass->rg->shader_cache[shader->name_with_macros];
-				} else {
-					shader_tasks.push_back(ThreadPool::submit(
-						[pass](Shader* shader) {
-							shader->compile(pass);
-							return shader;
-						},
-						shader));
-				}
-			}
-			for (auto& task : shader_tasks) {
-				auto shader = task.get();
 				{
 					std::lock_guard<std::mutex> lock(pass->rg->shader_map_mutex);
-					pass->rg->shader_cache[shader->name_with_macros] = *shader;
-				}
-			}
-			for (auto& shader : active_shaders) {
-				process_bindless_resources(*shader);
-				process_bindings(*shader);
-			}
-		} break;
-		case PassType::RT: {
-			std::vector<std::future<Shader*>> shader_tasks;
-			shader_tasks.reserve(pass->rt_settings->shaders.size());
-			for (auto& shader : active_shaders) {
-				if (pass->rg->shader_cache.find(shader->name_with_macros) != pass->rg->shader_cache.end()) {
-					*shader = pass->rg->shader_cache[shader->name_with_macros];
-				} else {
-					shader_tasks.push_back(ThreadPool::submit(
-						[pass](Shader* shader) {
-							shader->compile(pass);
-							return shader;
-						},
-						shader));
-					// shader->compile(pass);
-					pass->rg->shader_cache[shader->name_with_macros] = *shader;
+					auto it = pass->rg->shader_cache.find(shader->name_with_macros);
+					if (it != pass->rg->shader_cache.end()) {
+						*shader = it->second;
+						continue;
+					}
 				}
-			}
-			for (auto& task : shader_tasks) {
-				auto shader = task.get();
-				{
+				shader_tasks.run(task_name("compile:", shader->name_with_macros), [pass, shader] {
+					shader->compile(pass);
 					std::lock_guard<std::mutex> lock(pass->rg->shader_map_mutex);
 					pass->rg->shader_cache[shader->name_with_macros] = *shader;
-				}
+				});
 			}
+			shader_tasks.wait();
 			for (auto& shader : active_shaders) {
-				process_bindless_resources(*shader);
-				process_bindings(*shader);
+				process_bindless_resources(pass, *shader);
+				process_bindings(pass, *shader);
 			}
-
 		} break;
 		case PassType::Compute: {
 			for (auto& shader : active_shaders) {
-				if (pass->rg->shader_cache.find(shader->name_with_macros) != pass->rg->shader_cache.end()) {
-					*shader = pass->rg->shader_cache[shader->name_with_macros];
-				} else {
-					shader->compile(pass);
-					{
-						std::lock_guard<std::mutex> lock(pass->rg->shader_map_mutex);
-						pass->rg->shader_cache[shader->name_with_macros] = *shader;
+				// Other passes compile and insert into the cache concurrently
+				bool cached = false;
+				{
+					std::lock_guard<std::mutex> lock(pass->rg->shader_map_mutex);
+					auto it = pass->rg->shader_cache.find(shader->name_with_macros);
+					if (it != pass->rg->shader_cache.end()) {
+						*shader = it->second;
+						cached = true;
 					}
 				}
+				if (!cached) {
+					shader->compile(pass);
+					std::lock_guard<std::mutex> lock(pass->rg->shader_map_mutex);
+					pass->rg->shader_cache[shader->name_with_macros] = *shader;
+				}
 				// shader->compile(pass);
 				pass->affected_buffer_pointers = shader->buffer_status_map;
-				process_bindings(*shader);
+				process_bindings(pass, *shader);
 			}
 		} break;
 		default:
@@ -338,7 +329,7 @@ RenderPass& RenderPass::bind_buffer_array(std::vector<Buffer>& buffers) {
 }
 
 RenderPass& RenderPass::bind_tlas(const AccelKHR& tlas) {
-	DIRTY_CHECK(rg->recording || rg->reload_shaders);
+	DIRTY_CHECK(rg->recording);
 	pipeline->tlas_info = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR};
 	pipeline->tlas_info.accelerationStructureCount = 1;
 	pipeline->tlas_info.pAccelerationStructures = &tlas.accel;
@@ -466,123 +457,248 @@ void RenderPass::finalize(bool record_override_encountered) {
 
 	// Create pipelines/push descriptor templates
 	if (!is_pipeline_cached) {
-		switch (type) {
-			case PassType::Graphics: {
-				auto func = [](RenderPass* pass) {
-					pass->pipeline->create_gfx_pipeline(*pass->gfx_settings, pass->descriptor_counts,
-														pass->gfx_settings->color_outputs,
-														pass->gfx_settings->depth_output);
-				};
-				if (rg->multithreaded_pipeline_compilation) {
-					rg->pipeline_tasks.push_back({func, pass_idx});
-				} else {
-					func(this);
-				}
-				break;
-			}
-			case PassType::RT: {
-				auto func = [](RenderPass* pass) {
-					pass->pipeline->create_rt_pipeline(*pass->rt_settings, pass->descriptor_counts);
-					// Create descriptor pool and sets
-					if (!pass->pipeline->tlas_descriptor_pool) {
-						auto pool_size = vk::descriptor_pool_size(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1);
-						auto descriptor_pool_ci = vk::descriptor_pool_CI(1, &pool_size, 1);
-
-						vk::check(vkCreateDescriptorPool(pass->rg->ctx->device, &descriptor_pool_ci, nullptr,
-														 &pass->pipeline->tlas_descriptor_pool),
-								  "Failed to create descriptor pool");
-						VkDescriptorSetAllocateInfo set_allocate_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-						set_allocate_info.descriptorPool = pass->pipeline->tlas_descriptor_pool;
-						set_allocate_info.descriptorSetCount = 1;
-						set_allocate_info.pSetLayouts = &pass->pipeline->tlas_layout;
-						vkAllocateDescriptorSets(pass->rg->ctx->device, &set_allocate_info,
-												 &pass->pipeline->tlas_descriptor_set);
-					}
-					auto descriptor_write = vk::write_descriptor_set(pass->pipeline->tlas_descriptor_set,
-																	 VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 0,
-																	 &pass->pipeline->tlas_info);
-					vkUpdateDescriptorSets(pass->rg->ctx->device, 1, &descriptor_write, 0, nullptr);
-				};
-				if (rg->multithreaded_pipeline_compilation) {
-					rg->pipeline_tasks.push_back({func, pass_idx});
-				} else {
-					func(this);
-				}
-				break;
-			}
-			case PassType::Compute: {
-				auto func = [](RenderPass* pass) {
-					pass->pipeline->create_compute_pipeline(*pass->compute_settings, pass->descriptor_counts);
-				};
-				if (rg->multithreaded_pipeline_compilation) {
-					rg->pipeline_tasks.push_back({func, pass_idx});
-				} else {
-					func(this);
-				}
-				break;
-			}
-			default:
-				break;
-		}
-		if (!rg->multithreaded_pipeline_compilation) {
+		if (rg->multithreaded_pipeline_compilation) {
+			rg->pipeline_tasks.push_back({true, pass_idx});
+		} else {
+			build_pipeline(false);
 			transition_resources();
 		}
 	} else {
-		rg->pipeline_tasks.push_back({nullptr, pass_idx});
+		rg->pipeline_tasks.push_back({false, pass_idx});
+	}
+}
+
+std::vector<Shader*> RenderPass::shader_list() {
+	std::vector<Shader*> shaders;
+	if (gfx_settings) {
+		for (auto& shader : gfx_settings->shaders) {
+			shaders.push_back(&shader);
+		}
+	} else if (rt_settings) {
+		for (auto& shader : rt_settings->shaders) {
+			shaders.push_back(&shader);
+		}
+	} else {
+		shaders.push_back(&compute_settings->shader);
+	}
+	return shaders;
+}
+
+void RenderPass::reflect_pipeline() {
+	switch (type) {
+		case PassType::Graphics:
+			pipeline->reflect(gfx_settings->shaders);
+			break;
+		case PassType::RT:
+			pipeline->reflect(rt_settings->shaders);
+			break;
+		case PassType::Compute:
+			pipeline->reflect({compute_settings->shader});
+			break;
+		default:
+			break;
+	}
+}
+
+bool RenderPass::build_pipeline(bool compile_shaders) {
+	if (compile_shaders) {
+		for (Shader* shader : shader_list()) {
+			shader->compile(this);
+			if (shader->binary.empty()) {
+				return false;
+			}
+			process_bindless_resources(this, *shader);
+			process_bindings(this, *shader);
+		}
+	}
+	switch (type) {
+		case PassType::Graphics:
+			pipeline->create_gfx_pipeline(*gfx_settings, descriptor_counts, gfx_settings->color_outputs,
+										  gfx_settings->depth_output);
+			break;
+		case PassType::RT: {
+			pipeline->create_rt_pipeline(*rt_settings, descriptor_counts);
+			// Create descriptor pool and sets
+			if (!pipeline->tlas_descriptor_pool) {
+				auto pool_size = vk::descriptor_pool_size(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1);
+				auto descriptor_pool_ci = vk::descriptor_pool_CI(1, &pool_size, 1);
+
+				vk::check(vkCreateDescriptorPool(rg->ctx->device, &descriptor_pool_ci, nullptr,
+												 &pipeline->tlas_descriptor_pool),
+						  "Failed to create descriptor pool");
+				VkDescriptorSetAllocateInfo set_allocate_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+				set_allocate_info.descriptorPool = pipeline->tlas_descriptor_pool;
+				set_allocate_info.descriptorSetCount = 1;
+				set_allocate_info.pSetLayouts = &pipeline->tlas_layout;
+				vkAllocateDescriptorSets(rg->ctx->device, &set_allocate_info, &pipeline->tlas_descriptor_set);
+			}
+			auto descriptor_write = vk::write_descriptor_set(
+				pipeline->tlas_descriptor_set, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 0, &pipeline->tlas_info);
+			vkUpdateDescriptorSets(rg->ctx->device, 1, &descriptor_write, 0, nullptr);
+			break;
+		}
+		case PassType::Compute:
+			pipeline->create_compute_pipeline(*compute_settings, descriptor_counts);
+			break;
+		default:
+			break;
+	}
+	return true;
+}
+
+std::unique_ptr<RenderPass> RenderPass::detached_copy(Pipeline* pipeline) const {
+	// The constructors append the macros to the shader names, the copied shaders already have them
+	std::unique_ptr<RenderPass> copy;
+	switch (type) {
+		case PassType::Graphics:
+			copy = std::make_unique<RenderPass>(type, pipeline, name, rg, pass_idx, *gfx_settings, "", true);
+			copy->gfx_settings->shaders = gfx_settings->shaders;
+			break;
+		case PassType::RT:
+			copy = std::make_unique<RenderPass>(type, pipeline, name, rg, pass_idx, *rt_settings, "", true);
+			copy->rt_settings->shaders = rt_settings->shaders;
+			break;
+		default:
+			copy = std::make_unique<RenderPass>(type, pipeline, name, rg, pass_idx, *compute_settings, "", true);
+			copy->compute_settings->shader = compute_settings->shader;
+			break;
 	}
+	copy->bound_resources = bound_resources;
+	copy->descriptor_counts = descriptor_counts;
+	return copy;
 }
 
 void RenderPass::write_impl(Buffer& buffer, VkAccessFlags access_flags) {
-	register_dependencies(buffer, access_flags);
-	rg->buffer_resource_map[buffer.handle] = {pass_idx, access_flags};
+	const uint32_t resource = rg->resource_id(buffer);
+	register_dependencies(buffer, resource, access_flags);
+	rg->buffer_states[resource] = {pass_idx, access_flags};
+	if (rg->capturing_plan) {
+		rg->captured_buffers.push_back(resource);
+	}
 }
 
 void RenderPass::write_impl(Texture2D& tex) {
+	save_entry_layout(tex);
 	VkImageLayout target_layout = get_target_img_layout(tex, VK_ACCESS_SHADER_WRITE_BIT);
-	register_dependencies(tex, target_layout);
-	rg->img_resource_map[tex.img] = pass_idx;
+	const uint32_t resource = rg->resource_id(tex);
+	register_dependencies(tex, resource, target_layout);
+	rg->img_states[resource] = pass_idx;
+	if (rg->capturing_plan) {
+		rg->captured_textures.push_back(&tex);
+	}
 }
 
 void RenderPass::read_impl(Buffer& buffer) { read_impl(buffer, VK_ACCESS_SHADER_READ_BIT); }
 
 void RenderPass::read_impl(Buffer& buffer, VkAccessFlags access_flags) {
-	register_dependencies(buffer, access_flags);
-	rg->buffer_resource_map[buffer.handle] = {pass_idx, access_flags};
+	const uint32_t resource = rg->resource_id(buffer);
+	register_dependencies(buffer, resource, access_flags);
+	rg->buffer_states[resource] = {pass_idx, access_flags};
+	if (rg->capturing_plan) {
+		rg->captured_buffers.push_back(resource);
+	}
 }
 
 void RenderPass::read_impl(Texture2D& tex) {
+	save_entry_layout(tex);
 	VkImageLayout target_layout = get_target_img_layout(tex, VK_ACCESS_SHADER_READ_BIT);
-	register_dependencies(tex, target_layout);
-	rg->img_resource_map[tex.img] = pass_idx;
+	const uint32_t resource = rg->resource_id(tex);
+	register_dependencies(tex, resource, target_layout);
+	rg->img_states[resource] = pass_idx;
+	if (rg->capturing_plan) {
+		rg->captured_textures.push_back(&tex);
+	}
+}
+
+void RenderPass::save_entry_layout(Texture2D& tex) {
+	for (const auto& [entry_tex, _] : entry_layouts) {
+		if (entry_tex == &tex) {
+			return;
+		}
+	}
+	entry_layouts.push_back({&tex, tex.layout});
+}
+
+VkImageLayout RenderPass::entry_layout(const Texture2D& tex) const {
+	for (const auto& [entry_tex, layout] : entry_layouts) {
+		if (entry_tex == &tex) {
+			return layout;
+		}
+	}
+	return tex.layout;
+}
+
+void RenderPass::clear_sync_state() {
+	set_signals_buffer.clear();
+	wait_signals_buffer.clear();
+	set_signals_img.clear();
+	wait_signals_img.clear();
+	layout_transitions.clear();
+	buffer_barriers.clear();
+	post_execution_buffer_barriers.clear();
+	entry_layouts.clear();
+	sync_state_cached = false;
 }
 
 void RenderPass::post_execution_barrier(Buffer& buffer, VkAccessFlags access_flags) {
-	auto src_access_flags = rg->buffer_resource_map[buffer.handle].second;
+	auto src_access_flags = rg->buffer_states[rg->resource_id(buffer)].access_flags;
 	post_execution_buffer_barriers.push_back({buffer.handle, src_access_flags, access_flags});
 }
 
-void RenderPass::run(VkCommandBuffer cmd) {
-	std::vector<VkEvent> wait_events;
+void RenderPass::acquire_events(VkCommandBuffer cmd) {
+	for (auto& v : set_signals_buffer) {
+		if (rg->passes[v.opposing_pass_idx].on_async_queue == on_async_queue) {
+			v.event = rg->event_pool.get_event(rg->ctx->device, cmd);
+		}
+	}
+	for (auto& v : set_signals_img) {
+		if (rg->passes[v.opposing_pass_idx].on_async_queue == on_async_queue) {
+			v.event = rg->event_pool.get_event(rg->ctx->device, cmd);
+		}
+	}
+}
+
+void RenderPass::run(VkCommandBuffer cmd, FrameArena& arena) {
+	std::pmr::vector<VkEvent> wait_events(&arena);
 	const bool use_events = rg->settings.use_events;
 	if (use_events) {
 		wait_events.reserve(wait_signals_buffer.size());
 	}
 	DebugMarker::begin_region(rg->ctx->device, cmd, name.c_str(), glm::vec4(1.0f, 0.78f, 0.05f, 1.0f));
+	const uint32_t pass_query = rg->profiler.begin_pass(cmd, name, on_async_queue);
+	if (alias_barrier) {
+		// The memory was used by another transient resource before
+		VkMemoryBarrier2 alias_mem_barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+		alias_mem_barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		alias_mem_barrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+		alias_mem_barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		alias_mem_barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+		VkDependencyInfo alias_dependency_info = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+		alias_dependency_info.memoryBarrierCount = 1;
+		alias_dependency_info.pMemoryBarriers = &alias_mem_barrier;
+		vkCmdPipelineBarrier2(cmd, &alias_dependency_info);
+	}
 	// Wait: Buffer
 	auto& buffer_sync = rg->buffer_sync_resources[pass_idx];
 	auto& img_sync = rg->img_sync_resources[pass_idx];
 	int i = 0;
-	for (const auto& [k, v] : wait_signals_buffer) {
-		if (use_events) {
-			LUMEN_ASSERT(rg->passes[v.opposing_pass_idx].set_signals_buffer[k].event, "Event can't be null");
-		}
-		buffer_sync.buffer_bariers[i] =
-			buffer_barrier2(k, v.src_access_flags, v.dst_access_flags,
+	for (const auto& v : wait_signals_buffer) {
+		const VkBufferMemoryBarrier2 barrier =
+			buffer_barrier2(v.buffer, v.src_access_flags, v.dst_access_flags,
 							get_pipeline_stage(rg->passes[v.opposing_pass_idx].type, v.src_access_flags),
 							get_pipeline_stage(type, v.dst_access_flags));
+		if (use_events && rg->passes[v.opposing_pass_idx].on_async_queue != on_async_queue) {
+			// Events don't work across queues, the semaphore between the queue batches already waited
+			VkDependencyInfo dependency_info = vk::dependency_info(1, &barrier);
+			vkCmdPipelineBarrier2(cmd, &dependency_info);
+			continue;
+		}
+		buffer_sync.buffer_bariers[i] = barrier;
 		buffer_sync.dependency_infos[i] = vk::dependency_info(1, &buffer_sync.buffer_bariers[i]);
 		if (use_events) {
-			wait_events.push_back(rg->passes[v.opposing_pass_idx].set_signals_buffer[k].event);
+			const auto* signal = find_sync_descriptor(rg->passes[v.opposing_pass_idx].set_signals_buffer, v.resource);
+			LUMEN_ASSERT(signal && signal->event, "Event can't be null");
+			wait_events.push_back(signal->event);
 		}
 		i++;
 	}
@@ -606,7 +722,7 @@ void RenderPass::run(VkCommandBuffer cmd) {
 
 	// Buffer barriers
 	{
-		std::vector<VkBufferMemoryBarrier2> buffer_memory_barriers;
+		std::pmr::vector<VkBufferMemoryBarrier2> buffer_memory_barriers(&arena);
 		buffer_memory_barriers.reserve(buffer_barriers.size());
 		for (auto& barrier : buffer_barriers) {
 			auto curr_stage = get_pipeline_stage(type, barrier.src_access_flags);
@@ -622,20 +738,25 @@ void RenderPass::run(VkCommandBuffer cmd) {
 	// Wait: Images
 	wait_events.clear();
 	i = 0;
-	for (const auto& [k, v] : wait_signals_img) {
-		if (use_events) {
-			LUMEN_ASSERT(rg->passes[v.opposing_pass_idx].set_signals_img[k].event, "Event can't be null");
-		}
+	for (const auto& v : wait_signals_img) {
 		auto src_access_flags = vk::access_flags_for_img_layout(v.old_layout);
 		auto dst_access_flags = vk::access_flags_for_img_layout(v.new_layout);
 		auto src_stage = get_pipeline_stage(rg->passes[v.opposing_pass_idx].type, src_access_flags);
 		auto dst_stage = get_pipeline_stage(type, dst_access_flags);
-		img_sync.img_barriers[i] =
-			image_barrier2(k, src_access_flags, dst_access_flags, v.old_layout, v.new_layout, v.image_aspect, src_stage,
+		const VkImageMemoryBarrier2 barrier =
+			image_barrier2(v.img, src_access_flags, dst_access_flags, v.old_layout, v.new_layout, v.image_aspect, src_stage,
 						   dst_stage, rg->ctx->indices.gfx_family.value());
+		if (use_events && rg->passes[v.opposing_pass_idx].on_async_queue != on_async_queue) {
+			VkDependencyInfo dependency_info = vk::dependency_info(1, &barrier);
+			vkCmdPipelineBarrier2(cmd, &dependency_info);
+			continue;
+		}
+		img_sync.img_barriers[i] = barrier;
 		img_sync.dependency_infos[i] = vk::dependency_info(1, &img_sync.img_barriers[i]);
 		if (use_events) {
-			wait_events.push_back(rg->passes[v.opposing_pass_idx].set_signals_img[k].event);
+			const auto* signal = find_sync_descriptor(rg->passes[v.opposing_pass_idx].set_signals_img, v.resource);
+			LUMEN_ASSERT(signal && signal->event, "Event can't be null");
+			wait_events.push_back(signal->event);
 		}
 		i++;
 	}
@@ -656,18 +777,31 @@ void RenderPass::run(VkCommandBuffer cmd) {
 		tex->force_transition(cmd, old_layout, dst_layout);
 	}
 
+	// Until the pipeline is created, the pass only takes part in the synchronization
+	const bool pipeline_ready = !pipeline->compiling.load(std::memory_order_acquire);
 	// Push descriptors
-	if (bound_resources.size()) {
+	if (pipeline_ready && bound_resources.size()) {
 		vkCmdPushDescriptorSetWithTemplateKHR(cmd, pipeline->update_template, pipeline->pipeline_layout, 0,
 											  descriptor_infos);
 	}
+	// Scene textures
+	if (pipeline_ready && pipeline->uses_bindless) {
+		VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		if (type == PassType::RT) {
+			bind_point = VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR;
+		} else if (type == PassType::Compute) {
+			bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+		}
+		vkCmdBindDescriptorSets(cmd, bind_point, pipeline->pipeline_layout, BINDLESS_SET, 1, &rg->ctx->bindless->set,
+								0, nullptr);
+	}
 	// Push constants
-	if (pipeline->push_constant_size) {
+	if (pipeline_ready && pipeline->push_constant_size) {
 		vkCmdPushConstants(cmd, pipeline->pipeline_layout, pipeline->pc_stages, 0, pipeline->push_constant_size,
 						   push_constant_data);
 	}
 	// Run
-	if (!disable_execution) {
+	if (pipeline_ready && !disable_execution) {
 		switch (type) {
 			case PassType::RT: {
 				LUMEN_ASSERT(pipeline->tlas_descriptor_set, "TLAS descriptor set cannot be NULL!");
@@ -685,8 +819,15 @@ void RenderPass::run(VkCommandBuffer cmd) {
 					rt_settings->pass_func(cmd, *this);
 				} else {
 					auto& regions = pipeline->get_rt_regions();
-					auto& dims = rt_settings->dims;
-					vkCmdTraceRaysKHR(cmd, &regions[0], &regions[1], &regions[2], &regions[3], dims.x, dims.y, dims.z);
+					if (rt_settings->indirect_buffer) {
+						const VkDeviceAddress args =
+							rt_settings->indirect_buffer->get_device_address() + rt_settings->indirect_offset;
+						vkCmdTraceRaysIndirectKHR(cmd, &regions[0], &regions[1], &regions[2], &regions[3], args);
+					} else {
+						auto& dims = rt_settings->dims;
+						vkCmdTraceRaysKHR(cmd, &regions[0], &regions[1], &regions[2], &regions[3], dims.x, dims.y,
+										  dims.z);
+					}
 				}
 				break;
 			}
@@ -695,6 +836,9 @@ void RenderPass::run(VkCommandBuffer cmd) {
 
 				if (compute_settings->pass_func) {
 					compute_settings->pass_func(cmd, *this);
+				} else if (compute_settings->indirect_buffer) {
+					vkCmdDispatchIndirect(cmd, compute_settings->indirect_buffer->handle,
+										  compute_settings->indirect_offset);
 				} else {
 					auto& dims = compute_settings->dims;
 					vkCmdDispatch(cmd, dims.x, dims.y, dims.z);
@@ -714,10 +858,10 @@ void RenderPass::run(VkCommandBuffer cmd) {
 				vkCmdSetScissor(cmd, 0, 1, &scissor);
 
 				if (gfx_settings->vertex_buffers.size()) {
-					std::vector<VkDeviceSize> offsets(gfx_settings->vertex_buffers.size(), 0);
-					std::vector<VkBuffer> vert_buffers(gfx_settings->vertex_buffers.size(), 0);
-					for (auto& buf : gfx_settings->vertex_buffers) {
-						vert_buffers[i] = buf->handle;
+					std::pmr::vector<VkDeviceSize> offsets(gfx_settings->vertex_buffers.size(), 0, &arena);
+					std::pmr::vector<VkBuffer> vert_buffers(gfx_settings->vertex_buffers.size(), 0, &arena);
+					for (size_t j = 0; j < vert_buffers.size(); j++) {
+						vert_buffers[j] = gfx_settings->vertex_buffers[j]->handle;
 					}
 					vkCmdBindVertexBuffers(cmd, 0, (uint32_t)vert_buffers.size(), vert_buffers.data(), offsets.data());
 				}
@@ -725,7 +869,7 @@ void RenderPass::run(VkCommandBuffer cmd) {
 				if (gfx_settings->index_buffer) {
 					vkCmdBindIndexBuffer(cmd, gfx_settings->index_buffer->handle, 0, gfx_settings->index_type);
 				}
-				std::vector<VkRenderingAttachmentInfo> rendering_attachments;
+				std::pmr::vector<VkRenderingAttachmentInfo> rendering_attachments(&arena);
 				rendering_attachments.reserve(color_outputs.size());
 				for (Texture2D* color_output : color_outputs) {
 					color_output->transition(cmd, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
@@ -772,7 +916,7 @@ void RenderPass::run(VkCommandBuffer cmd) {
 
 	// Post execution buffer barriers
 	{
-		std::vector<VkBufferMemoryBarrier2> post_execution_buffer_memory_barriers;
+		std::pmr::vector<VkBufferMemoryBarrier2> post_execution_buffer_memory_barriers(&arena);
 		post_execution_buffer_memory_barriers.reserve(post_execution_buffer_barriers.size());
 		for (auto& barrier : post_execution_buffer_barriers) {
 			auto curr_stage = get_pipeline_stage(type, barrier.src_access_flags);
@@ -795,6 +939,7 @@ void RenderPass::run(VkCommandBuffer cmd) {
 				region.imageSubresource.baseArrayLayer = 0;
 				region.imageSubresource.layerCount = 1;
 				region.imageExtent = src.tex->base_extent;
+				region.bufferOffset = dst.offset;
 				VkImageLayout old_layout = src.tex->layout;
 				src.tex->transition(cmd, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
 				vkCmdCopyImageToBuffer(cmd, src.tex->img, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst.buf->handle, 1,
@@ -803,32 +948,39 @@ void RenderPass::run(VkCommandBuffer cmd) {
 			}
 		} else {  // buffer
 			if (dst.buf) {
-				VkBufferCopy copy_region = {.size = src.buf->size};
+				VkBufferCopy copy_region = {.dstOffset = dst.offset, .size = src.buf->size};
 				vkCmdCopyBuffer(cmd, src.buf->handle, dst.buf->handle, 1, &copy_region);
 			}
 		}
 	}
 
 	// Set: Buffer
-	for (const auto& [k, v] : set_signals_buffer) {
-		LUMEN_ASSERT(v.event == nullptr, "VkEvent should be null in the setter");
+	// The events are already there if acquire_events() was called
+	for (auto& v : set_signals_buffer) {
+		if (rg->passes[v.opposing_pass_idx].on_async_queue != on_async_queue) {
+			continue;
+		}
 		VkBufferMemoryBarrier2 mem_barrier =
-			buffer_barrier2(k, v.src_access_flags, v.dst_access_flags, get_pipeline_stage(type, v.src_access_flags),
+			buffer_barrier2(v.buffer, v.src_access_flags, v.dst_access_flags, get_pipeline_stage(type, v.src_access_flags),
 							get_pipeline_stage(rg->passes[v.opposing_pass_idx].type, v.dst_access_flags));
 		VkDependencyInfo dependency_info = vk::dependency_info(1, &mem_barrier);
 
 		if (use_events) {
-			set_signals_buffer[k].event = rg->event_pool.get_event(rg->ctx->device, cmd);
-			vkCmdSetEvent2(cmd, set_signals_buffer[k].event, &dependency_info);
+			if (!v.event) {
+				v.event = rg->event_pool.get_event(rg->ctx->device, cmd);
+			}
+			vkCmdSetEvent2(cmd, v.event, &dependency_info);
 		}
 	}
 
 	// Set: Images
-	for (const auto& [k, v] : set_signals_img) {
-		LUMEN_ASSERT(v.event == nullptr, "VkEvent should be null in the setter");
+	for (auto& v : set_signals_img) {
+		if (rg->passes[v.opposing_pass_idx].on_async_queue != on_async_queue) {
+			continue;
+		}
 		auto src_access_flags = vk::access_flags_for_img_layout(v.old_layout);
 		auto dst_access_flags = vk::access_flags_for_img_layout(v.new_layout);
-		auto mem_barrier = image_barrier2(k, vk::access_flags_for_img_layout(v.old_layout),
+		auto mem_barrier = image_barrier2(v.img, vk::access_flags_for_img_layout(v.old_layout),
 										  vk::access_flags_for_img_layout(v.new_layout), v.old_layout, v.new_layout,
 										  v.image_aspect, get_pipeline_stage(type, src_access_flags),
 										  get_pipeline_stage(rg->passes[v.opposing_pass_idx].type, dst_access_flags),
@@ -836,20 +988,27 @@ void RenderPass::run(VkCommandBuffer cmd) {
 
 		VkDependencyInfo dependency_info = vk::dependency_info(1, &mem_barrier);
 		if (use_events) {
-			set_signals_img[k].event = rg->event_pool.get_event(rg->ctx->device, cmd);
-			vkCmdSetEvent2(cmd, set_signals_img[k].event, &dependency_info);
+			if (!v.event) {
+				v.event = rg->event_pool.get_event(rg->ctx->device, cmd);
+			}
+			vkCmdSetEvent2(cmd, v.event, &dependency_info);
 		}
 	}
+	rg->profiler.end_pass(cmd, pass_query);
 	DebugMarker::end_region(rg->ctx->device, cmd);
 }
 
 void RenderGraph::run(VkCommandBuffer cmd) {
+	profiler.enabled = settings.profile_passes || profiling_requested;
+	profiler.begin_frame(ctx);
+	poll_pipeline_builds();
 	buffer_sync_resources.resize(passes.size());
 	img_sync_resources.resize(passes.size());
 
-	// Compile shaders and process resources
+	// Compile shaders and process resources, reloads are compiled in the background
 	const bool recording_or_reload = recording || reload_shaders;
-	if (!pass_idxs_with_shader_compilation_overrides.empty() || recording_or_reload) {
+	if (!pass_idxs_with_shader_compilation_overrides.empty() || recording) {
+		Profiler::CPUScope scope(profiler, "Build shaders");
 		auto cmp = [](const std::pair<Shader*, RenderPass*>& a, const std::pair<Shader*, RenderPass*>& b) {
 			return a.first->name_with_macros < b.first->name_with_macros;
 		};
@@ -876,8 +1035,8 @@ void RenderGraph::run(VkCommandBuffer cmd) {
 				}
 			}
 		};
-		if (recording_or_reload) {
-			// Recording or reload -> The pass is active by default
+		if (recording) {
+			// Recording -> The pass is active by default
 			for (auto i = beginning_pass_idx; i < ending_pass_idx; i++) {
 				process_pass(i);
 			}
@@ -888,93 +1047,1225 @@ void RenderGraph::run(VkCommandBuffer cmd) {
 			}
 		}
 
-		std::vector<std::future<void>> futures;
 		for (auto& [shader, rp] : unique_shaders_set) {
 			unique_shaders[rp].push_back(shader);
 		}
+		TaskGroup build_tasks;
 		// Compile and process resources for unique shaders
 		for (auto& [pass, shaders] : unique_shaders) {
-			futures.push_back(ThreadPool::submit(std::bind(&build_shaders, pass, shaders)));
-		}
-		for (auto& future : futures) {
-			future.wait();
+			build_tasks.run(task_name("shaders:", pass->name), [pass, &shaders] { build_shaders(pass, shaders); });
 		}
-		futures.clear();
+		build_tasks.wait();
 		// Process resources for duplicate shaders
 		for (auto& [pass, shaders] : existing_shaders) {
-			futures.push_back(ThreadPool::submit(std::bind(&build_shaders, pass, shaders)));
-		}
-		for (auto& future : futures) {
-			future.wait();
+			build_tasks.run(task_name("shaders:", pass->name), [pass, &shaders] { build_shaders(pass, shaders); });
 		}
+		build_tasks.wait();
 	}
 
 	if (!pass_idxs_with_shader_compilation_overrides.empty()) {
 		std::sort(passes.begin(), passes.end(),
 				  [](const RenderPass& pass1, const RenderPass& pass2) { return pass1.pass_idx < pass2.pass_idx; });
+		// Pass indices were shifted, none of the plans are valid anymore
+		execution_plans.clear();
+		// The alias barriers moved along with the passes, but the indices they were computed for are stale. Make
+		// reset() revalidate the lifetimes and reapply them
+		prev_scheduled_order.clear();
+		alias_first_uses.assign(1, {UINT32_MAX, UINT32_MAX});
 	}
 
-	uint32_t i = beginning_pass_idx;
-	uint32_t rem_passes = ending_pass_idx - beginning_pass_idx;
-	bool record_override_encountered = false;
-	while (rem_passes > 0) {
+	size_t plan_signature = 0;
+	bool replayed = false;
+	if (settings.replay_execution_plans) {
+		plan_signature = compute_plan_signature();
+		replayed = !recording_or_reload && pass_idxs_with_shader_compilation_overrides.empty() &&
+				   replay_plan(plan_signature);
+	}
+
+	uint32_t i;
+	uint32_t rem_passes;
+	if (!replayed) {
+		Profiler::CPUScope scope(profiler, "Finalize");
+		schedule_range();
+		for (uint32_t culled_idx : range_schedule.culled) {
+			passes[culled_idx].active = false;
+		}
+		range_order.assign(range_schedule.order.begin(), range_schedule.order.end());
+		for (i = beginning_pass_idx; i < ending_pass_idx; i++) {
+			if (passes[i].sync_state_cached) {
+				passes[i].clear_sync_state();
+			}
+		}
+		capturing_plan = settings.replay_execution_plans;
+		i = beginning_pass_idx;
+		rem_passes = ending_pass_idx - beginning_pass_idx;
+		bool record_override_encountered = false;
+		while (rem_passes > 0) {
+			if (passes[i].active) {
+				if (passes[i].record_override) {
+					record_override_encountered = true;
+				}
+				passes[i].finalize(record_override_encountered);
+			}
+			rem_passes--;
+			i++;
+		}
+
+		if (pipeline_tasks.size()) {
+			for (auto& [create, idx] : pipeline_tasks) {
+				if (!create) {
+					continue;
+				}
+				if (passes[idx].type == PassType::Graphics) {
+					// Cheap to create and they draw the UI, so these don't wait for a worker
+					passes[idx].build_pipeline(false);
+				} else {
+					start_pipeline_build(passes[idx], false);
+				}
+			}
+			for (auto& [_, idx] : pipeline_tasks) {
+				passes[idx].transition_resources();
+			}
+			pipeline_tasks.clear();
+		}
+		if (capturing_plan) {
+			capture_plan(plan_signature, range_schedule.culled);
+			capturing_plan = false;
+		}
+	}
+
+	for (uint32_t idx : range_order) {
+		buffer_sync_resources[idx].buffer_bariers.resize(passes[idx].wait_signals_buffer.size());
+		buffer_sync_resources[idx].dependency_infos.resize(passes[idx].wait_signals_buffer.size());
+		img_sync_resources[idx].img_barriers.resize(passes[idx].wait_signals_img.size());
+		img_sync_resources[idx].dependency_infos.resize(passes[idx].wait_signals_img.size());
+	}
+	// The dependency registration happens in declaration order, the schedule only moves independent passes
+	{
+		Profiler::CPUScope scope(profiler, "Record");
+		if (plan_queue_batches()) {
+			record_queue_batches(cmd);
+		} else if (!record_in_chunks(cmd)) {
+			for (uint32_t idx : range_order) {
+				passes[idx].run(cmd, frame_arena);
+			}
+		}
+	}
+	scheduled_order.insert(scheduled_order.end(), range_order.begin(), range_order.end());
+	if (!sync_plan_export_path.empty()) {
+		const SyncPlan plan = current_sync_plan();
+		std::ofstream(sync_plan_export_path + ".json") << sync_plan_to_json(plan);
+		std::ofstream(sync_plan_export_path + ".dot") << sync_plan_to_dot(plan);
+		const SyncPlanStats stats = sync_plan_stats(plan);
+		LUMEN_INFO("Exported the sync plan to {}: {} events, {} barriers, {} transitions, {} redundant waits",
+				   sync_plan_export_path, stats.events, stats.barriers, stats.transitions, stats.redundant_waits);
+		sync_plan_export_path.clear();
+	}
+}
+
+SyncPlan RenderGraph::current_sync_plan() const {
+	SyncPlan plan;
+	std::unordered_map<uint32_t, uint32_t> plan_pass_idxs;
+	std::unordered_map<uint64_t, uint32_t> resource_idxs;
+	auto resource_idx = [&](uint64_t handle, const std::string& name) {
+		auto [it, inserted] = resource_idxs.try_emplace(handle, (uint32_t)plan.resource_names.size());
+		if (inserted) {
+			plan.resource_names.push_back(name);
+		}
+		return it->second;
+	};
+	// Name the handles after the resources the passes use
+	std::unordered_map<uint64_t, std::string> names;
+	for (uint32_t idx : range_order) {
+		plan_pass_idxs[passes[idx].pass_idx] = (uint32_t)plan.pass_names.size();
+		plan.pass_names.push_back(passes[idx].name);
+		std::pmr::unordered_map<uint64_t, Resource> resources;
+		PassAccesses accesses;
+		collect_accesses(passes[idx], accesses, &resources);
+		for (const auto& [_, resource] : resources) {
+			if (resource.buf) {
+				names[(uint64_t)resource.buf->handle] = resource.buf->name;
+			} else {
+				names[(uint64_t)resource.tex->img] = resource.tex->name;
+			}
+		}
+	}
+	auto name_of = [&](uint64_t handle) {
+		auto it = names.find(handle);
+		return it != names.end() && !it->second.empty() ? it->second : std::to_string(handle);
+	};
+	for (uint32_t idx : range_order) {
+		const RenderPass& pass = passes[idx];
+		const uint32_t dst_pass = plan_pass_idxs[pass.pass_idx];
+		for (const auto& wait : pass.wait_signals_buffer) {
+			const uint64_t handle = (uint64_t)wait.buffer;
+			auto src = plan_pass_idxs.find(wait.opposing_pass_idx);
+			if (src == plan_pass_idxs.end()) {
+				continue;
+			}
+			plan.ops.push_back({.action = SyncAction::Event,
+								.resource = resource_idx((uint64_t)handle, name_of((uint64_t)handle)),
+								.src_pass = src->second,
+								.dst_pass = dst_pass,
+								.src_access_flags = wait.src_access_flags,
+								.dst_access_flags = wait.dst_access_flags});
+		}
+		for (const auto& wait : pass.wait_signals_img) {
+			const uint64_t handle = (uint64_t)wait.img;
+			auto src = plan_pass_idxs.find(wait.opposing_pass_idx);
+			if (src == plan_pass_idxs.end()) {
+				continue;
+			}
+			plan.ops.push_back({.action = SyncAction::Event,
+								.resource = resource_idx((uint64_t)handle, name_of((uint64_t)handle)),
+								.src_pass = src->second,
+								.dst_pass = dst_pass,
+								.old_layout = wait.old_layout,
+								.new_layout = wait.new_layout});
+		}
+		for (const auto& barrier : pass.buffer_barriers) {
+			plan.ops.push_back({.action = SyncAction::Barrier,
+								.resource = resource_idx((uint64_t)barrier.buffer, name_of((uint64_t)barrier.buffer)),
+								.src_pass = dst_pass,
+								.dst_pass = dst_pass,
+								.src_access_flags = barrier.src_access_flags,
+								.dst_access_flags = barrier.dst_access_flags});
+		}
+		for (const auto& [tex, old_layout, new_layout] : pass.layout_transitions) {
+			plan.ops.push_back({.action = SyncAction::Transition,
+								.resource = resource_idx((uint64_t)tex->img, tex->name),
+								.src_pass = dst_pass,
+								.dst_pass = dst_pass,
+								.old_layout = old_layout,
+								.new_layout = new_layout});
+		}
+	}
+	return plan;
+}
+
+bool RenderGraph::async_compute_available() const {
+	return ctx->indices.compute_family.value() != ctx->indices.gfx_family.value();
+}
+
+VkSemaphoreSubmitInfo RenderGraph::async_wait_info() const {
+	VkSemaphoreSubmitInfo wait_info = {VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+	if (pending_async_wait) {
+		wait_info.semaphore = timelines[1];
+		wait_info.value = pending_async_wait;
+		wait_info.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	}
+	return wait_info;
+}
+
+bool RenderGraph::plan_queue_batches() {
+	queue_batches.clear();
+	queue_transfers.clear();
+	for (uint32_t idx : range_order) {
+		passes[idx].on_async_queue = false;
+	}
+	auto is_async = [this](uint32_t idx) {
+		return passes[idx].compute_settings && passes[idx].compute_settings->async_compute;
+	};
+	// Batches are submitted ahead of the caller's command buffer, so anything already recorded into it
+	// would run after them. Only the first range of a frame can be split up.
+	if (!settings.async_compute || !async_compute_available() || !scheduled_order.empty() ||
+		std::none_of(range_order.begin(), range_order.end(), is_async)) {
+		return false;
+	}
+	/*
+		Fork-join over the execution order: A compute batch waits for the graphics batch before it and
+		runs alongside the graphics passes after it, until one of them touches a resource the compute
+		queue owns. Resources change their queue family at these points.
+	*/
+	struct OwnershipState {
+		// Last compute batch that used the resource, -1 if it's owned by the graphics queue
+		int32_t compute_batch = -1;
+		int32_t gfx_batch = -1;
+	};
+	std::pmr::unordered_map<uint64_t, OwnershipState> states(&frame_arena);
+	std::pmr::unordered_map<uint64_t, Resource> resources(&frame_arena);
+	auto push_batch = [this](bool compute, int32_t wait_batch) {
+		queue_batches.push_back({.compute = compute,
+								 .pass_idxs = std::pmr::vector<uint32_t>(&frame_arena),
+								 .wait_batch = wait_batch});
+	};
+	push_batch(false, -1);
+	int32_t curr_gfx = 0;
+	int32_t curr_compute = -1;
+	int32_t fork_gfx = -1;
+	auto add_gfx_batch = [&](int32_t wait_batch) {
+		if (queue_batches[curr_gfx].pass_idxs.empty()) {
+			queue_batches[curr_gfx].wait_batch = std::max(queue_batches[curr_gfx].wait_batch, wait_batch);
+			return;
+		}
+		push_batch(false, wait_batch);
+		curr_gfx = int32_t(queue_batches.size() - 1);
+	};
+	auto add_transfer = [&](uint64_t id, uint32_t pass_idx, int32_t release_batch, int32_t acquire_batch) {
+		const Resource& resource = resources.at(id);
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (resource.tex) {
+			layout = passes[pass_idx].entry_layout(*resource.tex);
+			if (layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+				// Contents are discarded anyway
+				return;
+			}
+		}
+		queue_transfers.push_back({.buf = resource.buf,
+								   .tex = resource.tex,
+								   .layout = layout,
+								   .release_batch = (uint32_t)release_batch,
+								   .acquire_batch = (uint32_t)acquire_batch});
+	};
+	PassAccesses& accesses = batch_accesses;
+	std::pmr::vector<uint64_t> ids(&frame_arena);
+	for (uint32_t idx : range_order) {
+		collect_accesses(passes[idx], accesses, &resources);
+		ids.assign(accesses.reads.begin(), accesses.reads.end());
+		ids.insert(ids.end(), accesses.writes.begin(), accesses.writes.end());
+		std::sort(ids.begin(), ids.end());
+		ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+		if (is_async(idx)) {
+			bool fork = curr_compute < 0;
+			for (uint64_t id : ids) {
+				fork |= states[id].gfx_batch > fork_gfx;
+			}
+			if (fork) {
+				fork_gfx = curr_gfx;
+				push_batch(true, curr_gfx);
+				curr_compute = int32_t(queue_batches.size() - 1);
+				push_batch(false, -1);
+				curr_gfx = int32_t(queue_batches.size() - 1);
+			}
+			for (uint64_t id : ids) {
+				auto& state = states[id];
+				if (state.compute_batch < 0) {
+					add_transfer(id, idx, fork_gfx, curr_compute);
+				}
+				state.compute_batch = curr_compute;
+			}
+			queue_batches[curr_compute].pass_idxs.push_back(idx);
+			passes[idx].on_async_queue = true;
+		} else {
+			int32_t wait_batch = -1;
+			for (uint64_t id : ids) {
+				wait_batch = std::max(wait_batch, states[id].compute_batch);
+			}
+			if (wait_batch >= 0) {
+				if (wait_batch == curr_compute) {
+					// Has to signal before this pass can start
+					curr_compute = -1;
+				}
+				add_gfx_batch(wait_batch);
+			}
+			for (uint64_t id : ids) {
+				auto& state = states[id];
+				if (state.compute_batch >= 0) {
+					add_transfer(id, idx, state.compute_batch, curr_gfx);
+					state.compute_batch = -1;
+				}
+				state.gfx_batch = curr_gfx;
+			}
+			queue_batches[curr_gfx].pass_idxs.push_back(idx);
+		}
+	}
+	// Hand everything back to the graphics queue, the last graphics batch waits for all of the compute work
+	int32_t last_compute = -1;
+	for (int32_t b = 0; b < (int32_t)queue_batches.size(); b++) {
+		if (queue_batches[b].compute) {
+			last_compute = b;
+		}
+	}
+	if (queue_batches[curr_gfx].wait_batch < last_compute) {
+		add_gfx_batch(last_compute);
+	}
+	for (auto& [id, state] : states) {
+		if (state.compute_batch < 0) {
+			continue;
+		}
+		const Resource& resource = resources.at(id);
+		if (resource.tex && resource.tex->layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+			continue;
+		}
+		queue_transfers.push_back({.buf = resource.buf,
+								   .tex = resource.tex,
+								   .layout = resource.tex ? resource.tex->layout : VK_IMAGE_LAYOUT_UNDEFINED,
+								   .release_batch = (uint32_t)state.compute_batch,
+								   .acquire_batch = (uint32_t)curr_gfx});
+	}
+	// The last graphics batch is the caller's command buffer, the only one waiting for the swapchain image
+	for (int32_t b = 0; b < curr_gfx; b++) {
+		for (uint32_t idx : queue_batches[b].pass_idxs) {
+			const auto& gfx_settings = passes[idx].gfx_settings;
+			if (gfx_settings && std::any_of(gfx_settings->color_outputs.begin(), gfx_settings->color_outputs.end(),
+											[](const Texture2D* tex) { return tex->present; })) {
+				for (uint32_t pass_idx : range_order) {
+					passes[pass_idx].on_async_queue = false;
+				}
+				queue_batches.clear();
+				queue_transfers.clear();
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void RenderGraph::record_queue_batches(VkCommandBuffer cmd) {
+	const uint32_t families[2] = {ctx->indices.gfx_family.value(), ctx->indices.compute_family.value()};
+	const QueueType queue_types[2] = {QueueType::GFX, QueueType::COMPUTE};
+	if (!timelines[0]) {
+		for (int lane = 0; lane < 2; lane++) {
+			VkCommandPoolCreateInfo pool_info = vk::command_pool_CI(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+			pool_info.queueFamilyIndex = families[lane];
+			vk::check(vkCreateCommandPool(ctx->device, &pool_info, nullptr, &async_cmd_pools[lane]),
+					  "Failed to create command pool!");
+			VkSemaphoreTypeCreateInfo type_info = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+			type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+			VkSemaphoreCreateInfo semaphore_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+			semaphore_info.pNext = &type_info;
+			vk::check(vkCreateSemaphore(ctx->device, &semaphore_info, nullptr, &timelines[lane]),
+					  "Failed to create timeline semaphore");
+		}
+	}
+	AsyncFrame& frame = async_frames[async_frame_idx];
+	async_frame_idx = (async_frame_idx + 1) % (uint32_t)async_frames.size();
+	// The command buffers of this slot may still be in flight
+	VkSemaphoreWaitInfo wait_info = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+	wait_info.semaphoreCount = 2;
+	wait_info.pSemaphores = timelines;
+	wait_info.pValues = frame.timeline_values;
+	vk::check(vkWaitSemaphores(ctx->device, &wait_info, UINT64_MAX), "Failed to wait for the async frame");
+
+	const uint32_t last_gfx = [this] {
+		uint32_t b = (uint32_t)queue_batches.size() - 1;
+		while (queue_batches[b].compute) {
+			b--;
+		}
+		return b;
+	}();
+	uint32_t used_cmds[2] = {0, 0};
+	for (uint32_t b = 0; b < queue_batches.size(); b++) {
+		QueueBatch& batch = queue_batches[b];
+		if (b == last_gfx) {
+			batch.cmd = cmd;
+			continue;
+		}
+		auto& cmds = frame.cmds[batch.compute];
+		uint32_t& used = used_cmds[batch.compute];
+		if (used == cmds.size()) {
+			cmds.push_back(VK_NULL_HANDLE);
+			auto allocate_info =
+				vk::command_buffer_allocate_info(async_cmd_pools[batch.compute], VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			vk::check(vkAllocateCommandBuffers(ctx->device, &allocate_info, &cmds.back()),
+					  "Could not allocate command buffer");
+		}
+		batch.cmd = cmds[used++];
+		vk::check(vkResetCommandBuffer(batch.cmd, 0));
+		auto begin_info = vk::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		vk::check(vkBeginCommandBuffer(batch.cmd, &begin_info), "Could not begin the command buffer");
+	}
+
+	auto record_transfers = [&](uint32_t b, bool release) {
+		const QueueBatch& batch = queue_batches[b];
+		std::pmr::vector<VkBufferMemoryBarrier2> buffer_barriers(&frame_arena);
+		std::pmr::vector<VkImageMemoryBarrier2> img_barriers(&frame_arena);
+		for (const QueueTransfer& transfer : queue_transfers) {
+			if ((release ? transfer.release_batch : transfer.acquire_batch) != b) {
+				continue;
+			}
+			const uint32_t src_family = release ? families[batch.compute] : families[!batch.compute];
+			const uint32_t dst_family = release ? families[!batch.compute] : families[batch.compute];
+			const VkPipelineStageFlags2 src_stage =
+				release ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_2_NONE;
+			const VkAccessFlags2 src_access = release ? VK_ACCESS_2_MEMORY_WRITE_BIT : VK_ACCESS_2_NONE;
+			const VkPipelineStageFlags2 dst_stage =
+				release ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			const VkAccessFlags2 dst_access =
+				release ? VK_ACCESS_2_NONE : VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+			if (transfer.buf) {
+				VkBufferMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+				barrier.srcStageMask = src_stage;
+				barrier.srcAccessMask = src_access;
+				barrier.dstStageMask = dst_stage;
+				barrier.dstAccessMask = dst_access;
+				barrier.srcQueueFamilyIndex = src_family;
+				barrier.dstQueueFamilyIndex = dst_family;
+				barrier.buffer = transfer.buf->handle;
+				barrier.size = VK_WHOLE_SIZE;
+				buffer_barriers.push_back(barrier);
+			} else {
+				VkImageMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+				barrier.srcStageMask = src_stage;
+				barrier.srcAccessMask = src_access;
+				barrier.dstStageMask = dst_stage;
+				barrier.dstAccessMask = dst_access;
+				barrier.oldLayout = transfer.layout;
+				barrier.newLayout = transfer.layout;
+				barrier.srcQueueFamilyIndex = src_family;
+				barrier.dstQueueFamilyIndex = dst_family;
+				barrier.image = transfer.tex->img;
+				barrier.subresourceRange.aspectMask = transfer.tex->aspect_flags;
+				barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+				barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+				img_barriers.push_back(barrier);
+			}
+		}
+		if (buffer_barriers.empty() && img_barriers.empty()) {
+			return;
+		}
+		VkDependencyInfo dependency_info = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+		dependency_info.bufferMemoryBarrierCount = (uint32_t)buffer_barriers.size();
+		dependency_info.pBufferMemoryBarriers = buffer_barriers.data();
+		dependency_info.imageMemoryBarrierCount = (uint32_t)img_barriers.size();
+		dependency_info.pImageMemoryBarriers = img_barriers.data();
+		vkCmdPipelineBarrier2(batch.cmd, &dependency_info);
+	};
+	for (uint32_t b = 0; b < queue_batches.size(); b++) {
+		record_transfers(b, false);
+		for (uint32_t idx : queue_batches[b].pass_idxs) {
+			passes[idx].run(queue_batches[b].cmd, frame_arena);
+		}
+		record_transfers(b, true);
+	}
+
+	// Pending uploads go first, the compute lane additionally waits for them
+	ctx->uploader->flush();
+	const VkSemaphoreSubmitInfo upload_wait = ctx->uploader->wait_info();
+	// Everything but the last graphics batch is submitted here, in creation order so waits see their signals
+	std::lock_guard<std::mutex> lock(VulkanSyncronization::queue_mutex);
+	for (uint32_t b = 0; b < queue_batches.size(); b++) {
+		QueueBatch& batch = queue_batches[b];
+		if (b == last_gfx) {
+			continue;
+		}
+		vk::check(vkEndCommandBuffer(batch.cmd), "Failed to end command buffer");
+		const int lane = batch.compute;
+		batch.signal_value = ++timeline_values[lane];
+		frame.timeline_values[lane] = batch.signal_value;
+		VkSemaphoreSubmitInfo wait_semaphores[2] = {{VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO}};
+		uint32_t wait_count = 0;
+		VkSemaphoreSubmitInfo signal_semaphore = {VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+		signal_semaphore.semaphore = timelines[lane];
+		signal_semaphore.value = batch.signal_value;
+		signal_semaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		VkCommandBufferSubmitInfo cmd_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+		cmd_info.commandBuffer = batch.cmd;
+		VkSubmitInfo2 submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+		if (batch.wait_batch >= 0) {
+			VkSemaphoreSubmitInfo& wait_semaphore = wait_semaphores[wait_count++];
+			wait_semaphore.semaphore = timelines[!lane];
+			wait_semaphore.value = queue_batches[batch.wait_batch].signal_value;
+			wait_semaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		}
+		if (queue_types[lane] != QueueType::GFX && upload_wait.semaphore) {
+			wait_semaphores[wait_count++] = upload_wait;
+		}
+		submit_info.waitSemaphoreInfoCount = wait_count;
+		submit_info.pWaitSemaphoreInfos = wait_semaphores;
+		submit_info.commandBufferInfoCount = 1;
+		submit_info.pCommandBufferInfos = &cmd_info;
+		submit_info.signalSemaphoreInfoCount = 1;
+		submit_info.pSignalSemaphoreInfos = &signal_semaphore;
+		vk::check(vkQueueSubmit2(ctx->queues[(int)queue_types[lane]], 1, &submit_info, VK_NULL_HANDLE),
+				  "Queue submission error");
+	}
+	const int32_t final_wait = queue_batches[last_gfx].wait_batch;
+	pending_async_wait = final_wait >= 0 ? queue_batches[final_wait].signal_value : 0;
+}
+
+void RenderGraph::destroy_async_resources() {
+	for (int lane = 0; lane < 2; lane++) {
+		if (async_cmd_pools[lane]) {
+			vkDestroyCommandPool(ctx->device, async_cmd_pools[lane], nullptr);
+			async_cmd_pools[lane] = VK_NULL_HANDLE;
+		}
+		if (timelines[lane]) {
+			vkDestroySemaphore(ctx->device, timelines[lane], nullptr);
+			timelines[lane] = VK_NULL_HANDLE;
+		}
+		timeline_values[lane] = 0;
+	}
+	async_frames = {};
+	async_frame_idx = 0;
+	pending_async_wait = 0;
+}
+
+bool RenderGraph::record_in_chunks(VkCommandBuffer cmd) {
+	// The chunks would queue up behind the pipeline builds on the workers
+	if (!settings.multithreaded_recording || ThreadPool::num_threads() < 2 || !pipeline_builds.empty()) {
+		return false;
+	}
+	// Graphics passes stay on the calling thread, their pass functions aren't necessarily thread safe (ImGui) and
+	// they transition their outputs during the recording. So do image copies, the layouts are tracked on the CPU
+	record_serial.assign(range_order.size(), false);
+	for (size_t k = 0; k < range_order.size(); k++) {
+		const RenderPass& pass = passes[range_order[k]];
+		record_serial[k] = pass.type == PassType::Graphics ||
+						   std::any_of(pass.resource_copies.begin(), pass.resource_copies.end(),
+									   [](const auto& copy) { return copy.first.tex != nullptr; });
+	}
+	partition_recording(record_serial, settings.min_passes_per_chunk, ThreadPool::num_threads(), record_segments);
+	const std::vector<RecordSegment>& segments = record_segments;
+	const uint32_t num_chunks = (uint32_t)std::count_if(segments.begin(), segments.end(),
+														[](const RecordSegment& segment) { return !segment.serial; });
+	if (num_chunks < 2) {
+		return false;
+	}
+
+	RecordingFrame& frame = recording_frames[recording_frame_idx];
+	while (frame.pools.size() < num_chunks) {
+		VkCommandPoolCreateInfo pool_info = vk::command_pool_CI();
+		pool_info.queueFamilyIndex = ctx->indices.gfx_family.value();
+		frame.pools.push_back(VK_NULL_HANDLE);
+		vk::check(vkCreateCommandPool(ctx->device, &pool_info, nullptr, &frame.pools.back()),
+				  "Failed to create command pool!");
+		frame.cmds.emplace_back();
+		frame.used_cmds.push_back(0);
+	}
+	while (chunk_arenas.size() < num_chunks) {
+		chunk_arenas.push_back(std::make_unique<FrameArena>());
+	}
+	// A pass may wait on an event that is set in another chunk, which could still be recording
+	if (settings.use_events) {
+		for (uint32_t idx : range_order) {
+			passes[idx].acquire_events(cmd);
+		}
+	}
+
+	auto record_chunk = [this, &frame](uint32_t c, uint32_t begin, uint32_t end) {
+		auto& cmds = frame.cmds[c];
+		uint32_t& used = frame.used_cmds[c];
+		if (used == cmds.size()) {
+			cmds.push_back(VK_NULL_HANDLE);
+			auto allocate_info =
+				vk::command_buffer_allocate_info(frame.pools[c], VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			vk::check(vkAllocateCommandBuffers(ctx->device, &allocate_info, &cmds.back()),
+					  "Could not allocate command buffer");
+		}
+		VkCommandBuffer chunk_cmd = cmds[used++];
+		// Executed outside of rendering, nothing to inherit
+		VkCommandBufferInheritanceInfo inheritance_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+		auto begin_info = vk::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		begin_info.pInheritanceInfo = &inheritance_info;
+		vk::check(vkBeginCommandBuffer(chunk_cmd, &begin_info), "Could not begin the command buffer");
+		for (uint32_t k = begin; k < end; k++) {
+			passes[range_order[k]].run(chunk_cmd, *chunk_arenas[c]);
+		}
+		vk::check(vkEndCommandBuffer(chunk_cmd), "Failed to end command buffer");
+		return chunk_cmd;
+	};
+	// One group per chunk, so each can be waited on in submission order. Unlike futures these don't allocate
+	std::pmr::vector<TaskGroup> chunk_tasks(num_chunks, &frame_arena);
+	std::pmr::vector<VkCommandBuffer> chunk_cmds(num_chunks, &frame_arena);
+	uint32_t c = 0;
+	for (const RecordSegment& segment : segments) {
+		if (!segment.serial) {
+			chunk_tasks[c].run("record", [&record_chunk, &chunk_cmds, c, segment] {
+				chunk_cmds[c] = record_chunk(c, segment.begin, segment.end);
+			});
+			c++;
+		}
+	}
+	// The serial passes are recorded in the meantime. Secondary command buffers keep the submission order of the
+	// primary, so the barriers and events of each pass see the same preceding work as with sequential recording
+	c = 0;
+	for (const RecordSegment& segment : segments) {
+		if (segment.serial) {
+			for (uint32_t k = segment.begin; k < segment.end; k++) {
+				passes[range_order[k]].run(cmd, frame_arena);
+			}
+		} else {
+			chunk_tasks[c].wait();
+			vkCmdExecuteCommands(cmd, 1, &chunk_cmds[c]);
+			c++;
+		}
+	}
+	return true;
+}
+
+void RenderGraph::destroy_recording_resources() {
+	for (RecordingFrame& frame : recording_frames) {
+		for (VkCommandPool pool : frame.pools) {
+			vkDestroyCommandPool(ctx->device, pool, nullptr);
+		}
+		frame = {};
+	}
+	recording_frame_idx = 0;
+	chunk_arenas.clear();
+}
+
+void RenderGraph::schedule_range() {
+	range_pass_idxs.clear();
+	for (uint32_t i = beginning_pass_idx; i < ending_pass_idx; i++) {
 		if (passes[i].active) {
-			if (passes[i].record_override) {
-				record_override_encountered = true;
+			range_pass_idxs.push_back(i);
+		}
+	}
+	if (!settings.cull_passes && !settings.reorder_passes) {
+		range_schedule.order.assign(range_pass_idxs.begin(), range_pass_idxs.end());
+		range_schedule.culled.clear();
+		return;
+	}
+	// Never shrunk, the access lists keep their capacity
+	if (range_accesses.size() < range_pass_idxs.size()) {
+		range_accesses.resize(range_pass_idxs.size());
+	}
+	for (uint32_t k = 0; k < range_pass_idxs.size(); k++) {
+		collect_accesses(passes[range_pass_idxs[k]], range_accesses[k]);
+	}
+	range_transients.clear();
+	for (const auto& transient : transients) {
+		range_transients.push_back(transient.buf ? (uint64_t)transient.buf : (uint64_t)transient.tex);
+	}
+	std::sort(range_transients.begin(), range_transients.end());
+	schedule_passes(std::span(range_accesses.data(), range_pass_idxs.size()), range_transients,
+					settings.cull_passes, settings.reorder_passes, range_schedule, &frame_arena);
+	for (uint32_t& idx : range_schedule.order) {
+		idx = range_pass_idxs[idx];
+	}
+	for (uint32_t& idx : range_schedule.culled) {
+		idx = range_pass_idxs[idx];
+	}
+}
+
+void RenderGraph::collect_accesses(const RenderPass& pass, PassAccesses& access,
+								   std::pmr::unordered_map<uint64_t, Resource>* resources) const {
+	access.reads.clear();
+	access.writes.clear();
+	access.side_effects = false;
+	auto track = [resources](const void* resource, bool is_buffer) {
+		if (resources && !resources->contains((uint64_t)resource)) {
+			is_buffer ? resources->emplace((uint64_t)resource, Resource(*(Buffer*)resource))
+					  : resources->emplace((uint64_t)resource, Resource(*(Texture2D*)resource));
+		}
+	};
+	auto read = [&](const Buffer* buffer) {
+		track(buffer, true);
+		access.reads.push_back((uint64_t)buffer);
+	};
+	auto write = [&](const Buffer* buffer) {
+		track(buffer, true);
+		access.writes.push_back((uint64_t)buffer);
+	};
+	auto write_tex = [&](const Texture2D* tex) {
+		track(tex, false);
+		access.writes.push_back((uint64_t)tex);
+	};
+	// Image reads can transition the layout, so they are ordered like writes
+	auto read_tex = [&](const Texture2D* tex) {
+		track(tex, false);
+		access.reads.push_back((uint64_t)tex);
+		access.writes.push_back((uint64_t)tex);
+	};
+	if (settings.shader_inference) {
+		for (const auto& binding : pass.bound_resources) {
+			if (!binding.active) {
+				continue;
+			}
+			if (binding.write) {
+				binding.buf ? write(binding.buf) : write_tex(binding.tex);
+			} else if (binding.read) {
+				binding.buf ? read(binding.buf) : read_tex(binding.tex);
 			}
-			passes[i].finalize(record_override_encountered);
 		}
-		rem_passes--;
-		i++;
+		for (const auto& [buffer, status] : pass.affected_buffer_pointers) {
+			if (status.write) {
+				write(buffer);
+			} else if (status.read) {
+				read(buffer);
+			}
+		}
+	} else {
+		for (Buffer* buffer : pass.explicit_buffer_reads) {
+			read(buffer);
+		}
+		for (Buffer* buffer : pass.explicit_buffer_writes) {
+			write(buffer);
+		}
+		for (Texture2D* tex : pass.explicit_tex_reads) {
+			read_tex(tex);
+		}
+		for (Texture2D* tex : pass.explicit_tex_writes) {
+			write_tex(tex);
+		}
+		// Without reflection the bound resources may be accessed in any way
+		for (const auto& binding : pass.bound_resources) {
+			if (binding.buf) {
+				read(binding.buf);
+				write(binding.buf);
+			} else {
+				read_tex(binding.tex);
+			}
+		}
+		access.side_effects = pass.explicit_buffer_writes.empty() && pass.explicit_tex_writes.empty();
 	}
+	if (Buffer* args = pass.indirect_buffer()) {
+		read(args);
+	}
+	for (const Resource& resource : pass.resource_zeros) {
+		resource.buf ? write(resource.buf) : write_tex(resource.tex);
+	}
+	for (const auto& [src, dst] : pass.resource_copies) {
+		src.buf ? read(src.buf) : read_tex(src.tex);
+		dst.buf ? write(dst.buf) : write_tex(dst.tex);
+	}
+	if (pass.gfx_settings) {
+		for (const Texture2D* color_output : pass.gfx_settings->color_outputs) {
+			write_tex(color_output);
+		}
+		if (pass.gfx_settings->depth_output) {
+			write_tex(pass.gfx_settings->depth_output);
+		}
+	}
+}
 
-	if (pipeline_tasks.size()) {
-		std::vector<std::future<void>> futures;
-		futures.reserve(pipeline_tasks.size());
-		for (auto& [task, idx] : pipeline_tasks) {
-			if (task) {
-				futures.push_back(ThreadPool::submit(task, &passes[idx]));
+uint32_t RenderGraph::resource_id(Buffer& buffer) {
+	bool registered;
+	const uint32_t resource = buffer_registry.resolve(buffer.rg_handle, (uint64_t)buffer.handle, &registered);
+	if (resource >= buffer_states.size()) {
+		buffer_states.resize(buffer_registry.capacity());
+	}
+	if (registered) {
+		buffer_states[resource] = {};
+	}
+	return resource;
+}
+
+uint32_t RenderGraph::resource_id(Texture2D& tex) {
+	bool registered;
+	const uint32_t resource = img_registry.resolve(tex.rg_handle, (uint64_t)tex.img, &registered);
+	if (resource >= img_states.size()) {
+		img_states.resize(img_registry.capacity(), UINT32_MAX);
+	}
+	if (registered) {
+		img_states[resource] = UINT32_MAX;
+	}
+	return resource;
+}
+
+size_t RenderGraph::compute_plan_signature() {
+	// Everything that feeds into the dependency registration of the pass range:
+	// Pass identities, bound resources and the sync state they are entered with
+	size_t signature = ending_pass_idx;
+	// The schedule settings can be toggled at runtime
+	hash_combine(signature, (size_t)settings.cull_passes | (size_t)settings.reorder_passes << 1);
+	auto hash_buffer = [&](Buffer* buffer) {
+		hash_combine(signature, (size_t)buffer->handle);
+		const BufferState& state = buffer_states[resource_id(*buffer)];
+		if (state.pass_idx != UINT32_MAX) {
+			hash_combine(signature, state.pass_idx);
+			hash_combine(signature, state.access_flags);
+			hash_combine(signature, passes[state.pass_idx].submitted);
+		}
+	};
+	auto hash_tex = [&](Texture2D* tex) {
+		hash_combine(signature, (size_t)tex->img);
+		hash_combine(signature, tex->layout);
+		const uint32_t pass_idx = img_states[resource_id(*tex)];
+		if (pass_idx != UINT32_MAX) {
+			hash_combine(signature, pass_idx);
+			hash_combine(signature, passes[pass_idx].submitted);
+		}
+	};
+	for (uint32_t i = beginning_pass_idx; i < ending_pass_idx; i++) {
+		const RenderPass& pass = passes[i];
+		hash_combine(signature, pass.active);
+		if (!pass.active) {
+			continue;
+		}
+		hash_combine(signature, pass.pass_idx);
+		hash_combine(signature, (size_t)pass.pipeline);
+		hash_combine(signature, pass.pipeline->push_constant_size);
+		for (const auto& binding : pass.bound_resources) {
+			hash_combine(signature, (size_t)binding.active | (size_t)binding.read << 1 | (size_t)binding.write << 2);
+			if (binding.buf) {
+				hash_buffer(binding.buf);
+			} else {
+				hash_tex(binding.tex);
+				hash_combine(signature, (size_t)binding.sampler);
 			}
 		}
-		for (auto& future : futures) {
-			future.wait();
+		for (const auto& [buffer, status] : pass.affected_buffer_pointers) {
+			hash_combine(signature, (size_t)status.read | (size_t)status.write << 1);
+			hash_buffer(buffer);
 		}
-		for (auto& [_, idx] : pipeline_tasks) {
-			passes[idx].transition_resources();
+		for (Buffer* buffer : pass.explicit_buffer_reads) {
+			hash_buffer(buffer);
+		}
+		for (Buffer* buffer : pass.explicit_buffer_writes) {
+			hash_buffer(buffer);
+		}
+		for (Texture2D* tex : pass.explicit_tex_reads) {
+			hash_tex(tex);
+		}
+		for (Texture2D* tex : pass.explicit_tex_writes) {
+			hash_tex(tex);
+		}
+		if (Buffer* args = pass.indirect_buffer()) {
+			hash_buffer(args);
+		}
+		for (const Resource& resource : pass.resource_zeros) {
+			resource.buf ? hash_buffer(resource.buf) : hash_tex(resource.tex);
+		}
+		for (const auto& [src, dst] : pass.resource_copies) {
+			src.buf ? hash_buffer(src.buf) : hash_tex(src.tex);
+			dst.buf ? hash_buffer(dst.buf) : hash_tex(dst.tex);
+		}
+		if (pass.gfx_settings) {
+			for (Texture2D* color_output : pass.gfx_settings->color_outputs) {
+				hash_tex(color_output);
+			}
+			if (pass.gfx_settings->depth_output) {
+				hash_tex(pass.gfx_settings->depth_output);
+			}
 		}
-		pipeline_tasks.clear();
 	}
-	i = beginning_pass_idx;
-	rem_passes = ending_pass_idx - beginning_pass_idx;
+	return signature;
+}
 
-	while (rem_passes > 0) {
-		rem_passes--;
-		if (!passes[i].active) {
+bool RenderGraph::replay_plan(size_t signature) {
+	auto it = execution_plans.find(beginning_pass_idx);
+	if (it == execution_plans.end() || it->second.signature != signature) {
+		return false;
+	}
+	// The per-pass barriers are still in place, only apply the side effects of the dependency registration
+	const ExecutionPlan& plan = it->second;
+	for (uint32_t culled_idx : plan.culled) {
+		passes[culled_idx].active = false;
+	}
+	range_order = plan.order;
+	for (const auto& [tex, layout] : plan.img_layouts) {
+		tex->layout = layout;
+	}
+	for (const auto& [handle, pass_idx] : plan.img_states) {
+		if (img_registry.is_current(handle)) {
+			img_states[handle.idx] = pass_idx;
+		}
+	}
+	for (const auto& [handle, state] : plan.buffer_states) {
+		if (buffer_registry.is_current(handle)) {
+			buffer_states[handle.idx] = state;
+		}
+	}
+	if (settings.use_events) {
+		for (uint32_t i = beginning_pass_idx; i < ending_pass_idx; i++) {
+			for (auto& v : passes[i].set_signals_buffer) {
+				v.event = nullptr;
+			}
+			for (auto& v : passes[i].set_signals_img) {
+				v.event = nullptr;
+			}
+		}
+	}
+	return true;
+}
+
+void RenderGraph::capture_plan(size_t signature, const std::vector<uint32_t>& culled) {
+	ExecutionPlan& plan = execution_plans[beginning_pass_idx];
+	plan.signature = signature;
+	plan.order = range_order;
+	plan.culled = culled;
+	plan.img_layouts.clear();
+	plan.img_states.clear();
+	plan.buffer_states.clear();
+	std::sort(captured_textures.begin(), captured_textures.end());
+	captured_textures.erase(std::unique(captured_textures.begin(), captured_textures.end()), captured_textures.end());
+	std::sort(captured_buffers.begin(), captured_buffers.end());
+	captured_buffers.erase(std::unique(captured_buffers.begin(), captured_buffers.end()), captured_buffers.end());
+	for (Texture2D* tex : captured_textures) {
+		const uint32_t resource = resource_id(*tex);
+		plan.img_layouts.push_back({tex, tex->layout});
+		plan.img_states.push_back({img_registry.handle_of(resource), img_states[resource]});
+	}
+	for (uint32_t resource : captured_buffers) {
+		plan.buffer_states.push_back({buffer_registry.handle_of(resource), buffer_states[resource]});
+	}
+	for (uint32_t i = beginning_pass_idx; i < ending_pass_idx; i++) {
+		passes[i].sync_state_cached = passes[i].active;
+	}
+	captured_textures.clear();
+	captured_buffers.clear();
+}
+
+void RenderGraph::add_transient(Buffer& buffer, const char* name, VkBufferUsageFlags usage, VkDeviceSize size,
+								std::function<void()> on_realized) {
+	buffer.create(name, ctx, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, size);
+	TransientResource resource{.buf = &buffer, .name = name, .on_realized = std::move(on_realized)};
+	auto it = std::find_if(transients.begin(), transients.end(), [&buffer](const auto& t) { return t.buf == &buffer; });
+	if (it != transients.end()) {
+		*it = std::move(resource);
+	} else {
+		transients.push_back(std::move(resource));
+	}
+	transients_dirty = true;
+}
+
+void RenderGraph::add_transient(Texture2D& tex, const char* name, const TextureSettings& settings, VkSampler sampler,
+								std::function<void()> on_realized) {
+	tex.create_empty_texture(name, ctx, settings, VK_IMAGE_LAYOUT_GENERAL, sampler);
+	TransientResource resource{.tex = &tex,
+							   .name = name,
+							   .tex_settings = settings,
+							   .sampler = sampler,
+							   .on_realized = std::move(on_realized)};
+	auto it = std::find_if(transients.begin(), transients.end(), [&tex](const auto& t) { return t.tex == &tex; });
+	if (it != transients.end()) {
+		*it = std::move(resource);
+	} else {
+		transients.push_back(std::move(resource));
+	}
+	transients_dirty = true;
+}
+
+std::vector<TransientRequest> RenderGraph::transient_lifetimes() {
+	std::unordered_map<const void*, uint32_t> transient_idxs;
+	for (uint32_t i = 0; i < transients.size(); i++) {
+		transient_idxs[transients[i].buf ? (const void*)transients[i].buf : (const void*)transients[i].tex] = i;
+	}
+	// The memory requirements are the ones of the current placement, realize_transients() fills them in otherwise
+	std::vector<TransientRequest> requests(transients.size());
+	for (uint32_t i = 0; i < requests.size(); i++) {
+		if (i < transient_requests.size()) {
+			requests[i] = transient_requests[i];
+		}
+		requests[i].first_use = UINT32_MAX;
+		requests[i].last_use = 0;
+	}
+	// Passes on the compute queue overlap with the graphics queue, their transients don't share memory
+	std::vector<bool> used_async(transients.size(), false);
+	auto touch = [&](const void* resource, uint32_t pos) {
+		auto it = transient_idxs.find(resource);
+		if (it == transient_idxs.end()) {
+			return;
+		}
+		auto& request = requests[it->second];
+		request.first_use = std::min(request.first_use, pos);
+		request.last_use = std::max(request.last_use, pos);
+		used_async[it->second] = used_async[it->second] || passes[scheduled_order[pos]].on_async_queue;
+	};
+	// Lifetimes are in terms of the execution order of the frame
+	const uint32_t pass_count = (uint32_t)scheduled_order.size();
+	for (uint32_t i = 0; i < pass_count; i++) {
+		const RenderPass& pass = passes[scheduled_order[i]];
+		for (const auto& binding : pass.bound_resources) {
+			touch(binding.buf ? (const void*)binding.buf : (const void*)binding.tex, i);
+		}
+		for (const auto& [buffer, _] : pass.affected_buffer_pointers) {
+			touch(buffer, i);
+		}
+		for (Buffer* buffer : pass.explicit_buffer_reads) {
+			touch(buffer, i);
+		}
+		for (Buffer* buffer : pass.explicit_buffer_writes) {
+			touch(buffer, i);
+		}
+		for (Texture2D* tex : pass.explicit_tex_reads) {
+			touch(tex, i);
+		}
+		for (Texture2D* tex : pass.explicit_tex_writes) {
+			touch(tex, i);
+		}
+		if (Buffer* args = pass.indirect_buffer()) {
+			touch(args, i);
+		}
+		for (const Resource& resource : pass.resource_zeros) {
+			touch(resource.buf ? (const void*)resource.buf : (const void*)resource.tex, i);
+		}
+		for (const auto& [src, dst] : pass.resource_copies) {
+			touch(src.buf ? (const void*)src.buf : (const void*)src.tex, i);
+			touch(dst.buf ? (const void*)dst.buf : (const void*)dst.tex, i);
+		}
+		if (pass.gfx_settings) {
+			for (Texture2D* color_output : pass.gfx_settings->color_outputs) {
+				touch(color_output, i);
+			}
+			touch(pass.gfx_settings->depth_output, i);
+		}
+	}
+	for (uint32_t i = 0; i < requests.size(); i++) {
+		auto& request = requests[i];
+		if (request.first_use == UINT32_MAX || used_async[i]) {
+			// Not used by any recorded pass or used on the compute queue, keep it alive throughout the frame
+			request.first_use = 0;
+			request.last_use = pass_count;
+		}
+	}
+	return requests;
+}
+
+void RenderGraph::update_transients() {
+	std::vector<TransientRequest> requests = transient_lifetimes();
+	// Passes that only run on some frames move the lifetimes around, the memory only has to move if the current
+	// placement doesn't hold for the new ones
+	if (!transients_dirty && transient_layout_valid(requests, transient_layout)) {
+		transient_requests = std::move(requests);
+		update_alias_barriers();
+		return;
+	}
+	realize_transients(requests);
+}
+
+void RenderGraph::realize_transients(std::vector<TransientRequest>& requests) {
+	transients_dirty = false;
+	// The previous resources and heaps may still be in use by the frames in flight
+	RetiredTransients retired;
+	for (uint32_t i = 0; i < transients.size(); i++) {
+		auto& transient = transients[i];
+		VkMemoryRequirements mem_reqs;
+		if (transient.buf) {
+			const VkBufferUsageFlags usage = transient.buf->usage_flags;
+			const VkDeviceSize size = transient.buf->size;
+			buffer_registry.release(transient.buf->rg_handle);
+			retired.buffers.push_back(*transient.buf);
+			transient.buf->allocation = {};
+			transient.buf->create_unbound(transient.name.c_str(), ctx, usage, size);
+			vkGetBufferMemoryRequirements(ctx->device, transient.buf->handle, &mem_reqs);
+			requests[i].group = 0;
+		} else {
+			img_registry.release(transient.tex->rg_handle);
+			retired.textures.push_back(*transient.tex);
+			transient.tex->bindless_idx = UINT32_MAX;
+			transient.tex->create_unbound(transient.name.c_str(), ctx, transient.tex_settings, transient.sampler);
+			vkGetImageMemoryRequirements(ctx->device, transient.tex->img, &mem_reqs);
+			requests[i].group = 1;
+		}
+		requests[i].size = mem_reqs.size;
+		requests[i].alignment = mem_reqs.alignment;
+		requests[i].memory_type_bits = mem_reqs.memoryTypeBits;
+	}
+	retired.heaps = std::move(transient_heaps);
+	transient_heaps.clear();
+	// The frame that was just recorded may not be submitted yet, so wait for the one after it as well
+	retired.frame_value = frame_value ? *frame_value + 1 : 0;
+	retired_transients.push_back(std::move(retired));
+	if (!frame_timeline) {
+		vkDeviceWaitIdle(ctx->device);
+	}
+
+	transient_layout = place_transient_resources(requests);
+	const TransientLayout& layout = transient_layout;
+	VkDeviceSize requested_size = 0;
+	VkDeviceSize allocated_size = 0;
+	for (uint32_t heap_idx = 0; heap_idx < layout.heaps.size(); heap_idx++) {
+		const TransientHeap& heap = layout.heaps[heap_idx];
+		bool device_address = false;
+		for (uint32_t i = 0; i < transients.size(); i++) {
+			if (layout.placements[i].heap_idx == heap_idx && transients[i].buf &&
+				(transients[i].buf->usage_flags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)) {
+				device_address = true;
+			}
+		}
+		VkMemoryAllocateInfo alloc_info = vk::memory_allocate_info();
+		alloc_info.allocationSize = heap.size;
+		alloc_info.memoryTypeIndex =
+			find_memory_type(&ctx->physical_device, heap.memory_type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VkMemoryAllocateFlagsInfo flags_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO};
+		if (device_address) {
+			flags_info.flags |= VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+			alloc_info.pNext = &flags_info;
+		}
+		VkDeviceMemory memory;
+		vk::check(vkAllocateMemory(ctx->device, &alloc_info, nullptr, &memory), "Failed to allocate transient heap");
+		transient_heaps.push_back(memory);
+		allocated_size += heap.size;
+	}
+	for (uint32_t i = 0; i < transients.size(); i++) {
+		const auto& placement = layout.placements[i];
+		if (transients[i].buf) {
+			transients[i].buf->bind_memory(transient_heaps[placement.heap_idx], placement.offset);
+		} else {
+			transients[i].tex->bind_memory(transient_heaps[placement.heap_idx], placement.offset);
+		}
+		requested_size += requests[i].size;
+	}
+	transient_requests = std::move(requests);
+	update_alias_barriers();
+	execution_plans.clear();
+	LUMEN_TRACE("Transient resources: {} MB requested, {} MB allocated in {} heap(s)", requested_size >> 20,
+				allocated_size >> 20, layout.heaps.size());
+
+	for (auto& transient : transients) {
+		if (transient.on_realized) {
+			transient.on_realized();
+		}
+	}
+}
+
+void RenderGraph::update_alias_barriers() {
+	// Resources that share memory with another one need a barrier and a layout discard on first use
+	const uint32_t pass_count = (uint32_t)scheduled_order.size();
+	std::vector<std::pair<uint32_t, uint32_t>> first_uses;
+	for (uint32_t i = 0; i < transients.size(); i++) {
+		bool aliased = false;
+		for (uint32_t j = 0; j < transients.size() && !aliased; j++) {
+			aliased = i != j && transient_ranges_overlap(transient_layout.placements[i], transient_requests[i].size,
+														 transient_layout.placements[j], transient_requests[j].size);
+		}
+		if (aliased && transient_requests[i].first_use < pass_count) {
+			first_uses.push_back({scheduled_order[transient_requests[i].first_use], i});
+		}
+	}
+	if (first_uses == alias_first_uses) {
+		return;
+	}
+	for (RenderPass& pass : passes) {
+		pass.discarded_textures.clear();
+		pass.alias_barrier = false;
+	}
+	for (const auto& [pass_idx, transient_idx] : first_uses) {
+		RenderPass& first_pass = passes[pass_idx];
+		first_pass.alias_barrier = true;
+		if (transients[transient_idx].tex) {
+			first_pass.discarded_textures.push_back(transients[transient_idx].tex);
+		}
+	}
+	alias_first_uses = std::move(first_uses);
+	// The cached plans were captured with the previous barriers
+	execution_plans.clear();
+}
+
+void RenderGraph::free_retired_transients(bool all) {
+	uint64_t completed = UINT64_MAX;
+	if (!all && frame_timeline && *frame_timeline) {
+		vk::check(vkGetSemaphoreCounterValue(ctx->device, *frame_timeline, &completed),
+				  "Failed to query the frame timeline");
+	}
+	for (size_t i = 0; i < retired_transients.size();) {
+		RetiredTransients& retired = retired_transients[i];
+		if (retired.frame_value > completed) {
 			i++;
 			continue;
 		}
-		buffer_sync_resources[i].buffer_bariers.resize(passes[i].wait_signals_buffer.size());
-		buffer_sync_resources[i].dependency_infos.resize(passes[i].wait_signals_buffer.size());
-		img_sync_resources[i].img_barriers.resize(passes[i].wait_signals_img.size());
-		img_sync_resources[i].dependency_infos.resize(passes[i].wait_signals_img.size());
-		passes[i].run(cmd);
-		i++;
+		for (Buffer& buffer : retired.buffers) {
+			buffer.destroy();
+		}
+		for (Texture2D& tex : retired.textures) {
+			tex.destroy();
+		}
+		for (VkDeviceMemory heap : retired.heaps) {
+			vkFreeMemory(ctx->device, heap, nullptr);
+		}
+		retired_transients.erase(retired_transients.begin() + i);
 	}
 }
 
 void RenderGraph::reset() {
+	// A different schedule (e.g. toggled or culled passes) changes the lifetimes as well
+	if (!transients.empty() && (transients_dirty || scheduled_order != prev_scheduled_order)) {
+		update_transients();
+	}
+	free_retired_transients();
+	std::swap(prev_scheduled_order, scheduled_order);
+	scheduled_order.clear();
 	pass_idxs_with_shader_compilation_overrides.clear();
 	event_pool.reset_events(ctx->device);
 	for (int i = 0; i < passes.size(); i++) {
-		passes[i].set_signals_buffer.clear();
-		passes[i].wait_signals_buffer.clear();
-		passes[i].set_signals_img.clear();
-		passes[i].wait_signals_img.clear();
-		passes[i].layout_transitions.clear();
+		if (!passes[i].sync_state_cached) {
+			passes[i].clear_sync_state();
+		}
 		passes[i].resource_zeros.clear();
 		passes[i].resource_copies.clear();
-		passes[i].buffer_barriers.clear();
-		passes[i].post_execution_buffer_barriers.clear();
 		passes[i].disable_execution = false;
 		passes[i].active = false;
 		passes[i].next_binding_idx = 0;
@@ -1001,14 +2292,136 @@ void RenderGraph::reset() {
 	if (pipeline_tasks.size()) {
 		pipeline_tasks.clear();
 	}
-	buffer_sync_resources.clear();
-	img_sync_resources.clear();
+	// Not cleared, run() resizes the barrier lists of the scheduled passes and they keep their capacity
 	beginning_pass_idx = ending_pass_idx = 0;
 	reload_shaders = false;
+	for (size_t i = 0; i < retired_pipelines.size();) {
+		if (--retired_pipelines[i].second == 0) {
+			retired_pipelines[i].first->cleanup();
+			retired_pipelines.erase(retired_pipelines.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	pending_async_wait = 0;
+	profiler.end_frame();
+	// The batches point into the arena
+	queue_batches.clear();
+	frame_arena.reset();
+	for (auto& arena : chunk_arenas) {
+		arena->reset();
+	}
+	// The next slot was recorded four frames ago, VulkanBase waited on the fence of that frame before this one
+	recording_frame_idx = (recording_frame_idx + 1) % (uint32_t)recording_frames.size();
+	RecordingFrame& next_frame = recording_frames[recording_frame_idx];
+	for (uint32_t c = 0; c < next_frame.pools.size(); c++) {
+		vk::check(vkResetCommandPool(ctx->device, next_frame.pools[c], 0));
+		next_frame.used_cmds[c] = 0;
+	}
+}
+
+void RenderGraph::start_pipeline_build(RenderPass& pass, bool reload) {
+	PipelineBuild build;
+	Pipeline* pipeline = pass.pipeline;
+	if (reload) {
+		build.pipeline = std::make_unique<Pipeline>(ctx, pass.name);
+		build.pipeline->tlas_info = pass.pipeline->tlas_info;
+		pipeline = build.pipeline.get();
+	} else {
+		// The dependency registration of the current run needs the binding layout
+		pass.reflect_pipeline();
+		pipeline->compiling.store(true, std::memory_order_release);
+	}
+	pipeline_cache[pass.name].building = true;
+	build.pass = pass.detached_copy(pipeline);
+	build.pass->reload_copy = reload;
+	build.result = ThreadPool::submit_named(
+		task_name("pipeline:", pass.name), [reload](RenderPass* copy) { return copy->build_pipeline(reload); },
+		build.pass.get());
+	pipeline_builds.push_back(std::move(build));
+}
+
+void RenderGraph::request_pipeline_reload(RenderPass& pass, PipelineStorage& storage) {
+	if (storage.building) {
+		storage.reload_requested = true;
+		return;
+	}
+	start_pipeline_build(pass, true);
+}
+
+void RenderGraph::poll_pipeline_builds() {
+	for (size_t i = 0; i < pipeline_builds.size();) {
+		PipelineBuild& build = pipeline_builds[i];
+		if (build.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			i++;
+			continue;
+		}
+		const bool built = build.result.get();
+		PipelineStorage& storage = pipeline_cache[build.pass->name];
+		storage.building = false;
+		if (!build.pipeline) {
+			storage.pipeline->compiling.store(false, std::memory_order_release);
+		} else if (!built) {
+			LUMEN_WARN("Shader compilation failed, {} keeps its previous pipeline", build.pass->name);
+			build.pipeline->cleanup();
+		} else {
+			Pipeline* old_pipeline = storage.pipeline.get();
+			std::vector<Shader*> new_shaders = build.pass->shader_list();
+			for (RenderPass& pass : passes) {
+				if (pass.pipeline != old_pipeline) {
+					continue;
+				}
+				pass.pipeline = build.pipeline.get();
+				std::vector<Shader*> shaders = pass.shader_list();
+				for (size_t s = 0; s < shaders.size(); s++) {
+					*shaders[s] = *new_shaders[s];
+				}
+				for (size_t b = 0; b < pass.bound_resources.size(); b++) {
+					pass.bound_resources[b].active = build.pass->bound_resources[b].active;
+					pass.bound_resources[b].read = build.pass->bound_resources[b].read;
+					pass.bound_resources[b].write = build.pass->bound_resources[b].write;
+				}
+				if (settings.shader_inference) {
+					pass.affected_buffer_pointers = build.pass->affected_buffer_pointers;
+				}
+			}
+			{
+				std::lock_guard<std::mutex> lock(shader_map_mutex);
+				for (Shader* shader : new_shaders) {
+					shader_cache[shader->name_with_macros] = *shader;
+				}
+			}
+			// Frames in flight may still use the old one
+			retired_pipelines.push_back({std::move(storage.pipeline), (uint32_t)recording_frames.size()});
+			storage.pipeline = std::move(build.pipeline);
+			// The accesses may have changed with the shaders
+			execution_plans.clear();
+		}
+		pipeline_builds.erase(pipeline_builds.begin() + i);
+		if (storage.reload_requested) {
+			storage.reload_requested = false;
+			for (RenderPass& pass : passes) {
+				if (pass.pipeline == storage.pipeline.get()) {
+					start_pipeline_build(pass, true);
+					break;
+				}
+			}
+		}
+	}
+}
+
+std::vector<std::string> RenderGraph::compiling_passes() const {
+	std::vector<std::string> names;
+	for (const PipelineBuild& build : pipeline_builds) {
+		names.push_back(build.pass->name);
+	}
+	return names;
 }
 
 void RenderGraph::submit(CommandBuffer& cmd) {
-	cmd.submit();
+	const VkSemaphoreSubmitInfo wait_info = async_wait_info();
+	cmd.submit(true, true, &wait_info);
+	pending_async_wait = 0;
 	uint32_t i = beginning_pass_idx;
 	uint32_t rem_passes = ending_pass_idx - beginning_pass_idx;
 	while (rem_passes > 0) {
@@ -1027,19 +2440,44 @@ void RenderGraph::run_and_submit(CommandBuffer& cmd) {
 }
 
 void RenderGraph::destroy() {
-	passes.clear();
-	event_pool.cleanup(ctx->device);
-	for (auto& pass : passes) {
-		if (pass.push_constant_data) {
-			free(pass.push_constant_data);
+	// The builds write into the cached pipelines
+	for (PipelineBuild& build : pipeline_builds) {
+		build.result.wait();
+		if (build.pipeline) {
+			build.pipeline->cleanup();
 		}
 	}
+	pipeline_builds.clear();
+	for (auto& [pipeline, _] : retired_pipelines) {
+		pipeline->cleanup();
+	}
+	retired_pipelines.clear();
+	passes.clear();
+	event_pool.cleanup(ctx->device);
 	for (const auto& [k, v] : pipeline_cache) {
 		v.pipeline->cleanup();
 	}
 	recording = true;
-	buffer_resource_map.clear();
-	img_resource_map.clear();
+	execution_plans.clear();
+	for (VkDeviceMemory heap : transient_heaps) {
+		vkFreeMemory(ctx->device, heap, nullptr);
+	}
+	transient_heaps.clear();
+	free_retired_transients(true);
+	transient_requests.clear();
+	transient_layout = {};
+	alias_first_uses.clear();
+	destroy_async_resources();
+	destroy_recording_resources();
+	profiler.destroy();
+	transients.clear();
+	transients_dirty = false;
+	scheduled_order.clear();
+	prev_scheduled_order.clear();
+	buffer_registry.clear();
+	img_registry.clear();
+	buffer_states.clear();
+	img_states.clear();
 	registered_buffer_pointers.clear();
 	shader_cache.clear();
 	pipeline_cache.clear();
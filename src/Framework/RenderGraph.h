@@ -6,6 +6,13 @@
 #include "Texture.h"
 #include "EventPool.h"
 #include "RenderGraphTypes.h"
+#include "TransientAllocator.h"
+#include "PassScheduler.h"
+#include "Profiler.h"
+#include "SyncPlanner.h"
+#include "ResourceRegistry.h"
+#include "FrameArena.h"
+#include <array>
 #include <span>
 
 #define TO_STR(V) (#V)
@@ -28,8 +35,15 @@ class RenderPass;
 
 class RenderGraph {
    public:
-	RenderGraph(VulkanContext* ctx) : ctx(ctx) { pipeline_tasks.reserve(32); }
+	// The frame timeline (see VulkanBase) tells when replaced transient memory can be freed, without it the
+	// replacement waits for the device to go idle
+	RenderGraph(VulkanContext* ctx, const VkSemaphore* frame_timeline = nullptr, const uint64_t* frame_value = nullptr)
+		: ctx(ctx), frame_timeline(frame_timeline), frame_value(frame_value) {
+		pipeline_tasks.reserve(32);
+	}
 	RenderPass& current_pass() { return passes.back(); }
+	// The device has a compute queue apart from the graphics one, settings.async_compute does nothing otherwise
+	bool async_compute_available() const;
 
 	RenderPass& add_rt(const std::string& name, const RTPassSettings& settings);
 	RenderPass& add_gfx(const std::string& name, const GraphicsPassSettings& settings);
@@ -39,6 +53,28 @@ class RenderGraph {
 	void submit(CommandBuffer& cmd);
 	void run_and_submit(CommandBuffer& cmd);
 	void destroy();
+	/*
+		Transient resources don't keep their contents across frames. They start with dedicated memory
+		and once their lifetimes are known from the recorded passes, they are recreated on top of
+		shared heaps with aliasing. The handles (and device addresses) change at that point, so
+		on_realized is invoked to let the owner update anything that refers to them. Later changes of
+		the pass order only recreate them if the lifetimes no longer fit the placement; the replaced
+		memory is freed once the frames in flight are done with it, so on_realized must not destroy
+		anything those frames use.
+	*/
+	void add_transient(Buffer& buffer, const char* name, VkBufferUsageFlags usage, VkDeviceSize size,
+					   std::function<void()> on_realized = nullptr);
+	void add_transient(Texture2D& tex, const char* name, const TextureSettings& settings, VkSampler sampler = 0,
+					   std::function<void()> on_realized = nullptr);
+	// Semaphore the submission of the command buffer given to run() has to wait on, null if there is none
+	VkSemaphoreSubmitInfo async_wait_info() const;
+	// Writes the sync plan of the next run() to path + ".json" and path + ".dot"
+	void export_sync_plan(const std::string& path) { sync_plan_export_path = path; }
+	// Passes whose pipeline is being created or reloaded in the background
+	std::vector<std::string> compiling_passes() const;
+	// Pass timestamps needed by the application itself (e.g. the convergence log), on top of settings.profile_passes,
+	// which stays the user's choice
+	bool profiling_requested = false;
 	friend RenderPass;
 	bool recording = true;
 	bool reload_shaders = false;
@@ -46,6 +82,9 @@ class RenderGraph {
 	std::unordered_map<std::string, Buffer*> registered_buffer_pointers;
 	std::unordered_map<std::string, Shader> shader_cache;
 	RenderGraphSettings settings;
+	Profiler profiler;
+	// Scratch memory of the current frame, rewound in reset()
+	FrameArena frame_arena;
 	std::mutex shader_map_mutex;
 
    private:
@@ -58,29 +97,187 @@ class RenderGraph {
 		std::vector<VkDependencyInfo> dependency_infos;
 	};
 
+	struct BufferState {
+		uint32_t pass_idx = UINT32_MAX;
+		VkAccessFlags access_flags = 0;
+	};
+
+	// Sync state produced by a run over [beginning_pass_idx, ending_pass_idx)
+	struct ExecutionPlan {
+		size_t signature = 0;
+		std::vector<std::pair<Texture2D*, VkImageLayout>> img_layouts;
+		std::vector<std::pair<ResourceHandle, uint32_t>> img_states;
+		std::vector<std::pair<ResourceHandle, BufferState>> buffer_states;
+		std::vector<uint32_t> order;
+		std::vector<uint32_t> culled;
+	};
+
+	struct TransientResource {
+		Buffer* buf = nullptr;
+		Texture2D* tex = nullptr;
+		std::string name;
+		TextureSettings tex_settings;
+		VkSampler sampler = VK_NULL_HANDLE;
+		std::function<void()> on_realized;
+	};
+
+	// Queue family ownership transfer of a resource between two queue batches
+	struct QueueTransfer {
+		Buffer* buf = nullptr;
+		Texture2D* tex = nullptr;
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		uint32_t release_batch;
+		uint32_t acquire_batch;
+	};
+
+	// Consecutive passes that are submitted together to either the graphics or the compute queue
+	struct QueueBatch {
+		bool compute = false;
+		// On the FrameArena, the batches are planned and recorded within one run()
+		std::pmr::vector<uint32_t> pass_idxs;
+		// Batch of the other queue that has to be finished first
+		int32_t wait_batch = -1;
+		uint64_t signal_value = 0;
+		VkCommandBuffer cmd = VK_NULL_HANDLE;
+	};
+
+	// Command buffers owned by the render graph for one run, reused once the timelines pass the values
+	struct AsyncFrame {
+		std::vector<VkCommandBuffer> cmds[2];
+		uint64_t timeline_values[2] = {};
+	};
+
+	// Secondary command buffers of one frame for the multithreaded recording. Every chunk has its own pool,
+	// a chunk is recorded by a single worker so the pools are never shared between threads
+	struct RecordingFrame {
+		std::vector<VkCommandPool> pools;
+		std::vector<std::vector<VkCommandBuffer>> cmds;
+		std::vector<uint32_t> used_cmds;
+	};
+
 	struct PipelineStorage {
 		std::unique_ptr<Pipeline> pipeline;
 		uint32_t offset_idx;
 		std::vector<uint32_t> pass_idxs;
+		bool building = false;
+		// Shaders were reloaded again while a build was running
+		bool reload_requested = false;
+	};
+
+	// Pipeline created on the ThreadPool across frames
+	struct PipelineBuild {
+		// Detached copy of the pass, the passes move around in the vector while the build runs
+		std::unique_ptr<RenderPass> pass;
+		// Replacement of the cached pipeline for reloads, null when the pipeline is created for the first time
+		std::unique_ptr<Pipeline> pipeline;
+		// False if a shader failed to compile
+		std::future<bool> result;
 	};
 	VulkanContext* ctx = nullptr;
 	std::vector<RenderPass> passes;
 	std::unordered_map<std::string, PipelineStorage> pipeline_cache;
-	std::vector<std::pair<std::function<void(RenderPass*)>, uint32_t>> pipeline_tasks;
+	// Passes finalized in this run, and whether their pipeline has to be created
+	std::vector<std::pair<bool, uint32_t>> pipeline_tasks;
+	std::vector<PipelineBuild> pipeline_builds;
+	// Replaced by reloads, destroyed once the frames that used them are done
+	std::vector<std::pair<std::unique_ptr<Pipeline>, uint32_t>> retired_pipelines;
+	void start_pipeline_build(RenderPass& pass, bool reload);
+	void request_pipeline_reload(RenderPass& pass, PipelineStorage& storage);
+	// Swaps in the pipelines that are done
+	void poll_pipeline_builds();
 	std::vector<std::function<void(RenderPass*)>> shader_tasks;
 	std::vector<uint32_t> pass_idxs_with_shader_compilation_overrides;
 	// Sync related data
 	std::vector<BufferSyncResources> buffer_sync_resources;
 	std::vector<ImageSyncResources> img_sync_resources;
-	std::unordered_map<VkBuffer, std::pair<uint32_t, VkAccessFlags>>
-		buffer_resource_map;								 // Buffer handle - { Write Pass Idx, Access Type }
-	std::unordered_map<VkImage, uint32_t> img_resource_map;	 // Tex2D handle - Pass Idx
+	// Last user of each registered resource, indexed by the registry slots
+	ResourceRegistry buffer_registry;
+	ResourceRegistry img_registry;
+	std::vector<BufferState> buffer_states;
+	std::vector<uint32_t> img_states;  // Pass Idx, UINT32_MAX if unused
+	uint32_t resource_id(Buffer& buffer);
+	uint32_t resource_id(Texture2D& tex);
 	uint32_t beginning_pass_idx = 0;
 	uint32_t ending_pass_idx = 0;
 	const bool multithreaded_pipeline_compilation = true;
+	// Execution plans keyed by their beginning pass index
+	std::unordered_map<uint32_t, ExecutionPlan> execution_plans;
+	bool capturing_plan = false;
+	// Execution order of the current run() range and of the whole frame
+	std::vector<uint32_t> range_order;
+	std::vector<uint32_t> scheduled_order;
+	std::vector<uint32_t> prev_scheduled_order;
+	std::vector<Texture2D*> captured_textures;
+	std::vector<uint32_t> captured_buffers;
+
+	// Transient resources
+	std::vector<TransientResource> transients;
+	std::vector<VkDeviceMemory> transient_heaps;
+	// Requirements and lifetimes the current heaps were last checked against, and their placement
+	std::vector<TransientRequest> transient_requests;
+	TransientLayout transient_layout;
+	// (pass, transient) pairs of the aliased transients and the passes that use them first
+	std::vector<std::pair<uint32_t, uint32_t>> alias_first_uses;
+	// Resources and heaps replaced by a new placement, freed once the frame timeline reaches frame_value
+	struct RetiredTransients {
+		std::vector<Buffer> buffers;
+		std::vector<Texture2D> textures;
+		std::vector<VkDeviceMemory> heaps;
+		uint64_t frame_value = 0;
+	};
+	std::vector<RetiredTransients> retired_transients;
+	const VkSemaphore* frame_timeline = nullptr;
+	const uint64_t* frame_value = nullptr;
+	bool transients_dirty = false;
+	std::vector<TransientRequest> transient_lifetimes();
+	void update_transients();
+	void realize_transients(std::vector<TransientRequest>& requests);
+	void update_alias_barriers();
+	void free_retired_transients(bool all = false);
+
+	// Fills range_schedule, the containers below keep their capacity so that steady frames don't allocate
+	void schedule_range();
+	PassSchedule range_schedule;
+	std::vector<uint32_t> range_pass_idxs;
+	std::vector<PassAccesses> range_accesses;
+	std::vector<uint64_t> range_transients;
+	SyncPlan current_sync_plan() const;
+	std::string sync_plan_export_path;
+	// Async compute
+	std::vector<QueueBatch> queue_batches;
+	std::vector<QueueTransfer> queue_transfers;
+	PassAccesses batch_accesses;
+	// Indexed by 0: Graphics, 1: Compute
+	VkCommandPool async_cmd_pools[2] = {};
+	VkSemaphore timelines[2] = {};
+	uint64_t timeline_values[2] = {};
+	std::array<AsyncFrame, 4> async_frames;
+	uint32_t async_frame_idx = 0;
+	uint64_t pending_async_wait = 0;
+	bool plan_queue_batches();
+	void record_queue_batches(VkCommandBuffer cmd);
+	void destroy_async_resources();
+	// Multithreaded recording, one slot per frame (reset() to reset()). Reused after the frames in flight of
+	// VulkanBase waited on their fences
+	std::array<RecordingFrame, 4> recording_frames;
+	uint32_t recording_frame_idx = 0;
+	std::vector<std::unique_ptr<FrameArena>> chunk_arenas;
+	std::vector<bool> record_serial;
+	std::vector<RecordSegment> record_segments;
+	bool record_in_chunks(VkCommandBuffer cmd);
+	void destroy_recording_resources();
+
+	// Overwrites access, resources collects the resources behind the ids
+	void collect_accesses(const RenderPass& pass, PassAccesses& access,
+						  std::pmr::unordered_map<uint64_t, Resource>* resources = nullptr) const;
+	size_t compute_plan_signature();
+	bool replay_plan(size_t signature);
+	void capture_plan(size_t signature, const std::vector<uint32_t>& culled);
 
 	template <typename Settings>
 	RenderPass& add_pass_impl(const std::string& name, const Settings& settings);
+	std::string pass_name_scratch;
+	std::string macro_string_scratch;
 };
 
 class RenderPass {
@@ -155,11 +352,20 @@ class RenderPass {
 	RenderPass& zero(const Resource& resource, bool cond);
 	RenderPass& copy(const Resource& src, const Resource& dst);
 	void finalize(bool record_override_encountered);
+	// Argument buffer of an indirect dispatch or ray launch
+	Buffer* indirect_buffer() const {
+		if (compute_settings) {
+			return compute_settings->indirect_buffer;
+		}
+		return rt_settings ? rt_settings->indirect_buffer : nullptr;
+	}
 	friend RenderGraph;
 	std::vector<ResourceBinding> bound_resources;
 
 	RenderGraph* rg;
 	std::vector<ShaderMacro> macro_defines;
+	// Detached copy compiled by a background reload, always goes through the compiler
+	bool reload_copy = false;
 	std::unordered_map<Buffer*, BufferStatus> affected_buffer_pointers;
 	std::unique_ptr<GraphicsPassSettings> gfx_settings = nullptr;
 	std::unique_ptr<RTPassSettings> rt_settings = nullptr;
@@ -182,30 +388,54 @@ class RenderPass {
 	void read_impl(Texture2D& tex);
 	void post_execution_barrier(Buffer& buffer, VkAccessFlags access_flags);
 
-	void run(VkCommandBuffer cmd);
-	void register_dependencies(Buffer& buffer, VkAccessFlags dst_access_flags);
-	void register_dependencies(Texture2D& tex, VkImageLayout target_layout);
+	void run(VkCommandBuffer cmd, FrameArena& arena);
+	// Takes the events of the signals ahead of the recording, for passes recorded on different threads
+	void acquire_events(VkCommandBuffer cmd);
+	void register_dependencies(Buffer& buffer, uint32_t resource, VkAccessFlags dst_access_flags);
+	void register_dependencies(Texture2D& tex, uint32_t resource, VkImageLayout target_layout);
 	void transition_resources();
+	void clear_sync_state();
+	std::vector<Shader*> shader_list();
+	void reflect_pipeline();
+	// Compiles the shaders first for reloads, false if one of them failed
+	bool build_pipeline(bool compile_shaders);
+	std::unique_ptr<RenderPass> detached_copy(Pipeline* pipeline) const;
 
 	std::string name;
 	Pipeline* pipeline;
 	int next_binding_idx = 0;
 	std::vector<uint32_t> descriptor_counts;
-	void* push_constant_data = nullptr;
+	// Stored inline, 256 bytes is the common maxPushConstantsSize of the desktop GPUs
+	alignas(16) std::byte push_constant_data[256] = {};
 	bool is_pipeline_cached;
 	bool submitted = false;
 	bool record_override = true;
+	// Sync state belongs to a valid execution plan and survives reset()
+	bool sync_state_cached = false;
+	// Transient textures whose contents are discarded in this pass (first use in the frame)
+	std::vector<Texture2D*> discarded_textures;
+	// The pass is the first user of aliased transient memory
+	bool alias_barrier = false;
+	// Recorded into a batch of the compute queue
+	bool on_async_queue = false;
+	// Layouts of the images before the dependency registration of this pass. A pass touches a handful of images, a
+	// flat list keeps its capacity across frames
+	std::vector<std::pair<Texture2D*, VkImageLayout>> entry_layouts;
+	void save_entry_layout(Texture2D& tex);
+	VkImageLayout entry_layout(const Texture2D& tex) const;
 	/*
 		Note:
 		The assumption is that a SyncDescriptor is unique to a pass (either via
 		Buffer or Image). Which is reasonable because each pass is comprised of a
 		single shader dispatch
+		There is at most one descriptor per resource in each of these, a pass only touches a handful of
+		resources so a linear search is cheaper than hashing.
 	*/
-	std::unordered_map<VkBuffer, BufferSyncDescriptor> set_signals_buffer;
-	std::unordered_map<VkBuffer, BufferSyncDescriptor> wait_signals_buffer;
+	std::vector<BufferSyncDescriptor> set_signals_buffer;
+	std::vector<BufferSyncDescriptor> wait_signals_buffer;
 
-	std::unordered_map<VkImage, ImageSyncDescriptor> set_signals_img;
-	std::unordered_map<VkImage, ImageSyncDescriptor> wait_signals_img;
+	std::vector<ImageSyncDescriptor> set_signals_img;
+	std::vector<ImageSyncDescriptor> wait_signals_img;
 
 	DescriptorInfo descriptor_infos[32] = {};
 
@@ -229,8 +459,11 @@ inline RenderPass& RenderGraph::add_pass_impl(const std::string& name, const Set
 	uint32_t pass_idx = ending_pass_idx++;
 	bool cached = false;
 
-	std::string name_with_macros = name;
-	std::string macro_string;
+	// The key is rebuilt for every pass in every frame, so the strings keep their capacity around
+	std::string& name_with_macros = pass_name_scratch;
+	std::string& macro_string = macro_string_scratch;
+	name_with_macros.assign(name);
+	macro_string.clear();
 
 	if (!settings.macros.empty()) {
 		macro_string += '(';
@@ -241,13 +474,25 @@ inline RenderPass& RenderGraph::add_pass_impl(const std::string& name, const Set
 		}
 		macro_string += settings.macros[i].name;
 		if (settings.macros[i].has_val) {
-			macro_string += "=" + std::to_string(settings.macros[i].val);
+			macro_string += '=';
+			macro_string += std::to_string(settings.macros[i].val);
 		}
 	}
 	if (!settings.macros.empty()) {
 		macro_string += ')';
 	}
 	name_with_macros += macro_string;
+	// Specialization constants only change the pipeline, the shaders are shared between the variants
+	if (!settings.specialization_data.empty()) {
+		name_with_macros += '<';
+		for (size_t i = 0; i < settings.specialization_data.size(); i++) {
+			if (i > 0) {
+				name_with_macros += ',';
+			}
+			name_with_macros += std::to_string(settings.specialization_data[i]);
+		}
+		name_with_macros += '>';
+	}
 
 	if (pipeline_cache.find(name_with_macros) != pipeline_cache.end()) {
 		auto& storage = pipeline_cache[name_with_macros];
@@ -262,16 +507,11 @@ inline RenderPass& RenderGraph::add_pass_impl(const std::string& name, const Set
 				}	
 			}
 			passes[idx].active = true;
-			if (reload_shaders) {
-				if (storage.offset_idx == 0) {
-					pipeline_cache[name_with_macros].pipeline->cleanup();
-					pipeline_cache[name_with_macros].pipeline = std::make_unique<Pipeline>(ctx, name_with_macros);
-				}
-				passes[idx].pipeline = pipeline_cache[name_with_macros].pipeline.get();
-				passes[idx].is_pipeline_cached = false;
-			} else {
-				passes[idx].is_pipeline_cached = true;
+			if (reload_shaders && storage.offset_idx == 0) {
+				// The pass keeps its pipeline until the reloaded one is ready
+				request_pipeline_reload(passes[idx], storage);
 			}
+			passes[idx].is_pipeline_cached = true;
 			++storage.offset_idx;
 			// If this is a cached pipeline and the cached pipeline index is not 0, make this the starting pass index
 			if (idx != 0 && beginning_pass_idx == 0) {
@@ -310,13 +550,7 @@ inline RenderPass& RenderGraph::add_pass_impl(const std::string& name, const Set
 
 template <typename T>
 inline RenderPass& RenderPass::push_constants(T* data) {
-	void* new_ptr = nullptr;
-	if (rg->recording) {
-		new_ptr = malloc(sizeof(T));
-	} else {
-		new_ptr = push_constant_data;
-	}
-	memcpy(new_ptr, data, sizeof(T));
-	push_constant_data = new_ptr;
+	static_assert(sizeof(T) <= sizeof(push_constant_data), "Push constants don't fit into the pass");
+	memcpy(push_constant_data, data, sizeof(T));
 	return *this;
 }
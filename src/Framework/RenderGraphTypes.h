@@ -23,6 +23,22 @@ struct ShaderMacro {
 struct RenderGraphSettings {
 	bool shader_inference = false;
 	bool use_events = false;
+	// The optimizations below are opt-in until they have been validated on more drivers and scenes
+	// Reuse the synchronization state of the previous frame when the pass topology is unchanged
+	bool replay_execution_plans = false;
+	// Skip passes that only produce transient resources nobody reads. Everything else persists across frames and
+	// counts as consumed, so this only ever drops passes writing add_transient() resources
+	bool cull_passes = false;
+	// Interleave independent passes to increase the distance between producers and consumers
+	bool reorder_passes = false;
+	// Run async_compute passes on a dedicated compute queue when the device has one
+	bool async_compute = false;
+	// Wrap every pass in timestamp queries, see Profiler
+	bool profile_passes = false;
+	// Record the passes on the ThreadPool into secondary command buffers, gfx passes stay on the calling thread
+	bool multithreaded_recording = false;
+	// Smaller chunks cost more in secondary command buffer overhead than they save
+	uint32_t min_passes_per_chunk = 8;
 };
 
 struct GraphicsPassSettings {
@@ -55,6 +71,10 @@ struct RTPassSettings {
 	std::vector<uint32_t> specialization_data = {};
 	dim3 dims;
 	VkAccelerationStructureKHR accel;
+	// When set, the launch size is a VkTraceRaysIndirectCommandKHR read from the buffer on the GPU and dims is ignored.
+	// The buffer needs the indirect and device address usages
+	Buffer* indirect_buffer = nullptr;
+	VkDeviceSize indirect_offset = 0;
 	std::function<void(VkCommandBuffer cmd, const RenderPass& pass)> pass_func;
 };
 
@@ -63,7 +83,12 @@ struct ComputePassSettings {
 	std::vector<ShaderMacro> macros = {};
 	std::vector<uint32_t> specialization_data = {};
 	dim3 dims;
+	// When set, the workgroup counts are a VkDispatchIndirectCommand read from the buffer on the GPU and dims is ignored
+	Buffer* indirect_buffer = nullptr;
+	VkDeviceSize indirect_offset = 0;
 	std::function<void(VkCommandBuffer cmd, const RenderPass& pass)> pass_func;
+	// The pass may run on the compute queue, overlapping with the graphics work that doesn't depend on it
+	bool async_compute = false;
 };
 
 enum class PassType { Compute, RT, Graphics };
@@ -106,11 +131,16 @@ struct ResourceBinding {
 struct Resource {
 	Buffer* buf = nullptr;
 	Texture2D* tex = nullptr;
-	Resource(Buffer& buf) : buf(&buf) {}
+	// Byte offset into a buffer that is the destination of a copy
+	VkDeviceSize offset = 0;
+	Resource(Buffer& buf, VkDeviceSize offset = 0) : buf(&buf), offset(offset) {}
 	Resource(Texture2D& tex) : tex(&tex) {}
 };
 
 struct BufferSyncDescriptor {
+	// Render graph id of the buffer
+	uint32_t resource;
+	VkBuffer buffer;
 	// Read-after-write is the default dependency implicitly
 	VkAccessFlags src_access_flags = VK_ACCESS_SHADER_WRITE_BIT;
 	VkAccessFlags dst_access_flags = VK_ACCESS_SHADER_READ_BIT;
@@ -119,6 +149,9 @@ struct BufferSyncDescriptor {
 };
 
 struct ImageSyncDescriptor {
+	// Render graph id of the image
+	uint32_t resource;
+	VkImage img;
 	VkImageLayout old_layout;
 	VkImageLayout new_layout;
 	uint32_t opposing_pass_idx;
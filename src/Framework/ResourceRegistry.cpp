@@ -0,0 +1,64 @@
+#include "ResourceRegistry.h"
+
+uint32_t ResourceRegistry::resolve(ResourceHandle& handle, uint64_t native, bool* registered) {
+	if (registered) {
+		*registered = false;
+	}
+	if (is_current(handle)) {
+		if (slots[handle.idx].native == native) {
+			return handle.idx;
+		}
+		// Recreated since the last use
+		release_slot(handle.idx);
+	}
+	auto it = native_slots.find(native);
+	if (it != native_slots.end()) {
+		handle = handle_of(it->second);
+		return handle.idx;
+	}
+	uint32_t idx;
+	if (!free_slots.empty()) {
+		idx = free_slots.back();
+		free_slots.pop_back();
+	} else {
+		idx = (uint32_t)slots.size();
+		slots.emplace_back();
+	}
+	slots[idx].native = native;
+	slots[idx].alive = true;
+	native_slots[native] = idx;
+	handle = handle_of(idx);
+	if (registered) {
+		*registered = true;
+	}
+	return idx;
+}
+
+bool ResourceRegistry::is_current(const ResourceHandle& handle) const {
+	return handle.valid() && handle.idx < slots.size() && slots[handle.idx].alive &&
+		   slots[handle.idx].generation == handle.generation;
+}
+
+void ResourceRegistry::release(ResourceHandle& handle) {
+	if (is_current(handle)) {
+		release_slot(handle.idx);
+	}
+	handle = {};
+}
+
+void ResourceRegistry::release_slot(uint32_t idx) {
+	Slot& slot = slots[idx];
+	native_slots.erase(slot.native);
+	slot.alive = false;
+	slot.generation++;
+	free_slots.push_back(idx);
+}
+
+void ResourceRegistry::clear() {
+	// Generations keep counting up so that handles from before stay stale
+	for (uint32_t i = 0; i < slots.size(); i++) {
+		if (slots[i].alive) {
+			release_slot(i);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Slot of a resource in a ResourceRegistry, only valid while the generation matches
+struct ResourceHandle {
+	uint32_t idx = UINT32_MAX;
+	uint32_t generation = 0;
+	bool valid() const { return idx != UINT32_MAX; }
+};
+
+/*
+	Dense integer ids for the resources the render graph tracks. Resources keep their handle, so the per-frame
+	state can live in flat arrays indexed by the slot instead of maps keyed by the Vulkan handles.
+	When the native handle of a resource changes (it got recreated), its slot is released and the generation
+	is bumped, which invalidates the handles held by copies of the resource.
+*/
+class ResourceRegistry {
+   public:
+	// Slot of the resource, (re)registers it if the handle is unset or stale.
+	// registered is set when the slot is new, its state has to be reset by the caller
+	uint32_t resolve(ResourceHandle& handle, uint64_t native, bool* registered = nullptr);
+	bool is_current(const ResourceHandle& handle) const;
+	ResourceHandle handle_of(uint32_t idx) const { return {idx, slots[idx].generation}; }
+	void release(ResourceHandle& handle);
+	void clear();
+	uint32_t capacity() const { return (uint32_t)slots.size(); }
+
+   private:
+	struct Slot {
+		uint64_t native = 0;
+		uint32_t generation = 0;
+		bool alive = false;
+	};
+	std::vector<Slot> slots;
+	std::vector<uint32_t> free_slots;
+	// Only consulted on registration, so that copies of a resource end up in the same slot
+	std::unordered_map<uint64_t, uint32_t> native_slots;
+	void release_slot(uint32_t idx);
+};
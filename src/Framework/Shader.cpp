@@ -1,6 +1,7 @@
 #include "../LumenPCH.h"
 #include "Shader.h"
 #include "RenderGraph.h"
+#include "BindlessHeap.h"
 #include <spirv_cross/spirv.h>
 #include <spirv_cross/spirv_glsl.hpp>
 
@@ -142,6 +143,9 @@ static void parse_spirv(spirv_cross::CompilerGLSL& glsl, const spirv_cross::Shad
 	auto active_vars = glsl.get_active_interface_variables();
 	auto active_resources = glsl.get_shader_resources(active_vars);
 	for (auto& sampled_img : active_resources.sampled_images) {
+		if (glsl.get_decoration(sampled_img.id, spv::DecorationDescriptorSet) == BINDLESS_SET) {
+			continue;
+		}
 		auto binding = glsl.get_decoration(sampled_img.id, spv::DecorationBinding);
 		shader.resource_binding_map[binding].read = true;
 		shader.resource_binding_map[binding].active = true;
@@ -386,6 +390,10 @@ static void parse_shader(Shader& shader, const uint32_t* code, size_t code_size,
 	auto reflect = [&shader, &glsl](const spirv_cross::Resource& resource, VkDescriptorType type) {
 		unsigned set = glsl.get_decoration(resource.id, spv::DecorationDescriptorSet);
 		unsigned binding = glsl.get_decoration(resource.id, spv::DecorationBinding);
+		if (set == BINDLESS_SET) {
+			shader.uses_bindless = true;
+			return;
+		}
 		shader.binding_mask |= 1 << binding;
 		shader.descriptor_types[binding] = type;
 	};
@@ -464,11 +472,11 @@ static std::unordered_map<std::string, shaderc_shader_kind> mstages = {
 };
 
 static std::vector<uint32_t> compile_file(const std::string& source_name, shaderc_shader_kind kind, const std::string& source, 
-										  RenderPass* pass, bool optimize = false) {
+										  const std::vector<ShaderMacro>& macros, bool optimize = false) {
 	shaderc::Compiler compiler;
 	shaderc::CompileOptions options;
 
-	for (const auto& macro : pass->macro_defines) {
+	for (const auto& macro : macros) {
 		if (macro.has_val) {
 			options.AddMacroDefinition(macro.name, std::to_string(macro.val));
 			
@@ -501,7 +509,116 @@ static std::vector<uint32_t> compile_file(const std::string& source_name, shader
 
 Shader::Shader() {}
 Shader::Shader(const std::string& filename) : filename(filename) {}
+
+std::string Shader::cache_path(const std::string& name_with_macros) {
+#ifdef LUMEN_SHADER_CACHE_DIR
+	std::string file_name = name_with_macros;
+	for (auto& c : file_name) {
+		if (!std::isalnum((unsigned char)c) && c != '_' && c != '.') {
+			c = '_';
+		}
+	}
+	return std::string(LUMEN_SHADER_CACHE_DIR) + "/" + file_name + ".spv";
+#else
+	return "";
+#endif
+}
+
+// SPIR-V of the variants compiled ahead of their first pass by Shader::prewarm()
+static std::mutex prewarmed_mutex;
+static std::unordered_map<std::string, std::vector<uint32_t>> prewarmed_binaries;
+
+static bool read_spirv(const std::string& path, std::vector<uint32_t>& binary) {
+	std::ifstream bin(path, std::ios::ate | std::ios::binary);
+	if (!bin.good()) {
+		return false;
+	}
+	size_t file_size = (size_t)bin.tellg();
+	bin.seekg(0);
+	binary.resize(file_size / 4);
+	bin.read((char*)binary.data(), file_size);
+	return true;
+}
+
+bool Shader::prewarm(const std::string& filename, const std::vector<std::string>& macros) {
+	// Same key as RenderGraph::add_pass_impl() builds
+	std::string name_with_macros = filename;
+	std::vector<ShaderMacro> defines;
+	for (size_t i = 0; i < macros.size(); i++) {
+		name_with_macros += i == 0 ? '(' : ',';
+		name_with_macros += macros[i];
+		const auto eq = macros[i].find('=');
+		if (eq == std::string::npos) {
+			defines.emplace_back(macros[i]);
+		} else {
+			defines.emplace_back(macros[i].substr(0, eq), std::stoi(macros[i].substr(eq + 1)));
+		}
+	}
+	if (!macros.empty()) {
+		name_with_macros += ')';
+	}
+	{
+		std::lock_guard<std::mutex> lock(prewarmed_mutex);
+		if (prewarmed_binaries.contains(name_with_macros)) {
+			return true;
+		}
+	}
+	std::vector<uint32_t> binary;
+	const auto path = cache_path(name_with_macros);
+	if (path.empty() || !read_spirv(path, binary)) {
+#if USE_SHADERC
+		const auto kind = mstages.find(filename.substr(filename.rfind('.') + 1));
+		if (kind == mstages.end()) {
+			return false;
+		}
+		std::ifstream fin(filename);
+		std::stringstream buffer;
+		buffer << fin.rdbuf() << "\n";
+		binary = compile_file(filename, kind->second, buffer.str(), defines);
+#endif
+	}
+	if (binary.empty()) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(prewarmed_mutex);
+	prewarmed_binaries[name_with_macros] = std::move(binary);
+	return true;
+}
+
+static bool load_precompiled(Shader& shader, RenderPass* pass) {
+	// Reloads always go through the compiler so that edits are picked up
+	if (pass->rg->reload_shaders || pass->reload_copy) {
+		return false;
+	}
+	{
+		// Taken out of the map, later passes with this variant hit the shader cache of the render graph
+		std::unique_lock<std::mutex> lock(prewarmed_mutex);
+		auto prewarmed = prewarmed_binaries.extract(shader.name_with_macros);
+		lock.unlock();
+		if (!prewarmed.empty()) {
+			shader.binary = std::move(prewarmed.mapped());
+			parse_shader(shader, shader.binary.data(), shader.binary.size(), pass);
+			return true;
+		}
+	}
+	const auto path = Shader::cache_path(shader.name_with_macros);
+	if (path.empty()) {
+		return false;
+	}
+	if (!read_spirv(path, shader.binary)) {
+		LUMEN_WARN("Shader variant {0} is not in the shader cache, add it to shader_variants.txt",
+				   shader.name_with_macros);
+		return false;
+	}
+	parse_shader(shader, shader.binary.data(), shader.binary.size(), pass);
+	return true;
+}
+
 int Shader::compile(RenderPass* pass) {
+	if (load_precompiled(*this, pass)) {
+		LUMEN_TRACE("Loaded precompiled shader: {0}", name_with_macros);
+		return 0;
+	}
 	LUMEN_TRACE("Compiling shader: {0}", name_with_macros);
 #if USE_SHADERC
 	std::ifstream fin(filename);
@@ -520,7 +637,11 @@ int Shader::compile(RenderPass* pass) {
 	};
 	const auto& str = buffer.str();
 	 // Compiling
-	binary = compile_file(filename, mstages[get_ext(filename)], str, pass);
+	binary = compile_file(filename, mstages[get_ext(filename)], str, pass->macro_defines);
+	if (binary.empty() && pass->reload_copy) {
+		// The reload keeps the previous pipeline
+		return 1;
+	}
 	parse_shader(*this, binary.data(), binary.size(), pass);
 	return 0;
 #else
@@ -18,10 +18,17 @@ struct Shader {
 	int local_size_y = 1;
 	int local_size_z = 1;
 	bool uses_push_constants = false;
+	// Indexes the BindlessHeap, which isn't part of the reflected bindings
+	bool uses_bindless = false;
 	uint32_t push_constant_size = 0;
 	Shader();
 	Shader(const std::string& filename);
 	int compile(RenderPass* pass);
+	// Path of the ahead-of-time compiled variant in the shader cache, empty if there is no cache
+	static std::string cache_path(const std::string& name_with_macros);
+	// Loads or compiles the SPIR-V of a variant ahead of its first pass, macros are NAME or NAME=VALUE as in
+	// shader_variants.txt. Thread safe, returns false if the variant couldn't be built
+	static bool prewarm(const std::string& filename, const std::vector<std::string>& macros);
 	VkShaderModule create_vk_shader_module(const VkDevice& device) const;
 	struct BindingStatus {
 		bool read = false;
@@ -0,0 +1,267 @@
+#include "SyncPlanner.h"
+#include "Logger.h"
+#include <algorithm>
+#include <optional>
+#include <set>
+#include <sstream>
+
+BufferDependency plan_buffer_dependency(const LastAccess* last, uint32_t pass_idx, VkAccessFlags dst_access_flags) {
+	if (!last || (dst_access_flags == VK_ACCESS_SHADER_READ_BIT && last->access_flags == dst_access_flags)) {
+		return {};
+	}
+	if (last->submitted) {
+		return {};
+	}
+	const VkAccessFlags src_access_flags = last->access_flags;
+	if (src_access_flags & VK_ACCESS_TRANSFER_WRITE_BIT) {
+		dst_access_flags |= VK_ACCESS_TRANSFER_WRITE_BIT;
+	}
+	// Invariant : Pass with lower index should be the setter
+	return {.action = last->pass_idx < pass_idx ? SyncAction::Event : SyncAction::Barrier,
+			.src_access_flags = src_access_flags,
+			.dst_access_flags = dst_access_flags,
+			.opposing_pass_idx = last->pass_idx};
+}
+
+ImageDependency plan_image_dependency(const LastAccess* last, VkImageLayout layout, VkImageLayout dst_layout,
+									  bool has_storage_bit, uint32_t pass_idx, uint32_t beginning_pass_idx) {
+	const bool eq_layouts = layout == dst_layout;
+	// Note: Currently, the following optimization doesn't work for this:
+	// if (eq_layouts && (!has_storage_bit || dst_layout == VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL)) {
+	// The reason is that when both src and dst layout are VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, it's possible that prior
+	// to this pass, there was another pass that signalled a transition to READ_ONLY_OPTIMAL, and that pass might have a
+	// different pipeline type. So, for example:
+	// (compute - Image layout : general) -> (compute - Image layout: read_only (for compute only)) - (fragment - Image layout: read only)
+	// In this case: The correct synchronization is needed to ensure a fragment shader read access.
+	// So in principle it would be possible to feed that access flag in the 2nd stage,
+	// but our architecture currently doesn't allow this as we don't explicitly store the pipeline stage for signals
+	if (eq_layouts && !has_storage_bit) {
+		return {};
+	}
+	if (has_storage_bit && eq_layouts && !last) {
+		return {};
+	}
+	ImageDependency dependency = {.action = SyncAction::Transition, .old_layout = layout, .new_layout = dst_layout};
+	if (layout == VK_IMAGE_LAYOUT_UNDEFINED || !last) {
+		return dependency;
+	}
+	if (last->submitted) {
+		return {};
+	}
+	if (last->pass_idx < pass_idx && last->pass_idx >= beginning_pass_idx) {
+		dependency.action = SyncAction::Event;
+		dependency.opposing_pass_idx = last->pass_idx;
+	}
+	return dependency;
+}
+
+SyncPlan simulate_sync(std::span<const SimResource> resources, std::span<const SimPass> passes) {
+	SyncPlan plan;
+	for (const SimPass& pass : passes) {
+		plan.pass_names.push_back(pass.name);
+	}
+	for (const SimResource& resource : resources) {
+		plan.resource_names.push_back(resource.name);
+	}
+	std::vector<std::optional<LastAccess>> last_accesses(resources.size());
+	std::vector<VkImageLayout> layouts(resources.size());
+	for (size_t i = 0; i < resources.size(); i++) {
+		layouts[i] = resources[i].initial_layout;
+	}
+	// A pass waits at most once per resource (wait_signals_* are keyed by the handle)
+	std::set<std::pair<uint32_t, uint32_t>> waits;
+	for (uint32_t pass_idx = 0; pass_idx < (uint32_t)passes.size(); pass_idx++) {
+		for (const SimAccess& access : passes[pass_idx].accesses) {
+			LUMEN_ASSERT(access.resource < resources.size(), "Invalid resource index");
+			const SimResource& resource = resources[access.resource];
+			auto& last = last_accesses[access.resource];
+			SyncOp op = {.resource = access.resource, .src_pass = pass_idx, .dst_pass = pass_idx};
+			VkAccessFlags access_flags;
+			if (resource.image) {
+				access_flags = access.write ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+				// Same as get_target_img_layout()
+				const VkImageLayout dst_layout = resource.sampled && !access.write ? VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL
+																				  : VK_IMAGE_LAYOUT_GENERAL;
+				const ImageDependency dependency =
+					plan_image_dependency(last ? &*last : nullptr, layouts[access.resource], dst_layout,
+										  resource.storage, pass_idx, 0);
+				op.action = dependency.action;
+				op.old_layout = dependency.old_layout;
+				op.new_layout = dependency.new_layout;
+				if (dependency.action == SyncAction::Event) {
+					op.src_pass = dependency.opposing_pass_idx;
+				}
+				if (dependency.action != SyncAction::None) {
+					layouts[access.resource] = dst_layout;
+				}
+			} else {
+				access_flags = access.access_flags
+								   ? access.access_flags
+								   : (access.write ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT);
+				const BufferDependency dependency =
+					plan_buffer_dependency(last ? &*last : nullptr, pass_idx, access_flags);
+				op.action = dependency.action;
+				op.src_access_flags = dependency.src_access_flags;
+				op.dst_access_flags = dependency.dst_access_flags;
+				if (dependency.action == SyncAction::Event) {
+					op.src_pass = dependency.opposing_pass_idx;
+				}
+			}
+			last = LastAccess{.pass_idx = pass_idx, .access_flags = access_flags};
+			if (op.action == SyncAction::None ||
+				(op.action == SyncAction::Event && !waits.insert({pass_idx, access.resource}).second)) {
+				continue;
+			}
+			plan.ops.push_back(op);
+		}
+	}
+	return plan;
+}
+
+std::vector<bool> find_redundant_waits(const SyncPlan& plan) {
+	const size_t num_passes = plan.pass_names.size();
+	std::vector<std::vector<uint32_t>> preds(num_passes);
+	for (const SyncOp& op : plan.ops) {
+		if (op.action == SyncAction::Event && op.src_pass != op.dst_pass) {
+			preds[op.dst_pass].push_back(op.src_pass);
+		}
+	}
+	for (auto& p : preds) {
+		std::sort(p.begin(), p.end());
+		p.erase(std::unique(p.begin(), p.end()), p.end());
+	}
+	// Passes are in execution order, so the reachability can be built front to back
+	std::vector<std::vector<uint64_t>> reachable(num_passes, std::vector<uint64_t>((num_passes + 63) / 64));
+	auto set_bit = [](std::vector<uint64_t>& bits, uint32_t i) { bits[i / 64] |= 1ull << (i % 64); };
+	auto test_bit = [](const std::vector<uint64_t>& bits, uint32_t i) { return (bits[i / 64] >> (i % 64)) & 1; };
+	for (uint32_t i = 0; i < num_passes; i++) {
+		for (uint32_t pred : preds[i]) {
+			set_bit(reachable[i], pred);
+			for (size_t w = 0; w < reachable[i].size(); w++) {
+				reachable[i][w] |= reachable[pred][w];
+			}
+		}
+	}
+	std::vector<bool> redundant(plan.ops.size(), false);
+	for (size_t i = 0; i < plan.ops.size(); i++) {
+		const SyncOp& op = plan.ops[i];
+		if (op.action != SyncAction::Event || op.src_pass == op.dst_pass) {
+			continue;
+		}
+		// Covered if another direct predecessor already depends on the signalling pass
+		for (uint32_t pred : preds[op.dst_pass]) {
+			if (pred != op.src_pass && test_bit(reachable[pred], op.src_pass)) {
+				redundant[i] = true;
+				break;
+			}
+		}
+	}
+	return redundant;
+}
+
+SyncPlanStats sync_plan_stats(const SyncPlan& plan) {
+	SyncPlanStats stats;
+	std::set<std::pair<uint32_t, uint32_t>> signals;
+	for (const SyncOp& op : plan.ops) {
+		switch (op.action) {
+			case SyncAction::Event:
+				stats.events++;
+				signals.insert({op.src_pass, op.resource});
+				break;
+			case SyncAction::Barrier:
+				stats.barriers++;
+				break;
+			case SyncAction::Transition:
+				stats.transitions++;
+				break;
+			default:
+				break;
+		}
+	}
+	stats.signals = (uint32_t)signals.size();
+	for (bool redundant : find_redundant_waits(plan)) {
+		stats.redundant_waits += redundant;
+	}
+	return stats;
+}
+
+static const char* action_name(SyncAction action) {
+	switch (action) {
+		case SyncAction::Event:
+			return "event";
+		case SyncAction::Barrier:
+			return "barrier";
+		case SyncAction::Transition:
+			return "transition";
+		default:
+			return "none";
+	}
+}
+
+static std::string escape(const std::string& str) {
+	std::string res;
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			res += '\\';
+		}
+		res += c;
+	}
+	return res;
+}
+
+std::string sync_plan_to_json(const SyncPlan& plan) {
+	const SyncPlanStats stats = sync_plan_stats(plan);
+	const std::vector<bool> redundant = find_redundant_waits(plan);
+	std::ostringstream out;
+	out << "{\n  \"passes\": [";
+	for (size_t i = 0; i < plan.pass_names.size(); i++) {
+		out << (i ? ", " : "") << '"' << escape(plan.pass_names[i]) << '"';
+	}
+	out << "],\n  \"resources\": [";
+	for (size_t i = 0; i < plan.resource_names.size(); i++) {
+		out << (i ? ", " : "") << '"' << escape(plan.resource_names[i]) << '"';
+	}
+	out << "],\n  \"ops\": [\n";
+	for (size_t i = 0; i < plan.ops.size(); i++) {
+		const SyncOp& op = plan.ops[i];
+		out << "    {\"action\": \"" << action_name(op.action) << "\", \"resource\": " << op.resource
+			<< ", \"src_pass\": " << op.src_pass << ", \"dst_pass\": " << op.dst_pass
+			<< ", \"src_access\": " << op.src_access_flags << ", \"dst_access\": " << op.dst_access_flags
+			<< ", \"old_layout\": " << op.old_layout << ", \"new_layout\": " << op.new_layout
+			<< ", \"redundant\": " << (redundant[i] ? "true" : "false") << "}" << (i + 1 < plan.ops.size() ? "," : "")
+			<< "\n";
+	}
+	out << "  ],\n  \"stats\": {\"events\": " << stats.events << ", \"signals\": " << stats.signals
+		<< ", \"barriers\": " << stats.barriers << ", \"transitions\": " << stats.transitions
+		<< ", \"redundant_waits\": " << stats.redundant_waits << "}\n}\n";
+	return out.str();
+}
+
+std::string sync_plan_to_dot(const SyncPlan& plan) {
+	const std::vector<bool> redundant = find_redundant_waits(plan);
+	std::vector<uint32_t> local_ops(plan.pass_names.size());
+	for (const SyncOp& op : plan.ops) {
+		if (op.action == SyncAction::Barrier || op.action == SyncAction::Transition) {
+			local_ops[op.dst_pass]++;
+		}
+	}
+	std::ostringstream out;
+	out << "digraph sync_plan {\n  node [shape=box];\n";
+	for (size_t i = 0; i < plan.pass_names.size(); i++) {
+		out << "  p" << i << " [label=\"" << i << ": " << escape(plan.pass_names[i]);
+		if (local_ops[i]) {
+			out << "\\n" << local_ops[i] << " barrier(s)";
+		}
+		out << "\"];\n";
+	}
+	for (size_t i = 0; i < plan.ops.size(); i++) {
+		const SyncOp& op = plan.ops[i];
+		if (op.action != SyncAction::Event) {
+			continue;
+		}
+		out << "  p" << op.src_pass << " -> p" << op.dst_pass << " [label=\"" << escape(plan.resource_names[op.resource])
+			<< "\"" << (redundant[i] ? ", style=dashed, color=red" : "") << "];\n";
+	}
+	out << "}\n";
+	return out.str();
+}
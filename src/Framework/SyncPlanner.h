@@ -0,0 +1,106 @@
+#pragma once
+// Only the flag and layout types, the planner never calls into Vulkan
+#ifndef VK_NO_PROTOTYPES
+#define VK_NO_PROTOTYPES
+#endif
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+// The dependency decisions of RenderPass::register_dependencies without the render graph objects.
+// These don't touch the device, so a declared pass list can be compiled into a sync plan on the CPU alone.
+
+enum class SyncAction {
+	None,
+	// Signalled by the earlier pass, waited on by the later one (a pipeline barrier without events)
+	Event,
+	// Barrier inside the pass itself
+	Barrier,
+	// Layout transition inside the pass itself
+	Transition
+};
+
+// Previous user of a resource in the current frame
+struct LastAccess {
+	uint32_t pass_idx = 0;
+	VkAccessFlags access_flags = 0;
+	bool submitted = false;
+};
+
+struct BufferDependency {
+	SyncAction action = SyncAction::None;
+	VkAccessFlags src_access_flags = 0;
+	VkAccessFlags dst_access_flags = 0;
+	uint32_t opposing_pass_idx = 0;
+};
+
+struct ImageDependency {
+	SyncAction action = SyncAction::None;
+	VkImageLayout old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkImageLayout new_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	uint32_t opposing_pass_idx = 0;
+};
+
+BufferDependency plan_buffer_dependency(const LastAccess* last, uint32_t pass_idx, VkAccessFlags dst_access_flags);
+ImageDependency plan_image_dependency(const LastAccess* last, VkImageLayout layout, VkImageLayout dst_layout,
+									  bool has_storage_bit, uint32_t pass_idx, uint32_t beginning_pass_idx);
+
+// Declared pass list for the simulation
+struct SimResource {
+	std::string name;
+	bool image = false;
+	// Usage bits the layout selection depends on (see get_target_img_layout)
+	bool storage = true;
+	bool sampled = false;
+	VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+struct SimAccess {
+	uint32_t resource = 0;
+	bool write = false;
+	// Buffers only, derived from write if 0
+	VkAccessFlags access_flags = 0;
+};
+
+struct SimPass {
+	std::string name;
+	std::vector<SimAccess> accesses;
+};
+
+struct SyncOp {
+	SyncAction action = SyncAction::None;
+	uint32_t resource = 0;
+	// Signalling pass for events, equal to dst_pass otherwise
+	uint32_t src_pass = 0;
+	uint32_t dst_pass = 0;
+	VkAccessFlags src_access_flags = 0;
+	VkAccessFlags dst_access_flags = 0;
+	VkImageLayout old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkImageLayout new_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+struct SyncPlan {
+	std::vector<std::string> pass_names;
+	std::vector<std::string> resource_names;
+	std::vector<SyncOp> ops;
+};
+
+struct SyncPlanStats {
+	uint32_t events = 0;
+	// Distinct (pass, resource) signals, several waits can share one
+	uint32_t signals = 0;
+	uint32_t barriers = 0;
+	uint32_t transitions = 0;
+	// Event waits whose signalling pass is already ordered before the waiting pass by a chain of other waits.
+	// Only the execution order is implied, so these are candidates for review rather than certain over-syncs
+	uint32_t redundant_waits = 0;
+};
+
+SyncPlan simulate_sync(std::span<const SimResource> resources, std::span<const SimPass> passes);
+SyncPlanStats sync_plan_stats(const SyncPlan& plan);
+// Per op, whether the op is an event wait that is implied by the other waits
+std::vector<bool> find_redundant_waits(const SyncPlan& plan);
+std::string sync_plan_to_json(const SyncPlan& plan);
+std::string sync_plan_to_dot(const SyncPlan& plan);
@@ -0,0 +1,269 @@
+#include "TLSFAllocator.h"
+#include "Logger.h"
+#include <algorithm>
+#include <bit>
+
+TLSFAllocator::TLSFAllocator(uint64_t size) : total_size(size) {
+	for (auto& heads : free_heads) {
+		heads.fill(INVALID);
+	}
+	if (size) {
+		const uint32_t idx = new_node();
+		nodes[idx].size = size;
+		insert_free(idx);
+	}
+}
+
+void TLSFAllocator::mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+	if (size < SL_COUNT) {
+		fl = 0;
+		sl = (uint32_t)size;
+		return;
+	}
+	const uint32_t msb = 63 - std::countl_zero(size);
+	fl = msb - SL_BITS + 1;
+	sl = (uint32_t)(size >> (msb - SL_BITS)) ^ SL_COUNT;
+}
+
+uint32_t TLSFAllocator::new_node() {
+	if (!unused_nodes.empty()) {
+		const uint32_t idx = unused_nodes.back();
+		unused_nodes.pop_back();
+		nodes[idx] = Node();
+		return idx;
+	}
+	nodes.emplace_back();
+	return (uint32_t)nodes.size() - 1;
+}
+
+void TLSFAllocator::insert_free(uint32_t idx) {
+	Node& node = nodes[idx];
+	uint32_t fl, sl;
+	mapping(node.size, fl, sl);
+	node.free = true;
+	node.prev_free = INVALID;
+	node.next_free = free_heads[fl][sl];
+	if (node.next_free != INVALID) {
+		nodes[node.next_free].prev_free = idx;
+	}
+	free_heads[fl][sl] = idx;
+	fl_bitmap |= 1ull << fl;
+	sl_bitmaps[fl] |= 1u << sl;
+	num_free_ranges++;
+}
+
+void TLSFAllocator::remove_free(uint32_t idx) {
+	Node& node = nodes[idx];
+	uint32_t fl, sl;
+	mapping(node.size, fl, sl);
+	if (node.prev_free != INVALID) {
+		nodes[node.prev_free].next_free = node.next_free;
+	} else {
+		free_heads[fl][sl] = node.next_free;
+		if (node.next_free == INVALID) {
+			sl_bitmaps[fl] &= ~(1u << sl);
+			if (!sl_bitmaps[fl]) {
+				fl_bitmap &= ~(1ull << fl);
+			}
+		}
+	}
+	if (node.next_free != INVALID) {
+		nodes[node.next_free].prev_free = node.prev_free;
+	}
+	node.free = false;
+	node.prev_free = node.next_free = INVALID;
+	num_free_ranges--;
+}
+
+void TLSFAllocator::split(uint32_t idx, uint64_t size) {
+	const uint32_t rest = new_node();
+	// new_node() may have moved the nodes
+	Node& node = nodes[idx];
+	Node& rest_node = nodes[rest];
+	rest_node.offset = node.offset + size;
+	rest_node.size = node.size - size;
+	rest_node.prev_phys = idx;
+	rest_node.next_phys = node.next_phys;
+	if (node.next_phys != INVALID) {
+		nodes[node.next_phys].prev_phys = rest;
+	}
+	node.next_phys = rest;
+	node.size = size;
+	insert_free(rest);
+}
+
+uint32_t TLSFAllocator::find_free(uint64_t size) const {
+	uint32_t fl, sl;
+	mapping(size, fl, sl);
+	if (fl >= FL_COUNT) {
+		return INVALID;
+	}
+	uint32_t sl_map = sl_bitmaps[fl] & (~0u << sl);
+	if (!sl_map) {
+		const uint64_t fl_map = fl + 1 < 64 ? fl_bitmap & (~0ull << (fl + 1)) : 0;
+		if (!fl_map) {
+			return INVALID;
+		}
+		fl = std::countr_zero(fl_map);
+		sl_map = sl_bitmaps[fl];
+	}
+	sl = std::countr_zero(sl_map);
+	return free_heads[fl][sl];
+}
+
+uint32_t TLSFAllocator::find_exact_fit(uint64_t size, uint64_t alignment, uint64_t search_size) const {
+	uint32_t fl, sl, last_fl, last_sl;
+	mapping(size, fl, sl);
+	mapping(std::min(search_size, total_size), last_fl, last_sl);
+	while (fl < last_fl || (fl == last_fl && sl <= last_sl)) {
+		if (sl_bitmaps[fl] & (1u << sl)) {
+			for (uint32_t idx = free_heads[fl][sl]; idx != INVALID; idx = nodes[idx].next_free) {
+				const uint64_t padding = (alignment - nodes[idx].offset % alignment) % alignment;
+				if (nodes[idx].size >= size + padding) {
+					return idx;
+				}
+			}
+		}
+		if (++sl == SL_COUNT) {
+			sl = 0;
+			fl++;
+		}
+	}
+	return INVALID;
+}
+
+uint32_t TLSFAllocator::allocate(uint64_t size, uint64_t alignment) {
+	if (!size || size > total_size) {
+		return INVALID;
+	}
+	alignment = std::max<uint64_t>(alignment, 1);
+	// Search for a bin whose every range fits the request at any alignment
+	uint64_t search_size = size + alignment - 1;
+	if (search_size >= SL_COUNT) {
+		const uint32_t msb = 63 - std::countl_zero(search_size);
+		search_size += (1ull << (msb - SL_BITS)) - 1;
+	}
+	uint32_t idx = find_free(search_size);
+	if (idx == INVALID) {
+		// The bins skipped by the rounding can still hold a range that fits exactly, e.g. a full block
+		idx = find_exact_fit(size, alignment, search_size);
+		if (idx == INVALID) {
+			return INVALID;
+		}
+	}
+	remove_free(idx);
+
+	// Alignment padding becomes a free range of its own
+	const uint64_t padding = (alignment - nodes[idx].offset % alignment) % alignment;
+	if (padding) {
+		split(idx, padding);
+		const uint32_t aligned = nodes[idx].next_phys;
+		remove_free(aligned);
+		// The padding can't touch another free range, its previous neighbour was already allocated or merged
+		insert_free(idx);
+		idx = aligned;
+	}
+	if (nodes[idx].size > size) {
+		split(idx, size);
+	}
+	used_size += size;
+	num_allocations++;
+	return idx;
+}
+
+void TLSFAllocator::free(uint32_t handle) {
+	LUMEN_ASSERT(handle < nodes.size() && !nodes[handle].free, "Invalid TLSF allocation");
+	used_size -= nodes[handle].size;
+	num_allocations--;
+	uint32_t idx = handle;
+	const uint32_t prev = nodes[idx].prev_phys;
+	if (prev != INVALID && nodes[prev].free) {
+		remove_free(prev);
+		nodes[prev].size += nodes[idx].size;
+		nodes[prev].next_phys = nodes[idx].next_phys;
+		if (nodes[idx].next_phys != INVALID) {
+			nodes[nodes[idx].next_phys].prev_phys = prev;
+		}
+		unused_nodes.push_back(idx);
+		idx = prev;
+	}
+	const uint32_t next = nodes[idx].next_phys;
+	if (next != INVALID && nodes[next].free) {
+		remove_free(next);
+		nodes[idx].size += nodes[next].size;
+		nodes[idx].next_phys = nodes[next].next_phys;
+		if (nodes[next].next_phys != INVALID) {
+			nodes[nodes[next].next_phys].prev_phys = idx;
+		}
+		unused_nodes.push_back(next);
+	}
+	insert_free(idx);
+}
+
+uint64_t TLSFAllocator::largest_free_range() const {
+	if (!fl_bitmap) {
+		return 0;
+	}
+	// Only the highest non-empty bin can hold the largest range, its list is searched
+	const uint32_t fl = 63 - std::countl_zero(fl_bitmap);
+	const uint32_t sl = 31 - std::countl_zero(sl_bitmaps[fl]);
+	uint64_t largest = 0;
+	for (uint32_t idx = free_heads[fl][sl]; idx != INVALID; idx = nodes[idx].next_free) {
+		largest = std::max(largest, nodes[idx].size);
+	}
+	return largest;
+}
+
+bool TLSFAllocator::validate() const {
+	if (!total_size) {
+		return nodes.empty();
+	}
+	// The first range is the one without a physical predecessor that isn't recycled
+	std::vector<bool> unused(nodes.size(), false);
+	for (uint32_t idx : unused_nodes) {
+		unused[idx] = true;
+	}
+	uint32_t first = INVALID;
+	for (uint32_t i = 0; i < nodes.size(); i++) {
+		if (!unused[i] && nodes[i].prev_phys == INVALID) {
+			if (first != INVALID) {
+				return false;
+			}
+			first = i;
+		}
+	}
+	uint64_t offset = 0;
+	uint64_t used = 0;
+	uint32_t allocations = 0;
+	uint32_t free_ranges = 0;
+	bool prev_free = false;
+	for (uint32_t idx = first; idx != INVALID; idx = nodes[idx].next_phys) {
+		const Node& node = nodes[idx];
+		if (node.offset != offset || !node.size || (node.free && prev_free)) {
+			return false;
+		}
+		if (node.next_phys != INVALID && nodes[node.next_phys].prev_phys != idx) {
+			return false;
+		}
+		if (node.free) {
+			// Has to be reachable from its bin
+			uint32_t fl, sl;
+			mapping(node.size, fl, sl);
+			uint32_t it = free_heads[fl][sl];
+			while (it != INVALID && it != idx) {
+				it = nodes[it].next_free;
+			}
+			if (it == INVALID) {
+				return false;
+			}
+			free_ranges++;
+		} else {
+			used += node.size;
+			allocations++;
+		}
+		prev_free = node.free;
+		offset += node.size;
+	}
+	return offset == total_size && used == used_size && allocations == num_allocations &&
+		   free_ranges == num_free_ranges;
+}
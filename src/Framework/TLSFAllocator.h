@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/*
+	Two-level segregated fit placement of ranges inside a fixed size block, O(1) allocation and free.
+	Free ranges are binned by the position of their highest bit and SL_BITS bits below it, a bitmap per level
+	finds the first non-empty bin that is guaranteed to fit. Freed ranges are merged with their free neighbours.
+	This is independent of Vulkan so that it can be exercised without a device, see DeviceMemoryAllocator.
+*/
+class TLSFAllocator {
+   public:
+	static constexpr uint32_t INVALID = UINT32_MAX;
+
+	explicit TLSFAllocator(uint64_t size = 0);
+	// Returns a handle for offset() and free(), INVALID if no free range fits
+	uint32_t allocate(uint64_t size, uint64_t alignment = 1);
+	void free(uint32_t handle);
+	uint64_t offset(uint32_t handle) const { return nodes[handle].offset; }
+	uint64_t allocation_size(uint32_t handle) const { return nodes[handle].size; }
+
+	uint64_t size() const { return total_size; }
+	uint64_t used() const { return used_size; }
+	uint32_t allocation_count() const { return num_allocations; }
+	uint32_t free_range_count() const { return num_free_ranges; }
+	uint64_t largest_free_range() const;
+	bool empty() const { return num_allocations == 0; }
+	// Walks the ranges and checks that they tile the block, are binned correctly and that no two free ranges touch
+	bool validate() const;
+
+   private:
+	static constexpr uint32_t SL_BITS = 4;
+	static constexpr uint32_t SL_COUNT = 1 << SL_BITS;
+	static constexpr uint32_t FL_COUNT = 64 - SL_BITS + 1;
+
+	struct Node {
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint32_t prev_phys = INVALID;
+		uint32_t next_phys = INVALID;
+		uint32_t prev_free = INVALID;
+		uint32_t next_free = INVALID;
+		bool free = false;
+	};
+
+	static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+	// Head of the first non-empty bin whose ranges are all at least size
+	uint32_t find_free(uint64_t size) const;
+	// Linear search of the bins between size and search_size for a range that fits with its alignment padding
+	uint32_t find_exact_fit(uint64_t size, uint64_t alignment, uint64_t search_size) const;
+	uint32_t new_node();
+	void insert_free(uint32_t idx);
+	void remove_free(uint32_t idx);
+	// Splits size bytes off the front of idx, the remainder becomes a new free range
+	void split(uint32_t idx, uint64_t size);
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> unused_nodes;
+	uint64_t fl_bitmap = 0;
+	std::array<uint32_t, FL_COUNT> sl_bitmaps = {};
+	std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> free_heads;
+	uint64_t total_size = 0;
+	uint64_t used_size = 0;
+	uint32_t num_allocations = 0;
+	uint32_t num_free_ranges = 0;
+};
@@ -0,0 +1,112 @@
+#include "TaskGraph.h"
+#include "Logger.h"
+#include <algorithm>
+
+TaskGraph::NodeId TaskGraph::add(const std::string& name, std::function<void()> fn,
+								 std::initializer_list<NodeId> deps, bool main_thread) {
+	const NodeId id = (NodeId)nodes.size();
+	Node& node = nodes.emplace_back();
+	node.name = name;
+	node.fn = std::move(fn);
+	node.main_thread = main_thread;
+	for (NodeId dep : deps) {
+		LUMEN_ASSERT(dep < id, "TaskGraph dependencies have to be added before their dependents");
+		nodes[dep].successors.push_back(id);
+		node.num_deps++;
+	}
+	return id;
+}
+
+double TaskGraph::elapsed_ms() const {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void TaskGraph::launch(NodeId id) {
+	// Nothing new starts after a failure
+	if (failed) {
+		return;
+	}
+	if (nodes[id].main_thread) {
+		std::lock_guard<std::mutex> lock(main_queue_mutex);
+		main_queue.push_back(id);
+		return;
+	}
+	group->run(nodes[id].name, [this, id] {
+		Node& node = nodes[id];
+		node.start_ms = elapsed_ms();
+		try {
+			node.fn();
+		} catch (...) {
+			// The dependents never start, run() stops waiting and rethrows
+			failed = true;
+			throw;
+		}
+		node.end_ms = elapsed_ms();
+		finish(id);
+	});
+}
+
+void TaskGraph::finish(NodeId id) {
+	for (NodeId succ : nodes[id].successors) {
+		if (nodes[succ].remaining_deps.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			launch(succ);
+		}
+	}
+	num_finished.fetch_add(1, std::memory_order_release);
+}
+
+void TaskGraph::run() {
+	TaskGroup pool_nodes;
+	group = &pool_nodes;
+	start_time = std::chrono::steady_clock::now();
+	num_finished = 0;
+	failed = false;
+	for (Node& node : nodes) {
+		node.remaining_deps = node.num_deps;
+	}
+	for (NodeId id = 0; id < nodes.size(); id++) {
+		if (!nodes[id].num_deps) {
+			launch(id);
+		}
+	}
+	while (num_finished.load(std::memory_order_acquire) < nodes.size() && !failed) {
+		NodeId id = UINT32_MAX;
+		{
+			std::lock_guard<std::mutex> lock(main_queue_mutex);
+			if (!main_queue.empty()) {
+				id = main_queue.front();
+				main_queue.erase(main_queue.begin());
+			}
+		}
+		if (id != UINT32_MAX) {
+			Node& node = nodes[id];
+			node.start_ms = elapsed_ms();
+			try {
+				node.fn();
+			} catch (...) {
+				// The pool nodes still reference the graph, let them finish before unwinding
+				failed = true;
+				try {
+					pool_nodes.wait();
+				} catch (...) {
+				}
+				group = nullptr;
+				throw;
+			}
+			node.end_ms = elapsed_ms();
+			finish(id);
+		} else if (!ThreadPool::run_pending_task()) {
+			std::this_thread::yield();
+		}
+	}
+	pool_nodes.wait();
+	group = nullptr;
+}
+
+void TaskGraph::log_timings() const {
+#ifdef _DEBUG
+	for (const Node& node : nodes) {
+		LUMEN_TRACE("{}: {:.1f} - {:.1f} ms", node.name, node.start_ms, node.end_ms);
+	}
+#endif
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "ThreadPool.h"
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+/*
+	One-shot dependency graph of jobs, used to overlap the independent parts of startup.
+	Nodes start as soon as their dependencies are done. Nodes marked main_thread (anything that records or submits
+	Vulkan work, or talks to the window) run on the thread that calls run(), in the order they become ready; the
+	rest run on the ThreadPool.
+*/
+class TaskGraph {
+   public:
+	using NodeId = uint32_t;
+	NodeId add(const std::string& name, std::function<void()> fn, std::initializer_list<NodeId> deps = {},
+			   bool main_thread = false);
+	// Blocks until every node ran, rethrows the first exception of a node. After a failure on the main thread
+	// the pool nodes that already started are waited on first
+	void run();
+	// Per node timings of the last run, relative to its start. Debug builds only, at trace level
+	void log_timings() const;
+
+   private:
+	struct Node {
+		std::string name;
+		std::function<void()> fn;
+		std::vector<NodeId> successors;
+		uint32_t num_deps = 0;
+		std::atomic<uint32_t> remaining_deps = 0;
+		bool main_thread = false;
+		double start_ms = 0;
+		double end_ms = 0;
+	};
+	void finish(NodeId id);
+	void launch(NodeId id);
+	double elapsed_ms() const;
+
+	std::deque<Node> nodes;
+	TaskGroup* group = nullptr;
+	std::mutex main_queue_mutex;
+	std::vector<NodeId> main_queue;
+	std::atomic<uint32_t> num_finished = 0;
+	std::atomic_bool failed = false;
+	std::chrono::steady_clock::time_point start_time;
+};
@@ -2,6 +2,8 @@
 #include "Texture.h"
 #include "CommandBuffer.h"
 #include "VkUtils.h"
+#include "BindlessHeap.h"
+#include "UploadContext.h"
 #include <gli/gli.hpp>
 #include <stb_image/stb_image.h>
 
@@ -91,11 +93,6 @@ void Texture2D::load_from_data(VulkanContext* ctx, void* data, VkDeviceSize size
 	this->ctx = ctx;
 	aspect_flags = VK_IMAGE_ASPECT_COLOR_BIT;
 	usage_flags = flags;
-	Buffer staging_buffer;
-	staging_buffer.create(ctx, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-						  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-						  VK_SHARING_MODE_EXCLUSIVE, size, data);
-
 	// Need to do this check pre image creation
 	if (generate_mipmaps) {
 		usage_flags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
@@ -113,7 +110,7 @@ void Texture2D::load_from_data(VulkanContext* ctx, void* data, VkDeviceSize size
 
 	VkBufferImageCopy region{};
 
-	region.bufferOffset = 0;
+
 	region.bufferRowLength = 0;
 	region.bufferImageHeight = 0;
 	region.imageSubresource.aspectMask = aspect_flags;
@@ -123,26 +120,28 @@ void Texture2D::load_from_data(VulkanContext* ctx, void* data, VkDeviceSize size
 	region.imageExtent.width = info.extent.width;
 	region.imageExtent.height = info.extent.height;
 	region.imageExtent.depth = 1;
-	CommandBuffer copy_cmd(ctx, true);
-	transition_image_layout(copy_cmd.handle, img, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-							subresource_range, aspect_flags);
-
-	vkCmdCopyBufferToImage(copy_cmd.handle, staging_buffer.handle, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-						   &region);
-
-	if (generate_mipmaps) {
-		cmd_generate_mipmaps(info, copy_cmd.handle);
-	} else {
-		transition_image_layout(copy_cmd.handle, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-								VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, aspect_flags);
-	}
-	copy_cmd.submit();
-	staging_buffer.destroy();
+	// 16 byte staging alignment is a multiple of every texel size used here
+	ctx->uploader->upload(data, size, 16, [&](VkCommandBuffer cmd, VkBuffer src, VkDeviceSize src_offset) {
+		transition_image_layout(cmd, img, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+								subresource_range, aspect_flags);
+		region.bufferOffset = src_offset;
+		vkCmdCopyBufferToImage(cmd, src, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		if (generate_mipmaps) {
+			cmd_generate_mipmaps(info, cmd);
+		} else {
+			transition_image_layout(cmd, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+									VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresource_range, aspect_flags);
+		}
+	});
 	img_view = create_image_view(ctx->device, img, info.format);
 	this->sampler = a_sampler;
 
 	layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	base_extent = info.extent;
+	// Loaded textures stay read only, so they can be sampled through the heap
+	if (ctx->bindless && sampler) {
+		bindless_idx = ctx->bindless->add(img_view, sampler, layout);
+	}
 }
 
 void Texture2D::create_empty_texture(const char* name, VulkanContext* ctx, const TextureSettings& settings,
@@ -165,29 +164,7 @@ void Texture2D::create_empty_texture(const char* name, VulkanContext* ctx, const
 	}
 	// Create a default sampler
 	if (!in_sampler) {
-		sampler_allocated = true;
-		VkSamplerCreateInfo sampler_CI = vk::sampler_create_info();
-		sampler_CI.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		sampler_CI.magFilter = VK_FILTER_LINEAR;
-		sampler_CI.minFilter = VK_FILTER_LINEAR;
-		sampler_CI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		sampler_CI.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		sampler_CI.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		sampler_CI.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		sampler_CI.mipLodBias = 0.0f;
-		sampler_CI.compareOp = VK_COMPARE_OP_NEVER;
-		sampler_CI.minLod = 0.0f;
-		sampler_CI.maxLod = (float)settings.mip_levels;
-		sampler_CI.anisotropyEnable = ctx->supported_features.samplerAnisotropy;
-		sampler_CI.maxAnisotropy =
-			ctx->supported_features.samplerAnisotropy ? ctx->device_properties.limits.maxSamplerAnisotropy : 1.0f;
-		sampler_CI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		vk::check(vkCreateSampler(ctx->device, &sampler_CI, nullptr, &sampler), "Could not create image sampler");
-		if (name) {
-			std::string sampler_name = std::string("Sampler: ") + std::string(name);
-			DebugMarker::set_resource_name(ctx->device, (uint64_t)sampler, sampler_name.c_str(),
-										   VK_OBJECT_TYPE_SAMPLER);
-		}
+		create_default_sampler(name, settings);
 	} else {
 		sampler = in_sampler;
 	}
@@ -205,6 +182,71 @@ void Texture2D::create_empty_texture(const char* name, VulkanContext* ctx, const
 	base_extent = settings.base_extent;
 }
 
+void Texture2D::create_unbound(const char* name, VulkanContext* ctx, const TextureSettings& settings,
+							   VkSampler in_sampler /* 0*/, VkImageAspectFlags flags /*=VK_IMAGE_ASPECT_COLOR_BIT*/) {
+	this->ctx = ctx;
+	auto image_CI = vk::image_create_info(settings.format, settings.usage_flags, settings.base_extent);
+	image_CI.imageType = settings.image_type;
+	image_CI.mipLevels = settings.mip_levels;
+	image_CI.arrayLayers = settings.array_layers;
+	image_CI.tiling = settings.tiling;
+	image_CI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	image_CI.samples = settings.sample_count;
+	image_CI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	vk::check(vkCreateImage(ctx->device, &image_CI, nullptr, &img), "Failed to create image");
+	img_mem = VK_NULL_HANDLE;
+	img_view = VK_NULL_HANDLE;
+	memory_aliased = true;
+	format = settings.format;
+	mip_levels = settings.mip_levels;
+	aspect_flags = flags;
+	usage_flags = settings.usage_flags;
+	present = settings.present;
+	layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	base_extent = settings.base_extent;
+	if (name) {
+		DebugMarker::set_resource_name(ctx->device, (uint64_t)img, name, VK_OBJECT_TYPE_IMAGE);
+		this->name = name;
+	}
+	sampler_allocated = false;
+	if (!in_sampler) {
+		create_default_sampler(name, settings);
+	} else {
+		sampler = in_sampler;
+	}
+}
+
+void Texture2D::bind_memory(VkDeviceMemory memory, VkDeviceSize offset) {
+	vk::check(vkBindImageMemory(ctx->device, img, memory, offset), "Failed to bind image memory");
+	img_view = create_image_view(ctx->device, img, format, aspect_flags);
+}
+
+void Texture2D::create_default_sampler(const char* name, const TextureSettings& settings) {
+	sampler_allocated = true;
+	VkSamplerCreateInfo sampler_CI = vk::sampler_create_info();
+	sampler_CI.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_CI.magFilter = VK_FILTER_LINEAR;
+	sampler_CI.minFilter = VK_FILTER_LINEAR;
+	sampler_CI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	sampler_CI.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_CI.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_CI.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_CI.mipLodBias = 0.0f;
+	sampler_CI.compareOp = VK_COMPARE_OP_NEVER;
+	sampler_CI.minLod = 0.0f;
+	sampler_CI.maxLod = (float)settings.mip_levels;
+	sampler_CI.anisotropyEnable = ctx->supported_features.samplerAnisotropy;
+	sampler_CI.maxAnisotropy =
+		ctx->supported_features.samplerAnisotropy ? ctx->device_properties.limits.maxSamplerAnisotropy : 1.0f;
+	sampler_CI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	vk::check(vkCreateSampler(ctx->device, &sampler_CI, nullptr, &sampler), "Could not create image sampler");
+	if (name) {
+		std::string sampler_name = std::string("Sampler: ") + std::string(name);
+		DebugMarker::set_resource_name(ctx->device, (uint64_t)sampler, sampler_name.c_str(),
+									   VK_OBJECT_TYPE_SAMPLER);
+	}
+}
+
 Texture::Texture(VulkanContext* ctx) : ctx(ctx) {}
 
 void Texture::create_image(const VkImageCreateInfo& info) {
@@ -212,13 +254,11 @@ void Texture::create_image(const VkImageCreateInfo& info) {
 
 	VkMemoryRequirements mem_req;
 	vkGetImageMemoryRequirements(ctx->device, img, &mem_req);
-	auto alloc_info = vk::memory_allocate_info();
-	alloc_info.allocationSize = mem_req.size;
-	alloc_info.memoryTypeIndex =
-		find_memory_type(&ctx->physical_device, mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	vk::check(vkAllocateMemory(ctx->device, &alloc_info, nullptr, &img_mem), "Failed to allocate image memory");
-	vkBindImageMemory(ctx->device, img, img_mem, 0);
+	allocation = ctx->allocator->allocate(
+		mem_req, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		info.tiling == VK_IMAGE_TILING_LINEAR ? AllocationKind::Linear : AllocationKind::Optimal);
+	img_mem = allocation.memory;
+	vkBindImageMemory(ctx->device, img, img_mem, allocation.offset);
 	base_extent = info.extent;
 }
 
@@ -267,12 +307,20 @@ void Texture::cmd_generate_mipmaps(const VkImageCreateInfo& info, VkCommandBuffe
 }
 
 void Texture::destroy() {
+	if (bindless_idx != UINT32_MAX) {
+		ctx->bindless->remove(bindless_idx);
+		bindless_idx = UINT32_MAX;
+	}
 	if (sampler_allocated) {
 		vkDestroySampler(ctx->device, sampler, nullptr);
 	}
 	vkDestroyImageView(ctx->device, img_view, nullptr);
 	if (img_mem) {
 		vkDestroyImage(ctx->device, img, nullptr);
-		vkFreeMemory(ctx->device, img_mem, nullptr);
+		ctx->allocator->free(allocation);
+		img_mem = VK_NULL_HANDLE;
+	} else if (memory_aliased) {
+		vkDestroyImage(ctx->device, img, nullptr);
+		memory_aliased = false;
 	}
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include "../LumenPCH.h"
+#include "ResourceRegistry.h"
+#include "DeviceMemoryAllocator.h"
 
 struct TextureSettings {
 	VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
@@ -24,7 +26,9 @@ class Texture {
 	inline void set_context(VulkanContext* ctx) { this->ctx = ctx; }
 	VkImage img = VK_NULL_HANDLE;
 	VkImageView img_view = VK_NULL_HANDLE;
+	// allocation.memory, VK_NULL_HANDLE for aliased memory
 	VkDeviceMemory img_mem = VK_NULL_HANDLE;
+	MemoryAllocation allocation;
 	VkSampler sampler = VK_NULL_HANDLE;
 	VulkanContext* ctx;
 
@@ -39,8 +43,14 @@ class Texture {
 	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
 	bool sampler_allocated = false;
 	bool present = false;
+	// Memory is owned by someone else (e.g. a transient heap of the render graph)
+	bool memory_aliased = false;
 	VkImageAspectFlags aspect_flags;
 	std::string name = "";
+	// Id in the render graph
+	ResourceHandle rg_handle;
+	// Slot in the BindlessHeap, UINT32_MAX if the texture isn't in it
+	uint32_t bindless_idx = UINT32_MAX;
 
    protected:
 	void create_image(const VkImageCreateInfo& info);
@@ -64,6 +74,11 @@ class Texture2D : public Texture {
 		return create_empty_texture("", ctx, settings, img_layout, sampler, flags);
 	}
 
+	// Creates the image without any backing memory, see bind_memory()
+	void create_unbound(const char* name, VulkanContext* ctx, const TextureSettings& settings, VkSampler = 0,
+						VkImageAspectFlags flags = VK_IMAGE_ASPECT_COLOR_BIT);
+	void bind_memory(VkDeviceMemory memory, VkDeviceSize offset);
+
 	void transition(VkCommandBuffer cmd, VkImageLayout new_layout);
 	void force_transition(VkCommandBuffer cmd, VkImageLayout old_layout, VkImageLayout new_layout);
 	void transition_without_state(VkCommandBuffer cmd, VkImageLayout new_layout);
@@ -73,4 +88,5 @@ class Texture2D : public Texture {
 	VkDescriptorImageInfo descriptor() const;
 
    private:
+	void create_default_sampler(const char* name, const TextureSettings& settings);
 };
@@ -1,31 +1,210 @@
-#include "../LumenPCH.h"
 #include "ThreadPool.h"
+#include "ChromeTrace.h"
+#include "Logger.h"
+#include <chrono>
+#include <cmath>
 std::atomic_bool ThreadPool::done;
-std::queue<std::function<void()>> ThreadPool::work_queue;
-std::mutex ThreadPool::queue_mutex;
+std::vector<std::unique_ptr<WorkStealingDeque>> ThreadPool::deques;
+std::vector<Task*> ThreadPool::global_queue;
+size_t ThreadPool::global_head = 0;
+std::mutex ThreadPool::global_mutex;
+std::atomic<uint32_t> ThreadPool::global_size;
+std::atomic<int32_t> ThreadPool::num_queued;
+std::atomic<uint32_t> ThreadPool::num_sleeping;
+std::mutex ThreadPool::sleep_mutex;
 std::condition_variable ThreadPool::cv;
 std::vector<std::thread> ThreadPool::threads;
-void ThreadPool::init() {
-	uint32_t thread_count = std::thread::hardware_concurrency();
+thread_local int32_t ThreadPool::worker_idx = -1;
+std::atomic_bool ThreadPool::profiling_enabled;
+std::atomic<int32_t> ThreadPool::peak_queued;
+std::vector<std::unique_ptr<ThreadPool::WorkerProfile>> ThreadPool::profiles;
+
+// Written by the owning worker, read by stats() from any thread
+struct ThreadPool::WorkerProfile {
+	static constexpr size_t MAX_TRACE_EVENTS = 1 << 16;
+	std::atomic<uint64_t> tasks_executed = 0;
+	std::atomic<uint64_t> busy_ns = 0;
+	std::atomic<uint64_t> idle_ns = 0;
+	// Start of the current stretch without work, negative while busy
+	std::atomic<double> idle_since_us = -1.0;
+	std::array<std::atomic<uint64_t>, ThreadPoolStats::LATENCY_BUCKETS> wait_histogram = {};
+	std::mutex trace_mutex;
+	std::vector<TraceEvent> trace;
+	uint64_t dropped_events = 0;
+};
+
+static const auto profile_epoch = std::chrono::steady_clock::now();
+static double now_us() {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - profile_epoch).count();
+}
+
+namespace {
+constexpr size_t MAX_FREE_TASKS = 32;
+constexpr size_t MAX_SHARED_FREE_TASKS = 1024;
+// Fixed size, so that neither the free lists nor their first use on a thread allocate
+template <size_t Capacity>
+struct TaskFreeList {
+	std::array<Task*, Capacity> tasks;
+	size_t size = 0;
+	~TaskFreeList() {
+		for (size_t i = 0; i < size; i++) {
+			delete tasks[i];
+		}
+	}
+	template <size_t OtherCapacity>
+	void move_to(TaskFreeList<OtherCapacity>& other, size_t count) {
+		count = std::min({count, size, OtherCapacity - other.size});
+		std::copy(tasks.begin() + (size - count), tasks.begin() + size, other.tasks.begin() + other.size);
+		size -= count;
+		other.size += count;
+	}
+};
+thread_local TaskFreeList<MAX_FREE_TASKS> free_list;
+// Tasks created on one thread are mostly released on the workers, full free lists hand half of their tasks over
+// to the threads that ran dry
+TaskFreeList<MAX_SHARED_FREE_TASKS> shared_free_list;
+std::mutex shared_free_mutex;
+}  // namespace
+
+Task* Task::allocate() {
+	if (free_list.size == 0) {
+		std::lock_guard<std::mutex> lock(shared_free_mutex);
+		shared_free_list.move_to(free_list, MAX_FREE_TASKS / 2);
+	}
+	if (free_list.size == 0) {
+		return new Task();
+	}
+	return free_list.tasks[--free_list.size];
+}
+
+void Task::release(Task* task) {
+	if (free_list.size == MAX_FREE_TASKS) {
+		std::lock_guard<std::mutex> lock(shared_free_mutex);
+		free_list.move_to(shared_free_list, MAX_FREE_TASKS / 2);
+	}
+	if (free_list.size < MAX_FREE_TASKS) {
+		free_list.tasks[free_list.size++] = task;
+	} else {
+		delete task;
+	}
+}
+
+void Task::stock(uint32_t thread_count) {
+	// Every thread can hold on to a free list that is just short of spilling, plus one list worth in flight
+	const size_t count = std::min(size_t(thread_count + 2) * MAX_FREE_TASKS, MAX_SHARED_FREE_TASKS);
+	std::lock_guard<std::mutex> lock(shared_free_mutex);
+	while (shared_free_list.size < count) {
+		shared_free_list.tasks[shared_free_list.size++] = new Task();
+	}
+}
+
+void Task::run() {
+	invoke(this);
+	destroy(this);
+	release(this);
+}
+
+WorkStealingDeque::WorkStealingDeque(int64_t capacity) {
+	arrays.push_back(std::make_unique<Array>(capacity));
+	array.store(arrays.back().get(), std::memory_order_relaxed);
+}
+
+void WorkStealingDeque::push(Task* task) {
+	const int64_t b = bottom.load(std::memory_order_relaxed);
+	const int64_t t = top.load(std::memory_order_acquire);
+	Array* a = array.load(std::memory_order_relaxed);
+	if (b - t > a->capacity - 1) {
+		auto grown = std::make_unique<Array>(2 * a->capacity);
+		for (int64_t i = t; i < b; i++) {
+			grown->put(i, a->get(i));
+		}
+		a = grown.get();
+		arrays.push_back(std::move(grown));
+		array.store(a, std::memory_order_release);
+	}
+	a->put(b, task);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+Task* WorkStealingDeque::pop() {
+	const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	Array* a = array.load(std::memory_order_relaxed);
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+	if (t > b) {
+		// Empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	Task* task = a->get(b);
+	if (t == b) {
+		// Last element, race the thieves for it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			task = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return task;
+}
+
+Task* WorkStealingDeque::steal() {
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b) {
+		return nullptr;
+	}
+	Array* a = array.load(std::memory_order_acquire);
+	Task* task = a->get(t);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return nullptr;
+	}
+	return task;
+}
+
+TaskGroup::~TaskGroup() { wait_pending(); }
+
+void TaskGroup::wait_pending() {
+	while (pending.load(std::memory_order_acquire)) {
+		if (!ThreadPool::run_pending_task()) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void TaskGroup::wait() {
+	wait_pending();
+	std::exception_ptr ex;
+	{
+		std::lock_guard<std::mutex> lock(exception_mutex);
+		std::swap(ex, exception);
+	}
+	if (ex) {
+		std::rethrow_exception(ex);
+	}
+}
+
+void ThreadPool::init(uint32_t thread_count) {
+	if (thread_count == 0) {
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
 	done = false;
 	try {
+		deques.reserve(thread_count);
+		for (uint32_t i = 0; i < thread_count; i++) {
+			deques.push_back(std::make_unique<WorkStealingDeque>());
+		}
+		for (uint32_t i = 0; i <= thread_count; i++) {
+			profiles.push_back(std::make_unique<WorkerProfile>());
+		}
+		// The worker and the calling threads exchange the tasks, so the first frames would allocate until the free
+		// lists settle
+		Task::stock(thread_count);
 		threads.reserve(thread_count);
 		for (uint32_t i = 0; i < thread_count; i++) {
-			threads.emplace_back([] {
-				while (true) {
-					std::function<void()> task;
-					{
-						std::unique_lock<std::mutex> lock(queue_mutex);
-						cv.wait(lock, [] { return !work_queue.empty() || done; });
-						if (done && work_queue.empty()) {
-							break;
-						}
-						task = std::move(work_queue.front());
-						work_queue.pop();
-					}
-					task();
-				}
-			});
+			threads.emplace_back(worker_loop, i);
 		}
 	} catch (const std::exception& ex) {
 		LUMEN_ERROR(ex.what());
@@ -33,9 +212,242 @@ void ThreadPool::init() {
 }
 
 void ThreadPool::destroy() {
-	done = true;
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		done = true;
+	}
 	cv.notify_all();
 	for (auto& thread : threads) {
 		thread.join();
 	}
+	threads.clear();
+	deques.clear();
+	profiles.clear();
+}
+
+void ThreadPool::enqueue(Task* task, std::string_view name) {
+	if (done) {
+		LUMEN_ERROR("ThreadPool has been terminated");
+	}
+	const bool profile = profiling();
+	if (profile) {
+		task->name.assign(name.empty() ? std::string_view("task") : name);
+		task->enqueue_us = now_us();
+	}
+	if (worker_idx >= 0) {
+		deques[worker_idx]->push(task);
+	} else {
+		std::lock_guard<std::mutex> lock(global_mutex);
+		const size_t size = global_size.load(std::memory_order_relaxed);
+		if (size == global_queue.size()) {
+			std::vector<Task*> grown(std::max<size_t>(64, 2 * size));
+			for (size_t i = 0; i < size; i++) {
+				grown[i] = global_queue[(global_head + i) % size];
+			}
+			global_queue = std::move(grown);
+			global_head = 0;
+		}
+		global_queue[(global_head + size) % global_queue.size()] = task;
+		global_size.fetch_add(1, std::memory_order_relaxed);
+	}
+	// Pairs with the sleeping worker checking num_queued after announcing itself
+	const int32_t depth = num_queued.fetch_add(1) + 1;
+	if (profile) {
+		int32_t peak = peak_queued.load(std::memory_order_relaxed);
+		while (depth > peak && !peak_queued.compare_exchange_weak(peak, depth, std::memory_order_relaxed)) {
+		}
+	}
+	if (num_sleeping.load() > 0) {
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		cv.notify_one();
+	}
+}
+
+Task* ThreadPool::take_task() {
+	Task* task = nullptr;
+	if (worker_idx >= 0) {
+		task = deques[worker_idx]->pop();
+	}
+	if (!task && global_size.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(global_mutex);
+		if (global_size.load(std::memory_order_relaxed)) {
+			task = global_queue[global_head];
+			global_head = (global_head + 1) % global_queue.size();
+			global_size.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+	if (!task && !deques.empty()) {
+		// Start at a different victim on each attempt so that thieves spread out
+		static thread_local uint32_t rng = 0x9e3779b9u ^ (uint32_t)std::hash<std::thread::id>{}(std::this_thread::get_id());
+		rng ^= rng << 13;
+		rng ^= rng >> 17;
+		rng ^= rng << 5;
+		const uint32_t count = (uint32_t)deques.size();
+		for (uint32_t i = 0; i < count && !task; i++) {
+			const uint32_t victim = (rng + i) % count;
+			if ((int32_t)victim != worker_idx) {
+				task = deques[victim]->steal();
+			}
+		}
+	}
+	if (task) {
+		num_queued.fetch_sub(1);
+	}
+	return task;
+}
+
+bool ThreadPool::run_pending_task() {
+	Task* task = take_task();
+	if (!task) {
+		return false;
+	}
+	execute(task);
+	return true;
+}
+
+void ThreadPool::execute(Task* task) {
+	if (!profiling() || task->name.empty()) {
+		// Tasks enqueued before profiling was turned on aren't timed
+		task->name.clear();
+		task->run();
+		return;
+	}
+	const uint32_t slot = worker_idx >= 0 ? (uint32_t)worker_idx : num_threads();
+	WorkerProfile& profile = *profiles[slot];
+	const double start_us = now_us();
+	const double wait_us = start_us - task->enqueue_us;
+	const uint32_t bucket =
+		wait_us < 1.0 ? 0 : std::min(ThreadPoolStats::LATENCY_BUCKETS - 1, 1 + (uint32_t)std::log2(wait_us));
+	profile.wait_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+	// The task is recycled by run()
+	std::string name = std::move(task->name);
+	task->name.clear();
+	task->run();
+	const double end_us = now_us();
+	profile.tasks_executed.fetch_add(1, std::memory_order_relaxed);
+	profile.busy_ns.fetch_add(uint64_t((end_us - start_us) * 1e3), std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(profile.trace_mutex);
+	if (profile.trace.size() < WorkerProfile::MAX_TRACE_EVENTS) {
+		profile.trace.push_back({.name = std::move(name),
+								 .category = "task",
+								 .start_us = start_us,
+								 .duration_us = end_us - start_us,
+								 .tid = 3 + slot});
+	} else {
+		profile.dropped_events++;
+	}
+}
+
+void ThreadPool::worker_loop(uint32_t idx) {
+	worker_idx = idx;
+	WorkerProfile& profile = *profiles[idx];
+	while (true) {
+		if (Task* task = take_task()) {
+			const double idle_since_us = profile.idle_since_us.exchange(-1.0, std::memory_order_relaxed);
+			if (idle_since_us >= 0.0 && profiling()) {
+				profile.idle_ns.fetch_add(uint64_t((now_us() - idle_since_us) * 1e3), std::memory_order_relaxed);
+			}
+			execute(task);
+			continue;
+		}
+		if (profile.idle_since_us.load(std::memory_order_relaxed) < 0.0 && profiling()) {
+			profile.idle_since_us.store(now_us(), std::memory_order_relaxed);
+		}
+		// Spin briefly, tasks tend to come in bursts
+		bool found = false;
+		for (int i = 0; i < 64 && !found; i++) {
+			std::this_thread::yield();
+			found = num_queued.load(std::memory_order_relaxed) > 0;
+		}
+		if (found) {
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		num_sleeping.fetch_add(1);
+		cv.wait(lock, [] { return num_queued.load() > 0 || done; });
+		num_sleeping.fetch_sub(1);
+		if (done && num_queued.load() <= 0) {
+			break;
+		}
+	}
+}
+
+uint32_t ThreadPool::num_chunks(uint32_t count, uint32_t grain) {
+	const uint32_t max_chunks = (count + std::max(grain, 1u) - 1) / std::max(grain, 1u);
+	return std::max(1u, std::min(max_chunks, 4 * (num_threads() + 1)));
+}
+
+double ThreadPoolStats::Worker::wait_percentile_us(double p) const {
+	uint64_t total = 0;
+	for (uint64_t count : wait_histogram) {
+		total += count;
+	}
+	uint64_t acc = 0;
+	for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+		acc += wait_histogram[i];
+		if (total && acc >= p * total) {
+			return i == LATENCY_BUCKETS - 1 ? INFINITY : double(1ull << i);
+		}
+	}
+	return 0.0;
+}
+
+void ThreadPool::set_profiling(bool enable) {
+	if (enable && !profiling()) {
+		reset_stats();
+	}
+	profiling_enabled = enable;
+}
+
+ThreadPoolStats ThreadPool::stats() {
+	ThreadPoolStats res;
+	res.queue_depth = std::max(0, num_queued.load());
+	res.peak_queue_depth = peak_queued.load();
+	const double curr_us = now_us();
+	for (const auto& profile : profiles) {
+		ThreadPoolStats::Worker& worker = res.workers.emplace_back();
+		worker.tasks_executed = profile->tasks_executed.load(std::memory_order_relaxed);
+		worker.busy_ms = profile->busy_ns.load(std::memory_order_relaxed) * 1e-6;
+		worker.idle_ms = profile->idle_ns.load(std::memory_order_relaxed) * 1e-6;
+		// Include the stretch a sleeping worker is in
+		const double idle_since_us = profile->idle_since_us.load(std::memory_order_relaxed);
+		if (idle_since_us >= 0.0) {
+			worker.idle_ms += std::max(0.0, curr_us - idle_since_us) * 1e-3;
+		}
+		for (uint32_t i = 0; i < ThreadPoolStats::LATENCY_BUCKETS; i++) {
+			worker.wait_histogram[i] = profile->wait_histogram[i].load(std::memory_order_relaxed);
+		}
+		std::lock_guard<std::mutex> lock(profile->trace_mutex);
+		res.dropped_trace_events += profile->dropped_events;
+	}
+	return res;
+}
+
+void ThreadPool::reset_stats() {
+	peak_queued = std::max(0, num_queued.load());
+	for (auto& profile : profiles) {
+		profile->tasks_executed = 0;
+		profile->busy_ns = 0;
+		profile->idle_ns = 0;
+		if (profile->idle_since_us.load() >= 0.0) {
+			profile->idle_since_us = now_us();
+		}
+		for (auto& count : profile->wait_histogram) {
+			count = 0;
+		}
+		std::lock_guard<std::mutex> lock(profile->trace_mutex);
+		profile->trace.clear();
+		profile->dropped_events = 0;
+	}
+}
+
+bool ThreadPool::write_trace(const std::string& path) {
+	std::vector<TraceEvent> events;
+	std::vector<std::string> tracks;
+	for (uint32_t i = 0; i < profiles.size(); i++) {
+		tracks.push_back(i < num_threads() ? "Worker " + std::to_string(i) : "Waiting threads");
+		std::lock_guard<std::mutex> lock(profiles[i]->trace_mutex);
+		events.insert(events.end(), profiles[i]->trace.begin(), profiles[i]->trace.end());
+	}
+	return write_chrome_trace(path, events, tracks);
 }
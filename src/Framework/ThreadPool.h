@@ -1,34 +1,293 @@
 #pragma once
-#include "../LumenPCH.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Type-erased job. Callables up to INLINE_SIZE bytes are stored in place, and the tasks themselves are recycled
+// through per-thread free lists, so submitting small jobs doesn't touch the heap in steady state. Tasks released on
+// another thread than the one that created them flow back through a shared list.
+class Task {
+   public:
+	template <typename F>
+	static Task* create(F&& f);
+	// Runs the callable, which must not throw, and gives the task back to the free list of the calling thread
+	void run();
+
+   private:
+	friend class ThreadPool;
+	static constexpr size_t INLINE_SIZE = 64;
+	alignas(std::max_align_t) std::byte storage[INLINE_SIZE];
+	void (*invoke)(Task*) = nullptr;
+	void (*destroy)(Task*) = nullptr;
+	// Only filled in while the pool is profiling
+	std::string name;
+	double enqueue_us = 0.0;
+	static Task* allocate();
+	static void release(Task* task);
+	// Fills the shared free list up front, see ThreadPool::init()
+	static void stock(uint32_t thread_count);
+};
+
+// Chase-Lev deque: the owning worker pushes and pops at the bottom, other threads steal from the top
+class WorkStealingDeque {
+   public:
+	explicit WorkStealingDeque(int64_t capacity = 256);
+	void push(Task* task);
+	Task* pop();
+	Task* steal();
+
+   private:
+	struct Array {
+		int64_t capacity;
+		std::unique_ptr<std::atomic<Task*>[]> data;
+		explicit Array(int64_t capacity) : capacity(capacity), data(new std::atomic<Task*>[capacity]) {}
+		Task* get(int64_t i) const { return data[i & (capacity - 1)].load(std::memory_order_relaxed); }
+		void put(int64_t i, Task* task) { data[i & (capacity - 1)].store(task, std::memory_order_relaxed); }
+	};
+	alignas(64) std::atomic<int64_t> top = 0;
+	alignas(64) std::atomic<int64_t> bottom = 0;
+	std::atomic<Array*> array;
+	// Thieves may still read the arrays that were grown out of, they are freed with the deque
+	std::vector<std::unique_ptr<Array>> arrays;
+};
+
+// Tasks that are waited on together. wait() runs pending tasks of the pool instead of blocking, so groups can be
+// waited on from inside other tasks
+class TaskGroup {
+   public:
+	TaskGroup() = default;
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+	~TaskGroup();
+	template <typename F>
+	void run(F&& f);
+	// The name shows up in the ThreadPool profile, e.g. "compile:vcm_eye.rgen"
+	template <typename F>
+	void run(std::string_view name, F&& f);
+	// Rethrows the first exception thrown by the tasks
+	void wait();
+
+   private:
+	void wait_pending();
+	std::atomic<uint32_t> pending = 0;
+	std::mutex exception_mutex;
+	std::exception_ptr exception;
+};
+
+// Snapshot of the ThreadPool counters, see ThreadPool::set_profiling()
+struct ThreadPoolStats {
+	// Bucket 0 counts waits below 1 us, bucket i waits in [2^(i-1), 2^i) us, the last one everything above
+	static constexpr uint32_t LATENCY_BUCKETS = 22;
+	struct Worker {
+		uint64_t tasks_executed = 0;
+		double busy_ms = 0.0;
+		double idle_ms = 0.0;
+		// Time from enqueue to start of the tasks this worker ran
+		std::array<uint64_t, LATENCY_BUCKETS> wait_histogram = {};
+		// Upper bound of the bucket that holds the p-th fraction of the waits
+		double wait_percentile_us(double p) const;
+	};
+	// One per worker, the last one are the threads outside the pool that help while waiting on a TaskGroup
+	std::vector<Worker> workers;
+	int32_t queue_depth = 0;
+	int32_t peak_queue_depth = 0;
+	uint64_t dropped_trace_events = 0;
+};
 
 class ThreadPool {
    public:
 	template <typename FunctionType, typename... Args>
 	static auto submit(FunctionType&& f, Args&&... args);
-	static void init();
+	template <typename FunctionType, typename... Args>
+	static auto submit_named(std::string_view name, FunctionType&& f, Args&&... args);
+	// Calls f(i) for every i in [begin, end), in chunks of at least grain indices. The calling thread takes part
+	template <typename F>
+	static void parallel_for(uint32_t begin, uint32_t end, F&& f, uint32_t grain = 1);
+	// Combines map(i) over [begin, end). The chunks are combined in order, so the result doesn't depend on timing
+	template <typename T, typename Map, typename Combine>
+	static T parallel_reduce(uint32_t begin, uint32_t end, T identity, Map&& map, Combine&& combine,
+							 uint32_t grain = 1);
+	// thread_count = 0 starts one worker per hardware thread
+	static void init(uint32_t thread_count = 0);
 	static void destroy();
+	static uint32_t num_threads() { return (uint32_t)threads.size(); }
+	// Runs one queued task on the calling thread, returns false if there was none
+	static bool run_pending_task();
+
+	// Per worker counters and a trace of the executed tasks. Off by default, costs two clock reads per task when on
+	static void set_profiling(bool enable);
+	static bool profiling() { return profiling_enabled.load(std::memory_order_relaxed); }
+	static ThreadPoolStats stats();
+	static void reset_stats();
+	// Writes the tasks executed since the last reset_stats() in the chrome://tracing format
+	static bool write_trace(const std::string& path);
+	static void gui();
 
    private:
+	friend class TaskGroup;
+	struct WorkerProfile;
+	static void enqueue(Task* task, std::string_view name = {});
+	static void execute(Task* task);
+	static Task* take_task();
+	static void worker_loop(uint32_t idx);
+	// Splits [begin, end) into at most a few chunks per worker
+	static uint32_t num_chunks(uint32_t count, uint32_t grain);
+
 	static std::atomic_bool done;
-	static std::queue<std::function<void()>> work_queue;
-	static std::mutex queue_mutex;
+	static std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+	// Tasks submitted from threads outside the pool. A ring buffer that only grows, unlike a std::deque it doesn't
+	// allocate while tasks pass through
+	static std::vector<Task*> global_queue;
+	static size_t global_head;
+	static std::mutex global_mutex;
+	static std::atomic<uint32_t> global_size;
+	// Signed, a task can be taken before its push is counted
+	static std::atomic<int32_t> num_queued;
+	static std::atomic<uint32_t> num_sleeping;
+	static std::mutex sleep_mutex;
 	static std::condition_variable cv;
 	static std::vector<std::thread> threads;
+	static thread_local int32_t worker_idx;
+	static std::atomic_bool profiling_enabled;
+	static std::atomic<int32_t> peak_queued;
+	// Indexed like the workers, the last one is shared by the other threads
+	static std::vector<std::unique_ptr<WorkerProfile>> profiles;
 };
 
+template <typename F>
+Task* Task::create(F&& f) {
+	using Fn = std::decay_t<F>;
+	Task* task = allocate();
+	if constexpr (sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t)) {
+		new (task->storage) Fn(std::forward<F>(f));
+		task->invoke = [](Task* t) { (*std::launder(reinterpret_cast<Fn*>(t->storage)))(); };
+		task->destroy = [](Task* t) { std::launder(reinterpret_cast<Fn*>(t->storage))->~Fn(); };
+	} else {
+		Fn* fn = new Fn(std::forward<F>(f));
+		memcpy(task->storage, &fn, sizeof(fn));
+		task->invoke = [](Task* t) {
+			Fn* fn;
+			memcpy(&fn, t->storage, sizeof(fn));
+			(*fn)();
+		};
+		task->destroy = [](Task* t) {
+			Fn* fn;
+			memcpy(&fn, t->storage, sizeof(fn));
+			delete fn;
+		};
+	}
+	return task;
+}
+
+template <typename F>
+void TaskGroup::run(F&& f) {
+	run(std::string_view(), std::forward<F>(f));
+}
+
+template <typename F>
+void TaskGroup::run(std::string_view name, F&& f) {
+	pending.fetch_add(1, std::memory_order_relaxed);
+	ThreadPool::enqueue(Task::create([this, f = std::forward<F>(f)]() mutable {
+		try {
+			f();
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(exception_mutex);
+			if (!exception) {
+				exception = std::current_exception();
+			}
+		}
+		pending.fetch_sub(1, std::memory_order_release);
+	}), name);
+}
+
 template <typename FunctionType, typename... Args>
 auto ThreadPool::submit(FunctionType&& f, Args&&... args) {
+	return submit_named(std::string_view(), std::forward<FunctionType>(f), std::forward<Args>(args)...);
+}
+
+template <typename FunctionType, typename... Args>
+auto ThreadPool::submit_named(std::string_view name, FunctionType&& f, Args&&... args) {
 	using result_type = std::invoke_result_t<FunctionType, Args...>;
-	auto task = std::make_shared<std::packaged_task<result_type()>>(
-		std::bind(std::forward<FunctionType>(f), std::forward<Args>(args)...));
-	auto result = task->get_future();
-	{
-		std::lock_guard<std::mutex> lock(queue_mutex);
-		if (done) {
-			LUMEN_ERROR("ThreadPool has been terminated");
+	std::promise<result_type> promise;
+	auto result = promise.get_future();
+	enqueue(Task::create([promise = std::move(promise), f = std::forward<FunctionType>(f),
+						  ... args = std::forward<Args>(args)]() mutable {
+		try {
+			if constexpr (std::is_void_v<result_type>) {
+				std::invoke(f, args...);
+				promise.set_value();
+			} else {
+				promise.set_value(std::invoke(f, args...));
+			}
+		} catch (...) {
+			promise.set_exception(std::current_exception());
 		}
-		work_queue.emplace([task]() { (*task)(); });
-	}
-	cv.notify_one();
+	}), name);
 	return result;
 }
+
+template <typename F>
+void ThreadPool::parallel_for(uint32_t begin, uint32_t end, F&& f, uint32_t grain) {
+	if (begin >= end) {
+		return;
+	}
+	const uint32_t count = end - begin;
+	const uint32_t chunks = num_chunks(count, grain);
+	const uint32_t chunk_size = (count + chunks - 1) / chunks;
+	auto run_chunk = [&f, begin, end, chunk_size](uint32_t c) {
+		const uint32_t chunk_end = std::min(end, begin + (c + 1) * chunk_size);
+		for (uint32_t i = begin + c * chunk_size; i < chunk_end; i++) {
+			f(i);
+		}
+	};
+	TaskGroup group;
+	for (uint32_t c = 1; c < chunks; c++) {
+		group.run("parallel_for", [&run_chunk, c] { run_chunk(c); });
+	}
+	run_chunk(0);
+	group.wait();
+}
+
+template <typename T, typename Map, typename Combine>
+T ThreadPool::parallel_reduce(uint32_t begin, uint32_t end, T identity, Map&& map, Combine&& combine,
+							  uint32_t grain) {
+	if (begin >= end) {
+		return identity;
+	}
+	const uint32_t count = end - begin;
+	const uint32_t chunks = num_chunks(count, grain);
+	const uint32_t chunk_size = (count + chunks - 1) / chunks;
+	std::vector<T> partials(chunks, identity);
+	parallel_for(
+		0, chunks,
+		[&](uint32_t c) {
+			const uint32_t chunk_end = std::min(end, begin + (c + 1) * chunk_size);
+			T acc = identity;
+			for (uint32_t i = begin + c * chunk_size; i < chunk_end; i++) {
+				acc = combine(acc, map(i));
+			}
+			partials[c] = acc;
+		});
+	T res = identity;
+	for (const T& partial : partials) {
+		res = combine(res, partial);
+	}
+	return res;
+}
@@ -0,0 +1,56 @@
+#include "../LumenPCH.h"
+#include "ThreadPool.h"
+
+// Kept apart from ThreadPool.cpp, which is also built without ImGui (see lumen-core)
+void ThreadPool::gui() {
+	const ThreadPoolStats pool_stats = stats();
+	ImGui::Text("Queue depth %d (peak %d)", pool_stats.queue_depth, pool_stats.peak_queue_depth);
+	if (ImGui::Button("Reset")) {
+		reset_stats();
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Dump task trace")) {
+		if (write_trace("lumen_threadpool_trace.json")) {
+			LUMEN_INFO("Wrote the ThreadPool trace to lumen_threadpool_trace.json");
+		} else {
+			LUMEN_WARN("Failed to write the ThreadPool trace");
+		}
+	}
+	if (!ImGui::BeginTable("ThreadPool workers", 6,
+						   ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable)) {
+		return;
+	}
+	ImGui::TableSetupColumn("Worker");
+	ImGui::TableSetupColumn("Tasks");
+	ImGui::TableSetupColumn("Busy (ms)");
+	ImGui::TableSetupColumn("Utilization");
+	ImGui::TableSetupColumn("Wait p50 (us)");
+	ImGui::TableSetupColumn("Wait p99 (us)");
+	ImGui::TableHeadersRow();
+	for (uint32_t i = 0; i < pool_stats.workers.size(); i++) {
+		const ThreadPoolStats::Worker& worker = pool_stats.workers[i];
+		const double total_ms = worker.busy_ms + worker.idle_ms;
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		if (i < num_threads()) {
+			ImGui::Text("%u", i);
+		} else {
+			ImGui::TextUnformatted("Waiting threads");
+		}
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", (unsigned long long)worker.tasks_executed);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.2f", worker.busy_ms);
+		ImGui::TableNextColumn();
+		if (i < num_threads() && total_ms > 0.0) {
+			ImGui::Text("%.1f%%", 100.0 * worker.busy_ms / total_ms);
+		} else {
+			ImGui::TextUnformatted("-");
+		}
+		ImGui::TableNextColumn();
+		ImGui::Text("%.0f", worker.wait_percentile_us(0.5));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.0f", worker.wait_percentile_us(0.99));
+	}
+	ImGui::EndTable();
+}
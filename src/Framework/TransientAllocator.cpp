@@ -0,0 +1,90 @@
+#include "TransientAllocator.h"
+#include <algorithm>
+
+static uint64_t align_offset(uint64_t val, uint64_t alignment) {
+	return alignment > 1 ? (val + alignment - 1) / alignment * alignment : val;
+}
+
+TransientLayout place_transient_resources(std::span<const TransientRequest> requests) {
+	TransientLayout layout;
+	layout.placements.resize(requests.size());
+	// Interval coloring: Place the largest resources first, each one at the lowest offset that doesn't
+	// collide with an already placed resource whose lifetime overlaps with it
+	std::vector<uint32_t> order(requests.size());
+	for (uint32_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&requests](uint32_t a, uint32_t b) {
+		if (requests[a].size != requests[b].size) {
+			return requests[a].size > requests[b].size;
+		}
+		return requests[a].first_use < requests[b].first_use;
+	});
+
+	std::vector<std::vector<uint32_t>> heap_residents;
+	std::vector<std::pair<uint64_t, uint64_t>> occupied;
+	for (uint32_t idx : order) {
+		const TransientRequest& request = requests[idx];
+		uint32_t heap_idx = 0;
+		for (; heap_idx < layout.heaps.size(); heap_idx++) {
+			const TransientHeap& heap = layout.heaps[heap_idx];
+			if (heap.group == request.group && (heap.memory_type_bits & request.memory_type_bits)) {
+				break;
+			}
+		}
+		if (heap_idx == layout.heaps.size()) {
+			layout.heaps.push_back({.size = 0, .memory_type_bits = request.memory_type_bits, .group = request.group});
+			heap_residents.emplace_back();
+		}
+		TransientHeap& heap = layout.heaps[heap_idx];
+		heap.memory_type_bits &= request.memory_type_bits;
+
+		occupied.clear();
+		for (uint32_t resident : heap_residents[heap_idx]) {
+			if (transient_lifetimes_overlap(request, requests[resident])) {
+				const uint64_t offset = layout.placements[resident].offset;
+				occupied.push_back({offset, offset + requests[resident].size});
+			}
+		}
+		std::sort(occupied.begin(), occupied.end());
+		// First fit
+		uint64_t offset = 0;
+		for (const auto& [begin, end] : occupied) {
+			if (align_offset(offset, request.alignment) + request.size <= begin) {
+				break;
+			}
+			offset = std::max(offset, end);
+		}
+		offset = align_offset(offset, request.alignment);
+
+		layout.placements[idx] = {.heap_idx = heap_idx, .offset = offset};
+		heap.size = std::max(heap.size, offset + request.size);
+		heap_residents[heap_idx].push_back(idx);
+	}
+	return layout;
+}
+
+bool transient_layout_valid(std::span<const TransientRequest> requests, const TransientLayout& layout) {
+	if (layout.placements.size() != requests.size()) {
+		return false;
+	}
+	for (uint32_t i = 0; i < requests.size(); i++) {
+		const TransientPlacement& placement = layout.placements[i];
+		if (placement.heap_idx >= layout.heaps.size()) {
+			return false;
+		}
+		const TransientHeap& heap = layout.heaps[placement.heap_idx];
+		if (heap.group != requests[i].group || !(heap.memory_type_bits & requests[i].memory_type_bits) ||
+			placement.offset % std::max<uint64_t>(requests[i].alignment, 1) ||
+			placement.offset + requests[i].size > heap.size) {
+			return false;
+		}
+		for (uint32_t j = i + 1; j < requests.size(); j++) {
+			if (transient_lifetimes_overlap(requests[i], requests[j]) &&
+				transient_ranges_overlap(placement, requests[i].size, layout.placements[j], requests[j].size)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
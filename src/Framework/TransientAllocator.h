@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Placement of transient resources with disjoint lifetimes into shared memory heaps.
+// This is independent of Vulkan so that it can be exercised without a device.
+
+struct TransientRequest {
+	uint64_t size = 0;
+	uint64_t alignment = 1;
+	uint32_t memory_type_bits = ~0u;
+	// Resources only share heaps within the same group (e.g. buffers vs. optimal tiling images)
+	uint32_t group = 0;
+	// Inclusive range of pass indices the resource is live in
+	uint32_t first_use = 0;
+	uint32_t last_use = 0;
+};
+
+struct TransientPlacement {
+	uint32_t heap_idx = 0;
+	uint64_t offset = 0;
+};
+
+struct TransientHeap {
+	uint64_t size = 0;
+	uint32_t memory_type_bits = ~0u;
+	uint32_t group = 0;
+};
+
+struct TransientLayout {
+	std::vector<TransientPlacement> placements;	 // One per request, in request order
+	std::vector<TransientHeap> heaps;
+};
+
+inline bool transient_lifetimes_overlap(const TransientRequest& a, const TransientRequest& b) {
+	return a.first_use <= b.last_use && b.first_use <= a.last_use;
+}
+
+inline bool transient_ranges_overlap(const TransientPlacement& a, uint64_t a_size, const TransientPlacement& b,
+									 uint64_t b_size) {
+	return a.heap_idx == b.heap_idx && a.offset < b.offset + b_size && b.offset < a.offset + a_size;
+}
+
+TransientLayout place_transient_resources(std::span<const TransientRequest> requests);
+// Whether an existing layout still holds for the requests, i.e. no two resources that share memory are live at the
+// same time and every resource still fits its heap. Lets a layout outlive changes of the pass order
+bool transient_layout_valid(std::span<const TransientRequest> requests, const TransientLayout& layout);
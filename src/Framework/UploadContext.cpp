@@ -0,0 +1,217 @@
+#include "../LumenPCH.h"
+#include "UploadContext.h"
+
+void UploadContext::init(VulkanContext* ctx, VkDeviceSize ring_size) {
+	this->ctx = ctx;
+	this->ring_size = ring_size;
+	ring.create("Upload ring", ctx, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_SHARING_MODE_EXCLUSIVE,
+				ring_size);
+	VkCommandPoolCreateInfo pool_info = vk::command_pool_CI(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	pool_info.queueFamilyIndex = ctx->indices.gfx_family.value();
+	vk::check(vkCreateCommandPool(ctx->device, &pool_info, nullptr, &cmd_pool), "Failed to create command pool!");
+	VkSemaphoreTypeCreateInfo type_info = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	VkSemaphoreCreateInfo semaphore_info = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+	semaphore_info.pNext = &type_info;
+	vk::check(vkCreateSemaphore(ctx->device, &semaphore_info, nullptr, &timeline),
+			  "Failed to create timeline semaphore");
+}
+
+void UploadContext::destroy() {
+	wait(last_submitted);
+	std::lock_guard<std::mutex> lock(mutex);
+	// Copies that were never submitted are dropped
+	for (Buffer& buffer : recording.oversized) {
+		buffer.destroy();
+	}
+	recording = Batch();
+	in_flight.clear();
+	free_cmds.clear();
+	vkDestroyCommandPool(ctx->device, cmd_pool, nullptr);
+	vkDestroySemaphore(ctx->device, timeline, nullptr);
+	ring.destroy();
+	cmd_pool = VK_NULL_HANDLE;
+	timeline = VK_NULL_HANDLE;
+	last_submitted = 0;
+	head = tail = 0;
+	ring_empty = true;
+}
+
+void UploadContext::upload(Buffer& dst, const void* data, VkDeviceSize size, VkDeviceSize dst_offset) {
+	// Big buffers are streamed through the ring in chunks instead of getting their own staging buffer
+	const VkDeviceSize chunk_size = ring_size / 2;
+	for (VkDeviceSize done = 0; done < size; done += chunk_size) {
+		const VkDeviceSize n = std::min(chunk_size, size - done);
+		upload((const uint8_t*)data + done, n, 16, [&](VkCommandBuffer cmd, VkBuffer src, VkDeviceSize src_offset) {
+			VkBufferCopy copy_region = {};
+			copy_region.srcOffset = src_offset;
+			copy_region.dstOffset = dst_offset + done;
+			copy_region.size = n;
+			vkCmdCopyBuffer(cmd, src, dst.handle, 1, &copy_region);
+		});
+	}
+}
+
+void UploadContext::upload(const void* data, VkDeviceSize size, VkDeviceSize alignment, const RecordFn& fn) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (size + alignment > ring_size) {
+		Buffer staging_buffer;
+		staging_buffer.create("Upload staging", ctx, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+							  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+							  VK_SHARING_MODE_EXCLUSIVE, size, (void*)data);
+		fn(recording_cmd(), staging_buffer.handle, 0);
+		recording.oversized.push_back(staging_buffer);
+		return;
+	}
+	// allocate() may submit the batch, so the command buffer is fetched after it
+	const VkDeviceSize offset = allocate(size, alignment);
+	memcpy((uint8_t*)ring.data + offset, data, size);
+	fn(recording_cmd(), ring.handle, offset);
+	recording.uses_ring = true;
+}
+
+VkDeviceSize UploadContext::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+	if (!in_flight.empty()) {
+		uint64_t completed = 0;
+		vk::check(vkGetSemaphoreCounterValue(ctx->device, timeline, &completed), "Failed to query the timeline");
+		retire(completed);
+	}
+	VkDeviceSize offset = 0;
+	while (!try_allocate(size, alignment, offset)) {
+		// The ring is full, the space of the oldest batch is the next to be released
+		if (in_flight.empty()) {
+			submit();
+		}
+		const uint64_t value = in_flight.front().value;
+		VkSemaphoreWaitInfo wait_info = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+		wait_info.semaphoreCount = 1;
+		wait_info.pSemaphores = &timeline;
+		wait_info.pValues = &value;
+		vk::check(vkWaitSemaphores(ctx->device, &wait_info, UINT64_MAX), "Failed to wait for the upload batch");
+		retire(value);
+	}
+	return offset;
+}
+
+bool UploadContext::try_allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+	if (ring_empty) {
+		head = tail = 0;
+	}
+	const VkDeviceSize aligned = (head + alignment - 1) / alignment * alignment;
+	if (ring_empty || head > tail) {
+		// Free space is [head, ring_size) followed by [0, tail)
+		if (aligned + size <= ring_size) {
+			offset = aligned;
+		} else if (size <= tail) {
+			offset = 0;
+		} else {
+			return false;
+		}
+	} else if (head < tail && aligned + size <= tail) {
+		offset = aligned;
+	} else {
+		return false;
+	}
+	head = offset + size;
+	ring_empty = false;
+	return true;
+}
+
+VkCommandBuffer UploadContext::recording_cmd() {
+	if (recording.cmd) {
+		return recording.cmd;
+	}
+	if (!free_cmds.empty()) {
+		recording.cmd = free_cmds.back();
+		free_cmds.pop_back();
+	} else {
+		auto cmd_buf_allocate_info = vk::command_buffer_allocate_info(cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+		vk::check(vkAllocateCommandBuffers(ctx->device, &cmd_buf_allocate_info, &recording.cmd),
+				  "Could not allocate command buffer");
+	}
+	auto begin_info = vk::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	vk::check(vkBeginCommandBuffer(recording.cmd, &begin_info), "Could not begin the command buffer");
+	return recording.cmd;
+}
+
+uint64_t UploadContext::submit() {
+	if (!recording.cmd) {
+		return last_submitted;
+	}
+	// Later submissions on the queue are ordered after the copies by this barrier
+	VkMemoryBarrier2 mem_barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+	mem_barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	mem_barrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+	mem_barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	mem_barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+	VkDependencyInfo dependency_info = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+	dependency_info.memoryBarrierCount = 1;
+	dependency_info.pMemoryBarriers = &mem_barrier;
+	vkCmdPipelineBarrier2(recording.cmd, &dependency_info);
+	vk::check(vkEndCommandBuffer(recording.cmd), "Failed to end command buffer");
+
+	recording.value = ++last_submitted;
+	recording.ring_end = head;
+	VkSemaphoreSubmitInfo signal_semaphore = {VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+	signal_semaphore.semaphore = timeline;
+	signal_semaphore.value = recording.value;
+	signal_semaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	VkCommandBufferSubmitInfo cmd_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+	cmd_info.commandBuffer = recording.cmd;
+	VkSubmitInfo2 submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+	submit_info.commandBufferInfoCount = 1;
+	submit_info.pCommandBufferInfos = &cmd_info;
+	submit_info.signalSemaphoreInfoCount = 1;
+	submit_info.pSignalSemaphoreInfos = &signal_semaphore;
+	{
+		std::lock_guard<std::mutex> queue_lock(VulkanSyncronization::queue_mutex);
+		vk::check(vkQueueSubmit2(ctx->queues[(int)QueueType::GFX], 1, &submit_info, VK_NULL_HANDLE),
+				  "Queue submission error");
+	}
+	in_flight.push_back(std::move(recording));
+	recording = Batch();
+	return last_submitted;
+}
+
+void UploadContext::retire(uint64_t completed_value) {
+	while (!in_flight.empty() && in_flight.front().value <= completed_value) {
+		Batch& batch = in_flight.front();
+		tail = batch.ring_end;
+		for (Buffer& buffer : batch.oversized) {
+			buffer.destroy();
+		}
+		free_cmds.push_back(batch.cmd);
+		in_flight.pop_front();
+	}
+	if (in_flight.empty() && !recording.uses_ring) {
+		ring_empty = true;
+	}
+}
+
+uint64_t UploadContext::flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return submit();
+}
+
+void UploadContext::wait(uint64_t value) {
+	if (!value) {
+		return;
+	}
+	VkSemaphoreWaitInfo wait_info = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+	wait_info.semaphoreCount = 1;
+	wait_info.pSemaphores = &timeline;
+	wait_info.pValues = &value;
+	vk::check(vkWaitSemaphores(ctx->device, &wait_info, UINT64_MAX), "Failed to wait for the upload batch");
+	std::lock_guard<std::mutex> lock(mutex);
+	retire(value);
+}
+
+VkSemaphoreSubmitInfo UploadContext::wait_info() {
+	std::lock_guard<std::mutex> lock(mutex);
+	VkSemaphoreSubmitInfo info = {VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+	info.semaphore = last_submitted ? timeline : VK_NULL_HANDLE;
+	info.value = last_submitted;
+	info.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	return info;
+}
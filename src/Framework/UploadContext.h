@@ -0,0 +1,63 @@
+#pragma once
+#include "../LumenPCH.h"
+#include "Buffer.h"
+
+/*
+	Batches host to device copies through a persistently mapped staging ring. Uploads are recorded into a command
+	buffer that is only submitted by flush(), which every CommandBuffer submission, render graph lane and frame does
+	first, so the data is in place for any work submitted afterwards. Batches signal a timeline semaphore and their
+	part of the ring is reused once it passed, the caller only blocks when the ring is full.
+	Uploads bigger than the ring get their own staging buffer that is released with the batch.
+	Destroying the destination of a pending upload requires wait_idle() first.
+*/
+class UploadContext {
+   public:
+	// src is the staging buffer holding the data at src_offset
+	using RecordFn = std::function<void(VkCommandBuffer cmd, VkBuffer src, VkDeviceSize src_offset)>;
+
+	void init(VulkanContext* ctx, VkDeviceSize ring_size = 32ull << 20);
+	void destroy();
+	// Copies size bytes of data to dst at dst_offset
+	void upload(Buffer& dst, const void* data, VkDeviceSize size, VkDeviceSize dst_offset = 0);
+	// Stages data and lets fn record the copies (e.g. into an image) along with the required barriers
+	void upload(const void* data, VkDeviceSize size, VkDeviceSize alignment, const RecordFn& fn);
+	// Submits the recorded copies, returns the timeline value that signals their completion (0 if nothing was
+	// ever submitted)
+	uint64_t flush();
+	void wait(uint64_t value);
+	void wait_idle() { wait(flush()); }
+	// Wait for submissions on another queue than GFX, semaphore is VK_NULL_HANDLE if nothing was submitted
+	VkSemaphoreSubmitInfo wait_info();
+
+   private:
+	struct Batch {
+		VkCommandBuffer cmd = VK_NULL_HANDLE;
+		uint64_t value = 0;
+		// Ring offset past the data of the batch
+		VkDeviceSize ring_end = 0;
+		bool uses_ring = false;
+		std::vector<Buffer> oversized;
+	};
+	// The private functions expect the mutex to be held
+	// Returns the ring offset of size bytes, blocking on earlier batches if required
+	VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment);
+	bool try_allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+	VkCommandBuffer recording_cmd();
+	uint64_t submit();
+	void retire(uint64_t completed_value);
+
+	VulkanContext* ctx = nullptr;
+	Buffer ring;
+	VkDeviceSize ring_size = 0;
+	// In-flight data spans [tail, head), wrapping around the end of the ring
+	VkDeviceSize head = 0;
+	VkDeviceSize tail = 0;
+	bool ring_empty = true;
+	VkCommandPool cmd_pool = VK_NULL_HANDLE;
+	VkSemaphore timeline = VK_NULL_HANDLE;
+	uint64_t last_submitted = 0;
+	Batch recording;
+	std::deque<Batch> in_flight;
+	std::vector<VkCommandBuffer> free_cmds;
+	std::mutex mutex;
+};
@@ -269,6 +269,9 @@ VkPipelineStageFlags get_pipeline_stage(PassType pass_type, VkAccessFlags access
 	if ((access_flags & VK_ACCESS_TRANSFER_READ_BIT) || (access_flags & VK_ACCESS_TRANSFER_WRITE_BIT)) {
 		res |= VK_PIPELINE_STAGE_TRANSFER_BIT;
 	}
+	if (access_flags & VK_ACCESS_INDIRECT_COMMAND_READ_BIT) {
+		res |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+	}
 	return res;
 }
 
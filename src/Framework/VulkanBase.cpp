@@ -69,6 +69,14 @@ QueueFamilyIndices VulkanBase::find_queue_families(VkPhysicalDevice device) {
 
 		i++;
 	}
+	// Prefer a dedicated compute family, async compute passes can then overlap with the graphics queue
+	for (uint32_t j = 0; j < queue_families.size(); j++) {
+		const VkQueueFlags flags = queue_families[j].queueFlags;
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+			indices.compute_family = j;
+			break;
+		}
+	}
 	return indices;
 }
 
@@ -178,6 +186,15 @@ void VulkanBase::cleanup_swapchain() {
 	vkDestroySwapchainKHR(ctx.device, ctx.swapchain, nullptr);
 }
 
+void VulkanBase::recreate_render_graph() {
+	// The toggles of the UI survive resizes
+	const RenderGraphSettings settings = rg->settings;
+	const bool profiling_requested = rg->profiling_requested;
+	rg = std::make_unique<RenderGraph>(&ctx, &frame_timeline, &frame_value);
+	rg->settings = settings;
+	rg->profiling_requested = profiling_requested;
+}
+
 void VulkanBase::cleanup_app_data() {
 	rg->destroy();
 	if (!blases.empty()) {
@@ -202,11 +219,18 @@ void VulkanBase::cleanup() {
 		vkDestroySemaphore(ctx.device, render_finished_sem[i], nullptr);
 		vkDestroyFence(ctx.device, in_flight_fences[i], nullptr);
 	}
+	vkDestroySemaphore(ctx.device, frame_timeline, nullptr);
 
 	for (auto pool : ctx.cmd_pools) {
 		vkDestroyCommandPool(ctx.device, pool, nullptr);
 	}
 	vkDestroySurfaceKHR(ctx.instance, ctx.surface, nullptr);
+	uploader.destroy();
+	ctx.uploader = nullptr;
+	bindless.destroy();
+	ctx.bindless = nullptr;
+	allocator.destroy();
+	ctx.allocator = nullptr;
 
 	vkDestroyDevice(ctx.device, nullptr);
 	if (enable_validation_layers) {
@@ -249,7 +273,7 @@ void VulkanBase::create_instance() {
 	if (enable_validation_layers && !check_validation_layer_support()) {
 		LUMEN_ERROR("Validation layers requested, but not available!");
 	}
-	rg = std::make_unique<RenderGraph>(&ctx);
+	rg = std::make_unique<RenderGraph>(&ctx, &frame_timeline, &frame_value);
 }
 
 void VulkanBase::create_surface() {
@@ -364,10 +388,17 @@ void VulkanBase::create_logical_device() {
 	accel_fts.accelerationStructure = true;
 	accel_fts.pNext = &atomic_fts;
 	rt_fts.rayTracingPipeline = true;
+	rt_fts.rayTracingPipelineTraceRaysIndirect = true;
 	rt_fts.pNext = &accel_fts;
 	features12.bufferDeviceAddress = true;
+	features12.timelineSemaphore = true;
+	features12.hostQueryReset = true;
 	features12.runtimeDescriptorArray = true;
 	features12.shaderSampledImageArrayNonUniformIndexing = true;
+	// Bindless heap
+	features12.descriptorBindingPartiallyBound = true;
+	features12.descriptorBindingSampledImageUpdateAfterBind = true;
+	features12.descriptorBindingUpdateUnusedWhilePending = true;
 	if (1) {
 		dynamic_rendering_feature.dynamicRendering = true;
 		syncronization2_features.synchronization2 = true;
@@ -415,6 +446,12 @@ void VulkanBase::create_logical_device() {
 	vkGetDeviceQueue(ctx.device, ctx.indices.gfx_family.value(), 0, &ctx.queues[(int)QueueType::GFX]);
 	vkGetDeviceQueue(ctx.device, ctx.indices.compute_family.value(), 0, &ctx.queues[(int)QueueType::COMPUTE]);
 	vkGetDeviceQueue(ctx.device, ctx.indices.present_family.value(), 0, &ctx.queues[(int)QueueType::PRESENT]);
+	allocator.init(&ctx);
+	ctx.allocator = &allocator;
+	bindless.init(&ctx);
+	ctx.bindless = &bindless;
+	uploader.init(&ctx);
+	ctx.uploader = &uploader;
 }
 
 void VulkanBase::create_swapchain() {
@@ -606,6 +643,11 @@ void VulkanBase::create_sync_primitives() {
 					  vkCreateFence(ctx.device, &fence_info, nullptr, &in_flight_fences[i])},
 					 "Failed to create synchronization primitives for a frame");
 	}
+	VkSemaphoreTypeCreateInfo type_info = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	semaphore_info.pNext = &type_info;
+	vk::check(vkCreateSemaphore(ctx.device, &semaphore_info, nullptr, &frame_timeline),
+			  "Failed to create timeline semaphore");
 }
 
 // Called after window resize
@@ -920,7 +962,7 @@ uint32_t VulkanBase::prepare_frame() {
 		vkDeviceWaitIdle(ctx.device);
 		recreate_swap_chain(ctx);
 		cleanup_app_data();
-		rg = std::make_unique<RenderGraph>(&ctx);
+		recreate_render_graph();
 		return UINT32_MAX;
 	} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
 		LUMEN_ERROR("Failed to acquire new swap chain image");
@@ -953,21 +995,36 @@ uint32_t VulkanBase::prepare_frame() {
 }
 
 VkResult VulkanBase::submit_frame(uint32_t image_idx) {
-	VkSubmitInfo submit_info = vk::submit_info();
-	VkSemaphore wait_semaphores[] = {image_available_sem[current_frame]};
-	VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	submit_info.waitSemaphoreCount = 1;
-	submit_info.pWaitSemaphores = wait_semaphores;
-	submit_info.pWaitDstStageMask = wait_stages;
-
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &ctx.command_buffers[image_idx];
+	// Uploads recorded since the last submission land before the frame
+	uploader.flush();
+	VkSemaphoreSubmitInfo wait_infos[2] = {{VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO}};
+	wait_infos[0].semaphore = image_available_sem[current_frame];
+	wait_infos[0].stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+	// The frame can't finish before the async compute work of the render graph
+	wait_infos[1] = rg->async_wait_info();
+	const uint32_t wait_count = wait_infos[1].semaphore ? 2 : 1;
+
+	VkCommandBufferSubmitInfo cmd_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+	cmd_info.commandBuffer = ctx.command_buffers[image_idx];
 
 	VkSemaphore signal_semaphores[] = {render_finished_sem[current_frame]};
-	submit_info.signalSemaphoreCount = 1;
-	submit_info.pSignalSemaphores = signal_semaphores;
-
-	vk::check(vkQueueSubmit(ctx.queues[(int)QueueType::GFX], 1, &submit_info, in_flight_fences[current_frame]),
+	VkSemaphoreSubmitInfo signal_infos[2] = {{VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO},
+											 {VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO}};
+	signal_infos[0].semaphore = render_finished_sem[current_frame];
+	signal_infos[0].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	signal_infos[1].semaphore = frame_timeline;
+	signal_infos[1].value = ++frame_value;
+	signal_infos[1].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+	VkSubmitInfo2 submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+	submit_info.waitSemaphoreInfoCount = wait_count;
+	submit_info.pWaitSemaphoreInfos = wait_infos;
+	submit_info.commandBufferInfoCount = 1;
+	submit_info.pCommandBufferInfos = &cmd_info;
+	submit_info.signalSemaphoreInfoCount = 2;
+	submit_info.pSignalSemaphoreInfos = signal_infos;
+
+	vk::check(vkQueueSubmit2(ctx.queues[(int)QueueType::GFX], 1, &submit_info, in_flight_fences[current_frame]),
 			  "Failed to submit draw command buffer");
 	current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
 	VkPresentInfoKHR present_info{};
@@ -987,7 +1044,7 @@ VkResult VulkanBase::submit_frame(uint32_t image_idx) {
 		vkDeviceWaitIdle(ctx.device);
 		recreate_swap_chain(ctx);
 		cleanup_app_data();
-		rg = std::make_unique<RenderGraph>(&ctx);
+		recreate_render_graph();
 		return result;
 	} else if (result != VK_SUCCESS) {
 		LUMEN_ERROR("Failed to present swap chain image");
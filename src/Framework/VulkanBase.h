@@ -4,6 +4,9 @@
 #include "Buffer.h"
 #include "Event.h"
 #include "RenderGraph.h"
+#include "BindlessHeap.h"
+#include "DeviceMemoryAllocator.h"
+#include "UploadContext.h"
 
 class RenderGraph;
 
@@ -81,8 +84,14 @@ struct VulkanBase {
 	std::vector<VkSemaphore> render_finished_sem;
 	std::vector<VkFence> in_flight_fences;
 	std::vector<VkFence> images_in_flight;
+	// Signaled with frame_value once the frame submitted with it is done
+	VkSemaphore frame_timeline = VK_NULL_HANDLE;
+	uint64_t frame_value = 0;
 	std::vector<VkQueueFamilyProperties> queue_families;
 	VulkanContext ctx;
+	BindlessHeap bindless;
+	DeviceMemoryAllocator allocator;
+	UploadContext uploader;
 	std::unique_ptr<RenderGraph> rg;
 	VkFormat swapchain_format;
 
@@ -100,6 +109,7 @@ struct VulkanBase {
 	void cleanup();
 
    private:
+	void recreate_render_graph();
 	AccelKHR create_acceleration(VkAccelerationStructureCreateInfoKHR& accel);
 	void cmd_compact_blas(VkCommandBuffer cmdBuf, std::vector<uint32_t> indices,
 						  std::vector<BuildAccelerationStructure>& buildAs, VkQueryPool queryPool);
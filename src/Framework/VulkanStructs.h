@@ -25,6 +25,10 @@ struct DescriptorInfo {
 	DescriptorInfo(const VkDescriptorBufferInfo& buffer) { this->buffer = buffer; }
 };
 
+class BindlessHeap;
+class DeviceMemoryAllocator;
+class UploadContext;
+
 struct VulkanContext {
 	GLFWwindow* window_ptr = nullptr;
 	VkInstance instance;
@@ -46,6 +50,12 @@ struct VulkanContext {
 
 	VkPhysicalDeviceRayTracingPipelinePropertiesKHR rt_props{
 		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR};
+	// Owned by VulkanBase, see BindlessHeap
+	BindlessHeap* bindless = nullptr;
+	// Owned by VulkanBase, backs every Buffer and Texture that isn't transient
+	DeviceMemoryAllocator* allocator = nullptr;
+	// Owned by VulkanBase, see UploadContext
+	UploadContext* uploader = nullptr;
 };
 
 enum class QueueType { GFX, COMPUTE, PRESENT };
@@ -62,6 +62,7 @@ void BDPT::render() {
 								 {"src/shaders/ray_shadow.rmiss"},
 								 {"src/shaders/ray.rchit"},
 								 {"src/shaders/ray.rahit"}},
+					 .specialization_data = specialize({{SPEC_MAX_DEPTH, config.path_length}}),
 					 .dims = {instance->width, instance->height},
 					 .accel = instance->vkb.tlas.accel})
 		.zero(light_path_buffer)
@@ -76,7 +77,7 @@ void BDPT::render() {
 			scene_desc_buffer,
 		})
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
+		.bind(aov_bindings())
 		.bind_tlas(instance->vkb.tlas);
 	//.finalize();
 
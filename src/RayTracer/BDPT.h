@@ -14,6 +14,7 @@ class BDPT : public Integrator {
 	virtual void render() override;
 	virtual bool update() override;
 	virtual void destroy() override;
+	virtual bool supports_aovs() const override { return true; }
 
    private:
 	PCBDPT pc_ray{};
@@ -0,0 +1,141 @@
+#include "LumenPCH.h"
+#include "ConvergenceLogger.h"
+
+static std::string escape_json(const std::string& str) {
+	std::string res;
+	res.reserve(str.size());
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			res += '\\';
+		}
+		res += c;
+	}
+	return res;
+}
+
+void ConvergenceLogger::init(const Settings& settings, const std::string& reference, const std::string& integrator) {
+	this->settings = settings;
+	this->reference = reference;
+	if (this->settings.interval_s <= 0.0 && !this->settings.frame_interval) {
+		this->settings.interval_s = 1.0;
+	}
+	json = std::filesystem::path(settings.path).extension() == ".json";
+	if (writes_file() && !json) {
+		csv.open(settings.path);
+		if (!csv) {
+			LUMEN_WARN("Could not write the convergence log to {}", settings.path);
+		}
+		csv.precision(9);
+		csv << "integrator,run,frame,samples,wall_s,gpu_ms,rmse" << std::endl;
+	}
+	restart(integrator, 0.0);
+}
+
+void ConvergenceLogger::restart(const std::string& integrator, double gpu_time_ms) {
+	if (run_logged && json) {
+		write_json();
+	}
+	{
+		std::lock_guard<std::mutex> lock(entry_mutex);
+		// Resets without a logged frame in between (e.g. while the camera moves) keep the run
+		if (run_logged || run_integrators.empty()) {
+			run_integrators.push_back(integrator);
+		} else {
+			run_integrators.back() = integrator;
+		}
+	}
+	run_logged = false;
+	run_start = std::chrono::steady_clock::now();
+	run_gpu_ms = gpu_time_ms;
+	last_gpu_ms = gpu_time_ms;
+	next_due_s = settings.interval_s;
+}
+
+bool ConvergenceLogger::due(uint64_t frame, uint32_t samples, double gpu_time_ms, Entry& entry) {
+	const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+	// A recreated render graph starts its profiler from 0, the time counted before carries over
+	if (gpu_time_ms < last_gpu_ms) {
+		run_gpu_ms -= last_gpu_ms;
+	}
+	last_gpu_ms = gpu_time_ms;
+	bool is_due = settings.frame_interval && samples % settings.frame_interval == 0;
+	if (settings.interval_s > 0.0 && wall_s >= next_due_s) {
+		is_due = true;
+		// Frames longer than the interval are logged once
+		next_due_s = (std::floor(wall_s / settings.interval_s) + 1.0) * settings.interval_s;
+	}
+	if (!is_due) {
+		return false;
+	}
+	run_logged = true;
+	entry = {.run = uint32_t(run_integrators.size() - 1),
+			 .frame = frame,
+			 .samples = samples,
+			 .wall_s = wall_s,
+			 .gpu_ms = gpu_time_ms - run_gpu_ms};
+	return true;
+}
+
+void ConvergenceLogger::add(const Entry& entry) {
+	std::lock_guard<std::mutex> lock(entry_mutex);
+	auto before = [](const Entry& a, const Entry& b) { return a.run != b.run ? a.run < b.run : a.frame < b.frame; };
+	if (json) {
+		entries.insert(std::upper_bound(entries.begin(), entries.end(), entry, before), entry);
+	}
+	if (!has_last || !before(entry, last_entry)) {
+		last_entry = entry;
+		has_last = true;
+	}
+	LUMEN_TRACE("RMSE {:.6g} after {} samples, {:.2f} s", entry.rmse, entry.samples, entry.wall_s);
+	if (csv.is_open()) {
+		// Flushed, so that the log is complete up to here if the application doesn't exit cleanly
+		csv << run_integrators[entry.run] << ',' << entry.run << ',' << entry.frame << ',' << entry.samples << ','
+			<< entry.wall_s << ',' << entry.gpu_ms << ',' << entry.rmse << std::endl;
+	}
+}
+
+bool ConvergenceLogger::last(Entry& entry) {
+	std::lock_guard<std::mutex> lock(entry_mutex);
+	entry = last_entry;
+	return has_last;
+}
+
+void ConvergenceLogger::finish() {
+	if (json) {
+		write_json();
+	}
+	csv.close();
+}
+
+void ConvergenceLogger::write_json() {
+	std::lock_guard<std::mutex> lock(entry_mutex);
+	std::ofstream out(settings.path);
+	if (!out) {
+		LUMEN_WARN("Could not write the convergence log to {}", settings.path);
+		return;
+	}
+	out.precision(9);
+	out << "{\n\t\"reference\": \"" << escape_json(reference) << "\",\n\t\"runs\": [";
+	for (size_t i = 0; i < entries.size(); i++) {
+		const Entry& e = entries[i];
+		const bool first_in_run = i == 0 || entries[i - 1].run != e.run;
+		const bool last_in_run = i + 1 == entries.size() || entries[i + 1].run != e.run;
+		if (first_in_run) {
+			out << (i ? ",\n" : "\n") << "\t\t{\"integrator\": \"" << escape_json(run_integrators[e.run])
+				<< "\", \"entries\": [\n";
+		}
+		out << "\t\t\t{\"frame\": " << e.frame << ", \"samples\": " << e.samples << ", \"wall_s\": " << e.wall_s
+			<< ", \"gpu_ms\": " << e.gpu_ms << ", \"rmse\": ";
+		// JSON has no NaN or infinity
+		if (std::isfinite(e.rmse)) {
+			out << e.rmse;
+		} else {
+			out << "null";
+		}
+		out << "}" << (last_in_run ? "\n" : ",\n");
+		if (last_in_run) {
+			out << "\t\t]}";
+		}
+	}
+	out << "\n\t]\n}\n";
+}
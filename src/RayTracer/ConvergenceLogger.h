@@ -0,0 +1,66 @@
+#pragma once
+#include "LumenPCH.h"
+
+/*
+	Error against the reference image over a progressive render, for equal-time and equal-sample comparisons of the
+	integrators. An entry is due every interval_s seconds of wall time and/or every frame_interval accumulated frames,
+	both counted from the last restart of the accumulation. Its RMSE arrives through a readback a few frames later, so
+	add() is called from the readback workers. CSV logs get one row appended per entry, in arrival order. JSON logs
+	(.json paths) are written as a whole on restart() and finish().
+*/
+class ConvergenceLogger {
+   public:
+	struct Settings {
+		// Entries only go to the log output if empty
+		std::string path;
+		// 0 disables the respective trigger, if both are 0 an entry is written every second
+		double interval_s = 0.0;
+		uint32_t frame_interval = 0;
+	};
+
+	struct Entry {
+		// Every restart of the accumulation that logged something starts a new run
+		uint32_t run = 0;
+		uint64_t frame = 0;
+		// Accumulated frames, one sample per pixel each
+		uint32_t samples = 0;
+		// Measured when the frame is recorded
+		double wall_s = 0.0;
+		// 0 if the device has no timestamps
+		double gpu_ms = 0.0;
+		float rmse = 0.0f;
+	};
+
+	// Starts the first run
+	void init(const Settings& settings, const std::string& reference, const std::string& integrator);
+	// Times and samples start over, gpu_time_ms is the current total of the profiler
+	void restart(const std::string& integrator, double gpu_time_ms);
+	// Fills everything but the RMSE if the frame has to be logged, called every frame with the profiler enabled
+	bool due(uint64_t frame, uint32_t samples, double gpu_time_ms, Entry& entry);
+	void add(const Entry& entry);
+	// False until the first RMSE arrived
+	bool last(Entry& entry);
+	// Writes out the JSON log, once the readbacks are done
+	void finish();
+	bool writes_file() const { return !settings.path.empty(); }
+
+   private:
+	void write_json();
+
+	Settings settings;
+	bool json = false;
+	std::ofstream csv;
+	std::string reference;
+	std::vector<std::string> run_integrators;
+	bool run_logged = false;
+	std::chrono::steady_clock::time_point run_start;
+	double run_gpu_ms = 0.0;
+	double last_gpu_ms = 0.0;
+	double next_due_s = 0.0;
+
+	std::mutex entry_mutex;
+	// Only kept for the JSON log
+	std::vector<Entry> entries;
+	Entry last_entry;
+	bool has_last = false;
+};
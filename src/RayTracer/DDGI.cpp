@@ -166,7 +166,6 @@ void DDGI::render() {
 		.zero(g_buffer)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	// Trace rays from probes
 	uint32_t grid_size = probe_counts.x * probe_counts.y * probe_counts.z;
@@ -182,13 +181,14 @@ void DDGI::render() {
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(std::initializer_list<ResourceBinding>{mesh_lights_buffer, ddgi_ubo_buffer, rt.radiance_tex, rt.dir_depth_tex})
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	// Classify
 	uint32_t wg_x = (probe_counts.x * probe_counts.y * probe_counts.z + 31) / 32;
 	instance->vkb.rg
 		->add_compute("Classify Probes",
-					  {.shader = Shader("src/shaders/integrators/ddgi/classify.comp"), .dims = {wg_x}})
+					  {.shader = Shader("src/shaders/integrators/ddgi/classify.comp"),
+					   .dims = {wg_x},
+					   .async_compute = true})
 		.push_constants(&pc_ray)
 		.bind(std::initializer_list<ResourceBinding>{scene_ubo_buffer, scene_desc_buffer, ddgi_ubo_buffer, rt.radiance_tex, rt.dir_depth_tex});
 	// Update probes & borders
@@ -201,7 +201,8 @@ void DDGI::render() {
 				->add_compute(is_irr ? "Update Irradiance" : "Update Depth",
 							  {.shader = Shader(is_irr ? "src/shaders/integrators/ddgi/update_irradiance.comp"
 													   : "src/shaders/integrators/ddgi/update_depth.comp"),
-							   .dims = {wg_x, wg_y}})
+							   .dims = {wg_x, wg_y},
+							   .async_compute = true})
 				.push_constants(&pc_ray)
 				.bind(std::initializer_list<ResourceBinding>{scene_desc_buffer, irr_texes[!ping_pong], depth_texes[!ping_pong], irr_texes[ping_pong],
 					   depth_texes[ping_pong], ddgi_ubo_buffer, rt.radiance_tex, rt.dir_depth_tex});
@@ -213,7 +214,9 @@ void DDGI::render() {
 		wg_x = (probe_counts.x * probe_counts.y * probe_counts.z + 3) * 13 / 4;
 		instance->vkb.rg
 			->add_compute("Update Borders",
-						  {.shader = Shader("src/shaders/integrators/ddgi/update_borders.comp"), .dims = {wg_x}})
+						  {.shader = Shader("src/shaders/integrators/ddgi/update_borders.comp"),
+						   .dims = {wg_x},
+						   .async_compute = true})
 			.push_constants(&pc_ray)
 			.bind(std::initializer_list<ResourceBinding>{irr_texes[!ping_pong], depth_texes[!ping_pong], ddgi_ubo_buffer});
 	}
@@ -231,7 +234,9 @@ void DDGI::render() {
 		// 13 WGs process 4 probes (wg = 32 threads)
 		wg_x = (probe_counts.x * probe_counts.y * probe_counts.z + 31) / 32;
 		instance->vkb.rg
-			->add_compute("Relocate", {.shader = Shader("src/shaders/integrators/ddgi/relocate.comp"), .dims = {wg_x}})
+			->add_compute("Relocate", {.shader = Shader("src/shaders/integrators/ddgi/relocate.comp"),
+									   .dims = {wg_x},
+									   .async_compute = true})
 			.push_constants(&pc_ray)
 			.bind(std::initializer_list<ResourceBinding>{scene_ubo_buffer, scene_desc_buffer, ddgi_ubo_buffer, rt.dir_depth_tex});
 	}
@@ -1,7 +1,6 @@
 #include "LumenPCH.h"
 #include "Integrator.h"
 #include <Framework/Window.h>
-#include <stb_image/stb_image.h>
 
 void Integrator::init() {
 	VkPhysicalDeviceProperties2 prop2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
@@ -101,6 +100,49 @@ void Integrator::init() {
 							VK_SHARING_MODE_EXCLUSIVE, sizeof(SceneUBO));
 	update_uniform_buffers();
 	
+	// Create a sampler for textures
+	VkSamplerCreateInfo sampler_ci = vk::sampler_create_info();
+	sampler_ci.minFilter = VK_FILTER_LINEAR;
+	sampler_ci.magFilter = VK_FILTER_LINEAR;
+	sampler_ci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	sampler_ci.maxLod = FLT_MAX;
+	vk::check(vkCreateSampler(instance->vkb.ctx.device, &sampler_ci, nullptr, &texture_sampler),
+			  "Could not create image sampler");
+
+	auto add_default_texture = [this, instance]() {
+		std::array<uint8_t, 4> nil = {0, 0, 0, 0};
+		scene_textures.resize(1);
+		auto ci = make_img2d_ci(VkExtent2D{1, 1});
+		scene_textures[0].load_from_data(&instance->vkb.ctx, nil.data(), 4, ci, texture_sampler,
+										 VK_IMAGE_USAGE_SAMPLED_BIT, false);
+	};
+
+	if (!lumen_scene->textures.size()) {
+		add_default_texture();
+	} else {
+		// Decoded ahead of time during startup, integrator switches decode them again
+		if (lumen_scene->decoded_textures.size() != lumen_scene->textures.size()) {
+			lumen_scene->decode_textures();
+		}
+		scene_textures.resize(lumen_scene->textures.size());
+		for (size_t i = 0; i < lumen_scene->decoded_textures.size(); i++) {
+			const auto& tex = lumen_scene->decoded_textures[i];
+			auto size = tex.width * tex.height * 4;
+			auto img_dims = VkExtent2D{(uint32_t)tex.width, (uint32_t)tex.height};
+			auto ci = make_img2d_ci(img_dims, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_SAMPLED_BIT, false);
+			scene_textures[i].load_from_data(&instance->vkb.ctx, tex.data, size, ci, texture_sampler,
+											 VK_IMAGE_USAGE_SAMPLED_BIT, false);
+		}
+		lumen_scene->release_decoded_textures();
+	}
+	// Materials refer to the textures by their slots in the bindless heap
+	std::vector<Material> materials = lumen_scene->materials;
+	for (Material& material : materials) {
+		if (material.texture_id > -1) {
+			material.texture_id = (int)scene_textures[material.texture_id].bindless_idx;
+		}
+	}
+
 	// only create scene buffers if geometry is available
 	if(vertex_buf_size){
 		vertex_buffer.create("Vertex Buffer", &instance->vkb.ctx,
@@ -130,48 +172,13 @@ void Integrator::init() {
 		materials_buffer.create("Materials Buffer", &instance->vkb.ctx,
 								VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 								VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE,
-								lumen_scene->materials.size() * sizeof(Material), lumen_scene->materials.data(), true);
+								materials.size() * sizeof(Material), materials.data(), true);
 		prim_lookup_buffer.create("Prim Lookup Buffer", &instance->vkb.ctx,
 								  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 								  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE,
 								  prim_lookup.size() * sizeof(PrimMeshInfo), prim_lookup.data(), true);
 	}
 
-	// Create a sampler for textures
-	VkSamplerCreateInfo sampler_ci = vk::sampler_create_info();
-	sampler_ci.minFilter = VK_FILTER_LINEAR;
-	sampler_ci.magFilter = VK_FILTER_LINEAR;
-	sampler_ci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	sampler_ci.maxLod = FLT_MAX;
-	vk::check(vkCreateSampler(instance->vkb.ctx.device, &sampler_ci, nullptr, &texture_sampler),
-			  "Could not create image sampler");
-
-	auto add_default_texture = [this, instance]() {
-		std::array<uint8_t, 4> nil = {0, 0, 0, 0};
-		scene_textures.resize(1);
-		auto ci = make_img2d_ci(VkExtent2D{1, 1});
-		scene_textures[0].load_from_data(&instance->vkb.ctx, nil.data(), 4, ci, texture_sampler,
-										 VK_IMAGE_USAGE_SAMPLED_BIT, false);
-	};
-
-	if (!lumen_scene->textures.size()) {
-		add_default_texture();
-	} else {
-		scene_textures.resize(lumen_scene->textures.size());
-		int i = 0;
-		for (const auto& texture_path : lumen_scene->textures) {
-			int x, y, n;
-			unsigned char* data = stbi_load(texture_path.c_str(), &x, &y, &n, 4);
-
-			auto size = x * y * 4;
-			auto img_dims = VkExtent2D{(uint32_t)x, (uint32_t)y};
-			auto ci = make_img2d_ci(img_dims, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_SAMPLED_BIT, false);
-			scene_textures[i].load_from_data(&instance->vkb.ctx, data, size, ci, texture_sampler,
-											 VK_IMAGE_USAGE_SAMPLED_BIT, false);
-			stbi_image_free(data);
-			i++;
-		}
-	}
 	// Create BLAS and TLAS
 	if(vertex_buf_size){
 		create_blas();
@@ -185,6 +192,12 @@ void Integrator::init() {
 	settings.base_extent = {(uint32_t)instance->width, (uint32_t)instance->height, 1};
 	settings.format = VK_FORMAT_R32G32B32A32_SFLOAT;
 	output_tex.create_empty_texture("Color Output", &instance->vkb.ctx, settings, VK_IMAGE_LAYOUT_GENERAL);
+	if (!writes_aovs()) {
+		settings.base_extent = {1, 1, 1};
+	}
+	aov_albedo_depth.create_empty_texture("AOV Albedo Depth", &instance->vkb.ctx, settings, VK_IMAGE_LAYOUT_GENERAL);
+	aov_normal.create_empty_texture("AOV Normal", &instance->vkb.ctx, settings, VK_IMAGE_LAYOUT_GENERAL);
+	aov_stats.create_empty_texture("AOV Stats", &instance->vkb.ctx, settings, VK_IMAGE_LAYOUT_GENERAL);
 }
 
 bool Integrator::gui() {
@@ -193,6 +206,21 @@ bool Integrator::gui() {
 	return false;
 }
 
+std::vector<uint32_t> Integrator::specialize(std::initializer_list<std::pair<uint32_t, int>> constants,
+											 std::vector<uint32_t> data) const {
+	if (!lumen_scene->config.specialize_kernels) {
+		return data;
+	}
+	for (const auto& [id, value] : constants) {
+		if (data.size() <= id) {
+			data.resize(id + 1, 0);
+		}
+		// 0 is left for the push constant fallback
+		data[id] = uint32_t(value + 1);
+	}
+	return data;
+}
+
 void Integrator::create_blas() {
 	std::vector<BlasInput> blas_inputs;
 	auto vertex_address = get_device_address(instance->vkb.ctx.device, vertex_buffer.handle);
@@ -314,6 +342,7 @@ void Integrator::update_uniform_buffers() {
 	scene_ubo.inv_projection = glm::inverse(camera->projection);
 	scene_ubo.model = glm::mat4(1.0);
 	scene_ubo.light_pos = glm::vec4(3.0f, 2.5f, 1.0f, 1.0f);
+	scene_ubo.write_aovs = writes_aovs();
 	memcpy(scene_ubo_buffer.data, &scene_ubo, sizeof(scene_ubo));
 }
 
@@ -337,6 +366,9 @@ void Integrator::destroy() {
 		b->destroy();
 	}
 	output_tex.destroy();
+	aov_albedo_depth.destroy();
+	aov_normal.destroy();
+	aov_stats.destroy();
 	for (auto& tex : scene_textures) {
 		tex.destroy();
 	}
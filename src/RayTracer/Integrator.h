@@ -13,6 +13,7 @@
 #include "shaders/commons.h"
 #include "LumenScene.h"
 #include "LumenUtils.h"
+#include "ParallelPrimitives.h"
 class Integrator {
    public:
 	Integrator(LumenInstance* instance, LumenScene* lumen_scene) : instance(instance), lumen_scene(lumen_scene) {}
@@ -22,13 +23,27 @@ class Integrator {
 	virtual bool update();
 	virtual void destroy();
 	void update_camera();
+	// Only integrators that fill the AOV images return true, the scene config decides whether they do
+	virtual bool supports_aovs() const { return false; }
+	bool writes_aovs() const { return supports_aovs() && lumen_scene->config.write_aovs; }
 	Texture2D output_tex;
+	// First hit albedo in rgb and linear depth in a, first hit shading normal in rgb, and sample count, mean
+	// luminance, its M2 and variance. All averaged over the accumulated frames, 1x1 if the AOVs aren't written
+	Texture2D aov_albedo_depth;
+	Texture2D aov_normal;
+	Texture2D aov_stats;
 	std::unique_ptr<Camera> camera = nullptr;
 	bool updated = false;
 	VkSampler texture_sampler;
 
    protected:
 	virtual void update_uniform_buffers();
+	// Bound after the lights, the shaders always declare them
+	std::array<ResourceBinding, 3> aov_bindings() { return {aov_albedo_depth, aov_normal, aov_stats}; }
+	// Specialization data that bakes the given config values (SPEC_* ids from commons.h) into the kernels, when
+	// the scene config enables it. Every combination of values is a separate pipeline
+	std::vector<uint32_t> specialize(std::initializer_list<std::pair<uint32_t, int>> constants,
+									 std::vector<uint32_t> data = {}) const;
 	SceneUBO scene_ubo{};
 	Buffer vertex_buffer;
 	Buffer normal_buffer;
@@ -86,7 +86,6 @@ void BDPTResampled::render() {
 			scene_desc_buffer,
 		})
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	//.finalize();
 
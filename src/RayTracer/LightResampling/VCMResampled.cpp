@@ -173,7 +173,6 @@ void VCMResampled::render() {
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 
 	// Check resampling
@@ -198,7 +197,6 @@ void VCMResampled::render() {
 		.zero(light_state_buffer)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	pc_ray.random_num = rand() % UINT_MAX;
 	// Trace spawned rays
@@ -213,7 +211,6 @@ void VCMResampled::render() {
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	// Select a reservoir sample
 	instance->vkb.rg
@@ -242,7 +239,6 @@ void VCMResampled::render() {
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 
 	if (!do_spatiotemporal) {
@@ -4,6 +4,7 @@
 #include <tinygltf/json.hpp>
 #pragma warning(pop)
 #include <tiny_obj_loader.h>
+#include <stb_image/stb_image.h>
 #include "shaders/commons.h"
 #include <cctype>
 
@@ -96,6 +97,12 @@ void LumenScene::load_scene(const std::string& path) {
 		if (!integrator_config["path_length"].is_null()) {
 			config.path_length = integrator_config["path_length"];
 		}
+		if (!integrator_config["specialize_kernels"].is_null()) {
+			config.specialize_kernels = integrator_config["specialize_kernels"];
+		}
+		if (!integrator_config["write_aovs"].is_null()) {
+			config.write_aovs = integrator_config["write_aovs"];
+		}
 		if (!integrator_config["sky_col"].is_null()) {
 			auto sky = integrator_config["sky_col"];
 			config.sky_col = glm::vec3(sky[0], sky[1], sky[2]);
@@ -307,17 +314,24 @@ void LumenScene::load_scene(const std::string& path) {
 		config.cam_settings.fov = mitsuba_parser.camera.fov / 2;
 		config.cam_settings.cam_matrix = mitsuba_parser.camera.cam_matrix;
 		prim_meshes.resize(mitsuba_parser.meshes.size());
+		// Parse the objs in parallel, the geometry is appended in order below
+		std::vector<tinyobj::ObjReader> readers(mitsuba_parser.meshes.size());
+		std::vector<uint8_t> parsed(mitsuba_parser.meshes.size(), 0);
+		ThreadPool::parallel_for(0, (uint32_t)mitsuba_parser.meshes.size(), [&](uint32_t m) {
+			if (mitsuba_parser.meshes[m].file != "") {
+				tinyobj::ObjReaderConfig reader_config;
+				parsed[m] = readers[m].ParseFromFile(root + mitsuba_parser.meshes[m].file, reader_config);
+			}
+		});
 		// Load objs
 		int i = 0;
-		for (const auto& mesh : mitsuba_parser.meshes) {
+		for (uint32_t m = 0; m < mitsuba_parser.meshes.size(); m++) {
+			const auto& mesh = mitsuba_parser.meshes[m];
 			if (mesh.file == "") {
 				continue;
 			}
-			const std::string mesh_file = root + mesh.file;
-			tinyobj::ObjReaderConfig reader_config;
-
-			tinyobj::ObjReader reader;
-			if (!reader.ParseFromFile(mesh_file, reader_config)) {
+			const tinyobj::ObjReader& reader = readers[m];
+			if (!parsed[m]) {
 				if (!reader.Error().empty()) {
 					std::cerr << "TinyObjReader: " << reader.Error();
 				}
@@ -486,3 +500,25 @@ void LumenScene::compute_scene_dimensions() {
 	m_dimensions.center = scene_bbox.center();
 	m_dimensions.radius = scene_bbox.radius();
 }
+
+void LumenScene::decode_textures() {
+	release_decoded_textures();
+	decoded_textures.resize(textures.size());
+	ThreadPool::parallel_for(0, (uint32_t)textures.size(), [this](uint32_t i) {
+		int n;
+		DecodedTexture& tex = decoded_textures[i];
+		tex.data = stbi_load(textures[i].c_str(), &tex.width, &tex.height, &n, 4);
+		if (!tex.data) {
+			LUMEN_WARN("Could not load texture {}", textures[i]);
+		}
+	});
+}
+
+void LumenScene::release_decoded_textures() {
+	for (DecodedTexture& tex : decoded_textures) {
+		if (tex.data) {
+			stbi_image_free(tex.data);
+		}
+	}
+	decoded_textures.clear();
+}
@@ -30,7 +30,15 @@ struct LumenLight {
 
 class LumenScene {
    public:
+	struct DecodedTexture {
+		int width = 0;
+		int height = 0;
+		unsigned char* data = nullptr;
+	};
 	void load_scene(const std::string& path);
+	// Decodes the textures to RGBA8 on the ThreadPool, the upload in Integrator::init() releases them
+	void decode_textures();
+	void release_decoded_textures();
 	std::vector<glm::vec3> positions;
 	std::vector<uint32_t> indices;
 	std::vector<glm::vec3> normals;
@@ -41,6 +49,7 @@ class LumenScene {
 	std::vector<LumenPrimMesh> prim_meshes;
 	std::vector<Material> materials;
 	std::vector<std::string> textures;
+	std::vector<DecodedTexture> decoded_textures;
 	std::vector<LumenLight> lights;
 
 	struct Dimensions {
@@ -111,27 +111,10 @@ void PSSMLT::init() {
 							  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE,
 							  path_size * (config.path_length + 1) * sizeof(MLTPathVertex));
 
-	int size = 0;
-	int arr_size = num_bootstrap_samples;
-	do {
-		int num_blocks = std::max(1, (int)ceil(arr_size / (2.0f * 1024)));
-		if (num_blocks > 1) {
-			size++;
-		}
-		arr_size = num_blocks;
-	} while (arr_size > 1);
-	block_sums.resize(size);
-	int i = 0;
-	arr_size = num_bootstrap_samples;
-	do {
-		int num_blocks = std::max(1, (int)ceil(arr_size / (2.0f * 1024)));
-		if (num_blocks > 1) {
-			block_sums[i++].create(
-				&instance->vkb.ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, num_blocks * sizeof(float));
-		}
-		arr_size = num_blocks;
-	} while (arr_size > 1);
+	scan_state_buffer.create("Scan State", &instance->vkb.ctx,
+							 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+							 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE,
+							 scan_state_size(num_bootstrap_samples));
 
 	SceneDesc desc;
 	desc.vertex_addr = vertex_buffer.get_device_address();
@@ -227,11 +210,16 @@ void PSSMLT::render() {
 		.zero({light_path_buffer, camera_path_buffer})
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 
-	int counter = 0;
-	prefix_scan(0, num_bootstrap_samples, counter, instance->vkb.rg.get());
+	// Unnormalized CDF of the bootstrap luminances
+	add_scan(instance->vkb.rg.get(), "PrefixScan",
+			 {.buffer = &bootstrap_buffer,
+			  .num_elems = (uint32_t)num_bootstrap_samples,
+			  .stride = sizeof(BootstrapSample) / sizeof(float),
+			  .offset = offsetof(BootstrapSample, lum) / sizeof(float),
+			  .scale = 1.0f / num_bootstrap_samples},
+			 scan_state_buffer, cdf_buffer);
 	// Calculate CDF
 	instance->vkb.rg
 		->add_compute("Calculate CDF",
@@ -240,42 +228,6 @@ void PSSMLT::render() {
 		.push_constants(&pc_ray)
 		.bind(scene_desc_buffer);
 
-#if 0
-	// Debugging code
-	cdf_buffer.copy(cdf_cpu, cmd.handle);
-	bootstrap_buffer.copy(bootstrap_cpu, cmd.handle);
-	cmd.submit();
-	std::vector<BootstrapSample> samples;
-	samples.assign((BootstrapSample*)bootstrap_cpu.data,
-				   (BootstrapSample*)bootstrap_cpu.data + config->num_bootstrap_samples);
-	std::vector<float> cdf1(config->num_bootstrap_samples, 0);
-	std::vector<float> cdf2(config->num_bootstrap_samples, 0);
-
-	cdf1[0] = 0;
-	for (int i = 1; i < config->num_bootstrap_samples; i++) {
-		cdf1[i] = cdf1[i - 1] + samples[i - 1].lum / config->num_bootstrap_samples;
-	}
-	float sum = cdf1[config->num_bootstrap_samples - 1];
-	for (int i = 1; i < config->num_bootstrap_samples; i++) {
-		cdf1[i] *= 1. / sum;
-	}
-	cdf2.assign((float*)cdf_cpu.data,
-				(float*)cdf_cpu.data + config->num_bootstrap_samples);
-	float EPS = 1e-3;
-	for (int i = 0; i < config->num_bootstrap_samples; i++) {
-		float val1 = cdf1[i];
-		float val2 = cdf2[i];
-		float diff = abs(val1 - val2);
-		if (diff > EPS) {
-			assert(false);
-		}
-
-	}
-	sum = cdf1[config->num_bootstrap_samples - 1];
-	float sum2 = cdf2[config->num_bootstrap_samples - 1];
-	return;
-#endif
-
 	// Select seeds
 	instance->vkb.rg
 		->add_compute("Select Seeds", {.shader = Shader("src/shaders/integrators/pssmlt/select_seeds.comp"),
@@ -296,7 +248,6 @@ void PSSMLT::render() {
 		.zero({light_path_buffer, camera_path_buffer})
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 
 	instance->vkb.rg->run_and_submit(cmd);
@@ -317,7 +268,6 @@ void PSSMLT::render() {
 				.zero({light_path_buffer, camera_path_buffer})
 				.bind(rt_bindings)
 				.bind(mesh_lights_buffer)
-				.bind_texture_array(scene_textures)
 				.bind_tlas(instance->vkb.tlas);
 		};
 		const uint32_t iter_cnt = 100;
@@ -361,72 +311,6 @@ bool PSSMLT::update() {
 	return updated;
 }
 
-void PSSMLT::prefix_scan(int level, int num_elems, int& counter, RenderGraph* rg) {
-	const bool scan_sums = level > 0;
-	int num_wgs = std::max(1, (int)ceil(num_elems / (2 * 1024.0f)));
-	int num_grids = num_wgs - int((num_elems % 2048) != 0);
-	pc_compute.num_elems = num_elems;
-	auto scan = [&](int num_wgs, int idx) {
-		++counter;
-		rg->add_compute("PrefixScan - Scan", {.shader = Shader("src/shaders/integrators/pssmlt/prefix_scan.comp"),
-											  .dims = {(uint32_t)num_wgs, 1, 1}})
-			.push_constants(&pc_compute)
-			.bind(scene_desc_buffer);
-	};
-	auto uniform_add = [&](int num_wgs, int output_idx) {
-		++counter;
-		rg->add_compute(
-			  "PrefixScan - Uniform Add",
-			  {.shader = Shader("src/shaders/integrators/pssmlt/uniform_add.comp"), .dims = {(uint32_t)num_wgs, 1, 1}})
-			.push_constants(&pc_compute)
-			.bind(scene_desc_buffer);
-	};
-	if (num_wgs > 1) {
-		pc_compute.base_idx = 0;
-		pc_compute.block_idx = 0;
-		pc_compute.n = 2 * 1024;
-		pc_compute.store_sum = 1;
-		pc_compute.scan_sums = int(scan_sums);
-		pc_compute.block_sum_addr = block_sums[level].get_device_address();
-		scan(num_grids, level);
-		int rem = num_elems % (2 * 1024);
-		if (rem) {
-			pc_compute.base_idx = num_elems - rem;
-			pc_compute.block_idx = num_wgs - 1;
-			pc_compute.n = rem;
-			scan(1, level);
-		}
-		prefix_scan(level + 1, num_wgs, counter, rg);
-		pc_compute.base_idx = 0;
-		pc_compute.block_idx = 0;
-		pc_compute.n = num_elems - rem;
-		pc_compute.store_sum = 1;
-		pc_compute.scan_sums = int(scan_sums);
-		pc_compute.block_sum_addr = block_sums[level].get_device_address();
-		if (scan_sums) {
-			pc_compute.out_addr = block_sums[level - 1].get_device_address();
-		}
-		uniform_add(num_grids, level - 1);
-		if (rem) {
-			pc_compute.base_idx = num_elems - rem;
-			pc_compute.block_idx = num_wgs - 1;
-			pc_compute.n = rem;
-			uniform_add(1, level - 1);
-		}
-	} else {
-		int rem = num_elems % 2048;
-		pc_compute.n = rem == 0 ? 2048 : rem;
-		pc_compute.base_idx = 0;
-		pc_compute.block_idx = 0;
-		pc_compute.store_sum = 0;
-		pc_compute.scan_sums = bool(scan_sums);
-		if (scan_sums) {
-			pc_compute.block_sum_addr = block_sums[level - 1].get_device_address();
-		}
-		scan(num_wgs, level - 1);
-	}
-}
-
 void PSSMLT::destroy() {
 	Integrator::destroy();
 	std::vector<Buffer*> buffer_list = {&bootstrap_buffer,
@@ -446,9 +330,7 @@ void PSSMLT::destroy() {
 	for (auto b : buffer_list) {
 		b->destroy();
 	}
-	for (auto& b : block_sums) {
-		b.destroy();
-	}
+	scan_state_buffer.destroy();
 	if (bootstrap_cpu.size) {
 		bootstrap_cpu.destroy();
 	}
@@ -19,9 +19,7 @@ class PSSMLT : public Integrator {
 	virtual void destroy() override;
 
    private:
-	void prefix_scan(int level, int num_elems, int& counter, RenderGraph* rg);
 	PCMLT pc_ray{};
-	PushConstantCompute pc_compute{};
 	// PSSMLT buffers
 	Buffer bootstrap_buffer;
 	Buffer cdf_buffer;
@@ -41,7 +39,7 @@ class PSSMLT : public Integrator {
 	Buffer bootstrap_cpu;
 	Buffer cdf_cpu;
 
-	std::vector<Buffer> block_sums;
+	Buffer scan_state_buffer;
 
 	int mutation_count;
 	int light_path_rand_count;
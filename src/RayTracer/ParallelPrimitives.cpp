@@ -0,0 +1,216 @@
+#include "LumenPCH.h"
+#include "ParallelPrimitives.h"
+#include <random>
+
+// Has to match the kernels in src/shaders/primitives
+static constexpr uint32_t REDUCE_GROUP_SIZE = 1024;
+static constexpr uint32_t SCAN_BLOCK_SIZE = 1024 * 4;
+
+static PCPrimitives primitive_pc(const PrimitiveInput& input, bool inclusive) {
+	PCPrimitives pc;
+	pc.num_elems = input.num_elems;
+	pc.stride = input.stride;
+	pc.offset = input.offset;
+	pc.scale = input.scale;
+	pc.inclusive = uint32_t(inclusive);
+	return pc;
+}
+
+VkDeviceSize reduce_scratch_size(uint32_t num_elems, uint32_t elem_size) {
+	const uint32_t num_groups = std::max(1u, (num_elems + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE);
+	return sizeof(uint32_t) + VkDeviceSize(num_groups) * elem_size;
+}
+
+VkDeviceSize scan_state_size(uint32_t num_elems) {
+	const uint32_t num_blocks = std::max(1u, (num_elems + SCAN_BLOCK_SIZE - 1) / SCAN_BLOCK_SIZE);
+	return sizeof(uint32_t) * (1 + 3 * VkDeviceSize(num_blocks));
+}
+
+RenderPass& add_reduce(RenderGraph* rg, const std::string& name, ReduceOp op, const PrimitiveInput& input,
+					   Buffer& scratch, Buffer& output) {
+	LUMEN_ASSERT(scratch.size >= reduce_scratch_size(input.num_elems), "Reduction scratch buffer is too small");
+	PCPrimitives pc = primitive_pc(input, false);
+	const uint32_t num_groups = std::max(1u, (input.num_elems + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE);
+	const std::initializer_list<ResourceBinding> bindings = {*input.buffer, scratch, output};
+	return rg
+		->add_compute(name, {.shader = Shader("src/shaders/primitives/reduce.comp"),
+							 .macros = {{"REDUCE_OP", int(op)}},
+							 .dims = {num_groups, 1, 1}})
+		.push_constants(&pc)
+		.bind(bindings);
+}
+
+RenderPass& add_scan(RenderGraph* rg, const std::string& name, const PrimitiveInput& input, Buffer& state,
+					 Buffer& output, bool inclusive) {
+	LUMEN_ASSERT(state.size >= scan_state_size(input.num_elems), "Scan state buffer is too small");
+	PCPrimitives pc = primitive_pc(input, inclusive);
+	const uint32_t num_blocks = std::max(1u, (input.num_elems + SCAN_BLOCK_SIZE - 1) / SCAN_BLOCK_SIZE);
+	const std::initializer_list<ResourceBinding> bindings = {*input.buffer, output, state};
+	return rg
+		->add_compute(name, {.shader = Shader("src/shaders/primitives/scan.comp"), .dims = {num_blocks, 1, 1}})
+		.push_constants(&pc)
+		.bind(bindings)
+		.zero(state);
+}
+
+RenderPass& add_indirect_args(RenderGraph* rg, const std::string& name, Buffer& counts, uint32_t count_idx,
+							  uint32_t group_size, Buffer& args, uint32_t max_groups) {
+	LUMEN_ASSERT(args.usage_flags & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, "Indirect argument buffer lacks the usage");
+	PCIndirectArgs pc;
+	pc.count_idx = count_idx;
+	pc.group_size = group_size;
+	pc.max_groups = max_groups;
+	const std::initializer_list<ResourceBinding> bindings = {counts, args};
+	return rg->add_compute(name, {.shader = Shader("src/shaders/primitives/indirect_args.comp"), .dims = {1, 1, 1}})
+		.push_constants(&pc)
+		.bind(bindings);
+}
+
+bool validate_primitives(RenderGraph* rg, VulkanContext* ctx) {
+	// Around the workgroup and scan block boundaries, read through a strided and scaled view
+	const uint32_t sizes[] = {1, REDUCE_GROUP_SIZE - 1, REDUCE_GROUP_SIZE + 1, SCAN_BLOCK_SIZE + 1, (1 << 20) + 17};
+	const uint32_t stride = 2;
+	const uint32_t offset = 1;
+	const float scale = 0.5f;
+	const ReduceOp ops[] = {ReduceOp::Sum, ReduceOp::Min, ReduceOp::Max};
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> dist(0.01f, 1.0f);
+	bool valid = true;
+	for (uint32_t num_elems : sizes) {
+		std::vector<float> data(num_elems * stride);
+		std::vector<float> elems(num_elems);
+		for (uint32_t i = 0; i < data.size(); i++) {
+			data[i] = dist(rng);
+		}
+		for (uint32_t i = 0; i < num_elems; i++) {
+			elems[i] = data[i * stride + offset] * scale;
+		}
+
+		Buffer input, scratch, state, reduce_outputs[3], scan_outputs[2], readback;
+		input.create("Primitives - Input", ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, data.size() * sizeof(float),
+					 data.data(), true);
+		std::vector<uint8_t> zeros(reduce_scratch_size(num_elems), 0);
+		scratch.create("Primitives - Reduce Scratch", ctx,
+					   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, zeros.size(), zeros.data(), true);
+		state.create("Primitives - Scan State", ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, scan_state_size(num_elems));
+		for (Buffer& output : reduce_outputs) {
+			output.create("Primitives - Reduce Output", ctx,
+						  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+						  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, sizeof(float));
+		}
+		for (Buffer& output : scan_outputs) {
+			output.create("Primitives - Scan Output", ctx,
+						  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+						  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, num_elems * sizeof(float));
+		}
+		const VkDeviceSize scan_offset = 3 * sizeof(float);
+		readback.create("Primitives - Readback", ctx, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+						VK_SHARING_MODE_EXCLUSIVE, scan_offset + 2 * num_elems * sizeof(float));
+
+		CommandBuffer cmd(ctx, /*start*/ true, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		const PrimitiveInput primitive_input = {
+			.buffer = &input, .num_elems = num_elems, .stride = stride, .offset = offset, .scale = scale};
+		for (uint32_t i = 0; i < 3; i++) {
+			add_reduce(rg, "Validate Reduce", ops[i], primitive_input, scratch, reduce_outputs[i])
+				.copy(reduce_outputs[i], Resource(readback, i * sizeof(float)));
+		}
+		for (uint32_t i = 0; i < 2; i++) {
+			add_scan(rg, "Validate Scan", primitive_input, state, scan_outputs[i], i == 1)
+				.copy(scan_outputs[i], Resource(readback, scan_offset + i * num_elems * sizeof(float)));
+		}
+		rg->run_and_submit(cmd);
+
+		readback.map();
+		const float* results = (const float*)readback.data;
+		for (uint32_t i = 0; i < 3; i++) {
+			const float reference = reduce_reference(elems, ops[i]);
+			const float err = max_relative_error({results + i, 1}, {&reference, 1});
+			if (err > 1e-4f) {
+				LUMEN_WARN("Reduction {} of {} elements: {} instead of {}", i, num_elems, results[i], reference);
+				valid = false;
+			}
+		}
+		for (uint32_t i = 0; i < 2; i++) {
+			const std::vector<float> reference = scan_reference(elems, i == 1);
+			const float err = max_relative_error({results + 3 + i * num_elems, num_elems}, reference);
+			if (err > 1e-3f) {
+				LUMEN_WARN("{} scan of {} elements: max relative error {}", i == 1 ? "Inclusive" : "Exclusive",
+						   num_elems, err);
+				valid = false;
+			}
+		}
+		readback.unmap();
+		for (Buffer* buffer : {&input, &scratch, &state, &readback}) {
+			buffer->destroy();
+		}
+		for (Buffer& output : reduce_outputs) {
+			output.destroy();
+		}
+		for (Buffer& output : scan_outputs) {
+			output.destroy();
+		}
+	}
+	LUMEN_TRACE("Reduction and scan validation {}", valid ? "passed" : "failed");
+	return valid;
+}
+
+float reduce_reference(std::span<const float> data, ReduceOp op) {
+	switch (op) {
+		case ReduceOp::Sum: {
+			// Pairwise like the GPU, a running float sum drifts on large inputs
+			if (data.size() <= 8) {
+				float sum = 0.0f;
+				for (float v : data) {
+					sum += v;
+				}
+				return sum;
+			}
+			const size_t half = data.size() / 2;
+			return reduce_reference(data.first(half), op) + reduce_reference(data.subspan(half), op);
+		}
+		case ReduceOp::Min: {
+			float res = FLT_MAX;
+			for (float v : data) {
+				res = std::min(res, v);
+			}
+			return res;
+		}
+		case ReduceOp::Max: {
+			float res = -FLT_MAX;
+			for (float v : data) {
+				res = std::max(res, v);
+			}
+			return res;
+		}
+	}
+	return 0.0f;
+}
+
+std::vector<float> scan_reference(std::span<const float> data, bool inclusive) {
+	std::vector<float> res(data.size());
+	double sum = 0.0;
+	for (size_t i = 0; i < data.size(); i++) {
+		if (inclusive) {
+			sum += data[i];
+			res[i] = float(sum);
+		} else {
+			res[i] = float(sum);
+			sum += data[i];
+		}
+	}
+	return res;
+}
+
+float max_relative_error(std::span<const float> result, std::span<const float> reference) {
+	LUMEN_ASSERT(result.size() == reference.size(), "Result and reference sizes differ");
+	float err = 0.0f;
+	for (size_t i = 0; i < result.size(); i++) {
+		const float denom = std::max(std::abs(reference[i]), 1e-6f);
+		err = std::max(err, std::abs(result[i] - reference[i]) / denom);
+	}
+	return err;
+}
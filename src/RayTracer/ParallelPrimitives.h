@@ -0,0 +1,49 @@
+#pragma once
+#include "LumenPCH.h"
+#include "Framework/RenderGraph.h"
+#include "shaders/commons.h"
+#include <span>
+
+/*
+	GPU reductions and prefix sums that finish in a single dispatch, and the arguments of indirect passes sized by
+	GPU-side counters, see src/shaders/primitives.
+	The passes take their buffers as bindings, so the render graph orders them with the surrounding passes.
+	The CPU references compute the same results, for validating the kernels on readbacks.
+*/
+
+enum class ReduceOp : uint32_t { Sum = REDUCE_SUM, Min = REDUCE_MIN, Max = REDUCE_MAX };
+
+// Strided float view of a buffer: element i is buffer[i * stride + offset] * scale
+struct PrimitiveInput {
+	Buffer* buffer = nullptr;
+	uint32_t num_elems = 0;
+	uint32_t stride = 1;
+	uint32_t offset = 0;
+	float scale = 1.0f;
+};
+
+// Scratch of a single-pass reduction, has to be zero on creation but is left zeroed by every reduction
+VkDeviceSize reduce_scratch_size(uint32_t num_elems, uint32_t elem_size = sizeof(float));
+// State of a scan, cleared by the scan pass itself
+VkDeviceSize scan_state_size(uint32_t num_elems);
+
+// Reduces the input into the first float of output
+RenderPass& add_reduce(RenderGraph* rg, const std::string& name, ReduceOp op, const PrimitiveInput& input,
+					   Buffer& scratch, Buffer& output);
+// Prefix sum of the input into the first num_elems floats of output
+RenderPass& add_scan(RenderGraph* rg, const std::string& name, const PrimitiveInput& input, Buffer& state,
+					 Buffer& output, bool inclusive = false);
+
+// Writes the arguments of an indirect pass covering the uint at count_idx of counts into the start of args:
+// workgroups of group_size for a dispatch, group_size 1 for a ray launch. Clamped to max_groups
+RenderPass& add_indirect_args(RenderGraph* rg, const std::string& name, Buffer& counts, uint32_t count_idx,
+							  uint32_t group_size, Buffer& args, uint32_t max_groups = UINT32_MAX);
+
+// Runs the reductions and scans on random data of a few sizes and compares the readbacks to the CPU references,
+// see --validate-primitives. Submits and waits on its own command buffers, so it is meant for startup only
+bool validate_primitives(RenderGraph* rg, VulkanContext* ctx);
+
+float reduce_reference(std::span<const float> data, ReduceOp op);
+std::vector<float> scan_reference(std::span<const float> data, bool inclusive = false);
+// Largest difference relative to the magnitude of the reference
+float max_relative_error(std::span<const float> result, std::span<const float> reference);
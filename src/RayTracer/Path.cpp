@@ -37,6 +37,7 @@ void Path::render() {
 									  {"src/shaders/ray_shadow.rmiss"},
 									  {"src/shaders/ray.rchit"},
 									  {"src/shaders/ray.rahit"}},
+						  .specialization_data = specialize({{SPEC_MAX_DEPTH, config.path_length}}),
 						  .dims = {instance->width, instance->height},
 						  .accel = instance->vkb.tlas.accel})
 		.push_constants(&pc_ray)
@@ -46,7 +47,7 @@ void Path::render() {
 			scene_desc_buffer,
 		})
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
+		.bind(aov_bindings())
 		//.write(output_tex) // Needed if the automatic shader inference is disabled
 		.bind_tlas(instance->vkb.tlas);
 	instance->vkb.rg->run_and_submit(cmd);
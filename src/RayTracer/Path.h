@@ -12,6 +12,7 @@ class Path : public Integrator {
 	virtual void render() override;
 	virtual bool update() override;
 	virtual void destroy() override;
+	virtual bool supports_aovs() const override { return true; }
 
    private:
 	PCPath pc_ray{};
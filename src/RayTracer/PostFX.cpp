@@ -1,6 +1,10 @@
 #include "LumenPCH.h"
 #include "PostFX.h"
 
+void PostFX::load_kernel() {
+	kernel_data = load_exr("assets/kernels/Octagonal512.exr", kernel_width, kernel_height);
+}
+
 void PostFX::init(LumenInstance& instance) {
 	ctx = &instance.vk_ctx;
 	rg = instance.vkb.rg.get();
@@ -15,17 +19,17 @@ void PostFX::init(LumenInstance& instance) {
 	sampler_ci.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
 	vk::check(vkCreateSampler(instance.vkb.ctx.device, &sampler_ci, nullptr, &img_sampler),
 			  "Could not create image sampler");
-	// Load the kernel
-	const char* img_name_kernel = "assets/kernels/Octagonal512.exr";
-	int width, height;
-	float* data = load_exr(img_name_kernel, width, height);
-	auto img_dims = VkExtent2D{(uint32_t)width, (uint32_t)height};
+	if (!kernel_data) {
+		load_kernel();
+	}
+	auto img_dims = VkExtent2D{(uint32_t)kernel_width, (uint32_t)kernel_height};
 	auto ci = make_img2d_ci(img_dims, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT, false);
 	Texture2D kernel_org;
-	kernel_org.load_from_data(&instance.vkb.ctx, data, width * height * 4 * sizeof(float), ci, img_sampler,
-							  VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false);
-	if (data) {
-		free(data);
+	kernel_org.load_from_data(&instance.vkb.ctx, kernel_data, kernel_width * kernel_height * 4 * sizeof(float), ci,
+							  img_sampler, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, false);
+	if (kernel_data) {
+		free(kernel_data);
+		kernel_data = nullptr;
 	}
 	// Compute padded sizes
 	auto padded_width = 1 << uint32_t(ceil(log2(double(instance.width + kernel_org.base_extent.width))));
@@ -37,8 +41,9 @@ void PostFX::init(LumenInstance& instance) {
 
 	settings.format = VK_FORMAT_R32G32B32A32_SFLOAT;
 	settings.usage_flags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
-	fft_ping_padded.create_empty_texture("FFT - Ping", ctx, settings, VK_IMAGE_LAYOUT_GENERAL, img_sampler);
-	fft_pong_padded.create_empty_texture("FFT - Pong", ctx, settings, VK_IMAGE_LAYOUT_GENERAL, img_sampler);
+	// Only live during the bloom passes, their memory can be shared with other transients
+	rg->add_transient(fft_ping_padded, "FFT - Ping", settings, img_sampler);
+	rg->add_transient(fft_pong_padded, "FFT - Pong", settings, img_sampler);
 	kernel_ping.create_empty_texture("Kernel - Ping", ctx, settings, VK_IMAGE_LAYOUT_GENERAL, img_sampler);
 	kernel_pong.create_empty_texture("Kernel - Pong", ctx, settings, VK_IMAGE_LAYOUT_GENERAL, img_sampler);
 
@@ -91,7 +96,9 @@ void PostFX::render(Texture2D& input, Texture2D& output) {
 		uint32_t pad_width = (fft_ping_padded.base_extent.width + 31) / 32;
 		uint32_t pad_height = (fft_ping_padded.base_extent.height + 31) / 32;
 		rg->add_compute("Pad Image",
-						{.shader = Shader("src/shaders/bloom/pad.comp"), .dims = {pad_width, pad_height, 1}})
+						{.shader = Shader("src/shaders/bloom/pad.comp"),
+						 .dims = {pad_width, pad_height, 1},
+						 .async_compute = true})
 			.bind(input, img_sampler)
 			.bind(fft_ping_padded);
 		uint32_t wg_size_x = fft_ping_padded.base_extent.width;
@@ -112,7 +119,8 @@ void PostFX::render(Texture2D& input, Texture2D& output) {
 		rg->add_compute("FFT - Horizontal", {.shader = Shader("src/shaders/bloom/fft.comp"),
 											 .macros = macros_x,
 											 .specialization_data = {wg_size_x / RADIX_X, uint32_t(vertical), 0},
-											 .dims = {dim_y, 1, 1}})
+											 .dims = {dim_y, 1, 1},
+											 .async_compute = true})
 			.bind(fft_ping_padded, img_sampler)
 			.bind(fft_pong_padded)
 			.bind(kernel_pong, img_sampler);
@@ -120,7 +128,8 @@ void PostFX::render(Texture2D& input, Texture2D& output) {
 		rg->add_compute("FFT - Vertical", {.shader = Shader("src/shaders/bloom/fft.comp"),
 										   .macros = macros_y,
 										   .specialization_data = {wg_size_y / RADIX_Y, uint32_t(vertical), 0},
-										   .dims = {dim_x, 1, 1}})
+										   .dims = {dim_x, 1, 1},
+										   .async_compute = true})
 			.bind(fft_ping_padded, img_sampler)
 			.bind(fft_pong_padded)
 			.bind(kernel_pong, img_sampler);
@@ -128,7 +137,8 @@ void PostFX::render(Texture2D& input, Texture2D& output) {
 						{.shader = Shader("src/shaders/bloom/fft.comp"),
 						 .macros = macros_y,
 						 .specialization_data = {wg_size_y / RADIX_Y, uint32_t(vertical), 1},
-						 .dims = {dim_x, 1, 1}})
+						 .dims = {dim_x, 1, 1},
+						 .async_compute = true})
 			.bind(fft_ping_padded, img_sampler)
 			.bind(fft_pong_padded)
 			.bind(kernel_pong, img_sampler);
@@ -137,7 +147,8 @@ void PostFX::render(Texture2D& input, Texture2D& output) {
 						{.shader = Shader("src/shaders/bloom/fft.comp"),
 						 .macros = macros_x,
 						 .specialization_data = {wg_size_x / RADIX_X, uint32_t(vertical), 1},
-						 .dims = {dim_y, 1, 1}})
+						 .dims = {dim_y, 1, 1},
+						 .async_compute = true})
 			.bind(fft_ping_padded, img_sampler)
 			.bind(fft_pong_padded)
 			.bind(kernel_pong, img_sampler);
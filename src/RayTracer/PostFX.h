@@ -9,6 +9,8 @@
 
 class PostFX {
 public:
+	// Decodes the bloom kernel, doesn't touch the device so it can run before the instance is set up
+	void load_kernel();
 	void init(LumenInstance& instance);
 	void render(Texture2D& input, Texture2D& output);
 	bool gui();
@@ -20,6 +22,9 @@ private:
 	Texture2D fft_ping_padded;
 	Texture2D fft_pong_padded;
 	VkSampler img_sampler;
+	float* kernel_data = nullptr;
+	int kernel_width = 0;
+	int kernel_height = 0;
 
 	VulkanContext* ctx = nullptr;
 	RenderGraph* rg = nullptr;
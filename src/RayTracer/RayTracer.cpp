@@ -10,119 +10,231 @@
 #include <string.h>
 #include <ranges>
 #include "IntegratorRegistry.h"
+#include "Framework/TaskGraph.h"
 
 RayTracer* RayTracer::instance = nullptr;
-bool load_reference = false;
-bool calc_rmse = false;
 
 RayTracer::RayTracer(int width, int height, bool debug, int argc, char* argv[]) : LumenInstance(width, height, debug) {
 	this->instance = this;
 	parse_args(argc, argv);
 }
 
+// Builds the SPIR-V of the shader_variants.txt entries of the given owners, so that the first frame only has to
+// create the pipelines
+static void prewarm_shader_variants(std::initializer_list<std::string_view> owners) {
+#ifdef LUMEN_SHADER_MANIFEST
+	const char* manifest_path = LUMEN_SHADER_MANIFEST;
+#else
+	const char* manifest_path = "src/shaders/shader_variants.txt";
+#endif
+	std::ifstream manifest(manifest_path);
+	if (!manifest) {
+		LUMEN_WARN("Shader variant manifest {} not found, the shaders are compiled at the first frame", manifest_path);
+		return;
+	}
+	std::vector<std::pair<std::string, std::vector<std::string>>> variants;
+	std::string line;
+	while (std::getline(manifest, line)) {
+		std::istringstream fields(line);
+		std::string owner, path;
+		if (!(fields >> owner >> path) || owner[0] == '#' ||
+			std::find(owners.begin(), owners.end(), owner) == owners.end()) {
+			continue;
+		}
+		std::vector<std::string> macros;
+		for (std::string macro; fields >> macro;) {
+			macros.push_back(macro);
+		}
+		variants.emplace_back(path, std::move(macros));
+	}
+	TaskGroup compiles;
+	for (const auto& [path, macros] : variants) {
+		compiles.run("compile:" + path, [&path, &macros] {
+			if (!Shader::prewarm(path, macros)) {
+				LUMEN_WARN("Could not prewarm shader {}", path);
+			}
+		});
+	}
+	compiles.wait();
+}
+
+// Case insensitive lookup in the IntegratorRegistry, falls back to the path tracer
+static std::string_view resolve_integrator_id(std::string_view integrator_id) {
+	if (IntegratorRegistry::integrators.contains(integrator_id)) {
+		return integrator_id;
+	}
+	for (const auto& [id, entry] : IntegratorRegistry::integrators) {
+		if (id.size() != integrator_id.size())
+			continue;
+		bool char_wrong{false};
+		for (int i : std::ranges::iota_view(0, static_cast<int>(id.size())))
+			char_wrong |= std::tolower(id[i]) != std::tolower(integrator_id[i]);
+		if (!char_wrong) {
+			return id;
+		}
+	}
+	std::string report_string = std::string("Integrator ") + std::string(integrator_id) +
+								" can not be found, using standard Path tracer.\nAvailable options are:\n";
+	for (const auto& [id, entry] : IntegratorRegistry::integrators) {
+		report_string += "    ";
+		report_string += id;
+		report_string += "\n";
+	}
+	LUMEN_WARN(report_string);
+	return "Path";
+}
+
 void RayTracer::init(Window* window) {
 	srand((uint32_t)time(NULL));
 	this->window = window;
 	vkb.ctx.window_ptr = window->get_window_ptr();
-	// Init with ray tracing extensions
-	vkb.add_device_extension(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
-	vkb.add_device_extension(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME);
-	vkb.add_device_extension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
-	vkb.add_device_extension(VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME);
-	vkb.add_device_extension(VK_EXT_SHADER_ATOMIC_FLOAT_EXTENSION_NAME);
-	vkb.add_device_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
-	vkb.add_device_extension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
-	vkb.add_device_extension(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
-
-	vkb.create_instance();
-	if (vkb.enable_validation_layers) {
-		vkb.setup_debug_messenger();
-	}
-	vkb.create_surface();
-	vkb.pick_physical_device();
-	vkb.create_logical_device();
-	vkb.create_swapchain();
-	vkb.create_command_pools();
-	vkb.create_command_buffers();
-	vkb.create_sync_primitives();
-	vkb.init_imgui();
-	initialized = true;
-
-	scene.load_scene(scene_name);
-
-	// Enable shader reflections for the render graph
-	vkb.rg->settings.shader_inference = enable_shader_inference;
-	// Disable event based synchronization
-	// Currently the event API that comes with Vulkan 1.3 is buggy on NVIDIA drivers
-	// so this is turned off and pipeline barriers are used instead
-	vkb.rg->settings.use_events = use_events;
-
-	create_integrator(scene.config.integrator_name);
-	integrator->init();
-	post_fx.init(*instance);
-	init_resources();
+
+	// Startup as a dependency graph: the device setup overlaps with scene parsing, texture and kernel decoding and
+	// shader compilation, the GPU work joins once its inputs are there
+	TaskGraph startup;
+	auto device = startup.add(
+		"Device setup",
+		[this] {
+			// Init with ray tracing extensions
+			vkb.add_device_extension(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
+			vkb.add_device_extension(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME);
+			vkb.add_device_extension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
+			vkb.add_device_extension(VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME);
+			vkb.add_device_extension(VK_EXT_SHADER_ATOMIC_FLOAT_EXTENSION_NAME);
+			vkb.add_device_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			vkb.add_device_extension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+			vkb.add_device_extension(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+
+			vkb.create_instance();
+			if (vkb.enable_validation_layers) {
+				vkb.setup_debug_messenger();
+			}
+			vkb.create_surface();
+			vkb.pick_physical_device();
+			vkb.create_logical_device();
+			vkb.create_swapchain();
+			vkb.create_command_pools();
+			vkb.create_command_buffers();
+			vkb.create_sync_primitives();
+			vkb.init_imgui();
+			initialized = true;
+
+			// Enable shader reflections for the render graph
+			vkb.rg->settings.shader_inference = enable_shader_inference;
+			// Disable event based synchronization
+			// Currently the event API that comes with Vulkan 1.3 is buggy on NVIDIA drivers
+			// so this is turned off and pipeline barriers are used instead
+			vkb.rg->settings.use_events = use_events;
+		},
+		{}, true);
+	auto scene_parse = startup.add("Scene parsing", [this] {
+		scene.load_scene(scene_name);
+		scene.config.integrator_name = resolve_integrator_id(scene.config.integrator_name);
+		scene.config.write_aovs |= aovs_arg;
+	});
+	auto texture_decode = startup.add("Texture decoding", [this] { scene.decode_textures(); }, {scene_parse});
+	auto kernel_decode = startup.add("Bloom kernel decoding", [this] { post_fx.load_kernel(); });
+	auto common_shaders =
+		startup.add("Common shaders", [] { prewarm_shader_variants({"Common", "RayTracer", "Primitives", "PostFX"}); });
+	startup.add(
+		"Integrator shaders",
+		[this] { prewarm_shader_variants({std::string_view(scene.config.integrator_name)}); }, {scene_parse});
+	auto integrator_init = startup.add(
+		"Integrator setup",
+		[this] {
+			create_integrator(scene.config.integrator_name);
+			integrator->init();
+		},
+		{device, scene_parse, texture_decode}, true);
+	// Runs the bloom kernel FFT through the render graph, which should find its shaders built
+	startup.add("PostFX setup", [this] { post_fx.init(*instance); }, {integrator_init, kernel_decode, common_shaders},
+				true);
+	startup.add("Output resources", [this] { init_resources(); }, {integrator_init}, true);
+	startup.run();
+	startup.log_timings();
+	if (validate_primitives_arg) {
+		primitives_valid = validate_primitives(vkb.rg.get(), &vkb.ctx);
+	}
+	convergence.init(convergence_settings, reference_path, scene.config.integrator_name);
+	if (ThreadPool::profiling()) {
+		// Shows whether startup was bound by compilation, I/O or waiting on the main thread
+		if (ThreadPool::write_trace("lumen_startup_trace.json")) {
+			LUMEN_INFO("Wrote the startup trace to lumen_startup_trace.json");
+		}
+	}
 	LUMEN_TRACE("Memory usage {} MB", get_memory_usage(vk_ctx.physical_device) * 1e-6);
 }
 
 void RayTracer::init_resources() {
-	RTUtilsDesc desc;
+	RTUtilsDesc desc = {};
 	output_img_buffer.create("Output Image Buffer", &instance->vkb.ctx,
 							 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
 								 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 							 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE,
 							 instance->width * instance->height * 4 * 4);
 
-	output_img_buffer_cpu.create("Output Image CPU", &instance->vkb.ctx,
-								 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-								 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-								 VK_SHARING_MODE_EXCLUSIVE, instance->width * instance->height * 4 * 4);
-	residual_buffer.create("RMSE Residual", &instance->vkb.ctx,
-						   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-							   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-						   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE,
-						   instance->width * instance->height * 4);
-
-	counter_buffer.create("RMSE Counter", &instance->vkb.ctx,
-						  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-							  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-						  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, sizeof(int));
+	init_readback();
+	// Zeroed once, the reduction leaves it cleared
+	std::vector<uint8_t> rmse_scratch(reduce_scratch_size(instance->width * instance->height), 0);
+	rmse_scratch_buffer.create("RMSE Scratch", &instance->vkb.ctx,
+							   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+							   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, rmse_scratch.size(),
+							   rmse_scratch.data(), true);
 
+	// Read back through rmse_readback once the frame is done
 	rmse_val_buffer.create("RMSE Value", &instance->vkb.ctx,
 						   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-							   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-						   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-						   VK_SHARING_MODE_EXCLUSIVE, sizeof(float));
+							   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+						   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, sizeof(float));
+	rmse_readback.init(&instance->vkb.ctx, instance->vkb.frame_timeline, sizeof(float));
 
-	if (load_reference) {
-		// Load the ground truth image
+	has_gt = false;
+	if (!reference_path.empty()) {
 		int width, height;
-		float* data = load_exr("out.exr", width, height);
+		float* data = load_exr(reference_path.c_str(), width, height);
 		if (!data) {
 			LUMEN_ERROR("Could not load the reference image");
 		}
-		auto gt_size = width * height * 4 * sizeof(float);
-		gt_img_buffer.create("Ground Truth Image", &instance->vkb.ctx,
-							 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-							 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, gt_size, data, true);
-		desc.gt_img_addr = gt_img_buffer.get_device_address();
+		if (width == (int)instance->width && height == (int)instance->height) {
+			gt_img_buffer.create("Ground Truth Image", &instance->vkb.ctx,
+								 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+								 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE,
+								 width * height * 4 * sizeof(float), data, true);
+			desc.gt_img_addr = gt_img_buffer.get_device_address();
+			has_gt = true;
+		} else {
+			LUMEN_WARN("The reference is {}x{} but the output is {}x{}, the RMSE is disabled", width, height,
+					   instance->width, instance->height);
+		}
 		free(data);
 	}
+	// The GPU time of the convergence log comes from the pass timestamps
+	instance->vkb.rg->profiling_requested = has_gt;
 
 	desc.out_img_addr = output_img_buffer.get_device_address();
-	desc.residual_addr = residual_buffer.get_device_address();
-	desc.counter_addr = counter_buffer.get_device_address();
 	desc.rmse_val_addr = rmse_val_buffer.get_device_address();
+	rt_utils_desc_buffer.create("RT Utils Desc", &instance->vkb.ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+								VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, sizeof(RTUtilsDesc),
+								&desc, true);
+	rt_utils_pc.size = instance->width * instance->height;
 
 	REGISTER_BUFFER_WITH_ADDRESS(RTUtilsDesc, desc, out_img_addr, &output_img_buffer, instance->vkb.rg);
-	REGISTER_BUFFER_WITH_ADDRESS(RTUtilsDesc, desc, residual_addr, &residual_buffer, instance->vkb.rg);
-	REGISTER_BUFFER_WITH_ADDRESS(RTUtilsDesc, desc, counter_addr, &counter_buffer, instance->vkb.rg);
 	REGISTER_BUFFER_WITH_ADDRESS(RTUtilsDesc, desc, rmse_val_addr, &rmse_val_buffer, instance->vkb.rg);
 }
 
+void RayTracer::init_readback() {
+	// The AOV images follow the color output in each slot
+	const VkDeviceSize image_size = instance->width * instance->height * 4 * sizeof(float);
+	output_readback.init(&instance->vkb.ctx, instance->vkb.frame_timeline,
+						 integrator->writes_aovs() ? 4 * image_size : image_size);
+}
+
 void RayTracer::cleanup_resources() {
-	std::vector<Buffer*> buffer_list = {&output_img_buffer, &output_img_buffer_cpu, &residual_buffer,
-										&counter_buffer,	&rmse_val_buffer,		&rt_utils_desc_buffer};
-	if (load_reference) {
+	output_readback.destroy();
+	rmse_readback.destroy();
+	std::vector<Buffer*> buffer_list = {&output_img_buffer, &rmse_scratch_buffer, &rmse_val_buffer,
+										&rt_utils_desc_buffer};
+	if (has_gt) {
 		buffer_list.push_back(&gt_img_buffer);
 	}
 	for (auto b : buffer_list) {
@@ -137,7 +249,31 @@ void RayTracer::update() {
 	float frame_time = draw_frame();
 	cpu_avg_time = (1.0f - 1.0f / (cnt)) * cpu_avg_time + frame_time / (float)cnt;
 	cpu_avg_time = 0.95f * cpu_avg_time + 0.05f * frame_time;
-	integrator->update();
+	// Accumulation restarts when anything changed
+	if (integrator->update()) {
+		accumulated_frames = 0;
+		convergence.restart(scene.config.integrator_name, vkb.rg->profiler.gpu_time_ms());
+	}
+}
+
+// data holds the color output, followed by the AOV images if they are written
+static void save_output_exr(const float* data, int width, int height, const char* path, bool aovs,
+							const ExrWriteSettings& settings) {
+	if (!aovs) {
+		save_exr(data, width, height, path, settings);
+		return;
+	}
+	const size_t image_size = size_t(width) * height * 4;
+	constexpr ExrPixelType half = ExrPixelType::Half;
+	constexpr ExrPixelType full = ExrPixelType::Float;
+	const ExrLayer layers[] = {
+		{data, {"R", "G", "B", settings.write_alpha ? "A" : nullptr}, settings.pixel_types},
+		{data + image_size, {"albedo.R", "albedo.G", "albedo.B", "Z"}, {half, half, half, full}},
+		{data + 2 * image_size, {"normal.X", "normal.Y", "normal.Z", nullptr}, {half, half, half, half}},
+		// Variance of the luminance samples, divide it by the sample count for the variance of the pixel
+		{data + 3 * image_size, {"samples", nullptr, nullptr, "variance"}, {full, full, full, full}},
+	};
+	save_exr(layers, width, height, path, settings);
 }
 
 void RayTracer::render(uint32_t i) {
@@ -147,33 +283,55 @@ void RayTracer::render(uint32_t i) {
 	VkCommandBufferBeginInfo begin_info = vk::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 	vk::check(vkBeginCommandBuffer(cmdbuf, &begin_info));
 
-	if (write_exr) {
-		instance->vkb.rg->current_pass().copy(integrator->output_tex, output_img_buffer_cpu);
-	}
-	if (calc_rmse && has_gt) {
-		auto op_reduce = [&](const std::string& op_name, const std::string& op_shader_name,
-							 const std::string& reduce_name, const std::string& reduce_shader_name) {
-			uint32_t num_wgs = uint32_t((instance->width * instance->height + 1023) / 1024);
-			instance->vkb.rg->add_compute(op_name, {.shader = Shader(op_shader_name), .dims = {num_wgs, 1, 1}})
-				.push_constants(&rt_utils_pc)
-				.bind(rt_utils_desc_buffer)
-				.zero({residual_buffer, counter_buffer});
-			while (num_wgs != 1) {
-				instance->vkb.rg
-					->add_compute(reduce_name, {.shader = Shader(reduce_shader_name), .dims = {num_wgs, 1, 1}})
-					.push_constants(&rt_utils_pc)
-					.bind(rt_utils_desc_buffer);
-				num_wgs = (num_wgs + 1023) / 1024;
-			}
-		};
+	accumulated_frames++;
+	const bool capture = capture_interval > 0 && accumulated_frames % capture_interval == 0;
+	if (write_exr || capture) {
+		std::vector<std::string> paths;
+		if (write_exr) {
+			paths.push_back("out.exr");
+		}
+		if (capture) {
+			paths.push_back("capture_" + std::to_string(accumulated_frames) + ".exr");
+		}
+		// Encoded on a worker once the frame is done
+		const int width = (int)instance->width;
+		const int height = (int)instance->height;
+		const bool aovs = integrator->writes_aovs();
+		Buffer& dst =
+			output_readback.acquire([paths, width, height, aovs, settings = exr_settings](const void* data) {
+				for (const std::string& path : paths) {
+					save_output_exr((const float*)data, width, height, path.c_str(), aovs, settings);
+				}
+			});
+		instance->vkb.rg->current_pass().copy(integrator->output_tex, dst);
+		if (aovs) {
+			const VkDeviceSize image_size = instance->width * instance->height * 4 * sizeof(float);
+			instance->vkb.rg->current_pass()
+				.copy(integrator->aov_albedo_depth, Resource(dst, image_size))
+				.copy(integrator->aov_normal, Resource(dst, 2 * image_size))
+				.copy(integrator->aov_stats, Resource(dst, 3 * image_size));
+		}
+		write_exr = false;
+		readback_recorded = true;
+	}
+	ConvergenceLogger::Entry entry;
+	if (has_gt && convergence.due(cnt, accumulated_frames, vkb.rg->profiler.gpu_time_ms(), entry)) {
 		instance->vkb.rg->current_pass().copy(integrator->output_tex, output_img_buffer);
-		// Calculate RMSE
-		op_reduce("OpReduce: RMSE", "src/shaders/rmse/calc_rmse.comp", "OpReduce: Reduce RMSE",
-				  "src/shaders/rmse/reduce_rmse.comp");
+		// Calculate RMSE, the last workgroup of the reduction writes the result
+		const uint32_t num_wgs = uint32_t((instance->width * instance->height + 1023) / 1024);
 		instance->vkb.rg
-			->add_compute("Calculate RMSE", {.shader = Shader("src/shaders/rmse/output_rmse.comp"), .dims = {1, 1, 1}})
+			->add_compute("Calculate RMSE", {.shader = Shader("src/shaders/rmse/calc_rmse.comp"),
+											 .dims = {num_wgs, 1, 1},
+											 .async_compute = true})
 			.push_constants(&rt_utils_pc)
-			.bind(rt_utils_desc_buffer);
+			.bind(rt_utils_desc_buffer)
+			.bind(rmse_scratch_buffer);
+		Buffer& dst = rmse_readback.acquire([this, entry](const void* data) mutable {
+			entry.rmse = *(const float*)data;
+			convergence.add(entry);
+		});
+		instance->vkb.rg->current_pass().copy(rmse_val_buffer, dst);
+		readback_recorded = true;
 	}
 
 	vkb.rg->run(cmdbuf);
@@ -182,41 +340,65 @@ void RayTracer::render(uint32_t i) {
 }
 
 void RayTracer::create_integrator(std::string_view integrator_id) {
-	if(!IntegratorRegistry::integrators.contains(integrator_id)){
-		// check for lower case match
-		bool match{};
-		for(const auto& [id, entry]: IntegratorRegistry::integrators){
-			if(id.size() != integrator_id.size())
-				continue;
-			bool char_wrong{false};
-			for(int i: std::ranges::iota_view(0, static_cast<int>(id.size())))
-				char_wrong |= std::tolower(id[i]) != std::tolower(integrator_id[i]);
-			if(!char_wrong){
-				match = true;
-				integrator_id = id;
-				break;
-			}
-		}
-
-		if(!match){
-			std::string report_string = std::string("Integrator ") + integrator_id.data() + " can not be found, using standard Path tracer.\nAvailable options are:\n";
-			for(const auto& [id, entry]: IntegratorRegistry::integrators){
-				report_string += "    ";
-				report_string += id;
-				report_string += "\n";
-			}
-			LUMEN_WARN(report_string);
-			integrator_id = "Path";
-		}
-	}
-
-	integrator = IntegratorRegistry::integrators[integrator_id].create(this, &scene);
+	integrator = IntegratorRegistry::integrators[resolve_integrator_id(integrator_id)].create(this, &scene);
 }
 
 bool RayTracer::gui() {
 	ImGui::Text("Frame time %f ms ( %f FPS )", cpu_avg_time, 1000 / cpu_avg_time);
 	ImGui::Text("Memory Usage: %f MB", get_memory_usage(vk_ctx.physical_device) * 1e-6);
 	bool updated = false;
+	ImGui::Checkbox("Profile render graph", &vkb.rg->settings.profile_passes);
+	if (vkb.rg->settings.profile_passes) {
+		vkb.rg->profiler.gui();
+	}
+	bool profile_thread_pool = ThreadPool::profiling();
+	if (ImGui::Checkbox("Profile thread pool", &profile_thread_pool)) {
+		ThreadPool::set_profiling(profile_thread_pool);
+	}
+	if (profile_thread_pool) {
+		ThreadPool::gui();
+	}
+	if (ImGui::TreeNode("Device memory")) {
+		vk_ctx.allocator->gui();
+		ImGui::TreePop();
+	}
+	ImGui::Checkbox("Multithreaded recording", &vkb.rg->settings.multithreaded_recording);
+	ImGui::Checkbox("Replay execution plans", &vkb.rg->settings.replay_execution_plans);
+	ImGui::Checkbox("Cull unused passes", &vkb.rg->settings.cull_passes);
+	ImGui::Checkbox("Reorder passes", &vkb.rg->settings.reorder_passes);
+	ImGui::BeginDisabled(!vkb.rg->async_compute_available());
+	ImGui::Checkbox("Async compute", &vkb.rg->settings.async_compute);
+	ImGui::EndDisabled();
+	if (ImGui::InputInt("Capture every N frames", &capture_interval)) {
+		capture_interval = std::max(capture_interval, 0);
+	}
+	if (ImGui::TreeNode("EXR output")) {
+		const char* compressions[] = {"None", "ZIP", "PIZ"};
+		int compression = (int)exr_settings.compression;
+		if (ImGui::Combo("Compression", &compression, compressions, IM_ARRAYSIZE(compressions))) {
+			exr_settings.compression = (ExrCompression)compression;
+		}
+		bool float_rgb = exr_settings.pixel_types[0] == ExrPixelType::Float;
+		if (ImGui::Checkbox("32 bit float RGB", &float_rgb)) {
+			const ExrPixelType type = float_rgb ? ExrPixelType::Float : ExrPixelType::Half;
+			exr_settings.pixel_types = {type, type, type, exr_settings.pixel_types[3]};
+		}
+		ImGui::Checkbox("Write alpha", &exr_settings.write_alpha);
+		int tile_size = (int)exr_settings.tile_size;
+		if (ImGui::InputInt("Tile size (0 = scanlines)", &tile_size)) {
+			exr_settings.tile_size = (uint32_t)std::max(tile_size, 0);
+		}
+		ImGui::TreePop();
+	}
+	if (const uint32_t pending = output_readback.pending()) {
+		ImGui::Text("Pending readbacks: %u", pending);
+	}
+	if (ConvergenceLogger::Entry entry; has_gt && convergence.last(entry)) {
+		ImGui::Text("RMSE %.6g after %u samples (%.2f s)", entry.rmse, entry.samples, entry.wall_s);
+	}
+	if (ImGui::Button("Export sync plan")) {
+		vkb.rg->export_sync_plan("lumen_sync_plan");
+	}
 	ImGui::Checkbox("Show camera statistics", &show_cam_stats);
 	if (show_cam_stats) {
 		ImGui::PushItemWidth(170);
@@ -230,8 +412,21 @@ bool RayTracer::gui() {
 		vkb.rg->shader_cache.clear();
 		updated |= true;
 	}
+	const std::vector<std::string> compiling_passes = vkb.rg->compiling_passes();
+	for (const std::string& name : compiling_passes) {
+		ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.2f, 1.0f), "Compiling %s", name.c_str());
+	}
+	// A pipeline was swapped in, restart the accumulation
+	if (compiling_passes.size() < num_compiling_passes) {
+		integrator->updated = true;
+	}
+	num_compiling_passes = compiling_passes.size();
 
 	bool integrator_changed{};
+	if (integrator->supports_aovs()) {
+		// The integrator is recreated with the AOV images
+		integrator_changed |= ImGui::Checkbox("Write AOVs", &scene.config.write_aovs);
+	}
 	if (ImGui::BeginCombo("Select Integrator", scene.config.integrator_name.c_str())) {
 		for (auto& [integrator_type, entry]: IntegratorRegistry::integrators) {
 			const bool selected = integrator_type == scene.config.integrator_name;
@@ -255,8 +450,6 @@ bool RayTracer::gui() {
 		vkb.cleanup_app_data();
 		post_fx.destroy();
 		REGISTER_BUFFER_WITH_ADDRESS(RTUtilsDesc, desc, out_img_addr, &output_img_buffer, instance->vkb.rg);
-		REGISTER_BUFFER_WITH_ADDRESS(RTUtilsDesc, desc, residual_addr, &residual_buffer, instance->vkb.rg);
-		REGISTER_BUFFER_WITH_ADDRESS(RTUtilsDesc, desc, counter_addr, &counter_buffer, instance->vkb.rg);
 		REGISTER_BUFFER_WITH_ADDRESS(RTUtilsDesc, desc, rmse_val_addr, &rmse_val_buffer, instance->vkb.rg);
 
 		//auto prev_cam_settings = scene.config.cam_settings;
@@ -265,16 +458,15 @@ bool RayTracer::gui() {
 		create_integrator(scene.config.integrator_name);
 		integrator->init();
 		post_fx.init(*instance);
+		// The slots are sized for the AOVs of the integrator
+		output_readback.destroy();
+		init_readback();
 	}
 
 	return updated;
 }
 
 float RayTracer::draw_frame() {
-	if (cnt == 0) {
-		start = clock();
-	}
-
 	auto resize_func = [this]() {
 		vkb.rg->settings.shader_inference = enable_shader_inference;
 		vkb.rg->settings.use_events = use_events;
@@ -324,21 +516,13 @@ float RayTracer::draw_frame() {
 		vkb.rg->reset();
 	}
 
-	auto now = clock();
-	auto diff = ((float)now - start);
-
-	if (write_exr) {
-		write_exr = false;
-		save_exr((float*)output_img_buffer_cpu.data, instance->width, instance->height, "out.exr");
-	}
-	bool time_limit = (abs(diff / CLOCKS_PER_SEC - 5)) < 0.1;
-	calc_rmse = time_limit;
-
-	if (calc_rmse && has_gt) {
-		float rmse = *(float*)rmse_val_buffer.data;
-		LUMEN_TRACE("RMSE {}", rmse * 1e6);
-		start = now;
+	if (readback_recorded) {
+		output_readback.submitted(vkb.frame_value);
+		rmse_readback.submitted(vkb.frame_value);
+		readback_recorded = false;
 	}
+	output_readback.poll();
+	rmse_readback.poll();
 	auto t_end = glfwGetTime() * 1000;
 	auto t_diff = t_end - t_begin;
 	cnt++;
@@ -349,16 +533,36 @@ void RayTracer::parse_args(int argc, char* argv[]) {
 	scene_name = "scenes/caustics.json";
 	std::regex fn("(.*).(.json|.xml)");
 	for (int i = 0; i < argc; i++) {
-		if (std::regex_match(argv[i], fn)) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--capture-every") && has_value) {
+			capture_interval = std::max(atoi(argv[++i]), 0);
+		} else if (!strcmp(argv[i], "--aovs")) {
+			aovs_arg = true;
+		} else if (!strcmp(argv[i], "--validate-primitives")) {
+			validate_primitives_arg = true;
+		} else if (!strcmp(argv[i], "--reference") && has_value) {
+			reference_path = argv[++i];
+		} else if (!strcmp(argv[i], "--log-convergence") && has_value) {
+			// Checked before the scene, a .json log would match it
+			convergence_settings.path = argv[++i];
+		} else if (!strcmp(argv[i], "--log-interval") && has_value) {
+			convergence_settings.interval_s = std::max(atof(argv[++i]), 0.0);
+		} else if (!strcmp(argv[i], "--log-every") && has_value) {
+			convergence_settings.frame_interval = (uint32_t)std::max(atoi(argv[++i]), 0);
+		} else if (std::regex_match(argv[i], fn)) {
 			scene_name = argv[i];
 		}
 	}
+	if (!convergence_settings.path.empty() && reference_path.empty()) {
+		LUMEN_WARN("--log-convergence needs a --reference image, nothing will be logged");
+	}
 }
 void RayTracer::cleanup() {
 	const auto device = vkb.ctx.device;
 	vkDeviceWaitIdle(device);
 	if (initialized) {
 		cleanup_resources();
+		convergence.finish();
 		integrator->destroy();
 		post_fx.destroy();
 		vkb.destroy_imgui();
@@ -2,8 +2,10 @@
 #include "LumenPCH.h"
 #include "Framework/LumenInstance.h"
 #include "Framework/ImageUtils.h"
+#include "Framework/FrameReadback.h"
 #include "PostFX.h"
 #include "Integrator.h"
+#include "ConvergenceLogger.h"
 
 class RayTracer : public LumenInstance {
    public:
@@ -14,9 +16,12 @@ class RayTracer : public LumenInstance {
 	static RayTracer* instance;
 	inline static RayTracer* get() { return instance; }
 	bool resized = false;
+	// Result of --validate-primitives, main exits with it instead of rendering
+	std::optional<bool> primitives_valid;
 
    private:
 	void init_resources();
+	void init_readback();
 	void cleanup_resources();
 	void parse_args(int argc, char* argv[]);
 	float draw_frame();
@@ -35,10 +40,10 @@ class RayTracer : public LumenInstance {
 
 	Buffer gt_img_buffer;
 	Buffer output_img_buffer;
-	Buffer output_img_buffer_cpu;
-	Buffer residual_buffer;
-	Buffer counter_buffer;
+	FrameReadback output_readback;
+	Buffer rmse_scratch_buffer;
 	Buffer rmse_val_buffer;
+	FrameReadback rmse_readback;
 	Buffer rt_utils_desc_buffer;
 
 
@@ -47,10 +52,23 @@ class RayTracer : public LumenInstance {
 	std::string scene_name;
 	LumenScene scene;
 
-	clock_t start;
 	bool write_exr = false;
+	// Writes capture_<frame>.exr every N accumulated frames, 0 disables it (--capture-every N)
+	int capture_interval = 0;
+	uint32_t accumulated_frames = 0;
+	ExrWriteSettings exr_settings;
+	// --aovs, enables the AOVs regardless of the scene config
+	bool aovs_arg = false;
+	bool validate_primitives_arg = false;
+	bool readback_recorded = false;
+	// --reference <path>, the RMSE is computed against it at the intervals of the convergence log
+	std::string reference_path;
 	bool has_gt = false;
+	// --log-convergence <path>, --log-interval <seconds>, --log-every <frames>
+	ConvergenceLogger::Settings convergence_settings;
+	ConvergenceLogger convergence;
 	bool show_cam_stats = false;
+	size_t num_compiling_passes = 0;
 
 	const bool enable_shader_inference = true;
 	const bool use_events = true;
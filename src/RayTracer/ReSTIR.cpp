@@ -98,7 +98,6 @@ void ReSTIR::render() {
 		.zero(temporal_reservoir_buffer, !do_spatiotemporal)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	// Spatial pass
 	instance->vkb.rg
@@ -112,7 +111,6 @@ void ReSTIR::render() {
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 
 	// Output
@@ -127,7 +125,6 @@ void ReSTIR::render() {
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 
 	if (!do_spatiotemporal) {
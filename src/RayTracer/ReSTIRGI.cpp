@@ -99,7 +99,6 @@ void ReSTIRGI::render() {
 		.zero(spatial_reservoir_buffer, !do_spatiotemporal)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas)
 		.copy(restir_samples_buffer, restir_samples_old_buffer);
 
@@ -115,7 +114,6 @@ void ReSTIRGI::render() {
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 
 	// Spatial reuse
@@ -130,7 +128,6 @@ void ReSTIRGI::render() {
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	// Output
 	instance->vkb.rg
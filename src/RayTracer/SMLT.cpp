@@ -123,27 +123,10 @@ void SMLT::init() {
 		&instance->vkb.ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, num_mlt_threads * sizeof(uint32_t));
 
-	int size = 0;
-	int arr_size = num_bootstrap_samples;
-	do {
-		int num_blocks = std::max(1, (int)ceil(arr_size / (2.0f * 1024)));
-		if (num_blocks > 1) {
-			size++;
-		}
-		arr_size = num_blocks;
-	} while (arr_size > 1);
-	block_sums.resize(size);
-	int i = 0;
-	arr_size = num_bootstrap_samples;
-	do {
-		int num_blocks = std::max(1, (int)ceil(arr_size / (2.0f * 1024)));
-		if (num_blocks > 1) {
-			block_sums[i++].create(&instance->vkb.ctx,
-								   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-								   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, num_blocks * 4);
-		}
-		arr_size = num_blocks;
-	} while (arr_size > 1);
+	scan_state_buffer.create("Scan State", &instance->vkb.ctx,
+							 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+							 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE,
+							 scan_state_size(num_bootstrap_samples));
 
 	SceneDesc desc;
 	desc.vertex_addr = vertex_buffer.get_device_address();
@@ -254,7 +237,6 @@ void SMLT::render() {
 			.push_constants(&pc_ray)
 			.bind(rt_bindings)
 			.bind(mesh_lights_buffer)
-			.bind_texture_array(scene_textures)
 			.bind_tlas(instance->vkb.tlas);
 		// Eye
 		instance->vkb.rg
@@ -270,11 +252,16 @@ void SMLT::render() {
 			.push_constants(&pc_ray)
 			.bind(rt_bindings)
 			.bind(mesh_lights_buffer)
-			.bind_texture_array(scene_textures)
 			.bind_tlas(instance->vkb.tlas);
 	}
-	int counter = 0;
-	prefix_scan(0, num_bootstrap_samples, counter, instance->vkb.rg.get());
+	// Unnormalized CDF of the bootstrap luminances
+	add_scan(instance->vkb.rg.get(), "PrefixScan",
+			 {.buffer = &bootstrap_buffer,
+			  .num_elems = (uint32_t)num_bootstrap_samples,
+			  .stride = sizeof(BootstrapSample) / sizeof(float),
+			  .offset = offsetof(BootstrapSample, lum) / sizeof(float),
+			  .scale = 1.0f / num_bootstrap_samples},
+			 scan_state_buffer, cdf_buffer);
 	// Calculate CDF
 	instance->vkb.rg
 		->add_compute("Calculate CDF", {.shader = Shader("src/shaders/integrators/pssmlt/calc_cdf.comp"),
@@ -338,7 +325,6 @@ void SMLT::render() {
 			.zero(mlt_samplers_buffer)
 			.bind(rt_bindings)
 			.bind(mesh_lights_buffer)
-			.bind_texture_array(scene_textures)
 			.bind_tlas(instance->vkb.tlas);
 		// Eye
 		instance->vkb.rg
@@ -353,7 +339,6 @@ void SMLT::render() {
 			.zero(mlt_samplers_buffer)
 			.bind(rt_bindings)
 			.bind(mesh_lights_buffer)
-			.bind_texture_array(scene_textures)
 			.bind_tlas(instance->vkb.tlas);
 	}
 	instance->vkb.rg->run_and_submit(cmd);
@@ -375,7 +360,6 @@ void SMLT::render() {
 				.push_constants(&pc_ray)
 				.bind(rt_bindings)
 				.bind(mesh_lights_buffer)
-				.bind_texture_array(scene_textures)
 				.bind_tlas(instance->vkb.tlas);
 			// Eye
 			instance->vkb.rg
@@ -389,7 +373,6 @@ void SMLT::render() {
 				.push_constants(&pc_ray)
 				.bind(rt_bindings)
 				.bind(mesh_lights_buffer)
-				.bind_texture_array(scene_textures)
 				.bind_tlas(instance->vkb.tlas);
 		};
 		const uint32_t iter_cnt = 100;
@@ -433,72 +416,6 @@ bool SMLT::update() {
 	return updated;
 }
 
-void SMLT::prefix_scan(int level, int num_elems, int& counter, RenderGraph* rg) {
-	const bool scan_sums = level > 0;
-	int num_wgs = std::max(1, (int)ceil(num_elems / (2 * 1024.0f)));
-	int num_grids = num_wgs - int((num_elems % 2048) != 0);
-	pc_compute.num_elems = num_elems;
-	auto scan = [&](int num_wgs, int idx) {
-		++counter;
-		rg->add_compute("PrefixScan - Scan", {.shader = Shader("src/shaders/integrators/pssmlt/prefix_scan.comp"),
-											  .dims = {(uint32_t)num_wgs, 1, 1}})
-			.push_constants(&pc_compute)
-			.bind(scene_desc_buffer);
-	};
-	auto uniform_add = [&](int num_wgs, int output_idx) {
-		++counter;
-		rg->add_compute(
-			  "PrefixScan - Uniform Add",
-			  {.shader = Shader("src/shaders/integrators/pssmlt/uniform_add.comp"), .dims = {(uint32_t)num_wgs, 1, 1}})
-			.push_constants(&pc_compute)
-			.bind(scene_desc_buffer);
-	};
-	if (num_wgs > 1) {
-		pc_compute.base_idx = 0;
-		pc_compute.block_idx = 0;
-		pc_compute.n = 2 * 1024;
-		pc_compute.store_sum = 1;
-		pc_compute.scan_sums = int(scan_sums);
-		pc_compute.block_sum_addr = block_sums[level].get_device_address();
-		scan(num_grids, level);
-		int rem = num_elems % (2 * 1024);
-		if (rem) {
-			pc_compute.base_idx = num_elems - rem;
-			pc_compute.block_idx = num_wgs - 1;
-			pc_compute.n = rem;
-			scan(1, level);
-		}
-		prefix_scan(level + 1, num_wgs, counter, rg);
-		pc_compute.base_idx = 0;
-		pc_compute.block_idx = 0;
-		pc_compute.n = num_elems - rem;
-		pc_compute.store_sum = 1;
-		pc_compute.scan_sums = int(scan_sums);
-		pc_compute.block_sum_addr = block_sums[level].get_device_address();
-		if (scan_sums) {
-			pc_compute.out_addr = block_sums[level - 1].get_device_address();
-		}
-		uniform_add(num_grids, level - 1);
-		if (rem) {
-			pc_compute.base_idx = num_elems - rem;
-			pc_compute.block_idx = num_wgs - 1;
-			pc_compute.n = rem;
-			uniform_add(1, level - 1);
-		}
-	} else {
-		int rem = num_elems % 2048;
-		pc_compute.n = rem == 0 ? 2048 : rem;
-		pc_compute.base_idx = 0;
-		pc_compute.block_idx = 0;
-		pc_compute.store_sum = 0;
-		pc_compute.scan_sums = bool(scan_sums);
-		if (scan_sums) {
-			pc_compute.block_sum_addr = block_sums[level - 1].get_device_address();
-		}
-		scan(num_wgs, level - 1);
-	}
-}
-
 void SMLT::destroy() {
 	const auto device = instance->vkb.ctx.device;
 	Integrator::destroy();
@@ -522,9 +439,7 @@ void SMLT::destroy() {
 	for (auto b : buffer_list) {
 		b->destroy();
 	}
-	for (auto& b : block_sums) {
-		b.destroy();
-	}
+	scan_state_buffer.destroy();
 	if (bootstrap_cpu.size) {
 		bootstrap_cpu.destroy();
 	}
@@ -20,9 +20,7 @@ class SMLT : public Integrator {
 	virtual void destroy() override;
 
    private:
-	void prefix_scan(int level, int num_elems, int& counter, RenderGraph* rg);
 	PCMLT pc_ray{};
-	PushConstantCompute pc_compute{};
 
 	// SMLT buffers
 	Buffer bootstrap_buffer;
@@ -39,7 +37,7 @@ class SMLT : public Integrator {
 	Buffer light_path_buffer;
 	Buffer bootstrap_cpu;
 	Buffer cdf_cpu;
-	std::vector<Buffer> block_sums;
+	Buffer scan_state_buffer;
 
 	Buffer connected_lights_buffer;
 	Buffer tmp_seeds_buffer;
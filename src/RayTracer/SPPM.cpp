@@ -19,16 +19,12 @@ void SPPM::init() {
 							 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 						 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE,
 						 10 * instance->width * instance->height * sizeof(PhotonHash));
-	residual_buffer.create("Residual Buffer", &instance->vkb.ctx,
-						   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-							   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-						   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE,
-						   instance->width * instance->height * 4 * sizeof(float));
-
-	counter_buffer.create("Counter Buffer", &instance->vkb.ctx,
-						  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-							  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-						  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, sizeof(int));
+	// Shared by the min and max reductions, each leaves it cleared for the next
+	std::vector<uint8_t> bounds_scratch(reduce_scratch_size(instance->width * instance->height, sizeof(glm::vec4)), 0);
+	bounds_scratch_buffer.create("Bounds Scratch", &instance->vkb.ctx,
+								 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+								 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, bounds_scratch.size(),
+								 bounds_scratch.data(), true);
 
 	SceneDesc desc;
 	desc.vertex_addr = vertex_buffer.get_device_address();
@@ -41,8 +37,6 @@ void SPPM::init() {
 	desc.sppm_data_addr = sppm_data_buffer.get_device_address();
 	desc.atomic_data_addr = atomic_data_buffer.get_device_address();
 	desc.photon_addr = photon_buffer.get_device_address();
-	desc.residual_addr = residual_buffer.get_device_address();
-	desc.counter_addr = counter_buffer.get_device_address();
 	scene_desc_buffer.create(
 		&instance->vkb.ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SHARING_MODE_EXCLUSIVE, sizeof(SceneDesc), &desc, true);
@@ -55,8 +49,6 @@ void SPPM::init() {
 	REGISTER_BUFFER_WITH_ADDRESS(SceneDesc, desc, sppm_data_addr, &sppm_data_buffer, instance->vkb.rg);
 	REGISTER_BUFFER_WITH_ADDRESS(SceneDesc, desc, atomic_data_addr, &atomic_data_buffer, instance->vkb.rg);
 	REGISTER_BUFFER_WITH_ADDRESS(SceneDesc, desc, photon_addr, &photon_buffer, instance->vkb.rg);
-	REGISTER_BUFFER_WITH_ADDRESS(SceneDesc, desc, residual_addr, &residual_buffer, instance->vkb.rg);
-	REGISTER_BUFFER_WITH_ADDRESS(SceneDesc, desc, counter_addr, &counter_buffer, instance->vkb.rg);
 }
 
 void SPPM::render() {
@@ -82,19 +74,12 @@ void SPPM::render() {
 	if (pc_ray.radius < 1e-7f) {
 		pc_ray.radius = 1e-7f;
 	}
-	auto op_reduce = [&](const std::string& op_name, const std::string& op_shader_name, const std::string& reduce_name,
-						 const std::string& reduce_shader_name) {
+	auto op_reduce = [&](const std::string& op_name, const std::string& op_shader_name) {
 		uint32_t num_wgs = uint32_t((instance->width * instance->height + 1023) / 1024);
 		instance->vkb.rg->add_compute(op_name, {.shader = Shader(op_shader_name), .dims = {num_wgs, 1, 1}})
 			.push_constants(&pc_ray)
 			.bind(scene_desc_buffer)
-			.zero({residual_buffer, counter_buffer});
-		while (num_wgs != 1) {
-			instance->vkb.rg->add_compute(reduce_name, {.shader = Shader(reduce_shader_name), .dims = {num_wgs, 1, 1}})
-				.push_constants(&pc_ray)
-				.bind(scene_desc_buffer);
-			num_wgs = (uint32_t)(num_wgs + 1023) / 1024;
-		}
+			.bind(bounds_scratch_buffer);
 	};
 
 	const std::initializer_list<ResourceBinding> rt_bindings = {
@@ -117,13 +102,10 @@ void SPPM::render() {
 		.zero(sppm_data_buffer, /*cond=*/pc_ray.frame_num == 0)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	// Calculate scene bbox given the calculated radius
-	op_reduce("OpReduce: Max", "src/shaders/integrators/sppm/max.comp", "OpReduce: Reduce Max",
-			  "src/shaders/integrators/sppm/reduce_max.comp");
-	op_reduce("OpReduce: Min", "src/shaders/integrators/sppm/min.comp", "OpReduce: Reduce Min",
-			  "src/shaders/integrators/sppm/reduce_min.comp");
+	op_reduce("OpReduce: Max", "src/shaders/integrators/sppm/max.comp");
+	op_reduce("OpReduce: Min", "src/shaders/integrators/sppm/min.comp");
 	instance->vkb.rg
 		->add_compute("Bounds Calculation",
 					  {.shader = Shader("src/shaders/integrators/sppm/calc_bounds.comp"), .dims = {1, 1, 1}})
@@ -140,7 +122,6 @@ void SPPM::render() {
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	// Gather
 	instance->vkb.rg
@@ -148,8 +129,7 @@ void SPPM::render() {
 					  {.shader = Shader("src/shaders/integrators/sppm/gather.comp"),
 					   .dims = {(uint32_t)std::ceil(instance->width * instance->height / float(1024.0f)), 1, 1}})
 		.push_constants(&pc_ray)
-		.bind(scene_desc_buffer)
-		.bind_texture_array(scene_textures);
+		.bind(scene_desc_buffer);
 	// Composite
 	instance->vkb.rg
 		->add_compute("Composite",
@@ -172,8 +152,8 @@ bool SPPM::update() {
 void SPPM::destroy() {
 	const auto device = instance->vkb.ctx.device;
 	Integrator::destroy();
-	std::vector<Buffer*> buffer_list = {&sppm_data_buffer, &atomic_data_buffer, &photon_buffer, &residual_buffer,
-										&counter_buffer,   &hash_buffer,		&tmp_col_buffer};
+	std::vector<Buffer*> buffer_list = {&sppm_data_buffer,		&atomic_data_buffer, &photon_buffer,
+										&bounds_scratch_buffer, &hash_buffer,		 &tmp_col_buffer};
 	for (auto b : buffer_list) {
 		b->destroy();
 	}
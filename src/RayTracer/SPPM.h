@@ -25,8 +25,7 @@ class SPPM : public Integrator {
 	Buffer sppm_data_buffer;
 	Buffer atomic_data_buffer;
 	Buffer photon_buffer;
-	Buffer residual_buffer;
-	Buffer counter_buffer;
+	Buffer bounds_scratch_buffer;
 	Buffer hash_buffer;
 	Buffer tmp_col_buffer;
 
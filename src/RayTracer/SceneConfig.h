@@ -12,6 +12,10 @@ struct CameraSettings {
 
 struct SceneConfig {
 	int path_length = 6;
+	// Bake config values like the path length into the kernels instead of reading them from push constants
+	bool specialize_kernels = false;
+	// Write albedo, normal, depth, sample count and variance next to the color output (Path, BDPT and VCM)
+	bool write_aovs = false;
 	glm::vec3 sky_col = glm::vec3(0);
 	std::string integrator_name = "Path";
 	CameraSettings cam_settings;
@@ -136,6 +136,8 @@ void VCM::render() {
 	pc_ray.random_num = rand() % UINT_MAX;
 	pc_ray.max_angle_samples = max_samples;
 	pc_ray.light_triangle_count = total_light_triangle_cnt;
+	const std::vector<uint32_t> spec_data =
+		specialize({{SPEC_MAX_DEPTH, config.path_length}, {SPEC_USE_VM, enable_vm}, {SPEC_USE_VC, use_vc}});
 	const std::initializer_list<ResourceBinding> rt_bindings = {
 		output_tex,
 		scene_ubo_buffer,
@@ -168,12 +170,12 @@ void VCM::render() {
 										  {"src/shaders/ray_shadow.rmiss"},
 										  {"src/shaders/ray.rchit"},
 										  {"src/shaders/ray.rahit"}},
+							  .specialization_data = spec_data,
 							  .dims = {instance->width, instance->height},
 							  .accel = instance->vkb.tlas.accel})
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 
 	// Check resampling
@@ -192,13 +194,13 @@ void VCM::render() {
 												   {"src/shaders/ray_shadow.rmiss"},
 												   {"src/shaders/ray.rchit"},
 												   {"src/shaders/ray.rahit"}},
+									   .specialization_data = spec_data,
 									   .dims = {instance->width, instance->height},
 									   .accel = instance->vkb.tlas.accel})
 		.push_constants(&pc_ray)
 		.zero(light_state_buffer)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	pc_ray.random_num = rand() % UINT_MAX;
 	// Trace spawned rays
@@ -208,12 +210,12 @@ void VCM::render() {
 												   {"src/shaders/ray_shadow.rmiss"},
 												   {"src/shaders/ray.rchit"},
 												   {"src/shaders/ray.rahit"}},
+									   .specialization_data = spec_data,
 									   .dims = {instance->width, instance->height},
 									   .accel = instance->vkb.tlas.accel})
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
 		.bind_tlas(instance->vkb.tlas);
 	// Select a reservoir sample
 	instance->vkb.rg
@@ -237,12 +239,13 @@ void VCM::render() {
 												 {"src/shaders/ray_shadow.rmiss"},
 												 {"src/shaders/ray.rchit"},
 												 {"src/shaders/ray.rahit"}},
+									 .specialization_data = spec_data,
 									 .dims = {instance->width, instance->height},
 									 .accel = instance->vkb.tlas.accel})
 		.push_constants(&pc_ray)
 		.bind(rt_bindings)
 		.bind(mesh_lights_buffer)
-		.bind_texture_array(scene_textures)
+		.bind(aov_bindings())
 		.bind_tlas(instance->vkb.tlas);
 
 	if (!do_spatiotemporal) {
@@ -17,6 +17,7 @@ class VCM : public Integrator {
 	virtual void render() override;
 	virtual bool update() override;
 	virtual void destroy() override;
+	virtual bool supports_aovs() const override { return true; }
 
    private:
 	PCVCM pc_ray{};
@@ -24,9 +24,7 @@ class VCMMLT : public Integrator {
 	virtual void destroy() override;
 
    private:
-	void prefix_scan(int level, int num_elems, int& counter, RenderGraph* rg);
 	PCMLT pc_ray{};
-	PushConstantCompute pc_compute{};
 	// SMLT buffers
 	Buffer bootstrap_buffer;
 	Buffer cdf_buffer;
@@ -46,7 +44,7 @@ class VCMMLT : public Integrator {
 	Buffer mlt_atomicsum_buffer;
 	Buffer mlt_residual_buffer;
 	Buffer counter_buffer;
-	std::vector<Buffer> block_sums;
+	Buffer scan_state_buffer;
 
 	Buffer light_path_cnt_buffer;
 	int mutation_count;
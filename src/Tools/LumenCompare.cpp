@@ -0,0 +1,250 @@
+#include "Framework/Logger.h"
+#include "Framework/ThreadPool.h"
+#include "Framework/ImageUtils.h"
+#include "Framework/ImageMetrics.h"
+#include <cctype>
+#include <filesystem>
+#include <random>
+#include <sstream>
+
+/*
+	lumen-compare [options] <reference.exr> <test.exr>...
+	Compares the test images against the reference and prints one line of metrics per test image.
+		--metrics mse,rmse,relmse,mape,ssim,flip	Metrics to compute, all by default
+		--exposure E, --ppd P, --epsilon E			See ImageMetricSettings
+		--heatmaps DIR								Writes DIR/<test>_<metric>.exr
+		--heatmap-max V								Value at the top of the heatmaps of MSE, RMSE, relMSE and MAPE,
+													the 99th percentile of the map by default
+		--csv										Prints CSV instead of a table
+		--threads N									Worker count of the ThreadPool, all hardware threads by default
+		--bench N									Times N runs of each metric, on a generated 3840x2160 pair
+													if no images are given
+*/
+
+namespace {
+struct Image {
+	std::unique_ptr<float, decltype(&free)> rgba{nullptr, &free};
+	int width = 0;
+	int height = 0;
+};
+
+Image load_image(const std::string& path) {
+	Image image;
+	try {
+		image.rgba.reset(load_exr(path.c_str(), image.width, image.height));
+	} catch (const std::exception&) {
+	}
+	if (!image.rgba) {
+		fprintf(stderr, "Failed to load %s\n", path.c_str());
+	}
+	return image;
+}
+
+// Noisy version of a smooth HDR image, stands in for a render and its reference
+std::pair<Image, Image> synthetic_pair(int width, int height) {
+	std::pair<Image, Image> pair;
+	for (Image* image : {&pair.first, &pair.second}) {
+		image->rgba.reset((float*)malloc(size_t(width) * height * 4 * sizeof(float)));
+		image->width = width;
+		image->height = height;
+	}
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			const size_t idx = (size_t(y) * width + x) * 4;
+			for (int c = 0; c < 4; c++) {
+				const float v = 1.0f + std::sin(0.01f * x * (c + 1)) * std::cos(0.013f * y);
+				pair.first.rgba.get()[idx + c] = v;
+				pair.second.rgba.get()[idx + c] = v * (1.0f + noise(rng));
+			}
+		}
+	}
+	return pair;
+}
+
+float heatmap_max(ImageMetric metric, std::vector<float> values, float max_value) {
+	if (metric == ImageMetric::SSIM || metric == ImageMetric::FLIP) {
+		return 1.0f;
+	}
+	if (max_value > 0.0f) {
+		return max_value;
+	}
+	auto percentile = values.begin() + values.size() * 99 / 100;
+	std::nth_element(values.begin(), percentile, values.end());
+	return *percentile;
+}
+
+void print_usage() {
+	printf(
+		"Usage: lumen-compare [--metrics mse,rmse,relmse,mape,ssim,flip] [--exposure E] [--ppd P] [--epsilon E]\n"
+		"                     [--heatmaps DIR] [--heatmap-max V] [--csv] [--threads N] [--bench N]\n"
+		"                     <reference.exr> <test.exr>...\n");
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	std::vector<ImageMetric> metrics;
+	ImageMetricSettings settings;
+	std::string heatmap_dir;
+	float max_value = 0.0f;
+	bool csv = false;
+	uint32_t num_threads = 0;
+	uint32_t bench_runs = 0;
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (arg == "--metrics" && has_value) {
+			std::stringstream names(argv[++i]);
+			for (std::string name; std::getline(names, name, ',');) {
+				std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+				bool found = false;
+				for (uint32_t m = 0; m < (uint32_t)ImageMetric::Count; m++) {
+					std::string metric_id = metric_name(ImageMetric(m));
+					std::transform(metric_id.begin(), metric_id.end(), metric_id.begin(), ::tolower);
+					if (metric_id == name) {
+						metrics.push_back(ImageMetric(m));
+						found = true;
+					}
+				}
+				if (!found) {
+					fprintf(stderr, "Unknown metric %s\n", name.c_str());
+					return 1;
+				}
+			}
+		} else if (arg == "--exposure" && has_value) {
+			settings.exposure = std::strtof(argv[++i], nullptr);
+		} else if (arg == "--ppd" && has_value) {
+			settings.pixels_per_degree = std::strtof(argv[++i], nullptr);
+		} else if (arg == "--epsilon" && has_value) {
+			settings.epsilon = std::strtof(argv[++i], nullptr);
+		} else if (arg == "--heatmaps" && has_value) {
+			heatmap_dir = argv[++i];
+		} else if (arg == "--heatmap-max" && has_value) {
+			max_value = std::strtof(argv[++i], nullptr);
+		} else if (arg == "--csv") {
+			csv = true;
+		} else if (arg == "--threads" && has_value) {
+			num_threads = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		} else if (arg == "--bench" && has_value) {
+			bench_runs = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		} else if (arg == "--help" || arg == "-h") {
+			print_usage();
+			return 0;
+		} else if (arg.rfind("--", 0) == 0) {
+			fprintf(stderr, "Unknown option %s\n", arg.c_str());
+			print_usage();
+			return 1;
+		} else {
+			paths.push_back(arg);
+		}
+	}
+	if (metrics.empty()) {
+		for (uint32_t m = 0; m < (uint32_t)ImageMetric::Count; m++) {
+			metrics.push_back(ImageMetric(m));
+		}
+	}
+	if (paths.size() < 2 && !(bench_runs && paths.empty())) {
+		print_usage();
+		return 1;
+	}
+
+	Logger::init();
+	ThreadPool::init(num_threads);
+	int result = 0;
+	if (bench_runs) {
+		std::pair<Image, Image> images;
+		if (paths.empty()) {
+			images = synthetic_pair(3840, 2160);
+		} else {
+			images = {load_image(paths[0]), load_image(paths[1])};
+		}
+		const Image& reference = images.first;
+		const Image& test = images.second;
+		if (!reference.rgba || !test.rgba || reference.width != test.width || reference.height != test.height) {
+			fprintf(stderr, "The images have to be loaded and of the same size\n");
+			ThreadPool::destroy();
+			return 1;
+		}
+		printf("%dx%d, %u workers, %u runs\n", test.width, test.height, ThreadPool::num_threads(), bench_runs);
+		const float* test_rgba = test.rgba.get();
+		const float* reference_rgba = reference.rgba.get();
+		for (ImageMetric metric : metrics) {
+			// Warm up, also sizes the scratch of the workers
+			double value = compute_metric(metric, test_rgba, reference_rgba, test.width, test.height, settings);
+			const auto start = std::chrono::steady_clock::now();
+			for (uint32_t run = 0; run < bench_runs; run++) {
+				value = compute_metric(metric, test_rgba, reference_rgba, test.width, test.height, settings);
+			}
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			const double ms = elapsed.count() / bench_runs;
+			printf("%-8s %10.3f ms %10.1f MPixel/s   (%g)\n", metric_name(metric), ms,
+				   double(test.width) * test.height / (ms * 1000.0), value);
+		}
+		ThreadPool::destroy();
+		return 0;
+	}
+
+	if (!heatmap_dir.empty()) {
+		std::error_code ec;
+		std::filesystem::create_directories(heatmap_dir, ec);
+	}
+	const Image reference = load_image(paths[0]);
+	if (!reference.rgba) {
+		ThreadPool::destroy();
+		return 1;
+	}
+	if (csv) {
+		printf("test");
+		for (ImageMetric metric : metrics) {
+			printf(",%s", metric_name(metric));
+		}
+		printf("\n");
+	}
+	std::vector<float> error_map;
+	for (size_t i = 1; i < paths.size(); i++) {
+		const Image test = load_image(paths[i]);
+		if (!test.rgba) {
+			result = 1;
+			continue;
+		}
+		if (test.width != reference.width || test.height != reference.height) {
+			fprintf(stderr, "%s is %dx%d, the reference is %dx%d\n", paths[i].c_str(), test.width, test.height,
+					reference.width, reference.height);
+			result = 1;
+			continue;
+		}
+		printf(csv ? "%s" : "%s\n", paths[i].c_str());
+		for (ImageMetric metric : metrics) {
+			std::vector<float>* map = heatmap_dir.empty() ? nullptr : &error_map;
+			const double value =
+				compute_metric(metric, test.rgba.get(), reference.rgba.get(), test.width, test.height, settings, map);
+			if (csv) {
+				printf(",%.9g", value);
+			} else {
+				printf("  %-8s %.9g\n", metric_name(metric), value);
+			}
+			if (map) {
+				if (metric == ImageMetric::SSIM) {
+					for (float& v : error_map) {
+						v = 1.0f - v;
+					}
+				}
+				const std::vector<float> heatmap = error_heatmap(error_map, heatmap_max(metric, error_map, max_value));
+				const std::string out = (std::filesystem::path(heatmap_dir) /
+										 (std::filesystem::path(paths[i]).stem().string() + "_" + metric_name(metric) +
+										  ".exr"))
+											.string();
+				if (!save_exr(heatmap.data(), test.width, test.height, out.c_str(), ExrWriteSettings{})) {
+					result = 1;
+				}
+			}
+		}
+		if (csv) {
+			printf("\n");
+		}
+	}
+	ThreadPool::destroy();
+	return result;
+}
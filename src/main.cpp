@@ -14,13 +14,32 @@ int main(int argc, char* argv[]) {
 	bool fullscreen = false;
 	int width = 1600;
 	int height = 900;
+	// --threads N overrides the worker count of the ThreadPool, 0 uses all hardware threads
+	uint32_t num_threads = 0;
+	// --profile-threads records the ThreadPool counters from the start, startup is dumped as a trace
+	bool profile_threads = false;
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		if (arg == "--profile-threads") {
+			profile_threads = true;
+		} else if (arg == "--threads" && i + 1 < argc) {
+			num_threads = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		} else if (arg.rfind("--threads=", 0) == 0) {
+			num_threads = (uint32_t)std::strtoul(arg.c_str() + 10, nullptr, 10);
+		}
+	}
 	Logger::init();
-	ThreadPool::init();
+	ThreadPool::init(num_threads);
+	ThreadPool::set_profiling(profile_threads);
 	Window window(width, height, fullscreen);
+	int exit_code = EXIT_SUCCESS;
 	{
 		RayTracer app(width, height, enable_debug, argc, argv);
 		app.init(&window);
-		while (!window.should_close()) {
+		if (app.primitives_valid) {
+			exit_code = *app.primitives_valid ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		while (!app.primitives_valid && !window.should_close()) {
 			window.poll();
 			app.update();
 		}
@@ -28,5 +47,5 @@ int main(int argc, char* argv[]) {
 	}
 
 	ThreadPool::destroy();
-	return 0;
+	return exit_code;
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 Material load_material(const uint material_idx, const vec2 uv) {
     Material m = materials.m[material_idx];
     if (m.texture_id > -1) {
-        m.albedo *= texture(scene_textures[m.texture_id], uv).xyz;
+        m.albedo *= texture(scene_textures[nonuniformEXT(m.texture_id)], uv).xyz;
     }
     return m;
 }
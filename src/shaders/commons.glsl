@@ -5,20 +5,25 @@
 #include "atmosphere/atmosphere.glsl"
 
 
-#ifndef SCENE_TEX_IDX
-#define SCENE_TEX_IDX 4
-#endif
-
 layout(location = 0) rayPayloadEXT HitPayload payload;
 layout(location = 1) rayPayloadEXT AnyHitPayload any_hit_payload;
 layout(binding = 0, rgba32f) uniform image2D image;
 layout(binding = 1) uniform SceneUBOBuffer { SceneUBO ubo; };
 layout(binding = 2) buffer SceneDesc_ { SceneDesc scene_desc; };
 layout(binding = 3, scalar) readonly buffer Lights { Light lights[]; };
-layout(binding = SCENE_TEX_IDX) uniform sampler2D scene_textures[];
+// Bindless heap, see BindlessHeap.h
+layout(set = 2, binding = 0) uniform sampler2D scene_textures[];
 
 
 layout(set = 1, binding = 0) uniform accelerationStructureEXT tlas;
+
+// Config values baked into the kernel as value + 1, 0 leaves them to the push constants
+layout(constant_id = SPEC_MAX_DEPTH) const int spec_max_depth = 0;
+layout(constant_id = SPEC_USE_VM) const int spec_use_vm = 0;
+layout(constant_id = SPEC_USE_VC) const int spec_use_vc = 0;
+#define MAX_DEPTH (spec_max_depth > 0 ? spec_max_depth - 1 : pc_ray.max_depth)
+#define USE_VM (spec_use_vm > 0 ? spec_use_vm - 1 : pc_ray.use_vm)
+#define USE_VC (spec_use_vc > 0 ? spec_use_vc - 1 : pc_ray.use_vc)
 layout(buffer_reference, scalar) readonly buffer InstanceInfo {
     PrimMeshInfo d[];
 };
@@ -182,7 +187,7 @@ TriangleRecord sample_triangle(PrimMeshInfo pinfo, vec2 rands,
 vec3 eval_albedo(const Material m) {
     vec3 albedo = m.albedo;
     if (m.texture_id > -1) {
-        albedo *= texture(scene_textures[m.texture_id], payload.uv).xyz;
+        albedo *= texture(scene_textures[nonuniformEXT(m.texture_id)], payload.uv).xyz;
     }
     return albedo;
 }
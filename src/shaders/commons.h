@@ -9,6 +9,17 @@
 #define INTEGRATOR_VCM_EYE 5
 #define INTERATOR_COUNT 6
 
+// Specialization constant ids of the integrator config values, see Integrator::specialize.
+// The ids below 3 are taken by the kernels' own constants
+#define SPEC_MAX_DEPTH 3
+#define SPEC_USE_VM 4
+#define SPEC_USE_VC 5
+
+// Operators of the reductions in shaders/primitives, passed as the REDUCE_OP macro
+#define REDUCE_SUM 0
+#define REDUCE_MIN 1
+#define REDUCE_MAX 2
+
 // BSDF Types
 #define BSDF_DIFFUSE 1 << 0
 #define BSDF_MIRROR 1 << 1
@@ -250,15 +261,19 @@ struct PCPost {
 	float bloom_amount;
 };
 
-struct PushConstantCompute {
+// Strided float input of the reduce and scan primitives: element i is in[i * stride + offset] * scale
+struct PCPrimitives {
 	uint num_elems;
-	uint base_idx;
-	uint block_idx;
-	uint n;
-	uint store_sum;
-	uint scan_sums;
-	uint64_t block_sum_addr;
-	uint64_t out_addr;
+	uint stride;
+	uint offset;
+	float scale;
+	uint inclusive;
+};
+
+struct PCIndirectArgs {
+	uint count_idx;
+	uint group_size;
+	uint max_groups;
 };
 
 struct SceneUBO {
@@ -273,6 +288,8 @@ struct SceneUBO {
 	mat4 prev_projection;
 	ivec2 clicked_pos;
 	int debug_click;
+	// The integrators fill the AOV images, see aov_commons.glsl
+	int write_aovs;
 };
 
 struct DDGIUniforms {
@@ -662,7 +679,6 @@ struct SceneDesc {
 	uint64_t chain_stats_addr;
 	uint64_t splat_addr;
 	uint64_t past_splat_addr;
-	uint64_t block_sums_addr;
 
 	uint64_t connected_lights_addr;
 	uint64_t tmp_seeds_addr;
@@ -707,8 +723,6 @@ struct Desc2 {
 struct RTUtilsDesc {
 	uint64_t out_img_addr;
 	uint64_t gt_img_addr;
-	uint64_t residual_addr;
-	uint64_t counter_addr;
 	uint64_t rmse_val_addr;
 };
 
@@ -0,0 +1,50 @@
+#ifndef AOV_COMMONS
+#define AOV_COMMONS
+// Auxiliary outputs, bound after the lights (Integrator::aov_bindings()). They are
+// 1x1 placeholders unless ubo.write_aovs is set
+layout(binding = 4, rgba32f) uniform image2D aov_albedo_depth;
+layout(binding = 5, rgba32f) uniform image2D aov_normal;
+layout(binding = 6, rgba32f) uniform image2D aov_stats;
+
+// Lets the shared integrator code record the first hit
+#define WRITE_AOVS 1
+
+vec3 aov_albedo = vec3(0);
+vec3 aov_n_s = vec3(0);
+float aov_depth = 0;
+
+void aov_record_hit(const Material mat, vec3 n_s, vec3 pos) {
+    aov_albedo = mat.albedo;
+    aov_n_s = n_s;
+    // Distance along the view direction
+    aov_depth = dot(pos - ubo.view_pos.xyz, -ubo.inv_view[2].xyz);
+}
+
+// Accumulates the recorded hit and the luminance of the sample, the running
+// variance is updated with Welford's algorithm
+void aov_store(vec3 col, uint frame_num) {
+    if (ubo.write_aovs == 0) {
+        return;
+    }
+    const ivec2 coords = ivec2(gl_LaunchIDEXT.xy);
+    const float lum = luminance(col);
+    vec4 albedo_depth = vec4(aov_albedo, aov_depth);
+    vec4 normal = vec4(aov_n_s, 0);
+    vec4 stats = vec4(1, lum, 0, 0);
+    if (frame_num > 0) {
+        stats = imageLoad(aov_stats, coords);
+        stats.x += 1;
+        const float delta = lum - stats.y;
+        stats.y += delta / stats.x;
+        stats.z += delta * (lum - stats.y);
+        stats.w = stats.z / (stats.x - 1);
+        const float w = 1. / stats.x;
+        albedo_depth =
+            mix(imageLoad(aov_albedo_depth, coords), albedo_depth, w);
+        normal = mix(imageLoad(aov_normal, coords), normal, w);
+    }
+    imageStore(aov_albedo_depth, coords, albedo_depth);
+    imageStore(aov_normal, coords, normal);
+    imageStore(aov_stats, coords, stats);
+}
+#endif
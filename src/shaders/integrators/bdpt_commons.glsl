@@ -151,6 +151,11 @@ int bdpt_random_walk_eye(const int max_depth, vec3 throughput,
         const bool mat_transmissive =
             (mat.bsdf_props & BSDF_TRANSMISSIVE) == BSDF_TRANSMISSIVE;
         vtx_assign(b, delta, int(mat_specular));
+#ifdef WRITE_AOVS
+        if (b == 0) {
+            aov_record_hit(mat, n_s, payload.pos);
+        }
+#endif
 
         if (++b >= max_depth) {
             break;
@@ -152,7 +152,7 @@ vec3 vcm_get_light_radiance(in const Material mat,
     const float pdf_light_dir = abs(dot(payload.n_s, -camera_state.wi)) / PI;
     const float w_camera =
         pdf_light_pos * camera_state.d_vcm +
-        (pc_ray.use_vc == 1 || pc_ray.use_vm == 1
+        (USE_VC == 1 || USE_VM == 1
              ? (pdf_light_pos * pdf_light_dir) * camera_state.d_vc
              : 0);
     const float mis_weight = 1. / (1. + w_camera);
@@ -234,7 +234,7 @@ vec3 vcm_connect_light_vertices(uint light_path_len, uint light_path_idx,
     for (int i = 0; i < light_path_len; i++) {
         uint s = light_vtx(light_path_idx + i).path_len;
         uint mdepth = s + depth - 1;
-        if (mdepth >= pc_ray.max_depth) {
+        if (mdepth >= MAX_DEPTH) {
             break;
         }
         vec3 dir = light_vtx(light_path_idx + i).pos - payload.pos;
@@ -313,7 +313,7 @@ vec3 vcm_merge_light_vertices(uint light_path_len, uint light_path_idx,
                     }
                     // Should we?
                     uint depth = photons.d[h].path_len + depth - 1;
-                    if (depth > pc_ray.max_depth) {
+                    if (depth > MAX_DEPTH) {
                         continue;
                     }
                     float cam_pdf_fwd, cam_pdf_rev;
@@ -403,7 +403,7 @@ void vcm_fill_light(vec3 origin, VCMState vcm_state, bool finite_light,
         vcm_state.d_vcm /= cos_theta_wo;
         vcm_state.d_vc /= cos_theta_wo;
         vcm_state.d_vm /= cos_theta_wo;
-        if ((!mat_specular && (pc_ray.use_vc == 1 || pc_ray.use_vm == 1))) {
+        if ((!mat_specular && (USE_VC == 1 || USE_VM == 1))) {
 
             // Copy to light vertex buffer
             // light_vtx(path_idx).wi = vcm_state.wi;
@@ -421,12 +421,12 @@ void vcm_fill_light(vec3 origin, VCMState vcm_state, bool finite_light,
             light_vtx(path_idx).side = uint(side);
             path_idx++;
         }
-        if (depth >= pc_ray.max_depth) {
+        if (depth >= MAX_DEPTH) {
             break;
         }
         // Reverse pdf in solid angle form, since we have geometry term
         // at the outer paranthesis
-        if (!mat_specular && (pc_ray.use_vc == 1 && depth < pc_ray.max_depth)) {
+        if (!mat_specular && (USE_VC == 1 && depth < MAX_DEPTH)) {
             // Connect to camera
             ivec2 coords;
             vec3 splat_col =
@@ -520,7 +520,7 @@ void vcm_fill_light(vec3 origin, VCMState vcm_state, bool finite_light,
     // "Build" the hash grid
     // TODO: Add sorting later
 #if VC_MLT == 0
-    if (pc_ray.use_vm == 1) {
+    if (USE_VM == 1) {
         for (int i = 0; i < path_idx; i++) {
             ivec3 grid_idx = get_grid_idx(light_vtx(i).pos, pc_ray.min_bounds,
                                           pc_ray.max_bounds, pc_ray.grid_res);
@@ -558,7 +558,7 @@ vec3 vcm_trace_eye(VCMState camera_state, float eta_vcm, float eta_vc,
 #if VC_MLT == 1
     uint light_path_idx = uint(mlt_rand(mlt_seed, large_step) * screen_size);
     uint light_splat_idx =
-        light_path_idx * pc_ray.max_depth * (pc_ray.max_depth + 1);
+        light_path_idx * MAX_DEPTH * (MAX_DEPTH + 1);
     uint light_path_len = light_path_cnts.d[light_path_idx];
     mlt_sampler.splat_cnt = 0;
     if (save_radiance && connected_lights.d[pixel_idx] > 0) {
@@ -574,20 +574,20 @@ vec3 vcm_trace_eye(VCMState camera_state, float eta_vcm, float eta_vc,
     } else if (connected_lights.d[pixel_idx] > 0) {
         lum += tmp_lum_data.d[pixel_idx];
     }
-    light_path_idx *= (pc_ray.max_depth + 1);
+    light_path_idx *= (MAX_DEPTH + 1);
     light_splat_cnts.d[pixel_idx] = 0;
 #elif VCM_MLT == 1
     const uint num_light_paths = pc_ray.size_x * pc_ray.size_y;
     uint light_path_idx = uint(mlt_rand(seed, large_step) * num_light_paths);
     uint light_splat_idx =
-        light_path_idx * pc_ray.max_depth * (pc_ray.max_depth + 1);
+        light_path_idx * MAX_DEPTH * (MAX_DEPTH + 1);
     uint light_path_len = light_path_cnts.d[light_path_idx];
     mlt_sampler.splat_cnt = 0;
-    light_path_idx *= (pc_ray.max_depth + 1);
+    light_path_idx *= (MAX_DEPTH + 1);
 #else
     uint light_path_idx = uint(rand(seed) * screen_size);
     uint light_path_len = light_path_cnts.d[light_path_idx];
-    light_path_idx *= (pc_ray.max_depth + 1);
+    light_path_idx *= (MAX_DEPTH + 1);
 #endif
     vec3 col = vec3(0);
     int depth;
@@ -620,6 +620,11 @@ vec3 vcm_trace_eye(VCMState camera_state, float eta_vcm, float eta_vc,
         const Material mat = load_material(payload.material_idx, payload.uv);
         const bool mat_specular =
             (mat.bsdf_props & BSDF_SPECULAR) == BSDF_SPECULAR;
+#ifdef WRITE_AOVS
+        if (depth == 1) {
+            aov_record_hit(mat, n_s, payload.pos);
+        }
+#endif
         // Complete the missing geometry terms
         camera_state.d_vcm *= dist_sqr;
         camera_state.d_vcm /= cos_wo;
@@ -629,14 +634,14 @@ vec3 vcm_trace_eye(VCMState camera_state, float eta_vcm, float eta_vc,
         if (luminance(mat.emissive_factor) > 0) {
             col += camera_state.throughput *
                    vcm_get_light_radiance(mat, camera_state, depth);
-            // if (pc_ray.use_vc == 1 || pc_ray.use_vm == 1) {
+            // if (USE_VC == 1 || USE_VM == 1) {
             //     // break;
             // }
         }
         // Connect to light
         float pdf_rev;
         vec3 f;
-        if (!mat_specular && depth < pc_ray.max_depth) {
+        if (!mat_specular && depth < MAX_DEPTH) {
             col += vcm_connect_light(n_s, wo, mat, side, eta_vm, camera_state,
                                      pdf_rev, f);
         }
@@ -650,13 +655,13 @@ vec3 vcm_trace_eye(VCMState camera_state, float eta_vcm, float eta_vc,
 #if VC_MLT == 0
         // Vertex merging
         float r_sqr = radius * radius;
-        if (!mat_specular && pc_ray.use_vm == 1) {
+        if (!mat_specular && USE_VM == 1) {
             col += vcm_merge_light_vertices(
                 light_path_len, light_path_idx, depth, n_s, wo, mat, side,
                 eta_vc, camera_state, pdf_rev, radius, normalization_factor);
         }
 #endif
-        if (depth >= pc_ray.max_depth) {
+        if (depth >= MAX_DEPTH) {
             break;
         }
 
@@ -804,14 +809,14 @@ float mlt_fill_eye() {
         // Connect to light
         float pdf_rev;
         vec3 f;
-        if (!mat_specular && depth < pc_ray.max_depth) {
+        if (!mat_specular && depth < MAX_DEPTH) {
             const vec3 L = vcm_connect_light(n_s, wo, mat, side, 0,
                                              camera_state, pdf_rev, f);
             tmp_col.d[coords_idx] += L;
             lum_sum += luminance(L);
         }
 
-        if (depth >= pc_ray.max_depth) {
+        if (depth >= MAX_DEPTH) {
             break;
         }
         // Scattering
@@ -870,7 +875,7 @@ float mlt_trace_light() {
     uint path_idx =
         uint(mlt_rand(mlt_seed, large_step) * (pc_ray.size_x * pc_ray.size_y));
     uint path_len = light_path_cnts.d[path_idx];
-    path_idx *= (pc_ray.max_depth + 1);
+    path_idx *= (MAX_DEPTH + 1);
     // Trace from light
     VCMState light_state;
     bool finite;
@@ -918,10 +923,10 @@ float mlt_trace_light() {
         light_state.d_vcm /= cos_theta_wo;
         light_state.d_vc /= cos_theta_wo;
         light_state.d_vm /= cos_theta_wo;
-        if (d >= pc_ray.max_depth + 1) {
+        if (d >= MAX_DEPTH + 1) {
             break;
         }
-        if (d < pc_ray.max_depth) {
+        if (d < MAX_DEPTH) {
             // Connect to camera
             ivec2 coords;
             vec3 splat_col =
@@ -947,7 +952,7 @@ float mlt_trace_light() {
             for (int i = 0; i < path_len; i++) {
                 uint t = cam_vtx(path_idx + i).path_len;
                 uint depth = t + d - 1;
-                if (depth >= pc_ray.max_depth) {
+                if (depth >= MAX_DEPTH) {
                     break;
                 }
                 vec3 dir = hit_pos - cam_vtx(path_idx + i).pos;
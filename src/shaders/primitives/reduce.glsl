@@ -0,0 +1,92 @@
+#ifndef REDUCE_GLSL
+#define REDUCE_GLSL
+// Single-pass reduction: every workgroup reduces its values with subgroup operations and writes one partial,
+// the last workgroup to finish reduces the partials. Needs GL_KHR_shader_subgroup_arithmetic.
+//
+// The includer sets REDUCE_OP (REDUCE_SUM, REDUCE_MIN or REDUCE_MAX from commons.h), REDUCE_TYPE (float or a
+// float vector) and REDUCE_BINDING of the scratch buffer, which has to be zeroed once on creation, see
+// reduce_scratch_size(). All invocations of the dispatch have to call reduce_single_pass(), out of range ones
+// with REDUCE_IDENTITY.
+
+#ifndef REDUCE_OP
+#define REDUCE_OP REDUCE_SUM
+#endif
+#ifndef REDUCE_TYPE
+#define REDUCE_TYPE float
+#endif
+#ifndef REDUCE_BINDING
+#define REDUCE_BINDING 1
+#endif
+// Enough for 1024 invocations with subgroups of 8
+#define REDUCE_MAX_SUBGROUPS 128
+
+#if REDUCE_OP == REDUCE_SUM
+#define REDUCE_IDENTITY REDUCE_TYPE(0)
+#define reduce_combine(a, b) ((a) + (b))
+#define reduce_subgroup(a) subgroupAdd(a)
+#elif REDUCE_OP == REDUCE_MIN
+#define REDUCE_IDENTITY REDUCE_TYPE(3.402823466e+38)
+#define reduce_combine(a, b) min(a, b)
+#define reduce_subgroup(a) subgroupMin(a)
+#elif REDUCE_OP == REDUCE_MAX
+#define REDUCE_IDENTITY REDUCE_TYPE(-3.402823466e+38)
+#define reduce_combine(a, b) max(a, b)
+#define reduce_subgroup(a) subgroupMax(a)
+#endif
+
+layout(binding = REDUCE_BINDING, scalar) coherent buffer ReduceScratch_ {
+    uint reduce_ticket;
+    REDUCE_TYPE reduce_partials[];
+};
+
+shared REDUCE_TYPE reduce_shared[REDUCE_MAX_SUBGROUPS];
+shared bool reduce_last_group;
+
+// Result is only valid in the first invocation
+REDUCE_TYPE reduce_workgroup(REDUCE_TYPE val) {
+    // Previous users of the shared memory are done
+    barrier();
+    val = reduce_subgroup(val);
+    if (subgroupElect()) {
+        reduce_shared[gl_SubgroupID] = val;
+    }
+    barrier();
+    if (gl_SubgroupID == 0) {
+        REDUCE_TYPE acc = REDUCE_IDENTITY;
+        for (uint i = gl_SubgroupInvocationID; i < gl_NumSubgroups; i += gl_SubgroupSize) {
+            acc = reduce_combine(acc, reduce_shared[i]);
+        }
+        val = reduce_subgroup(acc);
+    }
+    return val;
+}
+
+// Returns true in the single invocation that holds the result of the whole dispatch
+bool reduce_single_pass(REDUCE_TYPE val, out REDUCE_TYPE result) {
+    val = reduce_workgroup(val);
+    if (gl_LocalInvocationIndex == 0) {
+        reduce_partials[gl_WorkGroupID.x] = val;
+        // The partial has to be visible before the ticket is taken
+        memoryBarrierBuffer();
+        reduce_last_group = atomicAdd(reduce_ticket, 1) == gl_NumWorkGroups.x - 1;
+    }
+    barrier();
+    if (!reduce_last_group) {
+        return false;
+    }
+    memoryBarrierBuffer();
+    REDUCE_TYPE acc = REDUCE_IDENTITY;
+    for (uint i = gl_LocalInvocationIndex; i < gl_NumWorkGroups.x; i += gl_WorkGroupSize.x) {
+        acc = reduce_combine(acc, reduce_partials[i]);
+    }
+    acc = reduce_workgroup(acc);
+    if (gl_LocalInvocationIndex == 0) {
+        // Ready for the next dispatch without a clear
+        reduce_ticket = 0;
+        result = acc;
+        return true;
+    }
+    return false;
+}
+
+#endif
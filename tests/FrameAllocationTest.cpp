@@ -0,0 +1,278 @@
+#include "TestUtils.h"
+#include "Framework/FrameArena.h"
+#include "Framework/PassScheduler.h"
+#include <atomic>
+#include <new>
+#include <unordered_map>
+
+// Counts every heap allocation of the process
+static std::atomic<uint64_t> heap_allocations = 0;
+
+void* operator new(size_t size) {
+	heap_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	heap_allocations.fetch_add(1, std::memory_order_relaxed);
+	const size_t align = std::max((size_t)alignment, sizeof(void*));
+	if (void* ptr = aligned_alloc(align, (size + align - 1) / align * align)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { free(ptr); }
+
+struct SimResource {
+	uint64_t id = 0;
+	bool transient = false;
+};
+
+struct SimPass {
+	bool active = true;
+	bool graphics = false;
+	std::vector<uint64_t> reads;
+	std::vector<uint64_t> writes;
+};
+
+/*
+	The device-free part of RenderGraph::run() with the same members and the same per-frame steps: schedule_range(),
+	plan_queue_batches() and record_in_chunks(). The command recording itself is replaced by a checksum.
+*/
+struct SimGraph {
+	struct QueueBatch {
+		bool compute = false;
+		std::pmr::vector<uint32_t> pass_idxs;
+		int32_t wait_batch = -1;
+	};
+
+	std::vector<SimPass> passes;
+	std::vector<SimResource> transients;
+	bool cull_passes = true;
+	bool reorder_passes = true;
+	uint32_t min_passes_per_chunk = 2;
+
+	FrameArena frame_arena{4 * 1024};
+	PassSchedule range_schedule;
+	std::vector<uint32_t> range_pass_idxs;
+	std::vector<PassAccesses> range_accesses;
+	std::vector<uint64_t> range_transients;
+	std::vector<uint32_t> range_order;
+	std::vector<uint32_t> scheduled_order;
+	std::vector<uint32_t> prev_scheduled_order;
+	std::vector<QueueBatch> queue_batches;
+	PassAccesses batch_accesses;
+	std::vector<bool> record_serial;
+	std::vector<RecordSegment> record_segments;
+
+	void collect_accesses(const SimPass& pass, PassAccesses& access) const {
+		access.reads.clear();
+		access.writes.clear();
+		access.side_effects = false;
+		access.reads.insert(access.reads.end(), pass.reads.begin(), pass.reads.end());
+		access.writes.insert(access.writes.end(), pass.writes.begin(), pass.writes.end());
+	}
+
+	void schedule_range() {
+		range_pass_idxs.clear();
+		for (uint32_t i = 0; i < passes.size(); i++) {
+			if (passes[i].active) {
+				range_pass_idxs.push_back(i);
+			}
+		}
+		if (range_accesses.size() < range_pass_idxs.size()) {
+			range_accesses.resize(range_pass_idxs.size());
+		}
+		for (uint32_t k = 0; k < range_pass_idxs.size(); k++) {
+			collect_accesses(passes[range_pass_idxs[k]], range_accesses[k]);
+		}
+		range_transients.clear();
+		for (const SimResource& transient : transients) {
+			range_transients.push_back(transient.id);
+		}
+		std::sort(range_transients.begin(), range_transients.end());
+		schedule_passes(std::span(range_accesses.data(), range_pass_idxs.size()), range_transients, cull_passes,
+						reorder_passes, range_schedule, &frame_arena);
+		for (uint32_t& idx : range_schedule.order) {
+			idx = range_pass_idxs[idx];
+		}
+		for (uint32_t& idx : range_schedule.culled) {
+			idx = range_pass_idxs[idx];
+		}
+	}
+
+	// Alternates the queue on every resource handoff between graphics and compute passes
+	void plan_queue_batches() {
+		std::pmr::unordered_map<uint64_t, int32_t> last_batch(&frame_arena);
+		std::pmr::unordered_map<uint64_t, SimResource> resources(&frame_arena);
+		auto push_batch = [this](bool compute, int32_t wait_batch) {
+			queue_batches.push_back(
+				{.compute = compute, .pass_idxs = std::pmr::vector<uint32_t>(&frame_arena), .wait_batch = wait_batch});
+		};
+		push_batch(false, -1);
+		PassAccesses& accesses = batch_accesses;
+		std::pmr::vector<uint64_t> ids(&frame_arena);
+		for (uint32_t idx : range_order) {
+			collect_accesses(passes[idx], accesses);
+			ids.assign(accesses.reads.begin(), accesses.reads.end());
+			ids.insert(ids.end(), accesses.writes.begin(), accesses.writes.end());
+			std::sort(ids.begin(), ids.end());
+			ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+			const bool compute = !passes[idx].graphics;
+			if (queue_batches.back().compute != compute) {
+				push_batch(compute, int32_t(queue_batches.size() - 1));
+			}
+			for (uint64_t id : ids) {
+				resources.try_emplace(id, SimResource{.id = id});
+				last_batch[id] = int32_t(queue_batches.size() - 1);
+			}
+			queue_batches.back().pass_idxs.push_back(idx);
+		}
+	}
+
+	uint64_t record_in_chunks() {
+		record_serial.assign(range_order.size(), false);
+		for (size_t k = 0; k < range_order.size(); k++) {
+			record_serial[k] = passes[range_order[k]].graphics;
+		}
+		partition_recording(record_serial, min_passes_per_chunk, ThreadPool::num_threads(), record_segments);
+		const uint32_t num_chunks = (uint32_t)std::count_if(
+			record_segments.begin(), record_segments.end(), [](const RecordSegment& segment) { return !segment.serial; });
+		auto record_chunk = [this](uint32_t begin, uint32_t end) {
+			uint64_t sum = 0;
+			for (uint32_t k = begin; k < end; k++) {
+				sum += range_order[k] * 31 + k;
+			}
+			return sum;
+		};
+		std::pmr::vector<TaskGroup> chunk_tasks(num_chunks, &frame_arena);
+		std::pmr::vector<uint64_t> chunk_sums(num_chunks, &frame_arena);
+		uint32_t c = 0;
+		for (const RecordSegment& segment : record_segments) {
+			if (!segment.serial) {
+				chunk_tasks[c].run("record", [&record_chunk, &chunk_sums, c, segment] {
+					chunk_sums[c] = record_chunk(segment.begin, segment.end);
+				});
+				c++;
+			}
+		}
+		uint64_t sum = 0;
+		c = 0;
+		for (const RecordSegment& segment : record_segments) {
+			if (segment.serial) {
+				sum += record_chunk(segment.begin, segment.end);
+			} else {
+				chunk_tasks[c].wait();
+				sum += chunk_sums[c++];
+			}
+		}
+		return sum;
+	}
+
+	uint64_t run() {
+		schedule_range();
+		for (uint32_t culled_idx : range_schedule.culled) {
+			passes[culled_idx].active = false;
+		}
+		range_order.assign(range_schedule.order.begin(), range_schedule.order.end());
+		scheduled_order.insert(scheduled_order.end(), range_order.begin(), range_order.end());
+		plan_queue_batches();
+		return record_in_chunks();
+	}
+
+	void reset() {
+		std::swap(prev_scheduled_order, scheduled_order);
+		scheduled_order.clear();
+		queue_batches.clear();
+		for (SimPass& pass : passes) {
+			pass.active = true;
+		}
+		frame_arena.reset();
+	}
+};
+
+// A frame of the path tracer shape: a G-buffer, compute work fanning out from it, a transient FFT chain whose
+// output is never read and a graphics pass at the end
+static void build_passes(SimGraph& graph, uint32_t compute_passes) {
+	enum : uint64_t { GBUFFER = 1, OUTPUT, FFT_A, FFT_B, FIRST_IMAGE };
+	graph.transients = {{.id = FFT_A, .transient = true}, {.id = FFT_B, .transient = true}};
+	graph.passes.push_back({.graphics = true, .writes = {GBUFFER}});
+	for (uint32_t i = 0; i < compute_passes; i++) {
+		const uint64_t image = FIRST_IMAGE + i;
+		graph.passes.push_back({.reads = {GBUFFER, image - (i % 3 == 0 ? 0 : 1)}, .writes = {image}});
+	}
+	graph.passes.push_back({.reads = {GBUFFER}, .writes = {FFT_A}});
+	graph.passes.push_back({.reads = {FFT_A}, .writes = {FFT_B}});
+	graph.passes.push_back({.graphics = true, .reads = {FIRST_IMAGE + compute_passes - 1}, .writes = {OUTPUT}});
+}
+
+static size_t count_batches(const SimGraph& graph) { return graph.queue_batches.size(); }
+
+int main() {
+	Logger::init();
+	ThreadPool::init(4);
+	{
+		SimGraph graph;
+		build_passes(graph, 40);
+
+		// The first frames grow the members and the arena, and fill the task free lists of the workers
+		uint64_t checksum = 0;
+		size_t warm_batches = 0;
+		for (uint32_t frame = 0; frame < 200; frame++) {
+			checksum = graph.run();
+			warm_batches = count_batches(graph);
+			graph.reset();
+		}
+		TEST_CHECK(graph.range_schedule.culled.size() == 2);
+		TEST_CHECK(graph.prev_scheduled_order.size() == graph.passes.size() - 2);
+		const uint64_t arena_allocations = graph.frame_arena.upstream_allocations();
+		const size_t capacity = graph.frame_arena.capacity();
+
+		// From here on a frame doesn't touch the heap at all
+		const uint64_t heap_before = heap_allocations.load();
+		size_t batches = 0;
+		for (uint32_t frame = 0; frame < 200; frame++) {
+			TEST_CHECK(graph.run() == checksum);
+			batches += count_batches(graph);
+			TEST_CHECK(graph.frame_arena.used() > 0);
+			graph.reset();
+		}
+		const uint64_t heap_after = heap_allocations.load();
+		TEST_CHECK(heap_after == heap_before);
+		TEST_CHECK(graph.frame_arena.upstream_allocations() == arena_allocations);
+		TEST_CHECK(graph.frame_arena.capacity() == capacity);
+		TEST_CHECK(batches == 200 * warm_batches);
+		printf("steady state: %llu heap allocations over 200 frames, arena capacity %zu bytes\n",
+			   (unsigned long long)(heap_after - heap_before), capacity);
+
+		// The counter itself works, the volatile keeps the compiler from eliding the allocation
+		std::vector<int>* volatile counted = new std::vector<int>(16);
+		TEST_CHECK(heap_allocations.load() == heap_after + 2);
+		delete counted;
+
+		// More passes grow the graph once more, then it is steady again
+		graph.passes.clear();
+		build_passes(graph, 400);
+		for (uint32_t frame = 0; frame < 8; frame++) {
+			graph.run();
+			graph.reset();
+		}
+		TEST_CHECK(graph.frame_arena.capacity() > capacity);
+		const uint64_t heap_grown = heap_allocations.load();
+		for (uint32_t frame = 0; frame < 50; frame++) {
+			graph.run();
+			graph.reset();
+		}
+		TEST_CHECK(heap_allocations.load() == heap_grown);
+		TEST_CHECK(graph.frame_arena.used() == 0);
+	}
+	ThreadPool::destroy();
+	return test_result("FrameAllocationTest");
+}
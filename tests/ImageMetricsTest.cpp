@@ -0,0 +1,115 @@
+#include "TestUtils.h"
+#include "Framework/ImageMetrics.h"
+#include <random>
+
+static bool near(double value, double expected, double tolerance = 1e-5) {
+	return std::abs(value - expected) <= tolerance * std::max(1.0, std::abs(expected));
+}
+
+static std::vector<float> random_image(std::mt19937& rng, int width, int height) {
+	std::uniform_real_distribution<float> dist(0.05f, 0.9f);
+	std::vector<float> image(size_t(width) * height * 4);
+	for (float& v : image) {
+		v = dist(rng);
+	}
+	return image;
+}
+
+static std::vector<float> constant_image(int width, int height, float value) {
+	std::vector<float> image(size_t(width) * height * 4, value);
+	for (size_t i = 3; i < image.size(); i += 4) {
+		image[i] = 1.0f;
+	}
+	return image;
+}
+
+// Sizes that leave SSE2 tails and partial bands
+static void test_size(std::mt19937& rng, int width, int height) {
+	const std::vector<float> ref = random_image(rng, width, height);
+	const float* r = ref.data();
+
+	// Identical images
+	std::vector<float> map;
+	for (ImageMetric metric : {ImageMetric::MSE, ImageMetric::RMSE, ImageMetric::RelMSE, ImageMetric::MAPE}) {
+		TEST_CHECK(compute_metric(metric, r, r, width, height, {}, &map) == 0.0);
+		TEST_CHECK(map.size() == size_t(width) * height);
+		TEST_CHECK(std::all_of(map.begin(), map.end(), [](float v) { return v == 0.0f; }));
+	}
+	TEST_CHECK(near(compute_metric(ImageMetric::SSIM, r, r, width, height, {}, &map), 1.0));
+	TEST_CHECK(std::all_of(map.begin(), map.end(), [](float v) { return near(v, 1.0, 1e-4); }));
+	TEST_CHECK(compute_metric(ImageMetric::FLIP, r, r, width, height) == 0.0);
+
+	// A constant offset of the color, alpha differs as well but is ignored
+	const float offset = 0.1f;
+	std::vector<float> test = ref;
+	for (size_t i = 0; i < test.size(); i++) {
+		test[i] += i % 4 == 3 ? 5.0f : offset;
+	}
+	const ImageMetricSettings settings;
+	double rel_mse = 0.0, mape = 0.0, max_offset = 0.0;
+	for (size_t i = 0; i < ref.size(); i++) {
+		if (i % 4 == 3) {
+			continue;
+		}
+		// The offset as it comes out of the float addition
+		const double d = double(test[i]) - ref[i];
+		rel_mse += d * d / (double(ref[i]) * ref[i] + settings.epsilon);
+		mape += std::abs(d) / (std::abs(ref[i]) + settings.epsilon);
+		max_offset = std::max(max_offset, std::abs(d - offset));
+	}
+	const double channels = 3.0 * width * height;
+	TEST_CHECK(max_offset < 1e-6);
+	TEST_CHECK(near(compute_metric(ImageMetric::MSE, test.data(), r, width, height, settings, &map),
+					offset * offset, 1e-4));
+	TEST_CHECK(std::all_of(map.begin(), map.end(), [&](float v) { return near(v, offset * offset, 1e-4); }));
+	TEST_CHECK(near(compute_metric(ImageMetric::RMSE, test.data(), r, width, height), offset, 1e-4));
+	TEST_CHECK(near(compute_metric(ImageMetric::RelMSE, test.data(), r, width, height), rel_mse / channels));
+	TEST_CHECK(near(compute_metric(ImageMetric::MAPE, test.data(), r, width, height), mape / channels));
+	// Symmetric in the squared error
+	TEST_CHECK(near(compute_metric(ImageMetric::MSE, r, test.data(), width, height), offset * offset, 1e-4));
+
+	// Constant images of luminance a and b: no variance or covariance, SSIM is (2ab + C1) / (a^2 + b^2 + C1)
+	const std::vector<float> a = constant_image(width, height, 0.5f);
+	const std::vector<float> b = constant_image(width, height, 0.6f);
+	constexpr double C1 = 1e-4;
+	TEST_CHECK(near(compute_metric(ImageMetric::SSIM, a.data(), b.data(), width, height),
+					(2.0 * 0.5 * 0.6 + C1) / (0.25 + 0.36 + C1), 1e-4));
+	// One stop down halves both
+	ImageMetricSettings darker;
+	darker.exposure = -1.0f;
+	TEST_CHECK(near(compute_metric(ImageMetric::SSIM, a.data(), b.data(), width, height, darker),
+					(2.0 * 0.25 * 0.3 + C1) / (0.0625 + 0.09 + C1), 1e-4));
+
+	// FLIP stays in [0, 1] and grows with the difference
+	const std::vector<float> c = constant_image(width, height, 0.9f);
+	const double flip_ab = compute_metric(ImageMetric::FLIP, a.data(), b.data(), width, height, {}, &map);
+	const double flip_ac = compute_metric(ImageMetric::FLIP, a.data(), c.data(), width, height);
+	TEST_CHECK(flip_ab > 0.0 && flip_ab < flip_ac && flip_ac <= 1.0);
+	TEST_CHECK(std::all_of(map.begin(), map.end(), [](float v) { return v >= 0.0f && v <= 1.0f; }));
+	const double flip_offset = compute_metric(ImageMetric::FLIP, test.data(), r, width, height);
+	TEST_CHECK(flip_offset > 0.0 && flip_offset <= 1.0);
+}
+
+int main() {
+	Logger::init();
+	ThreadPool::init(4);
+	std::mt19937 rng(3);
+	test_size(rng, 1, 1);
+	test_size(rng, 37, 23);
+	test_size(rng, 131, 150);
+
+	TEST_CHECK(!strcmp(metric_name(ImageMetric::RelMSE), "relMSE"));
+	TEST_CHECK(compute_metric(ImageMetric::MSE, nullptr, nullptr, 0, 0) == 0.0);
+
+	// The heatmap runs from the bottom to the top of the map, clamped above max_value
+	const float values[] = {0.0f, 1.0f, 2.0f, -1.0f};
+	const std::vector<float> heatmap = error_heatmap(values, 1.0f);
+	TEST_CHECK(heatmap.size() == 16);
+	TEST_CHECK(near(heatmap[0], std::pow(0.001f, 2.2f)) && near(heatmap[2], std::pow(0.014f, 2.2f)));
+	TEST_CHECK(near(heatmap[4], std::pow(0.987f, 2.2f)) && near(heatmap[6], std::pow(0.750f, 2.2f)));
+	TEST_CHECK(std::equal(heatmap.begin() + 4, heatmap.begin() + 8, heatmap.begin() + 8));
+	TEST_CHECK(std::equal(heatmap.begin(), heatmap.begin() + 4, heatmap.begin() + 12));
+	TEST_CHECK(heatmap[3] == 1.0f && heatmap[7] == 1.0f);
+	ThreadPool::destroy();
+	return test_result("ImageMetricsTest");
+}
@@ -0,0 +1,113 @@
+#include "TestUtils.h"
+#include "Framework/PassScheduler.h"
+#include <random>
+
+// Every pass shows up exactly once, either in the order or as culled
+static void check_complete(const PassSchedule& schedule, uint32_t pass_count) {
+	std::vector<uint32_t> seen(pass_count, 0);
+	for (uint32_t pass_idx : schedule.order) {
+		seen[pass_idx]++;
+	}
+	for (uint32_t pass_idx : schedule.culled) {
+		seen[pass_idx]++;
+	}
+	TEST_CHECK(std::all_of(seen.begin(), seen.end(), [](uint32_t count) { return count == 1; }));
+}
+
+// The accesses to a resource run in declaration order, reads included since the sync planner chains them
+static void check_order(std::span<const PassAccesses> passes, const PassSchedule& schedule) {
+	std::vector<uint32_t> positions(passes.size(), UINT32_MAX);
+	for (uint32_t pos = 0; pos < schedule.order.size(); pos++) {
+		positions[schedule.order[pos]] = pos;
+	}
+	std::unordered_map<uint64_t, uint32_t> last_access;
+	for (uint32_t i = 0; i < passes.size(); i++) {
+		if (positions[i] == UINT32_MAX) {
+			continue;
+		}
+		auto access = [&](uint64_t resource) {
+			auto it = last_access.find(resource);
+			if (it != last_access.end()) {
+				TEST_CHECK(positions[it->second] <= positions[i]);
+			}
+			last_access[resource] = i;
+		};
+		for (uint64_t resource : passes[i].reads) {
+			access(resource);
+		}
+		for (uint64_t resource : passes[i].writes) {
+			access(resource);
+		}
+	}
+}
+
+int main() {
+	Logger::init();
+	std::mt19937 rng(42);
+	for (uint32_t iter = 0; iter < 500; iter++) {
+		const uint32_t pass_count = 1 + rng() % 40;
+		const uint32_t resource_count = 1 + rng() % 12;
+		std::vector<PassAccesses> passes(pass_count);
+		for (auto& pass : passes) {
+			for (uint32_t r = 0; r < resource_count; r++) {
+				const uint32_t roll = rng() % 8;
+				if (roll == 0) {
+					pass.writes.push_back(r);
+				} else if (roll == 1) {
+					pass.reads.push_back(r);
+				}
+			}
+			pass.side_effects = rng() % 10 == 0;
+		}
+		std::unordered_set<uint64_t> transients;
+		for (uint32_t r = 0; r < resource_count; r++) {
+			if (rng() % 2) {
+				transients.insert(r);
+			}
+		}
+		for (uint32_t mode = 0; mode < 4; mode++) {
+			const bool cull = mode & 1;
+			const bool reorder = mode & 2;
+			const PassSchedule schedule = schedule_passes(passes, transients, cull, reorder);
+			check_complete(schedule, pass_count);
+			check_order(passes, schedule);
+			if (!cull) {
+				TEST_CHECK(schedule.culled.empty());
+			}
+			for (uint32_t pass_idx : schedule.culled) {
+				TEST_CHECK(!passes[pass_idx].side_effects);
+				TEST_CHECK(!passes[pass_idx].writes.empty());
+			}
+		}
+	}
+
+	// A writes X, B and C read it, D is independent. Reordering may move D in between, but never C before B
+	{
+		std::vector<PassAccesses> passes = {{.writes = {0}}, {.reads = {0}, .writes = {1}}, {.reads = {0}, .writes = {2}},
+											{.writes = {3}}};
+		const PassSchedule schedule = schedule_passes(passes, {}, false, true);
+		check_order(passes, schedule);
+		TEST_CHECK(schedule.order.size() == 4);
+	}
+
+	// Culling: 0 -> 1 feed a transient nobody reads, 2 writes it as well but has side effects, 3 writes a persistent
+	// resource and 4 writes nothing tracked
+	{
+		std::vector<PassAccesses> passes = {{.writes = {10}},
+											{.reads = {10}, .writes = {11}},
+											{.writes = {11}, .side_effects = true},
+											{.reads = {11}, .writes = {20}},
+											{.reads = {10}}};
+		const PassSchedule schedule = schedule_passes(passes, {10, 11}, true, false);
+		check_complete(schedule, (uint32_t)passes.size());
+		// 3 reads 11, so 1 stays, which keeps 0 alive through 10
+		TEST_CHECK(schedule.culled.empty());
+
+		passes[3].reads.clear();
+		passes[4].reads.clear();
+		const PassSchedule culled_schedule = schedule_passes(passes, {10, 11}, true, false);
+		TEST_CHECK((culled_schedule.culled == std::vector<uint32_t>{0, 1}));
+		TEST_CHECK((culled_schedule.order == std::vector<uint32_t>{2, 3, 4}));
+	}
+	return test_result("PassSchedulerTest");
+}
@@ -0,0 +1,162 @@
+#include "TestUtils.h"
+#include "Framework/ResourceRegistry.h"
+#include "Framework/SyncPlanner.h"
+#include <random>
+
+struct FakeBuffer {
+	uint64_t native = 0;
+	ResourceHandle rg_handle;
+};
+
+struct FakePass {
+	std::vector<uint32_t> buffers;
+	std::vector<bool> writes;
+};
+
+static std::vector<FakePass> random_passes(std::mt19937& rng, uint32_t pass_count, uint32_t buffer_count) {
+	std::vector<FakePass> passes(pass_count);
+	for (auto& pass : passes) {
+		const uint32_t access_count = 1 + rng() % 6;
+		for (uint32_t a = 0; a < access_count; a++) {
+			pass.buffers.push_back(rng() % buffer_count);
+			pass.writes.push_back(rng() % 3 == 0);
+		}
+	}
+	return passes;
+}
+
+// Checksum of the decisions, with the resources identified by their native handles so that plans over
+// different resource indices compare equal
+static uint64_t plan_checksum(const SyncPlan& plan, const std::vector<uint64_t>& natives) {
+	uint64_t checksum = 0;
+	for (const SyncOp& op : plan.ops) {
+		checksum = checksum * 31 + (uint64_t)op.action * 7919 + op.src_pass * 131 + op.dst_pass;
+		checksum = checksum * 31 + natives[op.resource];
+	}
+	return checksum;
+}
+
+// What the render graph does per frame: every access is resolved to its registry slot, the planning runs on the
+// slots. The frame goes through simulate_sync, the declared-pass entry point of the sync planner
+static uint64_t plan_frame(ResourceRegistry& registry, std::vector<FakeBuffer>& buffers,
+						   const std::vector<FakePass>& passes, std::vector<SimResource>& resources,
+						   std::vector<SimPass>& sim_passes, std::vector<uint64_t>& natives) {
+	sim_passes.resize(passes.size());
+	for (size_t p = 0; p < passes.size(); p++) {
+		sim_passes[p].accesses.resize(passes[p].buffers.size());
+		for (size_t a = 0; a < passes[p].buffers.size(); a++) {
+			FakeBuffer& buffer = buffers[passes[p].buffers[a]];
+			const uint32_t resource = registry.resolve(buffer.rg_handle, buffer.native);
+			if (resource >= resources.size()) {
+				resources.resize(registry.capacity());
+				natives.resize(registry.capacity());
+			}
+			natives[resource] = buffer.native;
+			sim_passes[p].accesses[a] = {.resource = resource, .write = passes[p].writes[a]};
+		}
+	}
+	return plan_checksum(simulate_sync(resources, sim_passes), natives);
+}
+
+// Same frame with the ids looked up by the native handles, like before the registry
+static uint64_t plan_frame_map(const std::vector<FakeBuffer>& buffers, const std::vector<FakePass>& passes,
+							   std::vector<SimPass>& sim_passes) {
+	std::unordered_map<uint64_t, uint32_t> ids;
+	std::vector<uint64_t> natives;
+	sim_passes.resize(passes.size());
+	for (size_t p = 0; p < passes.size(); p++) {
+		sim_passes[p].accesses.resize(passes[p].buffers.size());
+		for (size_t a = 0; a < passes[p].buffers.size(); a++) {
+			const uint64_t native = buffers[passes[p].buffers[a]].native;
+			auto [it, inserted] = ids.try_emplace(native, (uint32_t)natives.size());
+			if (inserted) {
+				natives.push_back(native);
+			}
+			sim_passes[p].accesses[a] = {.resource = it->second, .write = passes[p].writes[a]};
+		}
+	}
+	const std::vector<SimResource> resources(natives.size());
+	return plan_checksum(simulate_sync(resources, sim_passes), natives);
+}
+
+static void test_handles() {
+	ResourceRegistry registry;
+	FakeBuffer a{.native = 0x100}, b{.native = 0x200};
+	bool registered;
+	const uint32_t a_idx = registry.resolve(a.rg_handle, a.native, &registered);
+	TEST_CHECK(registered && a_idx == 0);
+	TEST_CHECK(registry.resolve(b.rg_handle, b.native, &registered) == 1 && registered);
+	TEST_CHECK(registry.resolve(a.rg_handle, a.native, &registered) == a_idx && !registered);
+
+	// A copy of a made before its first use ends up in the same slot
+	FakeBuffer a_copy{.native = a.native};
+	TEST_CHECK(registry.resolve(a_copy.rg_handle, a_copy.native, &registered) == a_idx && !registered);
+
+	// Recreating a recycles its slot, copies holding the old handle go stale
+	const ResourceHandle old_handle = a.rg_handle;
+	a.native = 0x300;
+	TEST_CHECK(registry.resolve(a.rg_handle, a.native, &registered) == a_idx && registered);
+	TEST_CHECK(a.rg_handle.generation != old_handle.generation);
+	TEST_CHECK(!registry.is_current(old_handle));
+	TEST_CHECK(registry.is_current(a.rg_handle));
+
+	registry.release(b.rg_handle);
+	TEST_CHECK(!b.rg_handle.valid());
+	TEST_CHECK(registry.capacity() == 2);
+	const ResourceHandle a_handle = a.rg_handle;
+	registry.clear();
+	TEST_CHECK(!registry.is_current(a_handle));
+}
+
+int main(int argc, char** argv) {
+	Logger::init();
+	test_handles();
+
+	// Dense slots give the same decisions as the ids looked up by handle, and the slot count stays at the number
+	// of resources over the frames. Prints the planning time per pass for both
+	const bool bench = argc > 1 && std::string(argv[1]) == "--bench";
+	const uint32_t frames = bench ? 200 : 10;
+	std::mt19937 rng(5);
+	for (uint32_t pass_count : {50u, 500u, 5000u}) {
+		const uint32_t buffer_count = pass_count / 2 + 8;
+		std::vector<FakeBuffer> buffers(buffer_count);
+		for (uint32_t i = 0; i < buffer_count; i++) {
+			buffers[i].native = 0x1000 + i * 64;
+		}
+		const std::vector<FakePass> passes = random_passes(rng, pass_count, buffer_count);
+		ResourceRegistry registry;
+		std::vector<SimResource> resources;
+		std::vector<SimPass> sim_passes;
+		std::vector<uint64_t> natives;
+
+		uint64_t registry_checksum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < frames; frame++) {
+			registry_checksum = plan_frame(registry, buffers, passes, resources, sim_passes, natives);
+		}
+		const double registry_ms =
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		uint64_t map_checksum = 0;
+		std::vector<SimPass> map_passes;
+		start = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < frames; frame++) {
+			map_checksum = plan_frame_map(buffers, passes, map_passes);
+		}
+		const double map_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		TEST_CHECK(registry_checksum == map_checksum);
+		TEST_CHECK(registry.capacity() <= buffer_count);
+		printf("%5u passes: %.3f us/pass with the registry, %.3f us/pass keyed by handle\n", pass_count,
+			   1000.0 * registry_ms / (frames * pass_count), 1000.0 * map_ms / (frames * pass_count));
+
+		// Recreating a few resources keeps the slot count and the decisions
+		for (uint32_t i = 0; i < buffer_count; i += 7) {
+			buffers[i].native += 0x100000;
+		}
+		TEST_CHECK(plan_frame(registry, buffers, passes, resources, sim_passes, natives) ==
+				   plan_frame_map(buffers, passes, map_passes));
+		TEST_CHECK(registry.capacity() <= buffer_count);
+	}
+	return test_result("ResourceRegistryTest");
+}
@@ -0,0 +1,129 @@
+#include "TestUtils.h"
+#include "Framework/SyncPlanner.h"
+#include <random>
+
+static const SyncOp* find_op(const SyncPlan& plan, uint32_t dst_pass, uint32_t resource) {
+	for (const SyncOp& op : plan.ops) {
+		if (op.dst_pass == dst_pass && op.resource == resource) {
+			return &op;
+		}
+	}
+	return nullptr;
+}
+
+int main() {
+	Logger::init();
+
+	// Write, two reads and a write of a buffer: only the first read and the last write wait
+	{
+		const SimResource resources[] = {{.name = "buf"}};
+		const SimPass passes[] = {{"write", {{0, true}}},
+								  {"read0", {{0, false}}},
+								  {"read1", {{0, false}}},
+								  {"write_again", {{0, true}}}};
+		const SyncPlan plan = simulate_sync(resources, passes);
+		TEST_CHECK(plan.ops.size() == 2);
+		const SyncOp* raw = find_op(plan, 1, 0);
+		TEST_CHECK(raw && raw->action == SyncAction::Event && raw->src_pass == 0);
+		TEST_CHECK(raw && raw->src_access_flags == VK_ACCESS_SHADER_WRITE_BIT &&
+				   raw->dst_access_flags == VK_ACCESS_SHADER_READ_BIT);
+		TEST_CHECK(!find_op(plan, 2, 0));
+		const SyncOp* war = find_op(plan, 3, 0);
+		TEST_CHECK(war && war->action == SyncAction::Event && war->src_pass == 2);
+		const SyncPlanStats stats = sync_plan_stats(plan);
+		TEST_CHECK(stats.events == 2 && stats.signals == 2 && stats.barriers == 0 && stats.redundant_waits == 0);
+		TEST_CHECK(sync_plan_to_json(plan).find("\"write_again\"") != std::string::npos);
+		TEST_CHECK(sync_plan_to_dot(plan).find("p2 -> p3") != std::string::npos);
+	}
+
+	// A write followed by a read in the same pass is a barrier, transfer writes carry over to the waiting access
+	{
+		const SimResource resources[] = {{.name = "buf"}};
+		const SimPass passes[] = {{"copy", {{0, true, VK_ACCESS_TRANSFER_WRITE_BIT}, {0, false}}},
+								  {"read", {{0, false}}}};
+		const SyncPlan plan = simulate_sync(resources, passes);
+		const SyncOp* barrier = find_op(plan, 0, 0);
+		TEST_CHECK(barrier && barrier->action == SyncAction::Barrier);
+		TEST_CHECK(barrier && barrier->dst_access_flags == (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT));
+		const SyncOp* event = find_op(plan, 1, 0);
+		TEST_CHECK(!event);
+	}
+
+	// Sampled storage image: written in GENERAL, read in READ_ONLY_OPTIMAL
+	{
+		const SimResource resources[] = {{.name = "img", .image = true, .storage = true, .sampled = true}};
+		const SimPass passes[] = {{"write", {{0, true}}}, {"read", {{0, false}}}};
+		const SyncPlan plan = simulate_sync(resources, passes);
+		TEST_CHECK(plan.ops.size() == 2);
+		const SyncOp* init = find_op(plan, 0, 0);
+		TEST_CHECK(init && init->action == SyncAction::Transition && init->old_layout == VK_IMAGE_LAYOUT_UNDEFINED &&
+				   init->new_layout == VK_IMAGE_LAYOUT_GENERAL);
+		const SyncOp* read = find_op(plan, 1, 0);
+		TEST_CHECK(read && read->action == SyncAction::Event && read->src_pass == 0 &&
+				   read->old_layout == VK_IMAGE_LAYOUT_GENERAL &&
+				   read->new_layout == VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+		// A read-only texture that is already in its layout needs nothing
+		const SimResource textures[] = {
+			{.name = "tex", .image = true, .storage = false, .sampled = true,
+			 .initial_layout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL}};
+		const SimPass reads[] = {{"read", {{0, false}}}};
+		TEST_CHECK(simulate_sync(textures, reads).ops.empty());
+	}
+
+	// The wait of pass 2 on pass 0 is implied by pass 1, which already waited on pass 0
+	{
+		const SimResource resources[] = {{.name = "a"}, {.name = "b"}, {.name = "c"}};
+		const SimPass passes[] = {{"produce", {{0, true}, {1, true}}},
+								  {"middle", {{0, false}, {2, true}}},
+								  {"consume", {{2, false}, {1, false}}}};
+		const SyncPlan plan = simulate_sync(resources, passes);
+		const std::vector<bool> redundant = find_redundant_waits(plan);
+		for (size_t i = 0; i < plan.ops.size(); i++) {
+			TEST_CHECK(redundant[i] == (plan.ops[i].dst_pass == 2 && plan.ops[i].resource == 1));
+		}
+		TEST_CHECK(sync_plan_stats(plan).redundant_waits == 1);
+	}
+
+	// Random buffer accesses: every pair of accesses in different passes with a write among them is covered by an
+	// event signalled at or after the first one and waited on at or before the second one. A wait covers everything
+	// recorded after it, which is how reads after reads are covered by the first read's wait
+	std::mt19937 rng(7);
+	for (uint32_t iter = 0; iter < 300; iter++) {
+		const uint32_t resource_count = 1 + rng() % 6;
+		const uint32_t pass_count = 1 + rng() % 24;
+		std::vector<SimResource> resources(resource_count);
+		std::vector<SimPass> passes(pass_count);
+		for (auto& pass : passes) {
+			for (uint32_t r = 0; r < resource_count; r++) {
+				if (rng() % 3 == 0) {
+					pass.accesses.push_back({r, rng() % 2 == 0});
+				}
+			}
+		}
+		const SyncPlan plan = simulate_sync(resources, passes);
+		for (uint32_t r = 0; r < resource_count; r++) {
+			for (uint32_t i = 0; i < pass_count; i++) {
+				for (uint32_t j = i + 1; j < pass_count; j++) {
+					bool accessed_i = false, accessed_j = false, written = false;
+					for (const SimAccess& access : passes[i].accesses) {
+						accessed_i |= access.resource == r;
+						written |= access.resource == r && access.write;
+					}
+					for (const SimAccess& access : passes[j].accesses) {
+						accessed_j |= access.resource == r;
+						written |= access.resource == r && access.write;
+					}
+					if (!accessed_i || !accessed_j || !written) {
+						continue;
+					}
+					const bool covered = std::any_of(plan.ops.begin(), plan.ops.end(), [&](const SyncOp& op) {
+						return op.action == SyncAction::Event && op.resource == r && i <= op.src_pass &&
+							   op.src_pass < op.dst_pass && op.dst_pass <= j;
+					});
+					TEST_CHECK(covered);
+				}
+			}
+		}
+	}
+	return test_result("SyncPlannerTest");
+}
@@ -0,0 +1,102 @@
+#include "TestUtils.h"
+#include "Framework/TLSFAllocator.h"
+#include <random>
+
+struct LiveAllocation {
+	uint32_t handle;
+	uint64_t size;
+	uint64_t alignment;
+};
+
+// The live allocations are aligned, inside the block and don't overlap
+static void check_allocations(const TLSFAllocator& tlsf, const std::vector<LiveAllocation>& live) {
+	std::vector<std::pair<uint64_t, uint64_t>> ranges;
+	uint64_t used = 0;
+	for (const LiveAllocation& allocation : live) {
+		const uint64_t offset = tlsf.offset(allocation.handle);
+		TEST_CHECK(offset % allocation.alignment == 0);
+		TEST_CHECK(offset + allocation.size <= tlsf.size());
+		TEST_CHECK(tlsf.allocation_size(allocation.handle) == allocation.size);
+		ranges.push_back({offset, allocation.size});
+		used += allocation.size;
+	}
+	std::sort(ranges.begin(), ranges.end());
+	for (size_t i = 1; i < ranges.size(); i++) {
+		TEST_CHECK(ranges[i - 1].first + ranges[i - 1].second <= ranges[i].first);
+	}
+	TEST_CHECK(tlsf.used() == used);
+	TEST_CHECK(tlsf.allocation_count() == live.size());
+}
+
+int main() {
+	Logger::init();
+	constexpr uint64_t BLOCK_SIZE = 64ull << 20;
+	std::mt19937_64 rng(99);
+	for (uint32_t round = 0; round < 4; round++) {
+		TLSFAllocator tlsf(BLOCK_SIZE);
+		TEST_CHECK(tlsf.validate());
+		std::vector<LiveAllocation> live;
+		uint32_t failed_allocations = 0;
+		for (uint32_t step = 0; step < 20000; step++) {
+			// Biased towards allocating in the first half of the round, towards freeing in the second
+			const bool alloc = live.empty() || rng() % 100 < (step < 10000 ? 60u : 35u);
+			if (alloc) {
+				// Mostly small, sometimes a few MB, like buffers and textures
+				const uint64_t size = rng() % 8 ? 1 + rng() % (256 << 10) : 1 + rng() % (8 << 20);
+				const uint64_t alignment = 1ull << (rng() % 17);
+				const uint32_t handle = tlsf.allocate(size, alignment);
+				if (handle == TLSFAllocator::INVALID) {
+					failed_allocations++;
+				} else {
+					live.push_back({handle, size, alignment});
+				}
+			} else {
+				const size_t i = rng() % live.size();
+				tlsf.free(live[i].handle);
+				live[i] = live.back();
+				live.pop_back();
+			}
+			if (!tlsf.validate()) {
+				TEST_CHECK(!"validate() failed");
+				break;
+			}
+			if (step % 500 == 0) {
+				check_allocations(tlsf, live);
+			}
+		}
+		check_allocations(tlsf, live);
+		for (const LiveAllocation& allocation : live) {
+			tlsf.free(allocation.handle);
+		}
+		TEST_CHECK(tlsf.validate());
+		// Everything merged back into one range
+		TEST_CHECK(tlsf.empty() && tlsf.used() == 0);
+		TEST_CHECK(tlsf.free_range_count() == 1);
+		TEST_CHECK(tlsf.largest_free_range() == BLOCK_SIZE);
+		printf("round %u: %u allocations didn't fit\n", round, failed_allocations);
+	}
+
+	// A request for the whole block fits exactly, anything on top of it doesn't
+	TLSFAllocator tlsf(1 << 20);
+	const uint32_t full = tlsf.allocate(1 << 20, 256);
+	TEST_CHECK(full != TLSFAllocator::INVALID && tlsf.offset(full) == 0);
+	TEST_CHECK(tlsf.allocate(1) == TLSFAllocator::INVALID);
+	TEST_CHECK(tlsf.largest_free_range() == 0);
+	tlsf.free(full);
+	TEST_CHECK(tlsf.allocate((1 << 20) + 1) == TLSFAllocator::INVALID);
+	TEST_CHECK(tlsf.allocate(0) == TLSFAllocator::INVALID);
+	TEST_CHECK(tlsf.validate());
+
+	// Alignment padding stays usable
+	const uint32_t first = tlsf.allocate(100);
+	const uint32_t aligned = tlsf.allocate(1000, 4096);
+	TEST_CHECK(tlsf.offset(aligned) == 4096);
+	const uint32_t in_padding = tlsf.allocate(1000);
+	TEST_CHECK(tlsf.offset(in_padding) < 4096);
+	TEST_CHECK(tlsf.validate());
+	tlsf.free(first);
+	tlsf.free(aligned);
+	tlsf.free(in_padding);
+	TEST_CHECK(tlsf.validate() && tlsf.free_range_count() == 1);
+	return test_result("TLSFAllocatorTest");
+}
@@ -0,0 +1,67 @@
+#include "TestUtils.h"
+#include "Framework/TaskGraph.h"
+#include <atomic>
+#include <stdexcept>
+
+int main() {
+	Logger::init();
+	ThreadPool::init(4);
+	const std::thread::id main_id = std::this_thread::get_id();
+
+	// Nodes start after their dependencies, main thread nodes run on the caller
+	{
+		TaskGraph graph;
+		std::atomic<uint32_t> step = 0;
+		bool on_main = false;
+		const auto a = graph.add("a", [&] { TEST_CHECK(step.fetch_add(1) == 0); });
+		const auto b = graph.add("b", [&] { step.fetch_add(1); }, {a});
+		const auto c = graph.add("c", [&] { step.fetch_add(1); }, {a});
+		graph.add("d", [&] {
+			on_main = std::this_thread::get_id() == main_id;
+			TEST_CHECK(step.load() == 3);
+		}, {b, c}, true);
+		graph.run();
+		TEST_CHECK(on_main);
+	}
+
+	// A throwing main thread node waits for the pool nodes that are running before its exception comes out, and
+	// their dependents don't start
+	{
+		TaskGraph graph;
+		std::atomic_bool slow_done = false;
+		std::atomic_bool dependent_ran = false;
+		const auto slow = graph.add("slow", [&] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			slow_done = true;
+		});
+		graph.add("dependent", [&] { dependent_ran = true; }, {slow});
+		graph.add("main", [] { throw std::runtime_error("main failed"); }, {}, true);
+		bool caught = false;
+		try {
+			graph.run();
+		} catch (const std::runtime_error&) {
+			caught = true;
+		}
+		TEST_CHECK(caught);
+		TEST_CHECK(slow_done);
+		TEST_CHECK(!dependent_ran);
+	}
+
+	// Same for a pool node
+	{
+		TaskGraph graph;
+		std::atomic_bool main_ran = false;
+		const auto failing = graph.add("failing", [] { throw std::runtime_error("pool failed"); });
+		graph.add("main", [&] { main_ran = true; }, {failing}, true);
+		bool caught = false;
+		try {
+			graph.run();
+		} catch (const std::runtime_error&) {
+			caught = true;
+		}
+		TEST_CHECK(caught);
+		TEST_CHECK(!main_ran);
+	}
+	ThreadPool::destroy();
+	return test_result("TaskGraphTest");
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Framework/Logger.h"
+#include "Framework/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Minimal checks for the tests, a failed check is reported and the test keeps going
+
+inline int& test_failures() {
+	static int failures = 0;
+	return failures;
+}
+
+#define TEST_CHECK(x)                                                                \
+	do {                                                                             \
+		if (!(x)) {                                                                  \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+			test_failures()++;                                                       \
+		}                                                                            \
+	} while (0)
+
+// Return value of main()
+inline int test_result(const char* name) {
+	if (test_failures()) {
+		fprintf(stderr, "%s: %d check(s) failed\n", name, test_failures());
+		return EXIT_FAILURE;
+	}
+	printf("%s: passed\n", name);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+#include "TestUtils.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+
+// Meant to run under TSan as well (LUMEN_SANITIZE=thread), the worker count comes from the command line.
+// ThreadPoolTest [workers] --bench times the scheduler with the micro-benchmarks below instead
+
+// The owner pushes and pops while the other threads steal, every item has to come out exactly once
+static void test_deque(uint32_t thief_count) {
+	constexpr uint32_t ITEM_COUNT = 200000;
+	WorkStealingDeque deque(4);
+	std::vector<std::atomic<uint32_t>> taken(ITEM_COUNT);
+	std::atomic_bool owner_done = false;
+	auto take = [&](Task* task) {
+		// The deque never dereferences the tasks, the items are indices in disguise
+		taken[(uintptr_t)task - 1].fetch_add(1, std::memory_order_relaxed);
+	};
+	std::vector<std::thread> thieves;
+	for (uint32_t i = 0; i < thief_count; i++) {
+		thieves.emplace_back([&] {
+			while (!owner_done.load(std::memory_order_acquire)) {
+				if (Task* task = deque.steal()) {
+					take(task);
+				}
+			}
+			while (Task* task = deque.steal()) {
+				take(task);
+			}
+		});
+	}
+	for (uint32_t i = 0; i < ITEM_COUNT; i++) {
+		deque.push((Task*)(uintptr_t)(i + 1));
+		if (i % 3 == 0) {
+			if (Task* task = deque.pop()) {
+				take(task);
+			}
+		}
+	}
+	while (Task* task = deque.pop()) {
+		take(task);
+	}
+	owner_done.store(true, std::memory_order_release);
+	for (auto& thief : thieves) {
+		thief.join();
+	}
+	uint32_t wrong = 0;
+	for (auto& count : taken) {
+		wrong += count.load() != 1;
+	}
+	TEST_CHECK(wrong == 0);
+}
+
+static void test_task_groups() {
+	std::atomic<uint32_t> counter = 0;
+	{
+		TaskGroup group;
+		for (uint32_t i = 0; i < 10000; i++) {
+			group.run([&counter] { counter.fetch_add(1, std::memory_order_relaxed); });
+		}
+		group.wait();
+		TEST_CHECK(counter.load() == 10000);
+	}
+
+	// Groups waited on from inside tasks, every level runs the tasks of the others while waiting
+	counter = 0;
+	{
+		TaskGroup outer;
+		for (uint32_t i = 0; i < 64; i++) {
+			outer.run("outer", [&counter] {
+				TaskGroup inner;
+				for (uint32_t j = 0; j < 64; j++) {
+					inner.run("inner", [&counter] { counter.fetch_add(1, std::memory_order_relaxed); });
+				}
+				inner.wait();
+			});
+		}
+		outer.wait();
+		TEST_CHECK(counter.load() == 64 * 64);
+	}
+
+	// The first exception comes out of wait(), the other tasks still run
+	counter = 0;
+	bool caught = false;
+	{
+		TaskGroup group;
+		for (uint32_t i = 0; i < 100; i++) {
+			group.run([&counter, i] {
+				counter.fetch_add(1, std::memory_order_relaxed);
+				if (i % 10 == 0) {
+					throw std::runtime_error("task failed");
+				}
+			});
+		}
+		try {
+			group.wait();
+		} catch (const std::runtime_error&) {
+			caught = true;
+		}
+	}
+	TEST_CHECK(caught);
+	TEST_CHECK(counter.load() == 100);
+
+	// Plain submits with results, including one that doesn't fit the inline storage of a task
+	std::array<uint64_t, 32> big_capture = {};
+	big_capture[31] = 5;
+	auto small = ThreadPool::submit([](uint32_t a, uint32_t b) { return a + b; }, 2u, 3u);
+	auto big = ThreadPool::submit([big_capture] { return big_capture[31]; });
+	TEST_CHECK(small.get() == 5);
+	TEST_CHECK(big.get() == 5);
+}
+
+static void test_parallel_loops() {
+	constexpr uint32_t COUNT = 1 << 20;
+	std::vector<uint32_t> values(COUNT, 0);
+	ThreadPool::parallel_for(0, COUNT, [&values](uint32_t i) { values[i] += i; }, 1024);
+	uint32_t wrong = 0;
+	for (uint32_t i = 0; i < COUNT; i++) {
+		wrong += values[i] != i;
+	}
+	TEST_CHECK(wrong == 0);
+
+	// Nested inside another loop
+	std::vector<std::atomic<uint32_t>> hits(64 * 64);
+	ThreadPool::parallel_for(0, 64, [&hits](uint32_t i) {
+		ThreadPool::parallel_for(0, 64, [&hits, i](uint32_t j) { hits[i * 64 + j].fetch_add(1); });
+	});
+	TEST_CHECK(std::all_of(hits.begin(), hits.end(), [](const auto& hit) { return hit.load() == 1; }));
+
+	// Float sums come out the same every time, the chunks are combined in order
+	auto map = [](uint32_t i) { return 1.0f / float(i + 1); };
+	auto sum = [](float a, float b) { return a + b; };
+	const float reference = ThreadPool::parallel_reduce(0u, COUNT, 0.0f, map, sum, 256);
+	for (uint32_t i = 0; i < 8; i++) {
+		TEST_CHECK(ThreadPool::parallel_reduce(0u, COUNT, 0.0f, map, sum, 256) == reference);
+	}
+	TEST_CHECK(std::abs(reference - 14.44f) < 1e-2f);
+	TEST_CHECK(ThreadPool::parallel_reduce(5u, 5u, 7.0f, map, sum) == 7.0f);
+}
+
+template <typename F>
+static double time_ms(F&& f) {
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Submit overhead, fork/join of small groups and a memory-bound loop
+static void bench() {
+	constexpr uint32_t SUBMITS = 200000;
+	std::vector<std::future<void>> futures;
+	futures.reserve(SUBMITS);
+	const double submit_ms = time_ms([&futures] {
+		for (uint32_t i = 0; i < SUBMITS; i++) {
+			futures.push_back(ThreadPool::submit([] {}));
+		}
+		for (auto& future : futures) {
+			future.get();
+		}
+	});
+	printf("%u empty submits: %.1f ms\n", SUBMITS, submit_ms);
+
+	constexpr uint32_t GROUPS = 2000;
+	std::atomic<uint32_t> counter = 0;
+	const double group_ms = time_ms([&counter] {
+		for (uint32_t g = 0; g < GROUPS; g++) {
+			TaskGroup group;
+			for (uint32_t i = 0; i < 64; i++) {
+				group.run([&counter] { counter.fetch_add(1, std::memory_order_relaxed); });
+			}
+			group.wait();
+		}
+	});
+	TEST_CHECK(counter.load() == GROUPS * 64);
+	printf("%u groups of 64 tiny tasks: %.1f ms\n", GROUPS, group_ms);
+
+	constexpr uint32_t COUNT = 1 << 24;
+	std::vector<float> values(COUNT, 1.0f);
+	const double loop_ms = time_ms([&values] {
+		for (uint32_t r = 0; r < 20; r++) {
+			ThreadPool::parallel_for(0, COUNT, [&values](uint32_t i) { values[i] = values[i] * 0.5f + 1.0f; }, 4096);
+		}
+	});
+	TEST_CHECK(std::abs(values[COUNT - 1] - 2.0f) < 1e-3f);
+	printf("20x %u-element parallel_for: %.1f ms\n", COUNT, loop_ms);
+}
+
+int main(int argc, char** argv) {
+	Logger::init();
+	uint32_t worker_count = 4;
+	bool run_bench = false;
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--bench") {
+			run_bench = true;
+		} else {
+			worker_count = (uint32_t)std::max(1, atoi(argv[i]));
+		}
+	}
+	if (run_bench) {
+		ThreadPool::init(worker_count);
+		bench();
+		ThreadPool::destroy();
+		printf("%u worker(s)\n", worker_count);
+		return test_result("ThreadPoolTest");
+	}
+	test_deque(std::min(worker_count, 3u));
+
+	ThreadPool::init(worker_count);
+	test_task_groups();
+	test_parallel_loops();
+	// Again with the per worker counters on, they are written by the workers and read here
+	ThreadPool::set_profiling(true);
+	test_task_groups();
+	const ThreadPoolStats stats = ThreadPool::stats();
+	uint64_t executed = 0;
+	for (const auto& worker : stats.workers) {
+		executed += worker.tasks_executed;
+	}
+	TEST_CHECK(stats.workers.size() == worker_count + 1);
+	TEST_CHECK(executed >= 10000);
+	ThreadPool::set_profiling(false);
+	ThreadPool::destroy();
+	printf("%u worker(s)\n", worker_count);
+	return test_result("ThreadPoolTest");
+}
@@ -0,0 +1,73 @@
+#include "TestUtils.h"
+#include "Framework/TransientAllocator.h"
+#include <random>
+
+static std::vector<TransientRequest> random_requests(std::mt19937& rng, uint32_t count, uint32_t pass_count) {
+	std::vector<TransientRequest> requests(count);
+	for (auto& request : requests) {
+		request.size = 1 + rng() % (1 << 20);
+		request.alignment = 1ull << (rng() % 12);
+		request.memory_type_bits = rng() % 4 ? 0b0111 : 0b0100;
+		request.group = rng() % 2;
+		request.first_use = rng() % pass_count;
+		request.last_use = request.first_use + rng() % (pass_count - request.first_use);
+	}
+	return requests;
+}
+
+static void check_layout(std::span<const TransientRequest> requests, const TransientLayout& layout) {
+	TEST_CHECK(layout.placements.size() == requests.size());
+	for (uint32_t i = 0; i < requests.size(); i++) {
+		const TransientPlacement& placement = layout.placements[i];
+		TEST_CHECK(placement.heap_idx < layout.heaps.size());
+		const TransientHeap& heap = layout.heaps[placement.heap_idx];
+		TEST_CHECK(heap.group == requests[i].group);
+		TEST_CHECK(heap.memory_type_bits & requests[i].memory_type_bits);
+		TEST_CHECK(placement.offset % requests[i].alignment == 0);
+		TEST_CHECK(placement.offset + requests[i].size <= heap.size);
+		for (uint32_t j = i + 1; j < requests.size(); j++) {
+			if (transient_lifetimes_overlap(requests[i], requests[j])) {
+				TEST_CHECK(
+					!transient_ranges_overlap(placement, requests[i].size, layout.placements[j], requests[j].size));
+			}
+		}
+	}
+	TEST_CHECK(transient_layout_valid(requests, layout));
+}
+
+int main() {
+	Logger::init();
+	std::mt19937 rng(1234);
+	for (uint32_t iter = 0; iter < 200; iter++) {
+		const uint32_t pass_count = 1 + rng() % 32;
+		const auto requests = random_requests(rng, 1 + rng() % 48, pass_count);
+		check_layout(requests, place_transient_resources(requests));
+	}
+
+	// Disjoint lifetimes share memory, overlapping ones don't
+	std::vector<TransientRequest> requests = {
+		{.size = 1024, .first_use = 0, .last_use = 1},
+		{.size = 1024, .first_use = 2, .last_use = 3},
+		{.size = 512, .first_use = 1, .last_use = 2},
+	};
+	TransientLayout layout = place_transient_resources(requests);
+	check_layout(requests, layout);
+	TEST_CHECK(transient_ranges_overlap(layout.placements[0], 1024, layout.placements[1], 1024));
+	uint64_t heap_size = 0;
+	for (const TransientHeap& heap : layout.heaps) {
+		heap_size += heap.size;
+	}
+	TEST_CHECK(heap_size == 1536);
+
+	// A new pass order that keeps the aliased resources apart keeps the layout
+	requests[1].first_use = 3;
+	TEST_CHECK(transient_layout_valid(requests, layout));
+	// One that makes them overlap doesn't
+	requests[1].first_use = 1;
+	TEST_CHECK(!transient_layout_valid(requests, layout));
+	// Neither does a resource that grew out of its heap
+	requests[1].first_use = 2;
+	requests[2].size = 4096;
+	TEST_CHECK(!transient_layout_valid(requests, layout));
+	return test_result("TransientAllocatorTest");
+}